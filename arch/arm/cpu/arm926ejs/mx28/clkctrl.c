@@ -1861,7 +1861,7 @@ static int32_t gpmi_clk_set_rate(__in struct clk *clk, __in uint64_t rate)
     if((reminder << 1) > rate)
     {
         div ++;
-        if(div > 0x3ff);
+        if(div > 0x3ff)
             div--;
     }
 
@@ -2063,7 +2063,7 @@ static int32_t gpmi_clk_set_parent(__in struct clk *clk, __in struct clk *parent
 {
     assert(clk);
 
-    if((clk == &ref_xtal) || (clk == &ref_gpmi))
+    if((parent == &ref_xtal) || (parent == &ref_gpmi))
     {
         clk->parent = parent;
         return 0;
@@ -0,0 +1,390 @@
+#include "stddef.h"
+#include "errno.h"
+#include "common.h"
+#include "log.h"
+#include "exception_handle.h"
+#include "arch/arch-mx28/mx28_regs.h"
+#include "arch/arch-mx28/regs_icoll.h"
+#include "arch/arch-mx28/icoll.h"
+
+
+/* 中断处理函数描述 */
+struct irq_action
+{
+    irq_handler_t handler;  /* 中断处理函数 */
+    void *data;  /* 传给处理函数的参数 */
+    uint32_t count;  /* 中断发生次数 */
+};
+
+/* 中断处理函数表 */
+static struct irq_action irq_actions[ICOLL_IRQ_CNT];
+
+#ifdef CONFIG_USE_IRQ
+/* start.s中定义的栈地址 */
+extern uint32_t _armboot_start;
+extern uint32_t IRQ_STACK_START;
+extern uint32_t FIQ_STACK_START;
+#endif
+
+
+/********************************************************************************
+* 函数: int32_t icoll_init(void)
+* 描述: 初始化中断控制器，所有中断源默认关闭，使用同一个优先级
+* 输入: none
+* 输出: none
+* 返回: 0: 成功
+       -ETIMEDOUT: 复位超时
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+int32_t icoll_init(void)
+{
+    int32_t i;
+
+    /* 复位中断控制器 */
+    REG_CLR(REGS_ICOL_BASE, HW_ICOLL_CTRL, BM_ICOLL_CTRL_SFTRST);
+    mdelay(2);
+    REG_CLR(REGS_ICOL_BASE, HW_ICOLL_CTRL, BM_ICOLL_CTRL_CLKGATE);
+    REG_SET(REGS_ICOL_BASE, HW_ICOLL_CTRL, BM_ICOLL_CTRL_SFTRST);
+    for(i = 1000000; i > 0; --i)
+    {
+        if(REG_RD(REGS_ICOL_BASE, HW_ICOLL_CTRL) & BM_ICOLL_CTRL_CLKGATE)
+            break;
+
+        udelay(1);
+    }
+    /* 复位超时 */
+    if(i <= 0)
+    {
+        printl(LOG_LEVEL_ERR, "[ICOLL:ERR] reset icoll block timeout.\n");
+        return -ETIMEDOUT;
+    }
+
+    REG_CLR(REGS_ICOL_BASE, HW_ICOLL_CTRL, BM_ICOLL_CTRL_SFTRST);
+    mdelay(2);
+    REG_CLR(REGS_ICOL_BASE, HW_ICOLL_CTRL, BM_ICOLL_CTRL_CLKGATE);
+
+    for(i = 1000000; i > 0; --i)
+    {
+        if(!(REG_RD(REGS_ICOL_BASE, HW_ICOLL_CTRL) & BM_ICOLL_CTRL_CLKGATE))
+            break;
+
+        udelay(1);
+    }
+    /* 复位超时 */
+    if(i <= 0)
+    {
+        printl(LOG_LEVEL_ERR, "[ICOLL:ERR] reset icoll block timeout.\n");
+        return -ETIMEDOUT;
+    }
+
+    /* 关闭所有中断源 */
+    for(i = 0; i < ICOLL_IRQ_CNT; i++)
+        REG_WR(REGS_ICOL_BASE, HW_ICOLL_INTERRUPTn(i), 0);
+
+    /* 打开IRQ总输出 */
+    REG_SET(REGS_ICOL_BASE, HW_ICOLL_CTRL, BM_ICOLL_CTRL_IRQ_FINAL_ENABLE);
+
+    return 0;
+}
+
+
+/********************************************************************************
+* 函数: int32_t irq_install_handler(__in uint32_t irq, __in irq_handler_t handler,
+                                   __in void *data)
+* 描述: 注册中断处理函数，同一中断重复注册同一个函数直接返回成功
+* 输入: irq: 中断源编号
+       handler: 中断处理函数
+       data: 传给处理函数的参数
+* 输出: none
+* 返回: 0: 成功
+       -EINVAL: 参数无效
+       -EBUSY: 中断已经被其他函数占用
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+int32_t irq_install_handler(__in uint32_t irq, __in irq_handler_t handler, __in void *data)
+{
+    struct irq_action *action;
+
+    if((irq >= ICOLL_IRQ_CNT) || !handler)
+        return -EINVAL;
+
+    action = irq_actions + irq;
+
+    if(action->handler)
+    {
+        if((action->handler == handler) && (action->data == data))
+            return 0;
+
+        printl(LOG_LEVEL_ERR, "[ICOLL:ERR] irq %d already has a handler.\n", irq);
+        return -EBUSY;
+    }
+
+    action->data = data;
+    action->count = 0;
+    action->handler = handler;
+
+    return 0;
+}
+
+
+/********************************************************************************
+* 函数: void irq_free_handler(__in uint32_t irq)
+* 描述: 注销中断处理函数，同时关闭此中断源
+* 输入: irq: 中断源编号
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+void irq_free_handler(__in uint32_t irq)
+{
+    if(irq >= ICOLL_IRQ_CNT)
+        return ;
+
+    irq_disable(irq);
+
+    irq_actions[irq].handler = NULL;
+    irq_actions[irq].data = NULL;
+}
+
+
+/********************************************************************************
+* 函数: void irq_enable(__in uint32_t irq)
+* 描述: 打开中断源
+* 输入: irq: 中断源编号
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+void irq_enable(__in uint32_t irq)
+{
+    if(irq >= ICOLL_IRQ_CNT)
+        return ;
+
+    REG_WR_ADDR(REGS_ICOL_BASE + HW_ICOLL_INTERRUPTn_SET(irq), BM_ICOLL_INTERRUPTn_ENABLE);
+}
+
+
+/********************************************************************************
+* 函数: void irq_disable(__in uint32_t irq)
+* 描述: 关闭中断源
+* 输入: irq: 中断源编号
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+void irq_disable(__in uint32_t irq)
+{
+    if(irq >= ICOLL_IRQ_CNT)
+        return ;
+
+    REG_WR_ADDR(REGS_ICOL_BASE + HW_ICOLL_INTERRUPTn_CLR(irq), BM_ICOLL_INTERRUPTn_ENABLE);
+}
+
+
+#ifdef CONFIG_USE_IRQ
+/********************************************************************************
+* 函数: void enable_interrupts(void)
+* 描述: 打开cpu的IRQ
+* 输入: none
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+void enable_interrupts(void)
+{
+    uint32_t temp;
+
+    __asm__ __volatile__("mrs %0, cpsr\n"
+                         "bic %0, %0, #0x80\n"
+                         "msr cpsr_c, %0"
+                         : "=r" (temp)
+                         :
+                         : "memory");
+}
+
+
+/********************************************************************************
+* 函数: int32_t disable_interrupts(void)
+* 描述: 关闭cpu的IRQ
+* 输入: none
+* 输出: none
+* 返回: 0: 关闭之前IRQ是关闭的
+       1: 关闭之前IRQ是打开的
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+int32_t disable_interrupts(void)
+{
+    uint32_t old, temp;
+
+    __asm__ __volatile__("mrs %0, cpsr\n"
+                         "orr %1, %0, #0x80\n"
+                         "msr cpsr_c, %1"
+                         : "=r" (old), "=r" (temp)
+                         :
+                         : "memory");
+
+    return (old & 0x80) ? 0 : 1;
+}
+
+
+/********************************************************************************
+* 函数: int32_t interrupt_init(void)
+* 描述: 设置IRQ/FIQ栈，初始化中断控制器并打开cpu的IRQ
+* 输入: none
+* 输出: none
+* 返回: 0: 成功
+       -ETIMEDOUT: 中断控制器复位超时
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+int32_t interrupt_init(void)
+{
+    int32_t err;
+
+    /* IRQ栈位于全局数据区下方，FIQ栈紧接在IRQ栈下方 */
+    IRQ_STACK_START = _armboot_start - CONFIG_SYS_MALLOC_LEN - CONFIG_SYS_GBL_DATA_SIZE - 4;
+    FIQ_STACK_START = IRQ_STACK_START - CONFIG_STACKSIZE_IRQ;
+
+    err = icoll_init();
+    if(err)
+        return err;
+
+    enable_interrupts();
+
+    return 0;
+}
+
+
+/********************************************************************************
+* 函数: void do_irq(__in void *regs)
+* 描述: IRQ分发，由start.s中的IRQ向量调用
+* 输入: regs: 中断时保存的寄存器
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+void do_irq(__in void *regs)
+{
+    struct irq_action *action;
+    uint32_t irq;
+
+    /* 读取当前中断源，并通知中断控制器进入服务 */
+    irq = REG_RD(REGS_ICOL_BASE, HW_ICOLL_STAT) & BM_ICOLL_STAT_VECTOR_NUMBER;
+    REG_WR(REGS_ICOL_BASE, HW_ICOLL_VECTOR, irq);
+
+    action = irq_actions + irq;
+    if(action->handler)
+    {
+        action->count++;
+        action->handler(action->data);
+    }
+    else
+    {
+        /* 没有处理函数的中断直接关闭，防止一直进入中断 */
+        irq_disable(irq);
+        printl(LOG_LEVEL_WARN, "[ICOLL:WARN] spurious irq %d disabled.\n", irq);
+    }
+
+    /* 所有中断源都使用level0 */
+    REG_WR(REGS_ICOL_BASE, HW_ICOLL_LEVELACK, BV_ICOLL_LEVELACK_IRQLEVELACK__LEVEL0);
+}
+
+
+/********************************************************************************
+* 函数: void do_fiq(__in void *regs)
+* 描述: FIQ处理，目前没有使用FIQ
+* 输入: regs: 中断时保存的寄存器
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+void do_fiq(__in void *regs)
+{
+    printl(LOG_LEVEL_WARN, "[ICOLL:WARN] unexpected fiq.\n");
+}
+
+#else
+
+/********************************************************************************
+* 函数: void enable_interrupts(void)
+* 描述: 没有使用中断，不做任何操作
+* 输入: none
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+void enable_interrupts(void)
+{
+}
+
+
+/********************************************************************************
+* 函数: int32_t disable_interrupts(void)
+* 描述: 没有使用中断，不做任何操作
+* 输入: none
+* 输出: none
+* 返回: 0
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+int32_t disable_interrupts(void)
+{
+    return 0;
+}
+
+
+/********************************************************************************
+* 函数: int32_t interrupt_init(void)
+* 描述: 没有使用中断，完成事件全部通过查询寄存器获取
+* 输入: none
+* 输出: none
+* 返回: 0
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+int32_t interrupt_init(void)
+{
+    return 0;
+}
+
+
+/********************************************************************************
+* 函数: void do_irq(__in void *regs)
+* 描述: 没有使用中断时出现IRQ，属于致命错误
+* 输入: regs: 中断时保存的寄存器
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+void do_irq(__in void *regs)
+{
+    panic("interrupt request\n");
+}
+
+
+/********************************************************************************
+* 函数: void do_fiq(__in void *regs)
+* 描述: 没有使用中断时出现FIQ，属于致命错误
+* 输入: regs: 中断时保存的寄存器
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+void do_fiq(__in void *regs)
+{
+    panic("fast interrupt request\n");
+}
+
+#endif /* CONFIG_USE_IRQ */
@@ -2,6 +2,7 @@
 #include "types.h"
 #include "arch/arch-mx28/mx28_regs.h"
 #include "arch/arch-mx28/regs_timrot.h"
+#include "arch/arch-mx28/regs_digctl.h"
 
 /* 定时器是向下计数 */
 
@@ -243,6 +244,22 @@ uint32_t get_timer(__in uint32_t base)
 }
 
 
+/********************************************************************************
+* 函数: uint32_t get_timer_us(uint32_t base)
+* 描述: 获取微秒计数值，使用DIGCTL的微秒计数器，约71分钟溢出一次，
+       使用差值计算时溢出不影响结果
+* 输入: base: 计数基准
+* 输出: none
+* 返回: 计数值
+* 作者:
+* 版本: V1.0
+**********************************************************************************/
+uint32_t get_timer_us(__in uint32_t base)
+{
+	return REG_RD(REGS_DIGCTL_BASE, HW_DIGCTL_MICROSECONDS) - base;
+}
+
+
 /********************************************************************************
 * 函数: void set_timer(uint32_t t)
 * 描述: 设置当前计数值
@@ -351,7 +351,7 @@ fiq:
 #else
 
 	.align	5
-/*irq:
+irq:
 	get_bad_stack
 	bad_save_user_regs
 	bl	do_irq
@@ -361,6 +361,6 @@ fiq:
 	get_bad_stack
 	bad_save_user_regs
 	bl	do_fiq
-*/
+
 #endif
 
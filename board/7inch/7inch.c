@@ -2,12 +2,13 @@
 #include "clock.h"
 #include "log.h"
 #include "arch/arch-mx28/clkctrl.h"
+#include "arch/arch-mx28/icoll.h"
 
 
 
 /********************************************************************************
 * 函数: int32_t board_clk_init(void)
-* 描述: 初始化电路板时钟
+* 描述: 初始化电路板时钟，并打开中断控制器
 * 输入:
 * 输出:
 * 返回:
@@ -21,7 +22,7 @@ int32_t board_clk_init(void)
     clk_register(&pll_clk[0]);
     clk_register(&ref_cpu);
     clk_register(&ref_emi);
-    //clk_register(&ref_gpmi);
+    clk_register(&ref_gpmi);
     //clk_register(&ref_pix);
     clk_register(&clk_p);
     clk_register(&clk_h);
@@ -92,9 +93,18 @@ int32_t board_clk_init(void)
     /* 设置clk_timrot */
     clk_timrot.enable(&clk_uart);
 
-    /* 设置clk_gpmi */
-    clk_gpmi.set_parent(&clk_gpmi, &ref_xtal);
-    val = clk_gpmi.set_rate(&clk_gpmi, ref_xtal.get_rate(&ref_xtal));
+    /* 设置gpmi参考时钟 */
+    val = ref_gpmi.set_rate(&ref_gpmi, 480000000);
+    if(val)
+    {
+        printl(LOG_LEVEL_ERR, "[CLK:ERR] set %s rate failed, errcode = %d!\n", ref_gpmi.name, val);
+        return val;
+    }
+    ref_gpmi.enable(&ref_gpmi);
+
+    /* 设置clk_gpmi，由pll分频得到96MHz，nand时序由gpmi驱动根据该频率计算 */
+    clk_gpmi.set_parent(&clk_gpmi, &ref_gpmi);
+    val = clk_gpmi.set_rate(&clk_gpmi, 96000000);
     if(val)
     {
         printl(LOG_LEVEL_ERR, "[CLK:ERR] set %s rate failed, errcode = %d!\n", clk_gpmi.name, val);
@@ -114,5 +124,11 @@ int32_t board_clk_init(void)
 
     /* 设置clk_lcdif */
 
+    /* 时钟初始化在nand等外设初始化之前，在这里打开中断控制器，gpmi和dma驱动
+       注册的完成中断才会生效. 失败时驱动退回查询方式，不影响启动 */
+    val = interrupt_init();
+    if(val)
+        printl(LOG_LEVEL_WARN, "[IRQ:WARN] init interrupt failed, errcode = %d!\n", val);
+
     return 0;
 }
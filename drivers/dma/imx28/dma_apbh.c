@@ -1,19 +1,45 @@
 #include "stddef.h"
 #include "log.h"
 #include "errno.h"
-#include "malloc.h"
+#include "string.h"
+#include "common.h"
 #include "arch/arch-mx28/mx28_regs.h"
 #include "arch/arch-mx28/regs_dma_apbh.h"
 #include "arch/arch-mx28/dma_apbh.h"
+#include "arch/arch-mx28/icoll.h"
 
 
 
 //DMA链结构体数组
 static struct dma_chan dma_channels[DMA_MAX_CHANNELS];
 
+#ifdef CONFIG_USE_IRQ
+/* 每个通道对应的中断源，gpmi的8个通道共用一个中断源 */
+static const uint8_t dma_apbh_irqs[DMA_MAX_CHANNELS] =
+{
+    IRQ_SSP0_DMA, IRQ_SSP1_DMA, IRQ_SSP2_DMA, IRQ_SSP3_DMA,
+    IRQ_GPMI_DMA, IRQ_GPMI_DMA, IRQ_GPMI_DMA, IRQ_GPMI_DMA,
+    IRQ_GPMI_DMA, IRQ_GPMI_DMA, IRQ_GPMI_DMA, IRQ_GPMI_DMA,
+    IRQ_HSADC_DMA, IRQ_LCDIF_DMA, 0, 0,
+};
+#endif
+
 /* DMA模块复位标志 */
 static bool dma_reset_flag = false;
 
+/* 描述器池，池中描述器地址连续，初始化后按地址顺序分配 */
+static struct dma_desc dma_desc_pool[DMA_DESC_POOL_SIZE] __attribute__((aligned(DMA_DESC_POOL_ALIGN)));
+
+/* 空闲描述器链表，使用空闲描述器的cmd.next字段链接 */
+static struct dma_desc *dma_desc_free = NULL;
+
+/* 描述器池使用统计 */
+static uint32_t dma_desc_used = 0;
+static uint32_t dma_desc_peak = 0;
+
+/* 描述器池初始化标志 */
+static bool dma_desc_pool_ready = false;
+
 
 
 /********************************************************************************
@@ -161,6 +187,10 @@ static void dma_apbh_info(__in uint32_t chan, __out struct dma_info *pInfo)
     reg = REG_RD(REGS_APBH_BASE, HW_APBH_CTRL2);
     pInfo->status = ((reg >> chan) & 0x01);
     pInfo->buf_addr = REG_RD(REGS_APBH_BASE, HW_APBH_CHn_BAR(chan));  //需要执行的数据缓冲区的地址
+
+    pInfo->pool_total = DMA_DESC_POOL_SIZE;
+    pInfo->pool_used = dma_desc_used;
+    pInfo->pool_peak = dma_desc_peak;
 }
 
 /********************************************************************************
@@ -236,6 +266,39 @@ static void dma_apbh_ack_irq(__in uint32_t chan)
 }
 
 
+#ifdef CONFIG_USE_IRQ
+/********************************************************************************
+* 函数: static void dma_apbh_isr(__in void *data)
+* 描述: dma中断服务程序，记录每个通道的完成/错误状态并清除中断标志
+* 输入: data: 没有使用
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: V1.0
+**********************************************************************************/
+static void dma_apbh_isr(__in void *data)
+{
+    struct dma_chan *pchan;
+    uint32_t status;
+    uint32_t chan;
+
+    for(chan = 0; chan < DMA_MAX_CHANNELS; chan++)
+    {
+        pchan = dma_channels + chan;
+        if(!(pchan->flags & DMA_FLAGS_ALLOCATED))
+            continue;
+
+        status = dma_apbh_irq_is_pending(chan);
+        if(status)
+        {
+            pchan->irq_status |= status;
+            dma_apbh_ack_irq(chan);
+        }
+    }
+}
+#endif
+
+
 /*************************************************************************************************************
 *********************************************外部接口***********************************************************
 **************************************************************************************************************/
@@ -710,9 +773,33 @@ void dma_ack_irq(__in uint32_t channel)
     dma_apbh_ack_irq(channel);
 }
 
+/********************************************************************************
+* 函数: static void dma_desc_pool_init(void)
+* 描述: 初始化描述器池，按地址顺序建立空闲链表，保证连续分配的描述器地址连续
+* 输入: none
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: V1.0
+**********************************************************************************/
+static void dma_desc_pool_init(void)
+{
+    int32_t i;
+
+    for(i = 0; i < DMA_DESC_POOL_SIZE - 1; i++)
+        dma_desc_pool[i].cmd.next = (uint32_t)(dma_desc_pool + i + 1);
+
+    dma_desc_pool[DMA_DESC_POOL_SIZE - 1].cmd.next = 0;
+
+    dma_desc_free = dma_desc_pool;
+    dma_desc_used = 0;
+    dma_desc_peak = 0;
+    dma_desc_pool_ready = true;
+}
+
 /********************************************************************************
 * 函数: struct dma_desc *dma_alloc_desc(void)
-* 描述: 动态分配描述符结构
+* 描述: 从描述器池中分配一个描述器，中断服务程序中不分配描述器，所以不需要加锁
 * 输入: none
 * 输出: none
 * 返回: 成功: 描述符地址
@@ -724,25 +811,36 @@ struct dma_desc *dma_alloc_desc(void)
 {
     struct dma_desc *pdesc;
 
-#ifdef CONFIG_MMU
-    /* 此处添加MMU支持 */
-#else
-    pdesc = (struct dma_desc *)dlmemalign(DMA_ALIGNMENT, sizeof(struct dma_desc));
-#endif
+    if(!dma_desc_pool_ready)
+        dma_desc_pool_init();
 
+    pdesc = dma_desc_free;
     if(NULL == pdesc)
+    {
+        printl(LOG_LEVEL_ERR, "[DMA:ERR] dma descriptor pool exhausted.\n");
         return NULL;
+    }
+
+    dma_desc_free = (struct dma_desc *)pdesc->cmd.next;
+
+    dma_desc_used++;
+    if(dma_desc_used > dma_desc_peak)
+        dma_desc_peak = dma_desc_used;
 
     memset(pdesc, 0, sizeof(struct dma_desc));
 
+#ifdef CONFIG_MMU
+    /* 此处添加MMU支持 */
+#else
     pdesc->address = (uint32_t)pdesc;
+#endif
 
     return pdesc;
 }
 
 /********************************************************************************
 * 函数: void dma_free_desc(struct dma_desc *pdesc)
-* 描述: 释放描述符动态分配的结构体
+* 描述: 把描述符归还到描述器池
 * 输入: pdesc: 描述符指针
 * 输出: none
 * 返回: none
@@ -754,7 +852,19 @@ void dma_free_desc(__in struct dma_desc *pdesc)
     if(NULL == pdesc)
         return ;
 
-    dlfree((int8_t *)pdesc);
+    /* 不是池中的描述器 */
+    if((pdesc < dma_desc_pool) || (pdesc >= dma_desc_pool + DMA_DESC_POOL_SIZE) ||
+       (((uint32_t)pdesc - (uint32_t)dma_desc_pool) % sizeof(struct dma_desc)))
+    {
+        printl(LOG_LEVEL_ERR, "[DMA:ERR] free invalid dma descriptor 0x%x.\n", (uint32_t)pdesc);
+        return ;
+    }
+
+    pdesc->flags = 0;
+    pdesc->cmd.next = (uint32_t)dma_desc_free;
+    dma_desc_free = pdesc;
+
+    dma_desc_used--;
 }
 
 /********************************************************************************
@@ -1021,14 +1131,27 @@ int32_t dma_init(__in enum dma_channel channel)
     dma_reset(channel);
     dma_ack_irq(channel);
 
+#ifdef CONFIG_USE_IRQ
+    /* 注册通道的完成中断 */
+    if(dma_apbh_irqs[channel])
+    {
+        err = irq_install_handler(dma_apbh_irqs[channel], dma_apbh_isr, NULL);
+        if(err)
+            printl(LOG_LEVEL_WARN, "[DMA:WARN] channel %d irq unavailable, polling instead.\n", channel);
+        else
+            irq_enable(dma_apbh_irqs[channel]);
+    }
+#endif
+
     return 0;
 }
 
 
 /********************************************************************************
 * 函数: int32_t dma_wait_complete(__in uint32_t uSecTimeout, __in uint32_t chan)
-* 描述: 等待指定通道的dma执行完毕
-* 输入: uSecimeout: 等待时间
+* 描述: 等待指定通道的dma执行完毕. 使用中断时完成状态由中断服务程序记录，
+       中断没有打开时直接查询中断标志，两种情况都能正确返回
+* 输入: uSecimeout: 等待时间，单位微秒
        chan: 通道号
 * 输出: none
 * 返回: 0: 成功
@@ -1039,6 +1162,9 @@ int32_t dma_init(__in enum dma_channel channel)
 int32_t dma_wait_complete(__in uint32_t uSecTimeout, __in uint32_t chan)
 {
     struct dma_chan *pchan;
+    uint32_t start;
+    uint32_t status;
+
     if(chan >= DMA_MAX_CHANNELS)
         return 1;
 
@@ -1046,10 +1172,25 @@ int32_t dma_wait_complete(__in uint32_t uSecTimeout, __in uint32_t chan)
     if(!(pchan->flags & DMA_FLAGS_ALLOCATED))
         return 1;
 
-    while(!(REG_RD(REGS_APBH_BASE, HW_APBH_CTRL1) & (1 << chan)) && --uSecTimeout);
+    start = get_timer_us(0);
+
+    while(1)
+    {
+        status = pchan->irq_status | dma_apbh_irq_is_pending(chan);
+        if(status)
+            break;
+
+        if(get_timer_us(start) > uSecTimeout)
+        {
+            dma_apbh_reset(chan);
+            return 1;
+        }
+    }
 
-    if(uSecTimeout <= 0)
+    /* 通道执行出错 */
+    if(status & 0x02)
     {
+        printl(LOG_LEVEL_ERR, "[DMA:ERR] channel %d terminated with error.\n", chan);
         dma_apbh_reset(chan);
         return 1;
     }
@@ -1059,27 +1200,64 @@ int32_t dma_wait_complete(__in uint32_t uSecTimeout, __in uint32_t chan)
 
 
 /********************************************************************************
-* 函数: int32_t dma_go(__in int32_t chan)
-* 描述: 开启dma执行
+* 函数: void dma_start(__in int32_t chan)
+* 描述: 开启dma执行后立即返回，不等待执行完毕，调用者在执行期间可以做其他工作，
+       之后必须调用dma_finish回收描述器并关闭通道
 * 输入: chan: 通道号
 * 输出: none
-* 返回: 0: 执行完毕
-       -ETIMEDOUT: 执行失败，超时
+* 返回: none
 * 作者:
 * 版本: V1.0
 **********************************************************************************/
-int32_t dma_go(__in int32_t chan)
+void dma_start(__in int32_t chan)
 {
-    uint32_t timeout = 10000;
-    int32_t err;
-
-    LIST_HEAD(tmp_desc_list);
+    /* 清除上一次记录的中断状态 */
+    if(chan < DMA_MAX_CHANNELS)
+        dma_channels[chan].irq_status = 0;
 
     /* 使能中断 */
     dma_enable_irq(chan, true);
 
     /* 开始执行 */
     dma_enable(chan);
+}
+
+
+/********************************************************************************
+* 函数: int32_t dma_is_finished(__in int32_t chan)
+* 描述: 查询dma_start开启的通道是否已经执行完毕(完成或者出错)，不等待
+* 输入: chan: 通道号
+* 输出: none
+* 返回: 1: 执行完毕，可以调用dma_finish
+       0: 还在执行
+* 作者:
+* 版本: V1.0
+**********************************************************************************/
+int32_t dma_is_finished(__in int32_t chan)
+{
+    if(chan >= DMA_MAX_CHANNELS)
+        return 1;
+
+    return (dma_channels[chan].irq_status | dma_apbh_irq_is_pending(chan)) ? 1 : 0;
+}
+
+
+/********************************************************************************
+* 函数: int32_t dma_finish(__in int32_t chan, __in uint32_t timeout)
+* 描述: 等待dma_start开启的通道执行完毕，回收描述器并关闭通道
+* 输入: chan: 通道号
+       timeout: 等待时间，单位微秒
+* 输出: none
+* 返回: 0: 执行完毕
+       -ETIMEDOUT: 执行失败，超时
+* 作者:
+* 版本: V1.0
+**********************************************************************************/
+int32_t dma_finish(__in int32_t chan, __in uint32_t timeout)
+{
+    int32_t err;
+
+    LIST_HEAD(tmp_desc_list);
 
     /* 等待执行完毕 */
     err = (dma_wait_complete(timeout, chan)) ? -ETIMEDOUT : 0;
@@ -1095,3 +1273,38 @@ int32_t dma_go(__in int32_t chan)
 
     return err;
 }
+
+
+/********************************************************************************
+* 函数: int32_t dma_go_timeout(__in int32_t chan, __in uint32_t timeout)
+* 描述: 开启dma执行，并指定等待时间，用于较长的描述符链
+* 输入: chan: 通道号
+       timeout: 等待时间，单位微秒
+* 输出: none
+* 返回: 0: 执行完毕
+       -ETIMEDOUT: 执行失败，超时
+* 作者:
+* 版本: V1.0
+**********************************************************************************/
+int32_t dma_go_timeout(__in int32_t chan, __in uint32_t timeout)
+{
+    dma_start(chan);
+
+    return dma_finish(chan, timeout);
+}
+
+
+/********************************************************************************
+* 函数: int32_t dma_go(__in int32_t chan)
+* 描述: 开启dma执行
+* 输入: chan: 通道号
+* 输出: none
+* 返回: 0: 执行完毕
+       -ETIMEDOUT: 执行失败，超时
+* 作者:
+* 版本: V1.0
+**********************************************************************************/
+int32_t dma_go(__in int32_t chan)
+{
+    return dma_go_timeout(chan, 10000);
+}
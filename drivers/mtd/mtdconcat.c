@@ -5,9 +5,29 @@
 #include "malloc.h"
 #include "compiler.h"
 #include "log.h"
+#include "string.h"
+#include "math.h"
+#include "mtd/concat.h"
 
 
 
+struct mtd_concat;
+
+/* 异步请求在一个子设备上的分段 */
+struct concat_segment
+{
+    /* 提交到子设备的请求 */
+    struct mtd_request req;
+    /* 擦除分段的擦除信息 */
+    struct erase_info erase;
+    /* 所属的设备链 */
+    struct mtd_concat *concat;
+    /* 分段在头设备上的地址 */
+    loff_t ofs;
+    /* 分段已经提交还没有完成 */
+    int32_t busy;
+};
+
 /* mtd设备链接结构体 */
 struct mtd_concat
 {
@@ -17,11 +37,26 @@ struct mtd_concat
     int32_t num_subdev;
     /* 子设备指针数组 */
     struct mtd_info **subdev;
+    /* 条带大小，0表示子设备首尾相接 */
+    uint32_t stripe;
+    /* 每个子设备一个异步请求分段 */
+    struct concat_segment *seg;
+    /* 异步请求队列，队首的请求正在处理 */
+    struct mtd_request *req_head;
+    struct mtd_request *req_tail;
+    /* 队首请求已经拆分提交的长度 */
+    uint64_t req_issued;
+    /* 队首请求还没有完成的分段数 */
+    int32_t req_pending;
+    /* 队首请求出现的错误，以及ecc纠正(-EUCLEAN)或者失败(-EBADMSG) */
+    int32_t req_error;
+    int32_t req_ecc;
 };
 
 /* concat结构体大小 */
 #define SIZEOF_STRUCT_MTD_CONCAT(num_subdev) \
-    (sizeof(struct mtd_concat) + (num_subdev) * sizeof(struct mtd_info *))
+    (sizeof(struct mtd_concat) + \
+     (num_subdev) * (sizeof(struct concat_segment) + sizeof(struct mtd_info *)))
 
 /* 获取concat设备的结构体 */
 #define CONCAT(x) ((struct mtd_concat *)(x))
@@ -487,14 +522,12 @@ static int32_t concat_erase(__in struct mtd_info *mtd, __inout struct erase_info
 		offset += subdev->size;
 	}
 
-	instr->state = erase->state;
+	instr->state = err ? MTD_ERASE_FAILED : MTD_ERASE_DONE;
 	dlfree((int8_t *)erase);
-	if(err)
-		return err;
 
-	if (instr->callback)
-		instr->callback(instr);
-	return 0;
+	/* 成功和失败都调用一次擦除回调 */
+	mtd_erase_callback(instr);
+	return err;
 }
 
 /********************************************************************************
@@ -712,6 +745,315 @@ static int concat_block_markbad(__in struct mtd_info *mtd, __in loff_t ofs)
 }
 
 
+/********************************************************************************
+* 函数: static uint64_t concat_req_map(__in struct mtd_concat *concat, __in loff_t ofs,
+                                      __out int32_t *dev, __out loff_t *devofs)
+* 描述: 把头设备地址转换成子设备序号和子设备内地址，首尾相接和条带模式都适用
+* 输入: concat: mtd设备链
+       ofs: 头设备地址
+* 输出: dev: 子设备序号
+       devofs: 子设备内地址
+* 返回: 从ofs开始在这个子设备内连续的字节数
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static uint64_t concat_req_map(__in struct mtd_concat *concat, __in loff_t ofs,
+                                 __out int32_t *dev, __out loff_t *devofs)
+{
+    uint64_t num = ofs;
+    uint32_t in;
+    int32_t i;
+
+    if(concat->stripe)
+    {
+        in = do_div(num, concat->stripe);
+        *dev = do_div(num, concat->num_subdev);
+        *devofs = num * concat->stripe + in;
+
+        return concat->stripe - in;
+    }
+
+    for(i = 0; (i < concat->num_subdev - 1) && (ofs >= concat->subdev[i]->size); i++)
+        ofs -= concat->subdev[i]->size;
+
+    *dev = i;
+    *devofs = ofs;
+
+    return concat->subdev[i]->size - ofs;
+}
+
+/********************************************************************************
+* 函数: static void concat_seg_done(__in struct mtd_request *req)
+* 描述: 子设备上的分段请求完成回调，把结果合并到队首请求
+* 输入: req: 分段请求
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void concat_seg_done(__in struct mtd_request *req)
+{
+    struct concat_segment *seg = req->priv;
+    struct mtd_concat *concat = seg->concat;
+    struct mtd_request *parent = concat->req_head;
+    struct erase_info *instr = parent->instr;
+    loff_t fail;
+
+    seg->busy = 0;
+    concat->req_pending--;
+    parent->retlen += req->retlen;
+
+    if(!req->status)
+        return;
+
+    if(req->status == -EBADMSG)
+    {
+        concat->mtd.ecc_stats.failed++;
+        concat->req_ecc = req->status;
+    }
+    else if(req->status == -EUCLEAN)
+    {
+        concat->mtd.ecc_stats.corrected++;
+        if(!concat->req_ecc)
+            concat->req_ecc = req->status;
+    }
+    else
+    {
+        if(!concat->req_error)
+            concat->req_error = req->status;
+
+        /* 擦除失败地址转换成头设备地址，保留最低的 */
+        if((parent->type == MTD_REQ_ERASE) && (seg->erase.fail_addr != MTD_FAIL_ADDR_UNKNOWN))
+        {
+            fail = seg->ofs + (seg->erase.fail_addr - seg->erase.addr);
+            if((instr->fail_addr == MTD_FAIL_ADDR_UNKNOWN) || (fail < instr->fail_addr))
+                instr->fail_addr = fail;
+        }
+    }
+}
+
+/********************************************************************************
+* 函数: static void concat_req_issue(__in struct mtd_concat *concat)
+* 描述: 把队首请求按子设备拆分成分段提交，每个子设备同时只有一个分段，不同子设备
+       上的分段同时进行
+* 输入: concat: mtd设备链
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void concat_req_issue(__in struct mtd_concat *concat)
+{
+    struct mtd_request *req = concat->req_head;
+    struct concat_segment *seg;
+    struct mtd_info *subdev;
+    uint64_t total, size;
+    loff_t base, devofs;
+    int32_t dev, ret;
+
+    if(req->type == MTD_REQ_ERASE)
+    {
+        base = req->instr->addr;
+        total = req->instr->len;
+    }
+    else
+    {
+        base = req->addr;
+        total = req->len;
+    }
+
+    while(!concat->req_error && (concat->req_issued < total))
+    {
+        size = min_t(uint64_t, total - concat->req_issued,
+                     concat_req_map(concat, base + concat->req_issued, &dev, &devofs));
+        seg = concat->seg + dev;
+        subdev = concat->subdev[dev];
+
+        if(seg->busy)
+            break;
+
+        if((req->type != MTD_REQ_READ) && !(subdev->flags & MTD_WRITEABLE))
+        {
+            concat->req_error = -EROFS;
+            break;
+        }
+
+        memset(&seg->req, 0, sizeof(seg->req));
+        seg->req.type = req->type;
+        seg->req.addr = devofs;
+        seg->req.len = size;
+        seg->req.complete = concat_seg_done;
+        seg->req.priv = seg;
+
+        if(req->type == MTD_REQ_ERASE)
+        {
+            memset(&seg->erase, 0, sizeof(seg->erase));
+            seg->erase.mtd = subdev;
+            seg->erase.addr = devofs;
+            seg->erase.len = size;
+            seg->erase.callback = concat_erase_callback;
+            seg->req.instr = &seg->erase;
+        }
+        else
+            seg->req.buf = req->buf + (size_t)concat->req_issued;
+
+        seg->ofs = base + concat->req_issued;
+        seg->busy = 1;
+        concat->req_pending++;
+        concat->req_issued += size;
+
+        /* 子设备不支持异步请求时，mtd_submit返回之前分段已经完成 */
+        ret = mtd_submit(subdev, &seg->req);
+        if(ret)
+        {
+            seg->busy = 0;
+            concat->req_pending--;
+            concat->req_error = ret;
+        }
+    }
+}
+
+/********************************************************************************
+* 函数: static int32_t concat_poll(__in struct mtd_info *mtd)
+* 描述: 推进mtd设备链上的异步请求，轮询有分段的子设备，分段完成后提交下一段，
+       所有分段完成后完成队首请求. oob读取请求同步执行
+* 输入: mtd: mtd设备链中的头设备
+* 输出: none
+* 返回: 还没有完成的请求数
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t concat_poll(__in struct mtd_info *mtd)
+{
+    struct mtd_concat *concat = CONCAT(mtd);
+    struct mtd_request *req;
+    uint64_t total;
+    int32_t i, ret, count = 0;
+
+    while((req = concat->req_head) != NULL)
+    {
+        if(req->type == MTD_REQ_READ_OOB)
+        {
+            ret = mtd->read_oob(mtd, req->addr, req->ops);
+            req->retlen = req->ops->retlen;
+        }
+        else
+        {
+            concat_req_issue(concat);
+
+            for(i = 0; i < concat->num_subdev; i++)
+            {
+                if(!concat->seg[i].busy)
+                    continue;
+
+                /* 子设备队列已经空了但是分段没有完成 */
+                if((mtd_poll(concat->subdev[i]) <= 0) && concat->seg[i].busy)
+                {
+                    concat->seg[i].busy = 0;
+                    concat->req_pending--;
+                    if(!concat->req_error)
+                        concat->req_error = -EIO;
+                }
+            }
+
+            if(concat->req_pending)
+                break;
+
+            total = (req->type == MTD_REQ_ERASE) ? req->instr->len : req->len;
+            if(!concat->req_error && (concat->req_issued < total))
+                continue;
+
+            ret = concat->req_error ? concat->req_error : concat->req_ecc;
+
+            if(req->type == MTD_REQ_ERASE)
+            {
+                req->instr->state = ret ? MTD_ERASE_FAILED : MTD_ERASE_DONE;
+                mtd_erase_callback(req->instr);
+            }
+        }
+
+        /* 先出队再完成，完成回调中可以提交新的请求 */
+        concat->req_head = req->next;
+        if(!concat->req_head)
+            concat->req_tail = NULL;
+        concat->req_issued = 0;
+        concat->req_error = 0;
+        concat->req_ecc = 0;
+
+        mtd_request_done(req, ret);
+    }
+
+    for(req = concat->req_head; req; req = req->next)
+        count++;
+
+    return count;
+}
+
+/********************************************************************************
+* 函数: static int32_t concat_submit(__in struct mtd_info *mtd,
+                                    __inout struct mtd_request *req)
+* 描述: 提交异步请求到mtd设备链，请求按提交顺序处理，队列原来为空时立即开始
+* 输入: mtd: mtd设备链中的头设备
+       req: 请求
+* 输出: none
+* 返回: 0: 请求已经接受
+       -EINVAL: 参数无效
+       -EROFS: 设备只读
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t concat_submit(__in struct mtd_info *mtd, __inout struct mtd_request *req)
+{
+    struct mtd_concat *concat = CONCAT(mtd);
+
+    switch(req->type)
+    {
+    case MTD_REQ_READ:
+    case MTD_REQ_WRITE:
+        if((req->type == MTD_REQ_WRITE) && !(mtd->flags & MTD_WRITEABLE))
+            return -EROFS;
+        if((req->addr + req->len) > mtd->size)
+            return -EINVAL;
+        break;
+
+    case MTD_REQ_READ_OOB:
+        if(!mtd->read_oob || !req->ops)
+            return -EINVAL;
+        break;
+
+    case MTD_REQ_ERASE:
+        if(!(mtd->flags & MTD_WRITEABLE))
+            return -EROFS;
+        if((req->instr->addr + req->instr->len) > mtd->size)
+            return -EINVAL;
+
+        /* 擦除区域大小不同时由子设备检查对齐 */
+        if(!mtd->numeraseregions &&
+           ((req->instr->addr & (mtd->erasesize - 1)) || (req->instr->len & (mtd->erasesize - 1))))
+            return -EINVAL;
+
+        req->instr->fail_addr = MTD_FAIL_ADDR_UNKNOWN;
+        req->instr->state = MTD_ERASING;
+        break;
+
+    default:
+        return -EINVAL;
+    }
+
+    req->next = NULL;
+    if(concat->req_tail)
+        concat->req_tail->next = req;
+    else
+        concat->req_head = req;
+    concat->req_tail = req;
+
+    if(concat->req_head == req)
+        concat_poll(mtd);
+
+    return 0;
+}
+
+
 /********************************************************************************
 * 函数: struct mtd_info *mtd_concat_create(__in struct mtd_info *subdev[],
                                           __in int32_t num_devs,
@@ -750,8 +1092,13 @@ struct mtd_info *mtd_concat_create(__in struct mtd_info *subdev[], __in int32_t
 		return NULL;
 	}
 
-	//链接subdev指针
-	concat->subdev = (struct mtd_info **)(concat + 1);
+	memset(concat, 0, size);
+
+	//链接分段和subdev指针
+	concat->seg = (struct concat_segment *)(concat + 1);
+	concat->subdev = (struct mtd_info **)(concat->seg + num_devs);
+	for(i = 0; i < num_devs; i++)
+		concat->seg[i].concat = concat;
 
 	/* 设置总设备参数 */
 	concat->mtd.type = subdev[0]->type;
@@ -827,6 +1174,8 @@ struct mtd_info *mtd_concat_create(__in struct mtd_info *subdev[], __in int32_t
 	concat->mtd.sync = concat_sync;
 	concat->mtd.lock = concat_lock;
 	concat->mtd.unlock = concat_unlock;
+	concat->mtd.submit = concat_submit;
+	concat->mtd.poll = concat_poll;
 
 	/* 统计可擦除的区域 */
 	max_erasesize = curr_erasesize = subdev[0]->erasesize;
@@ -942,4 +1291,540 @@ struct mtd_info *mtd_concat_create(__in struct mtd_info *subdev[], __in int32_t
 }
 
 
+/********************************************************************************
+* 函数: static uint64_t concat_stripe_map(__in struct mtd_concat *concat,
+                                         __in loff_t ofs,
+                                         __out struct mtd_info **subdev,
+                                         __out loff_t *devofs)
+* 描述: 条带模式下把头设备地址转换成子设备和子设备内地址. 第n个条带位于第
+       n % num_subdev个子设备的第n / num_subdev个条带
+* 输入: concat: mtd设备链
+       ofs: 头设备地址
+* 输出: subdev: 子设备
+       devofs: 子设备内地址
+* 返回: 当前条带剩余的字节数
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static uint64_t concat_stripe_map(__in struct mtd_concat *concat, __in loff_t ofs,
+                                    __out struct mtd_info **subdev, __out loff_t *devofs)
+{
+    uint64_t num = ofs;
+    uint32_t in, dev;
+
+    in = do_div(num, concat->stripe);
+    dev = do_div(num, concat->num_subdev);
+
+    *subdev = concat->subdev[dev];
+    *devofs = num * concat->stripe + in;
+
+    return concat->stripe - in;
+}
+
+/********************************************************************************
+* 函数: static int32_t concat_stripe_read(__in struct mtd_info *mtd,
+                                         __in loff_t from,
+                                         __in size_t len,
+                                         __out size_t *retlen,
+                                         __out uint8_t *buf)
+* 描述: 条带模式读取数据. 作为异步请求提交到设备链，按条带拆分成各子设备的分段，
+       每个子设备同时有一个分段在进行，子设备支持异步请求时各自的dma链同时执行
+* 输入: mtd: mtd链中的头设备
+       from: 读取的起始地址
+       len: 读取的长度
+* 输出: retlen: 读取到的字节
+       buf: 读取到的字节存放缓冲区
+* 返回: 0: 读取成功
+       -EBADMSG: 有无法纠正的错误
+       -EINVAL: 参数无效
+       -EUCLEAN: 有错误位被纠正
+       其他: 未知错误
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t concat_stripe_read(__in struct mtd_info *mtd, __in loff_t from, __in size_t len,
+                                    __out size_t *retlen, __out uint8_t *buf)
+{
+    struct mtd_request req;
+    int32_t ret;
+
+    memset(&req, 0, sizeof(req));
+    req.type = MTD_REQ_READ;
+    req.addr = from;
+    req.len = len;
+    req.buf = buf;
+
+    ret = mtd_submit_wait(mtd, &req);
+    *retlen = req.retlen;
+
+    return ret;
+}
+
+/********************************************************************************
+* 函数: static int32_t concat_stripe_write(__in struct mtd_info *mtd,
+                                          __in loff_t to,
+                                          __in size_t len,
+                                          __out size_t *retlen,
+                                          __in const uint8_t *buf)
+* 描述: 条带模式写数据. 和读取一样作为异步请求提交，各子设备上的分段同时编程
+* 输入: mtd: mtd设备链中的头设备
+       to: 写入的地址
+       len: 写入的长度
+       buf: 需要写入的数据缓冲区
+* 输出: retlen: 成功写入的数据长度
+* 返回: 0: 写入成功
+       -EINVAL: 参数无效
+       -EROFS: 设备只读
+       其他: 未知错误
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t concat_stripe_write(__in struct mtd_info *mtd, __in loff_t to, __in size_t len,
+                                     __out size_t *retlen, __in const uint8_t *buf)
+{
+    struct mtd_request req;
+    int32_t ret;
+
+    memset(&req, 0, sizeof(req));
+    req.type = MTD_REQ_WRITE;
+    req.addr = to;
+    req.len = len;
+    req.buf = (uint8_t *)buf;
+
+    ret = mtd_submit_wait(mtd, &req);
+    *retlen = req.retlen;
+
+    return ret;
+}
 
+/********************************************************************************
+* 函数: static int32_t concat_stripe_oob(__in struct mtd_info *mtd, __in loff_t ofs,
+                                        __inout struct mtd_oob_ops *ops,
+                                        __in int32_t write)
+* 描述: 条带模式读写oob数据，按条带拆分，每段的oob长度按页数计算
+* 输入: mtd: mtd设备链中的头设备
+       ofs: 起始地址
+       ops: oob数据结构体
+       write: 0: 读 1: 写
+* 输出: ops: 读写的长度和读取的数据
+* 返回: 0: 成功
+       -EBADMSG: 有无法纠正的错误
+       -EINVAL: 参数无效
+       -EUCLEAN: 有错误位被纠正
+       其他: 未知错误
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t concat_stripe_oob(__in struct mtd_info *mtd, __in loff_t ofs,
+                                   __inout struct mtd_oob_ops *ops, __in int32_t write)
+{
+    struct mtd_concat *concat = CONCAT(mtd);
+    struct mtd_info *subdev;
+    struct mtd_oob_ops devops = *ops;
+    uint32_t oob_per_page;
+    uint64_t size;
+    loff_t devofs;
+    int32_t err, ret = 0;
+
+    ops->retlen = ops->oobretlen = 0;
+
+    if(write && !(mtd->flags & MTD_WRITEABLE))
+        return -EROFS;
+
+    oob_per_page = (ops->mode == MTD_OOB_AUTO) ? mtd->oobavail : mtd->oobsize;
+
+    while(1)
+    {
+        size = concat_stripe_map(concat, ofs, &subdev, &devofs);
+
+        if(ops->databuf)
+        {
+            devops.len = min_t(uint64_t, ops->len - ops->retlen, size);
+            size = devops.len;
+        }
+        if(ops->oobbuf)
+        {
+            /* oob按页分布，每段最多到条带结束 */
+            devops.ooblen = min_t(uint64_t, ops->ooblen - ops->oobretlen,
+                                  (((uint32_t)size + mtd->writesize - 1) / mtd->writesize) * oob_per_page);
+            if(!ops->databuf)
+                size = (devops.ooblen + oob_per_page - 1) / oob_per_page * mtd->writesize;
+        }
+
+        if(write)
+            err = subdev->write_oob(subdev, devofs, &devops);
+        else
+            err = subdev->read_oob(subdev, devofs, &devops);
+
+        ops->retlen += devops.retlen;
+        ops->oobretlen += devops.oobretlen;
+
+        if(unlikely(err))
+        {
+            if(!write && (err == -EBADMSG))
+            {
+                mtd->ecc_stats.failed++;
+                ret = err;
+            }
+            else if(!write && (err == -EUCLEAN))
+            {
+                mtd->ecc_stats.corrected++;
+                if(!ret)
+                    ret = err;
+            }
+            else
+                return err;
+        }
+
+        if(ops->databuf)
+        {
+            if(ops->retlen >= ops->len)
+                return ret;
+            devops.databuf += devops.retlen;
+        }
+        if(ops->oobbuf)
+        {
+            if(ops->oobretlen >= ops->ooblen)
+                return ret;
+            devops.oobbuf += devops.oobretlen;
+        }
+
+        ofs += size;
+        if(ofs >= mtd->size)
+            return -EINVAL;
+    }
+}
+
+/********************************************************************************
+* 函数: static int32_t concat_stripe_read_oob(__in struct mtd_info *mtd,
+                                             __in loff_t from,
+                                             __inout struct mtd_oob_ops *ops)
+* 描述: 条带模式读取oob数据
+* 输入: mtd: mtd设备链中的头设备
+       from: 读取的起始地址
+       ops: 需要读取的oob数据
+* 输出: ops: 读取到的oob数据
+* 返回: 同concat_stripe_oob
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t concat_stripe_read_oob(__in struct mtd_info *mtd, __in loff_t from,
+                                        __inout struct mtd_oob_ops *ops)
+{
+    return concat_stripe_oob(mtd, from, ops, 0);
+}
+
+/********************************************************************************
+* 函数: static int32_t concat_stripe_write_oob(__in struct mtd_info *mtd,
+                                              __in loff_t to,
+                                              __inout struct mtd_oob_ops *ops)
+* 描述: 条带模式写oob数据
+* 输入: mtd: mtd设备链中的头设备
+       to: 写入的起始地址
+       ops: 需要写入的oob数据
+* 输出: ops: 写入的长度
+* 返回: 同concat_stripe_oob
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t concat_stripe_write_oob(__in struct mtd_info *mtd, __in loff_t to,
+                                         __inout struct mtd_oob_ops *ops)
+{
+    return concat_stripe_oob(mtd, to, ops, 1);
+}
+
+/********************************************************************************
+* 函数: static int32_t concat_stripe_erase(__in struct mtd_info *mtd,
+                                          __inout struct erase_info *instr)
+* 描述: 条带模式擦除，每个条带在子设备内连续，按条带擦除
+* 输入: mtd: mtd设备链中的头设备
+       instr: 擦除的信息结构体
+* 输出: instr: 擦除的信息结构体
+* 返回: 0: 成功
+       -EINVAL: 地址或长度无效
+       -EROFS: 设备只读
+       -ENOMEM: 内存不足
+       其他: 擦除失败
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t concat_stripe_erase(__in struct mtd_info *mtd, __inout struct erase_info *instr)
+{
+    struct mtd_concat *concat = CONCAT(mtd);
+    struct mtd_info *subdev;
+    struct erase_info *erase;
+    uint64_t addr, length, size;
+    loff_t devofs;
+    int32_t err = 0;
+
+    if(!(mtd->flags & MTD_WRITEABLE))
+        return -EROFS;
+
+    if((instr->addr + instr->len) > mtd->size)
+        return -EINVAL;
+
+    if((instr->addr & (mtd->erasesize - 1)) || (instr->len & (mtd->erasesize - 1)))
+        return -EINVAL;
+
+    instr->fail_addr = MTD_FAIL_ADDR_UNKNOWN;
+
+    erase = dlmalloc(sizeof(struct erase_info));
+    if(!erase)
+        return -ENOMEM;
+
+    *erase = *instr;
+    addr = instr->addr;
+    length = instr->len;
+
+    while(length > 0)
+    {
+        size = min_t(uint64_t, length, concat_stripe_map(concat, addr, &subdev, &devofs));
+
+        if(!(subdev->flags & MTD_WRITEABLE))
+        {
+            err = -EROFS;
+            break;
+        }
+
+        erase->addr = devofs;
+        erase->len = size;
+        if((err = concat_dev_erase(subdev, erase)))
+        {
+            if(erase->fail_addr != MTD_FAIL_ADDR_UNKNOWN)
+                instr->fail_addr = addr + (erase->fail_addr - devofs);
+            break;
+        }
+
+        addr += size;
+        length -= size;
+    }
+
+    instr->state = err ? MTD_ERASE_FAILED : MTD_ERASE_DONE;
+    dlfree((int8_t *)erase);
+
+    /* 成功和失败都调用一次擦除回调 */
+    mtd_erase_callback(instr);
+    return err;
+}
+
+/********************************************************************************
+* 函数: static int32_t concat_stripe_block_isbad(__in struct mtd_info *mtd,
+                                                __in loff_t ofs)
+* 描述: 条带模式检测指定地址是否是坏块
+* 输入: mtd: mtd设备链中的头设备
+       ofs: 检测的地址
+* 输出: none
+* 返回: 0: 好块
+       1: 坏块
+       -EINVAL: 参数无效
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t concat_stripe_block_isbad(__in struct mtd_info *mtd, __in loff_t ofs)
+{
+    struct mtd_info *subdev;
+    loff_t devofs;
+
+    if(ofs >= mtd->size)
+        return -EINVAL;
+
+    concat_stripe_map(CONCAT(mtd), ofs, &subdev, &devofs);
+
+    return subdev->block_isbad(subdev, devofs);
+}
+
+/********************************************************************************
+* 函数: static int32_t concat_stripe_block_markbad(__in struct mtd_info *mtd,
+                                                  __in loff_t ofs)
+* 描述: 条带模式标记坏块
+* 输入: mtd: mtd设备链中的头设备
+       ofs: 需要标记坏块的地址
+* 输出: none
+* 返回: 0: 成功
+       -EINVAL: 参数无效
+       其他: 标记失败
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t concat_stripe_block_markbad(__in struct mtd_info *mtd, __in loff_t ofs)
+{
+    struct mtd_info *subdev;
+    loff_t devofs;
+    int32_t err;
+
+    if(ofs >= mtd->size)
+        return -EINVAL;
+
+    concat_stripe_map(CONCAT(mtd), ofs, &subdev, &devofs);
+
+    err = subdev->block_markbad(subdev, devofs);
+    if(!err)
+        mtd->ecc_stats.badblocks++;
+
+    return err;
+}
+
+/********************************************************************************
+* 函数: struct mtd_info *mtd_concat_create_striped(__in struct mtd_info *subdev[],
+                                                  __in int32_t num_devs,
+                                                  __in uint32_t stripe,
+                                                  __in const int8_t *name)
+* 描述: 创建条带模式的mtd设备链，地址按stripe大小轮流分布到各子设备(RAID-0)，
+       大块读写拆分成各子设备的请求. 子设备的大小和擦除大小必须相同，stripe
+       必须是擦除大小的整数倍，子设备大小必须是stripe的整数倍
+* 输入: subdev: 需要链接的设备数组
+       num_devs: 设备的数量
+       stripe: 条带大小
+       name: 链接好的设备的名字
+* 输出: none
+* 返回: 成功: 链接好的设备
+       NULL: 参数无效或者内存不足
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+struct mtd_info *mtd_concat_create_striped(__in struct mtd_info *subdev[], __in int32_t num_devs,
+                                            __in uint32_t stripe, __in const int8_t *name)
+{
+    struct mtd_concat *concat;
+    struct mtd_info *mtd;
+    uint64_t tmp64;
+    int32_t i;
+
+    if(!stripe || (stripe % subdev[0]->erasesize))
+    {
+        printl(LOG_LEVEL_ERR, "[MTD:ERR] stripe size 0x%x is not a multiple of erase size\n", stripe);
+        return NULL;
+    }
+
+    for(i = 0; i < num_devs; i++)
+    {
+        tmp64 = subdev[i]->size;
+        if(subdev[i]->numeraseregions || (subdev[i]->erasesize != subdev[0]->erasesize) ||
+           (subdev[i]->size != subdev[0]->size) || do_div(tmp64, stripe))
+        {
+            printl(LOG_LEVEL_ERR, "[MTD:ERR] \"%s\" can not be striped\n", subdev[i]->name);
+            return NULL;
+        }
+    }
+
+    mtd = mtd_concat_create(subdev, num_devs, name);
+    if(!mtd)
+        return NULL;
+
+    concat = CONCAT(mtd);
+    concat->stripe = stripe;
+
+    concat->mtd.read = concat_stripe_read;
+    concat->mtd.write = concat_stripe_write;
+    concat->mtd.erase = concat_stripe_erase;
+    if(concat->mtd.read_oob)
+        concat->mtd.read_oob = concat_stripe_read_oob;
+    if(concat->mtd.write_oob)
+        concat->mtd.write_oob = concat_stripe_write_oob;
+    if(concat->mtd.block_isbad)
+        concat->mtd.block_isbad = concat_stripe_block_isbad;
+    if(concat->mtd.block_markbad)
+        concat->mtd.block_markbad = concat_stripe_block_markbad;
+
+    /* 条带模式不支持按地址加锁 */
+    concat->mtd.lock = NULL;
+    concat->mtd.unlock = NULL;
+
+    printl(LOG_LEVEL_MSG, "[MTD:MSG] \"%s\" striped over %d devices, stripe size 0x%x\n",
+                          name, num_devs, stripe);
+
+    return &concat->mtd;
+}
+
+
+#ifdef CONFIG_SYS_MTD_CONCAT_BENCH
+/********************************************************************************
+* 函数: static uint32_t concat_bench_pass(__in struct mtd_info *mtd, __in size_t len,
+                                        __in size_t chunk, __in uint8_t *buf)
+* 描述: 从地址0开始每次读取chunk字节，一共读取len字节，计算读取速度
+* 输入: mtd: mtd设备链
+       len: 读取的总字节数，chunk的整数倍
+       chunk: 每次读取的字节数
+       buf: 读取缓冲区，长度为chunk
+* 输出: none
+* 返回: 读取速度，单位KiB/s，读取失败返回0
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static uint32_t concat_bench_pass(__in struct mtd_info *mtd, __in size_t len,
+                                    __in size_t chunk, __in uint8_t *buf)
+{
+    size_t done, retlen;
+    uint32_t start, us;
+    int32_t ret;
+
+    start = get_timer_us(0);
+    for(done = 0; done < len; done += chunk)
+    {
+        ret = mtd->read(mtd, done, chunk, &retlen, buf);
+        if((ret < 0) && (ret != -EUCLEAN) && (ret != -EBADMSG))
+        {
+            printl(LOG_LEVEL_ERR, "[MTD:ERR] bench read at 0x%x failed, code = %d\n", done, -ret);
+            return 0;
+        }
+    }
+    us = get_timer_us(start);
+    if(!us)
+        us = 1;
+
+    return (uint32_t)(((uint64_t)(len >> 10) * 1000000) / us);
+}
+
+/********************************************************************************
+* 函数: void mtd_concat_bench(__in struct mtd_info *subdev[], __in int32_t num_devs,
+                              __in size_t len)
+* 描述: 比较首尾相接和按擦除块条带的设备链的顺序读取速度. 首尾相接时读取的都在
+       第一个子设备上，条带时分布在所有子设备上，只比较速度，不比较数据
+* 输入: subdev: 子设备数组，大小和擦除大小必须相同
+       num_devs: 子设备数量
+       len: 读取的字节数
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+void mtd_concat_bench(__in struct mtd_info *subdev[], __in int32_t num_devs, __in size_t len)
+{
+    struct mtd_info *linear, *striped;
+    size_t chunk;
+    uint8_t *buf;
+    uint32_t speed;
+
+    chunk = subdev[0]->erasesize * num_devs;
+    if(len > subdev[0]->size)
+        len = subdev[0]->size;
+    len -= len % chunk;
+    if(!len)
+        return;
+
+    buf = dlmalloc(chunk);
+    if(!buf)
+    {
+        printl(LOG_LEVEL_ERR, "[MTD:ERR] bench failed to allocate %d bytes\n", chunk);
+        return;
+    }
+
+    linear = mtd_concat_create(subdev, num_devs, "bench-linear");
+    striped = mtd_concat_create_striped(subdev, num_devs, subdev[0]->erasesize, "bench-striped");
+    if(linear && striped)
+    {
+        speed = concat_bench_pass(linear, len, chunk, buf);
+        printl(LOG_LEVEL_INFO, "concat read %u KiB linear: %u KiB/s\n", len >> 10, speed);
+
+        speed = concat_bench_pass(striped, len, chunk, buf);
+        printl(LOG_LEVEL_INFO, "concat read %u KiB striped: %u KiB/s\n", len >> 10, speed);
+    }
+
+    /* 子设备擦除大小相同，没有分配擦除区域 */
+    if(linear)
+        dlfree((int8_t *)CONCAT(linear));
+    if(striped)
+        dlfree((int8_t *)CONCAT(striped));
+    dlfree((int8_t *)buf);
+}
+#endif
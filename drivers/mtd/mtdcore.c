@@ -162,3 +162,370 @@ void put_mtd_device(__in struct mtd_info *mtd)
         --mtd->usecount;
 }
 
+
+/********************************************************************************
+* 函数: static int32_t mtd_next_good(__in struct mtd_info *mtd, __in loff_t ofs,
+                                    __out loff_t *good)
+* 描述: 查找ofs所在块或者之后的第一个好块，设备不支持block_nextgood时逐块检查
+* 输入: mtd: mtd设备句柄
+       ofs: 起始地址
+* 输出: good: 好块起始地址
+* 返回: 0: 找到好块
+       -ENOSPC: 之后没有好块
+       <0: 其他错误
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t mtd_next_good(__in struct mtd_info *mtd, __in loff_t ofs, __out loff_t *good)
+{
+    int32_t ret;
+
+    if(mtd->block_nextgood)
+        return mtd->block_nextgood(mtd, ofs, good);
+
+    for(ofs &= ~((loff_t)mtd->erasesize - 1); ofs < mtd->size; ofs += mtd->erasesize)
+    {
+        ret = mtd->block_isbad ? mtd->block_isbad(mtd, ofs) : 0;
+        if(ret < 0)
+            return ret;
+
+        if(!ret)
+        {
+            *good = ofs;
+            return 0;
+        }
+    }
+
+    return -ENOSPC;
+}
+
+/********************************************************************************
+* 函数: static loff_t mtd_good_run(__in struct mtd_info *mtd, __in loff_t ofs,
+                                  __in loff_t end)
+* 描述: 从好块ofs开始向后查找连续好块，直到遇到坏块或者到达end
+* 输入: mtd: mtd设备句柄
+       ofs: 好块起始地址
+       end: 最大结束地址
+* 输出: none
+* 返回: 连续好块的结束地址
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static loff_t mtd_good_run(__in struct mtd_info *mtd, __in loff_t ofs, __in loff_t end)
+{
+    loff_t good;
+
+    for(ofs += mtd->erasesize; (ofs < end) && (ofs < mtd->size); ofs += mtd->erasesize)
+    {
+        if(mtd_next_good(mtd, ofs, &good) || (good != ofs))
+            break;
+    }
+
+    return (ofs < end) ? ofs : end;
+}
+
+/********************************************************************************
+* 函数: static int32_t mtd_rw_skip_bad(__in struct mtd_info *mtd, __in loff_t from,
+                                      __in size_t len, __out size_t *retlen,
+                                      __out loff_t *span, __inout uint8_t *buf,
+                                      __in int32_t write)
+* 描述: 跳过坏块读写一段逻辑上连续的数据，两个坏块之间的连续好块一次读写
+* 输入: mtd: mtd设备句柄
+       from: 起始地址，所在块是坏块时从之后的好块开始，块内偏移不变
+       len: 数据长度
+       write: 0: 读 1: 写
+* 输出: retlen: 实际读写的长度
+       span: 消耗的物理地址长度(包括跳过的坏块)，可以为NULL
+       buf: 数据缓冲区
+* 返回: 0: 成功
+       -EUCLEAN: 读取成功，有错误位被纠正
+       -ENOSPC: 好块不够
+       <0: 读写失败
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t mtd_rw_skip_bad(__in struct mtd_info *mtd, __in loff_t from, __in size_t len,
+                                 __out size_t *retlen, __out loff_t *span,
+                                 __inout uint8_t *buf, __in int32_t write)
+{
+    loff_t ofs = from, good, end;
+    size_t size, done;
+    int32_t ret = 0, res;
+
+    *retlen = 0;
+    if(span)
+        *span = 0;
+
+    if((from < 0) || (from >= mtd->size))
+        return -EINVAL;
+
+    while(len > 0)
+    {
+        /* 当前块是坏块时跳到下一个好块，块内偏移不变 */
+        res = mtd_next_good(mtd, ofs, &good);
+        if(res)
+            return res;
+
+        if(good != (ofs & ~((loff_t)mtd->erasesize - 1)))
+            ofs = good + (ofs & (mtd->erasesize - 1));
+
+        /* 连续好块一次读写 */
+        end = mtd_good_run(mtd, good, ofs + len);
+        size = (size_t)(end - ofs);
+
+        if(write)
+            res = mtd->write(mtd, ofs, size, &done, buf);
+        else
+            res = mtd->read(mtd, ofs, size, &done, buf);
+
+        *retlen += done;
+        if(span)
+            *span = ofs + done - from;
+
+        if(res == -EUCLEAN)
+            ret = res;
+        else if(res)
+            return res;
+
+        buf += size;
+        len -= size;
+        ofs = end;
+    }
+
+    return ret;
+}
+
+/********************************************************************************
+* 函数: int32_t mtd_read_skip_bad(__in struct mtd_info *mtd, __in loff_t from,
+                                 __in size_t len, __out size_t *retlen,
+                                 __out loff_t *span, __out uint8_t *buf)
+* 描述: 跳过坏块读取一段逻辑上连续的数据，例如跨越坏块的镜像
+* 输入: mtd: mtd设备句柄，可以是分区
+       from: 起始地址
+       len: 数据长度
+* 输出: retlen: 实际读取的长度
+       span: 消耗的物理地址长度(包括跳过的坏块)，可以为NULL
+       buf: 数据缓冲区
+* 返回: 0: 成功
+       -EUCLEAN: 读取成功，有错误位被纠正
+       -ENOSPC: 好块不够
+       <0: 读取失败
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+int32_t mtd_read_skip_bad(__in struct mtd_info *mtd, __in loff_t from, __in size_t len,
+                          __out size_t *retlen, __out loff_t *span, __out uint8_t *buf)
+{
+    return mtd_rw_skip_bad(mtd, from, len, retlen, span, buf, 0);
+}
+
+/********************************************************************************
+* 函数: int32_t mtd_write_skip_bad(__in struct mtd_info *mtd, __in loff_t to,
+                                  __in size_t len, __out size_t *retlen,
+                                  __out loff_t *span, __in const uint8_t *buf)
+* 描述: 跳过坏块写入一段逻辑上连续的数据
+* 输入: mtd: mtd设备句柄，可以是分区
+       to: 起始地址
+       len: 数据长度
+       buf: 数据缓冲区
+* 输出: retlen: 实际写入的长度
+       span: 消耗的物理地址长度(包括跳过的坏块)，可以为NULL
+* 返回: 0: 成功
+       -EROFS: 设备不可写
+       -ENOSPC: 好块不够
+       <0: 写入失败
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+int32_t mtd_write_skip_bad(__in struct mtd_info *mtd, __in loff_t to, __in size_t len,
+                           __out size_t *retlen, __out loff_t *span, __in const uint8_t *buf)
+{
+    if(!mtd->write)
+        return -EROFS;
+
+    return mtd_rw_skip_bad(mtd, to, len, retlen, span, (uint8_t *)buf, 1);
+}
+
+
+
+/********************************************************************************
+* 函数: static int32_t mtd_request_exec(__in struct mtd_info *mtd,
+                                       __inout struct mtd_request *req)
+* 描述: 使用同步接口执行请求，用于不支持异步请求的设备
+* 输入: mtd: mtd设备句柄
+       req: 请求
+* 输出: req: 完成的长度
+* 返回: 同步接口的返回值
+       -EINVAL: 请求类型无效
+       -EOPNOTSUPP: 设备不支持此操作
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t mtd_request_exec(__in struct mtd_info *mtd, __inout struct mtd_request *req)
+{
+    int32_t ret;
+
+    switch(req->type)
+    {
+    case MTD_REQ_READ:
+        return mtd->read(mtd, req->addr, req->len, &req->retlen, req->buf);
+
+    case MTD_REQ_WRITE:
+        if(!mtd->write)
+            return -EROFS;
+        return mtd->write(mtd, req->addr, req->len, &req->retlen, req->buf);
+
+    case MTD_REQ_READ_OOB:
+        if(!mtd->read_oob)
+            return -EOPNOTSUPP;
+        ret = mtd->read_oob(mtd, req->addr, req->ops);
+        req->retlen = req->ops->retlen;
+        return ret;
+
+    case MTD_REQ_ERASE:
+        return mtd->erase(mtd, req->instr);
+
+    default:
+        return -EINVAL;
+    }
+}
+
+/********************************************************************************
+* 函数: void mtd_request_done(__inout struct mtd_request *req, __in int32_t status)
+* 描述: 完成请求，恢复直通层修改的地址之后调用完成回调，驱动完成请求时使用.
+       擦除结束时地址已经由mtd_erase_callback恢复，这里只处理没有开始擦除的失败
+* 输入: req: 请求
+       status: 请求结果
+* 输出: req: 请求状态
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+void mtd_request_done(__inout struct mtd_request *req, __in int32_t status)
+{
+    if(req->bias)
+    {
+        if(req->type != MTD_REQ_ERASE)
+            req->addr -= req->bias;
+        else if(status && (req->instr->state != MTD_ERASE_FAILED))
+        {
+            if(req->instr->fail_addr != MTD_FAIL_ADDR_UNKNOWN)
+                req->instr->fail_addr -= req->bias;
+            req->instr->addr -= req->bias;
+        }
+
+        req->bias = 0;
+    }
+
+    req->status = status;
+
+    if(req->complete)
+        req->complete(req);
+}
+
+/********************************************************************************
+* 函数: int32_t mtd_submit(__in struct mtd_info *mtd, __inout struct mtd_request *req)
+* 描述: 提交异步请求，立即返回，请求完成时调用req->complete. 设备不支持异步请求
+       时同步执行，返回之前请求已经完成
+* 输入: mtd: mtd设备句柄
+       req: 请求，完成之前不能修改或者释放
+* 输出: none
+* 返回: 0: 请求已经接受
+       <0: 请求无效，没有被接受，不会调用完成回调
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+int32_t mtd_submit(__in struct mtd_info *mtd, __inout struct mtd_request *req)
+{
+    int32_t ret;
+
+    if(!mtd || !req)
+        return -EINVAL;
+
+    req->mtd = mtd;
+    req->retlen = 0;
+    req->bias = 0;
+    req->next = NULL;
+    req->status = -EINPROGRESS;
+
+    if(mtd->submit)
+    {
+        ret = mtd->submit(mtd, req);
+        if(ret)
+            req->status = ret;
+
+        return ret;
+    }
+
+    mtd_request_done(req, mtd_request_exec(mtd, req));
+
+    return 0;
+}
+
+/********************************************************************************
+* 函数: int32_t mtd_poll(__in struct mtd_info *mtd)
+* 描述: 推进设备上的异步请求，不等待硬件，完成的请求在这里调用完成回调
+* 输入: mtd: mtd设备句柄
+* 输出: none
+* 返回: >=0: 还没有完成的请求数
+       <0: 错误
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+int32_t mtd_poll(__in struct mtd_info *mtd)
+{
+    return mtd->poll ? mtd->poll(mtd) : 0;
+}
+
+/********************************************************************************
+* 函数: int32_t mtd_wait(__in struct mtd_info *mtd, __in struct mtd_request *req)
+* 描述: 等待请求完成，等待期间设备上之前提交的请求也会完成
+* 输入: mtd: 请求提交到的mtd设备
+       req: 请求
+* 输出: none
+* 返回: 请求的结果
+       -EIO: 设备队列已经空了但是请求没有完成
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+int32_t mtd_wait(__in struct mtd_info *mtd, __in struct mtd_request *req)
+{
+    int32_t ret;
+
+    while(req->status == -EINPROGRESS)
+    {
+        ret = mtd_poll(mtd);
+        if(ret < 0)
+            return ret;
+
+        if(!ret && (req->status == -EINPROGRESS))
+        {
+            printl(LOG_LEVEL_ERR, "[MTD:ERR] request lost on '%s'\n", mtd->name);
+            return -EIO;
+        }
+    }
+
+    return req->status;
+}
+
+/********************************************************************************
+* 函数: int32_t mtd_submit_wait(__in struct mtd_info *mtd,
+                               __inout struct mtd_request *req)
+* 描述: 提交请求并等待完成，驱动用它把同步接口实现为异步请求的包装
+* 输入: mtd: mtd设备句柄
+       req: 请求
+* 输出: req: 完成的长度
+* 返回: 请求的结果
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+int32_t mtd_submit_wait(__in struct mtd_info *mtd, __inout struct mtd_request *req)
+{
+    int32_t ret;
+
+    ret = mtd_submit(mtd, req);
+    if(ret)
+        return ret;
+
+    return mtd_wait(mtd, req);
+}
@@ -324,9 +324,12 @@ static int32_t part_erase(__in struct mtd_info *mtd, __in struct erase_info *ins
 	if(instr->addr >= mtd->size)
 		return -EINVAL;
 
+	/* 擦除开始之后主设备在结束时调用mtd_erase_callback恢复地址，state为
+	   MTD_ERASE_FAILED表示回调已经调用 */
+	instr->state = MTD_ERASE_PENDING;
 	instr->addr += part->offset;
 	ret = part->master->erase(part->master, instr);
-	if(ret)
+	if(ret && (instr->state != MTD_ERASE_FAILED))
 	{
 		if(instr->fail_addr != MTD_FAIL_ADDR_UNKNOWN)
             instr->fail_addr -= part->offset;
@@ -505,6 +508,162 @@ static int32_t part_block_markbad(__in struct mtd_info *mtd, __in loff_t ofs)
 	return res;
 }
 
+/********************************************************************************
+* 函数: static int32_t part_block_nextgood(__in struct mtd_info *mtd,
+                                          __in loff_t ofs,
+                                          __out loff_t *good)
+* 描述: 查找分区内ofs所在块或者之后的第一个好块
+* 输入: mtd: 分区mtd设备
+       ofs: 分区内起始地址
+* 输出: good: 分区内好块地址
+* 返回: 0: 找到好块
+       -EINVAL: 参数无效
+       -ENOSPC: 分区内之后没有好块
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t part_block_nextgood(__in struct mtd_info *mtd, __in loff_t ofs,
+                                     __out loff_t *good)
+{
+	struct mtd_part *part = PART(mtd);
+	int32_t res;
+
+	if(ofs >= mtd->size)
+		return -EINVAL;
+
+	res = part->master->block_nextgood(part->master, ofs + part->offset, good);
+	if(res)
+		return res;
+
+	*good -= part->offset;
+	if(*good >= mtd->size)
+		return -ENOSPC;
+
+	return 0;
+}
+
+/********************************************************************************
+* 函数: static int32_t part_block_skipbad(__in struct mtd_info *mtd,
+                                         __in loff_t from, __in loff_t ofs,
+                                         __out loff_t *phys)
+* 描述: 从分区内from所在块开始跳过坏块，计算逻辑偏移ofs对应的分区内地址
+* 输入: mtd: 分区mtd设备
+       from: 分区内起始地址
+       ofs: 跳过坏块后的逻辑偏移
+* 输出: phys: 分区内地址
+* 返回: 0: 成功
+       -EINVAL: 参数无效
+       -ENOSPC: 分区内好块不够
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t part_block_skipbad(__in struct mtd_info *mtd, __in loff_t from,
+                                    __in loff_t ofs, __out loff_t *phys)
+{
+	struct mtd_part *part = PART(mtd);
+	int32_t res;
+
+	if(from >= mtd->size)
+		return -EINVAL;
+
+	res = part->master->block_skipbad(part->master, from + part->offset, ofs, phys);
+	if(res)
+		return res;
+
+	*phys -= part->offset;
+	if(*phys >= mtd->size)
+		return -ENOSPC;
+
+	return 0;
+}
+
+
+
+/********************************************************************************
+* 函数: static int32_t part_submit(__in struct mtd_info *mtd,
+                                  __inout struct mtd_request *req)
+* 描述: 把异步请求的地址转换成主设备地址后直接加入主设备的队列，请求完成时
+       mtd_request_done按bias恢复分区内地址. 读写长度的截断和同步接口一致
+* 输入: mtd: 分区mtd设备
+       req: 请求
+* 输出: none
+* 返回: 0: 请求已经接受
+       -EINVAL: 参数无效
+       -EROFS: 分区只读
+       其他: 主设备拒绝请求
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t part_submit(__in struct mtd_info *mtd, __inout struct mtd_request *req)
+{
+	struct mtd_part *part = PART(mtd);
+	int32_t ret;
+
+	switch(req->type)
+	{
+	case MTD_REQ_READ:
+	case MTD_REQ_WRITE:
+		if((req->type == MTD_REQ_WRITE) && !(mtd->flags & MTD_WRITEABLE))
+			return -EROFS;
+
+		if(req->addr >= mtd->size)
+			req->len = 0;
+		else if((req->addr + req->len) > mtd->size)
+			req->len = mtd->size - req->addr;
+		break;
+
+	case MTD_REQ_READ_OOB:
+		if(req->addr >= mtd->size)
+			return -EINVAL;
+		if(req->ops->databuf && ((req->addr + req->ops->len) > mtd->size))
+			return -EINVAL;
+		break;
+
+	case MTD_REQ_ERASE:
+		if(!(mtd->flags & MTD_WRITEABLE))
+			return -EROFS;
+		if(req->instr->addr >= mtd->size)
+			return -EINVAL;
+
+		/* 和part_erase一样直接修改擦除地址，擦除结束时由mtd_erase_callback恢复 */
+		req->instr->state = MTD_ERASE_PENDING;
+		req->instr->addr += part->offset;
+		break;
+
+	default:
+		return -EINVAL;
+	}
+
+	if(req->type != MTD_REQ_ERASE)
+		req->addr += part->offset;
+	req->bias += part->offset;
+
+	ret = part->master->submit(part->master, req);
+	if(ret)
+	{
+		if(req->type == MTD_REQ_ERASE)
+			req->instr->addr -= part->offset;
+		else
+			req->addr -= part->offset;
+		req->bias -= part->offset;
+	}
+
+	return ret;
+}
+
+/********************************************************************************
+* 函数: static int32_t part_poll(__in struct mtd_info *mtd)
+* 描述: 推进主设备上的异步请求
+* 输入: mtd: 分区mtd设备
+* 输出: none
+* 返回: 主设备上还没有完成的请求数，包括其他分区提交的请求
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t part_poll(__in struct mtd_info *mtd)
+{
+	return mtd_poll(PART(mtd)->master);
+}
 
 
 /********************************************************************************
@@ -583,6 +742,11 @@ static struct mtd_part *add_one_partition(__in struct mtd_info *master,
 		slave->mtd.read_oob = part_read_oob;
 	if(master->write_oob)
 		slave->mtd.write_oob = part_write_oob;
+	if(master->submit)
+	{
+		slave->mtd.submit = part_submit;
+		slave->mtd.poll = part_poll;
+	}
 	if(master->read_user_prot_reg)
 		slave->mtd.read_user_prot_reg = part_read_user_prot_reg;
 	if(master->read_fact_prot_reg)
@@ -611,6 +775,10 @@ static struct mtd_part *add_one_partition(__in struct mtd_info *master,
 		slave->mtd.block_isbad = part_block_isbad;
 	if(master->block_markbad)
 		slave->mtd.block_markbad = part_block_markbad;
+	if(master->block_nextgood)
+		slave->mtd.block_nextgood = part_block_nextgood;
+	if(master->block_skipbad)
+		slave->mtd.block_skipbad = part_block_skipbad;
 	slave->mtd.erase = part_erase;
 	slave->master = master;
 	slave->offset = part->offset;
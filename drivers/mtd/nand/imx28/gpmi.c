@@ -9,25 +9,142 @@
 #include "mtd/nand/nand_device_info.h"
 #include "mtd/mtd.h"
 #include "mtd/nand/nand.h"
+#include "mtd/bbm.h"
 #include "assert.h"
 #include "math.h"
 #include "malloc.h"
 #include "string.h"
+#include "common.h"
 #include "log.h"
+#include "bitops.h"
+#include "arch/arch-mx28/icoll.h"
+
+/* gpmi单页操作的dma描述器，每种操作使用固定的描述器，初始化时建立模板 */
+#define GPMI_DESC_COMMAND         (0)  /* 发送命令: 1个 */
+#define GPMI_DESC_SEND_DATA       (1)  /* 写原始数据: 1个 */
+#define GPMI_DESC_READ_DATA       (2)  /* 读原始数据: 2个 */
+#define GPMI_DESC_SEND_PAGE       (4)  /* BCH写一页: 1个 */
+#define GPMI_DESC_READ_PAGE       (5)  /* BCH读一页: 4个 */
+#define GPMI_READ_PAGE_DESC_CNT   (4)
+#define GPMI_DESC_PROG_PAGE       (9)  /* 编程一页: 6个 */
+#define GPMI_PROG_PAGE_DESC_CNT   (6)
+
+/* 编程一页的描述器: 命令+地址, BCH写数据(或者原始写data区和oob区), 编程命令, 取消片选 */
+#define GPMI_PROG_SEQIN           (0)
+#define GPMI_PROG_ECC             (1)
+#define GPMI_PROG_DATA            (2)
+#define GPMI_PROG_OOB             (3)
+#define GPMI_PROG_CMD             (4)
+#define GPMI_PROG_DESELECT        (5)
 
 /* gpmi使用到dma描述器的数量 */
-#define GPMI_DMA_DESC_CNT         (8)
+#define GPMI_DMA_DESC_CNT         (GPMI_DESC_PROG_PAGE + GPMI_PROG_PAGE_DESC_CNT)
 
-/* dma描述器指针数组 */
+/* 修改模板pio_words[0]中的片选和传输长度 */
+#define GPMI_PIO0_PATCH(pio, cs, count) \
+    (((pio) & ~(BM_GPMI_CTRL0_CS | BM_GPMI_CTRL0_XFER_COUNT)) | \
+     BF_GPMI_CTRL0_CS(cs) | BF_GPMI_CTRL0_XFER_COUNT(count))
+
+/* dma描述器指针数组，描述器从dma描述器池中连续分配 */
 static struct dma_desc *gpmi_dma_desc[GPMI_DMA_DESC_CNT];
 
+/* 缓冲区地址是否满足dma对齐要求 */
+#define GPMI_DMA_ALIGNED(addr)    (!((uint32_t)(addr) & (DMA_ALIGNMENT - 1)))
+
+/* 一条dma链最多连续读取的页数 */
+#define GPMI_CHAIN_MAX_PAGES      (8)
+
+/* 多页读每页使用的描述器数量: 命令+地址, 读确认, 等待就绪, BCH解码, 关闭BCH */
+#define GPMI_CHAIN_DESC_PER_PAGE  (5)
+
+/* 多页读dma链描述器数量，最后一个用来取消片选 */
+#define GPMI_CHAIN_DESC_CNT       (GPMI_CHAIN_MAX_PAGES * GPMI_CHAIN_DESC_PER_PAGE + 1)
+
+/* 多页读每页命令缓冲区大小: 1字节命令 + 2字节列地址 + 最多3字节行地址，按dma对齐 */
+#define GPMI_CHAIN_CMD_SIZE       (8)
+
+/* 每页命令槽之后的单字节命令槽: 读确认，缓存读，缓存读结束，页编程，缓存编程，多plane编程 */
+#define GPMI_SLOT_READSTART       (GPMI_CHAIN_MAX_PAGES)
+#define GPMI_SLOT_CACHEREAD       (GPMI_CHAIN_MAX_PAGES + 1)
+#define GPMI_SLOT_CACHEREADEND    (GPMI_CHAIN_MAX_PAGES + 2)
+#define GPMI_SLOT_PAGEPROG        (GPMI_CHAIN_MAX_PAGES + 3)
+#define GPMI_SLOT_CACHEDPROG      (GPMI_CHAIN_MAX_PAGES + 4)
+#define GPMI_SLOT_MULTIPROG       (GPMI_CHAIN_MAX_PAGES + 5)
+#define GPMI_CHAIN_CMD_SLOTS      (GPMI_CHAIN_MAX_PAGES + 6)
+
+/* 一页data区+oob区缓冲区大小，按dma对齐，双缓冲的第二块紧跟在第一块之后 */
+#define GPMI_PAGE_BUF_SIZE        ((NAND_MAX_PAGESIZE + NAND_MAX_OOBSIZE + DMA_ALIGNMENT - 1) & \
+                                   ~(DMA_ALIGNMENT - 1))
+
+/* 命令槽地址 */
+#define GPMI_CMD_SLOT(gpmi, n)    ((gpmi)->chain_cmd_buf + (n) * GPMI_CHAIN_CMD_SIZE)
+
+/* 每页auxiliary区大小: metadata(4字节对齐) + 每个ecc块1字节状态，按dma对齐 */
+#define GPMI_CHAIN_AUX_SIZE       ((((GPMI_ECC_METADATA_SIZE + 0x03) & ~0x03) + \
+                                    4096 / GPMI_ECC_BLOCK_SIZE + DMA_ALIGNMENT - 1) & \
+                                   ~(DMA_ALIGNMENT - 1))
+
+/* BCH还没有写回状态时的填充值，BCH状态只会是0x00~0x14, 0xfe, 0xff */
+#define GPMI_BCH_STATUS_PENDING   (0xfd)
+
+/* 多页读dma链描述器指针数组 */
+static struct dma_desc *gpmi_chain_desc[GPMI_CHAIN_DESC_CNT];
+
+/* BCH完成等待时间，单位微秒 */
+#define GPMI_BCH_TIMEOUT_US       (10000)
+
+/* 多页dma链的完成等待时间，每页按一次BCH完成等待时间计算，单位微秒 */
+#define GPMI_CHAIN_TIMEOUT_US(pages)    ((pages) * GPMI_BCH_TIMEOUT_US)
+
+/* 异步编程时等待芯片编程完成(tPROG)的时间，和nand_wait的编程等待时间相同，单位微秒 */
+#define GPMI_PROG_TIMEOUT_US      (20000)
+
+/* BCH完成标记，由中断服务程序设置 */
+static volatile uint32_t gpmi_bch_complete;
+
 
 /* 最大的DLL延时 */
 #define MAX_DLL_CLOCK_PERIOD_IN_NS     (32)
 #define MAX_DLL_DELAY_IN_NS            (16)
 #define MAX_GPMI_SETUP_IN_NS           (4)
 
+/* 信号在板上往返传播延时的范围 */
+#define MAX_GPMI_PROP_DELAY_IN_NS      (5)
+#define MIN_GPMI_PROP_DELAY_IN_NS      (0)
 
+/* DLL采样延时系数的最大值 */
+#define MAX_SAMPLE_DELAY_FACTOR        (15)
+
+/* TIMING0中各时序域的最大周期数 */
+#define GPMI_MAX_TIMING_CYCLES         (0xff)
+
+
+
+/********************************************************************************
+* 函数: static void write_bch_layout(__in uint32_t block_cnt, __in uint32_t metadata_size,
+                                    __in uint32_t page_size, __in uint32_t ecc_strength)
+* 描述: 设置BCH布局0，每个ecc块都是GPMI_ECC_BLOCK_SIZE字节
+* 输入: block_cnt: ecc块数量-1
+       metadata_size: metadata字节数，位于第一个ecc块前面
+       page_size: 一次传输的字节数，包括ecc校验字节
+       ecc_strength: ecc位数
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void write_bch_layout(__in uint32_t block_cnt, __in uint32_t metadata_size,
+                               __in uint32_t page_size, __in uint32_t ecc_strength)
+{
+    REG_WR(REGS_BCH_BASE, HW_BCH_FLASH0LAYOUT0, (BF_BCH_FLASH0LAYOUT0_NBLOCKS(block_cnt) |
+                                                 BF_BCH_FLASH0LAYOUT0_META_SIZE(metadata_size) |
+                                                 BF_BCH_FLASH0LAYOUT0_ECC0(ecc_strength >> 1) |
+                                                 BF_BCH_FLASH0LAYOUT0_DATA0_SIZE(GPMI_ECC_BLOCK_SIZE)));
+
+    REG_WR(REGS_BCH_BASE, HW_BCH_FLASH0LAYOUT1, (BF_BCH_FLASH0LAYOUT1_PAGE_SIZE(page_size) |
+                                                 BF_BCH_FLASH0LAYOUT1_ECCN(ecc_strength >> 1) |
+                                                 BF_BCH_FLASH0LAYOUT1_DATAN_SIZE(GPMI_ECC_BLOCK_SIZE)));
+}
 
 /********************************************************************************
 * 函数: static int32_t set_geometry(__in struct mtd_info *mtd)
@@ -44,14 +161,12 @@ static int32_t set_geometry(__in struct mtd_info *mtd)
     assert(mtd);
 
     uint32_t block_cnt;
-    uint32_t block_size;
     uint32_t metadata_size;
     uint32_t page_size;
     uint32_t ecc_strength;
     int32_t i;
 
     block_cnt = mtd->writesize / GPMI_ECC_BLOCK_SIZE - 1;
-    block_size = GPMI_ECC_BLOCK_SIZE;
     metadata_size = GPMI_ECC_METADATA_SIZE;
 
     /* 计算ecc位数 */
@@ -110,14 +225,8 @@ static int32_t set_geometry(__in struct mtd_info *mtd)
 
 
     /* 设置nandflash布局 */
-    REG_WR(REGS_BCH_BASE, HW_BCH_FLASH0LAYOUT0, (BF_BCH_FLASH0LAYOUT0_NBLOCKS(block_cnt) |
-                                                 BF_BCH_FLASH0LAYOUT0_META_SIZE(metadata_size) |
-                                                 BF_BCH_FLASH0LAYOUT0_ECC0(ecc_strength >> 1) |
-                                                 BF_BCH_FLASH0LAYOUT0_DATA0_SIZE(block_size)));
+    write_bch_layout(block_cnt, metadata_size, page_size, ecc_strength);
 
-    REG_WR(REGS_BCH_BASE, HW_BCH_FLASH0LAYOUT1, (BF_BCH_FLASH0LAYOUT1_PAGE_SIZE(page_size) |
-                                                 BF_BCH_FLASH0LAYOUT1_ECCN(ecc_strength >> 1) |
-                                                 BF_BCH_FLASH0LAYOUT1_DATAN_SIZE(block_size)));
     /* 所有芯片都使用0的布局 */
     REG_WR(REGS_BCH_BASE, HW_BCH_LAYOUTSELECT, 0);
 
@@ -139,13 +248,36 @@ static int32_t set_geometry(__in struct mtd_info *mtd)
 static void clear_bch_irq(void)
 {
     REG_CLR(REGS_BCH_BASE, HW_BCH_CTRL, BM_BCH_CTRL_COMPLETE_IRQ);
+    gpmi_bch_complete = 0;
+}
+
+
+#ifdef CONFIG_USE_IRQ
+/********************************************************************************
+* 函数: static void gpmi_bch_isr(__in void *data)
+* 描述: bch完成中断服务程序
+* 输入: data: 没有使用
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void gpmi_bch_isr(__in void *data)
+{
+    if(REG_RD(REGS_BCH_BASE, HW_BCH_CTRL) & BM_BCH_CTRL_COMPLETE_IRQ)
+    {
+        REG_CLR(REGS_BCH_BASE, HW_BCH_CTRL, BM_BCH_CTRL_COMPLETE_IRQ);
+        gpmi_bch_complete = 1;
+    }
 }
+#endif
 
 
 /********************************************************************************
 * 函数: int32_t wait_for_bch_completion(__in uint32_t time)
-* 描述: 等待bch完成
-* 输入: time: 等待时间
+* 描述: 等待bch完成. 使用中断时完成标记由中断服务程序设置，中断没有打开时
+       直接查询中断标志
+* 输入: time: 等待时间，单位微秒
 * 输出: none
 * 返回: 0: bch计算完成
        -ETIMEDOUT: bch计算超时
@@ -154,9 +286,16 @@ static void clear_bch_irq(void)
 **********************************************************************************/
 int32_t wait_for_bch_completion(__in uint32_t time)
 {
-    while((!(REG_RD(REGS_BCH_BASE, HW_BCH_CTRL) & BM_BCH_CTRL_COMPLETE_IRQ)) && --time);
+    uint32_t start = get_timer_us(0);
 
-    return (time > 0) ? 0 : -ETIMEDOUT;
+    while(!gpmi_bch_complete &&
+          !(REG_RD(REGS_BCH_BASE, HW_BCH_CTRL) & BM_BCH_CTRL_COMPLETE_IRQ))
+    {
+        if(get_timer_us(start) > time)
+            return -ETIMEDOUT;
+    }
+
+    return 0;
 }
 
 
@@ -205,6 +344,30 @@ static uint32_t ns_to_cyles(__in uint32_t time, __in uint32_t period, __in uint3
 
 
 
+/********************************************************************************
+* 函数: static void gpmi_free_dma(__in uint32_t chan_end)
+* 描述: gpmi初始化失败时释放已经分配的dma描述器和通道
+* 输入: chan_end: 已经初始化的通道之后的第一个通道，DMA_CHANNEL_AHB_APBH_GPMI0
+                 表示没有初始化任何通道
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void gpmi_free_dma(__in uint32_t chan_end)
+{
+    uint32_t i;
+
+    for(i = DMA_CHANNEL_AHB_APBH_GPMI0; i < chan_end; i++)
+        dma_release(i);
+
+    for(i = 0; i < GPMI_CHAIN_DESC_CNT; i++)
+        dma_free_desc(gpmi_chain_desc[i]);
+
+    for(i = 0; i < GPMI_DMA_DESC_CNT; i++)
+        dma_free_desc(gpmi_dma_desc[i]);
+}
+
 /********************************************************************************
 * 函数: static int32_t gpmi_init(void)
 * 描述: 初始化gpmi模块
@@ -238,12 +401,32 @@ static int32_t gpmi_init(void)
         }
     }
 
+    /* 分配多页读使用的dma描述器 */
+    for(i = 0; i < GPMI_CHAIN_DESC_CNT; i++)
+    {
+        gpmi_chain_desc[i] = dma_alloc_desc();
+
+        /* 分配描述器失败，释放所有描述器 */
+        if(NULL == gpmi_chain_desc[i])
+        {
+            for(i -= 1; i >=0; i--)
+                dma_free_desc(gpmi_chain_desc[i]);
+
+            for(i = 0; i < GPMI_DMA_DESC_CNT; i++)
+                dma_free_desc(gpmi_dma_desc[i]);
+
+            printl(LOG_LEVEL_ERR, "[GPMI:ERR] allocate gpmi chain dma descriptor failed.\n");
+            return -ENOMEM;
+        }
+    }
+
     for(i = DMA_CHANNEL_AHB_APBH_GPMI0; i <= DMA_CHANNEL_AHB_APBH_GPMI7; i++)
     {
         err = dma_init(i);
-        if(!err)
+        if(err)
         {
             printl(LOG_LEVEL_ERR, "[GPMI:ERR] init dma channel gpmi%d failed, code = %d.\n", i, err);
+            gpmi_free_dma(i);
             return err;
         }
     }
@@ -264,6 +447,7 @@ static int32_t gpmi_init(void)
     if(i <= 0)
     {
         printl(LOG_LEVEL_ERR, "[GPMI:ERR] reset gpmi block timeout.\n");
+        gpmi_free_dma(DMA_CHANNEL_AHB_APBH_GPMI7 + 1);
         return -ETIMEDOUT;
     }
 
@@ -282,6 +466,7 @@ static int32_t gpmi_init(void)
     if(i <= 0)
     {
         printl(LOG_LEVEL_ERR, "[GPMI:ERR] reset gpmi block timeout.\n");
+        gpmi_free_dma(DMA_CHANNEL_AHB_APBH_GPMI7 + 1);
         return -ETIMEDOUT;
     }
 
@@ -298,6 +483,15 @@ static int32_t gpmi_init(void)
     /* 选择BCH ECC */
     REG_SET(REGS_GPMI_BASE, HW_GPMI_CTRL1, BM_GPMI_CTRL1_BCH_MODE);
 
+#ifdef CONFIG_USE_IRQ
+    /* 注册bch完成中断 */
+    err = irq_install_handler(IRQ_BCH, gpmi_bch_isr, NULL);
+    if(err)
+        printl(LOG_LEVEL_WARN, "[GPMI:WARN] bch irq unavailable, polling instead.\n");
+    else
+        irq_enable(IRQ_BCH);
+#endif
+
     return 0;
 }
 
@@ -319,35 +513,42 @@ static void gpmi_deinit(void)
     for(i = 0; i <  GPMI_DMA_DESC_CNT; i++)
         dma_free_desc(gpmi_dma_desc[i]);
 
+    for(i = 0; i < GPMI_CHAIN_DESC_CNT; i++)
+        dma_free_desc(gpmi_chain_desc[i]);
 }
 #endif
 
 /********************************************************************************
 * 函数: static int32_t set_hw_timing(__in nand_chip *chip,
                                     __in struct nand_timing *timing)
-* 描述: 设置gpmi时序
+* 描述: 根据当前gpmi时钟频率设置gpmi时序，芯片提供tREA/tRLOH/tRHOH时，
+       计算读数据有效窗口，选择最短的DATA_SETUP和DLL采样延时(EDO模式)
 * 输入: chip: nand设备的自身指针
-       timing: 需要设置的时序
+       timing: 需要设置的时序，不会被修改
 * 输出: none
 * 返回: 0: 成功
+       -EINVAL: gpmi时钟无效
 * 作者:
 * 版本: v1.0
 **********************************************************************************/
 static int32_t set_hw_timing(__in struct nand_chip *chip, __in struct nand_timing *timing)
 {
+    struct gpmi_info *gpmi = chip->priv;
+    struct nand_timing t = *timing;
     uint32_t clk_rate_in_hz;
     bool improved_timing_available = false;
     uint32_t clk_perid_in_ns;
-    uint32_t rp_in_ns;
-    uint32_t delay_in_ns;
-    uint32_t delta_data_setup_in_ns = 0;
+    uint32_t rp_in_ns = 0;
+    uint32_t trp_in_ns, trc_in_ns;
+    uint32_t eye_start_in_ns, eye_end_in_ns;
+    uint32_t sample_in_ns;
 
     uint32_t data_setup_in_cyles;
     uint32_t data_hold_in_cyles;
     uint32_t address_setup_in_cyles;
-    uint32_t sample_delay_factor;
-    bool dll_use_half_peroids;
-    bool dll_enable;
+    uint32_t sample_delay_factor = 0;
+    bool dll_use_half_peroids = false;
+    bool dll_enable = false;
     uint32_t dll_wait_time_in_us;
 
     uint32_t val = 0;
@@ -355,100 +556,100 @@ static int32_t set_hw_timing(__in struct nand_chip *chip, __in struct nand_timin
     /* 芯片数量增多时，延长一些时间*/
     if(chip->numchips > 2)
     {
-        timing->data_setup_in_ns += 10;
-        timing->data_hold_in_ns += 10;
-        timing->address_setup_in_ns += 10;
+        t.data_setup_in_ns += 10;
+        t.data_hold_in_ns += 10;
+        t.address_setup_in_ns += 10;
     }
 
     /* 更多的时钟信息,有助于提高带宽 */
-    improved_timing_available = ((timing->tREA_in_ns > 0) &&
-                                (timing->tRHOH_in_ns > 0) &&
-                                (timing->tRLOH_in_ns > 0));
+    improved_timing_available = ((t.tREA_in_ns > 0) &&
+                                (t.tRHOH_in_ns >= 0) &&
+                                (t.tRLOH_in_ns >= 0));
 
     /* gpmi时钟周期时间 */
     clk_rate_in_hz = clk_gpmi.get_rate(&clk_gpmi);
+    if(!clk_rate_in_hz || (clk_rate_in_hz > 1000000000))
+        return -EINVAL;
+
     clk_perid_in_ns = 1000000000 / clk_rate_in_hz;
 
 
-    /* 计算延时 */
+    /* 计算需要几个周期 */
+    /* 0时为最大值，所以最小值要设置为1 */
+    data_setup_in_cyles = ns_to_cyles(t.data_setup_in_ns, clk_perid_in_ns, 1);
+    data_hold_in_cyles = ns_to_cyles(t.data_hold_in_ns, clk_perid_in_ns, 1);
+
+    address_setup_in_cyles = ns_to_cyles(t.address_setup_in_ns, clk_perid_in_ns, 0);
+
+
+    /* 计算采样点 */
     if(improved_timing_available)
     {
-        /* dll处理 */
-        if(clk_perid_in_ns > MAX_DLL_CLOCK_PERIOD_IN_NS)
-        {
-            dll_enable = false;
-        }
-        else
+        /* dll只在时钟周期不超过32ns时可用，周期超过16ns时以半个周期为参考 */
+        if(clk_perid_in_ns <= MAX_DLL_CLOCK_PERIOD_IN_NS)
         {
-            if((timing->tREA_in_ns + MAX_GPMI_SETUP_IN_NS) < timing->data_setup_in_ns)
+            if(clk_perid_in_ns > ((MAX_DLL_CLOCK_PERIOD_IN_NS) >> 1))
             {
-                /* 需要gpmi延时 */
-                dll_enable = true;
+                rp_in_ns = (clk_perid_in_ns >> 1);
+                dll_use_half_peroids = true;
+            }
+            else
+                rp_in_ns = clk_perid_in_ns;
+        }
 
-                if(clk_perid_in_ns > ((MAX_DLL_CLOCK_PERIOD_IN_NS) >> 1))
-                {
-                    rp_in_ns = (clk_perid_in_ns >> 1);
-                    dll_use_half_peroids = true;
-                }
-                else
-                {
-                    rp_in_ns = clk_perid_in_ns;
-                    dll_use_half_peroids = false;
-                }
+        /* 从芯片要求的最小RE#低电平时间开始，寻找能够正确采样的最短DATA_SETUP */
+        for(; data_setup_in_cyles <= GPMI_MAX_TIMING_CYCLES; data_setup_in_cyles++)
+        {
+            trp_in_ns = data_setup_in_cyles * clk_perid_in_ns;
+            trc_in_ns = (data_setup_in_cyles + data_hold_in_cyles) * clk_perid_in_ns;
 
+            /* 数据有效窗口(相对RE#下降沿): 从tREA开始，到RE#上升沿之后tRHOH
+               或者下一个RE#下降沿之后tRLOH为止，取两者较晚的一个 */
+            eye_start_in_ns = t.tREA_in_ns + MAX_GPMI_PROP_DELAY_IN_NS + MAX_GPMI_SETUP_IN_NS;
+            eye_end_in_ns = max_t(uint32_t, trp_in_ns + t.tRHOH_in_ns,
+                                  trc_in_ns + t.tRLOH_in_ns) + MIN_GPMI_PROP_DELAY_IN_NS;
 
-                /* 计算延时 */
-                delay_in_ns = timing->tREA_in_ns + MAX_GPMI_SETUP_IN_NS - timing->data_setup_in_ns;
+            /* RE#上升沿时数据已经有效，不需要延时采样 */
+            if(eye_start_in_ns <= trp_in_ns)
+            {
+                dll_enable = false;
+                break;
+            }
 
-                if(delay_in_ns >= MAX_DLL_DELAY_IN_NS)
-                {
-                    delta_data_setup_in_ns = timing->tREA_in_ns + MAX_GPMI_SETUP_IN_NS - MAX_DLL_DELAY_IN_NS + 1;
-                    timing->data_hold_in_ns += (delta_data_setup_in_ns - timing->data_setup_in_ns);
-                    timing->address_setup_in_ns += (delta_data_setup_in_ns - timing->data_setup_in_ns);
-                    timing->data_setup_in_ns = delta_data_setup_in_ns;
-                }
+            /* 不能延时采样或者窗口太窄，只能延长RE#低电平时间 */
+            if(!rp_in_ns || (eye_start_in_ns > eye_end_in_ns))
+                continue;
 
+            /* 采样点尽量放在窗口中间，系数单位为rp/8 */
+            sample_in_ns = (eye_start_in_ns + eye_end_in_ns) >> 1;
+            sample_delay_factor = ((sample_in_ns - trp_in_ns) * 8 + (rp_in_ns >> 1)) / rp_in_ns;
+            if(sample_delay_factor > MAX_SAMPLE_DELAY_FACTOR)
+                sample_delay_factor = MAX_SAMPLE_DELAY_FACTOR;
 
-                /* 寻找合适的系数 */
-                do
-                {
-                    delay_in_ns = timing->tREA_in_ns + MAX_GPMI_SETUP_IN_NS - delta_data_setup_in_ns;
-                    sample_delay_factor = (delay_in_ns * 8 + rp_in_ns - 1) / rp_in_ns;
-                    delta_data_setup_in_ns += 1;
-                }while(sample_delay_factor > 15);
-
-                /* 计算最终时间 */
-                delta_data_setup_in_ns -= 1;
-                timing->data_hold_in_ns += (delta_data_setup_in_ns - timing->data_setup_in_ns);
-                timing->address_setup_in_ns += (delta_data_setup_in_ns - timing->data_setup_in_ns);
-                timing->data_setup_in_ns = delta_data_setup_in_ns;
-                timing->gpmi_sample_delay_in_ns = (sample_delay_factor * rp_in_ns + 7) / 8;
-            }
-            else
+            /* 以1/8ns为单位检查采样点是否落在窗口内 */
+            val = trp_in_ns * 8 + sample_delay_factor * rp_in_ns;
+            if((val >= eye_start_in_ns * 8) && (val <= eye_end_in_ns * 8))
             {
-                /* 不需要gpmi延时 */
-                dll_enable = false;
+                dll_enable = true;
+                break;
             }
         }
-    }
-    else
-    {
-        /* dll处理 */
-        dll_enable = false;
-    }
-
-
-    /* 计算需要几个周期 */
-    /* 0时为最大值，所以最小值要设置为1 */
-    data_setup_in_cyles = ns_to_cyles(timing->data_setup_in_ns, clk_perid_in_ns, 1);
-    data_hold_in_cyles = ns_to_cyles(timing->data_hold_in_ns, clk_perid_in_ns, 1);
 
-    address_setup_in_cyles = ns_to_cyles(timing->address_setup_in_ns, clk_perid_in_ns, 0);
+        /* 找不到合适的采样点时，回退到普通时序 */
+        if(data_setup_in_cyles > GPMI_MAX_TIMING_CYCLES)
+        {
+            printl(LOG_LEVEL_WARN, "[GPMI:WARN] no valid sample point at %u Hz, use normal timing\n", clk_rate_in_hz);
+            data_setup_in_cyles = ns_to_cyles(t.data_setup_in_ns, clk_perid_in_ns, 1);
+            dll_enable = false;
+        }
+    }
 
+    data_setup_in_cyles = min_t(uint32_t, data_setup_in_cyles, GPMI_MAX_TIMING_CYCLES);
+    data_hold_in_cyles = min_t(uint32_t, data_hold_in_cyles, GPMI_MAX_TIMING_CYCLES);
+    address_setup_in_cyles = min_t(uint32_t, address_setup_in_cyles, GPMI_MAX_TIMING_CYCLES);
 
 
     /* 设置延时时间 */
-    val = REG_RD(REGS_GPMI_BASE, HW_GPMI_TIMING0);
     val = (data_setup_in_cyles << BP_GPMI_TIMING0_DATA_SETUP) |
           (data_hold_in_cyles << BP_GPMI_TIMING0_DATA_HOLD) |
           (address_setup_in_cyles << BP_GPMI_TIMING0_ADDRESS_SETUP);
@@ -483,751 +684,2443 @@ static int32_t set_hw_timing(__in struct nand_chip *chip, __in struct nand_timin
         udelay(dll_wait_time_in_us);
     }
 
+    /* 记录时序和对应的时钟，时钟改变后重新计算 */
+    if(gpmi)
+    {
+        gpmi->timing = timing;
+        gpmi->timing_clk_rate = clk_rate_in_hz;
+    }
+
+    printl(LOG_LEVEL_MSG, "[GPMI:MSG] clk %u Hz, setup %u, hold %u, address %u cycles, sample delay %u/8%s\n",
+           clk_rate_in_hz, data_setup_in_cyles, data_hold_in_cyles, address_setup_in_cyles,
+           dll_enable ? sample_delay_factor : 0, dll_use_half_peroids ? " half" : "");
+
     return 0;
 
 }
 
 /********************************************************************************
-* 函数: static int32_t send_command(__in uint32_t chipnum,
-                                   __in uint32_t buffer,
-                                   __in uint32_t length)
-* 描述: 发送指令
-* 输入: chipnum: 芯片号
-       buffer: 命令地址缓冲区
-       length: 命令长度
+* 函数: static void gpmi_build_read_page_template(__in struct dma_desc **d)
+* 描述: 建立BCH读一页的描述器模板: 等待就绪，BCH读数据，关闭BCH等待读取完成
+* 输入: d: 连续3个描述器
 * 输出: none
-* 返回: 0: 成功
-       -ETIMEDOUT: 执行失败，超时
+* 返回: none
 * 作者:
 * 版本: v1.0
 **********************************************************************************/
-static int32_t send_command(__in uint32_t chipnum, __in uint32_t buffer,
-                              __in uint32_t length)
+static void gpmi_build_read_page_template(__in struct dma_desc **d)
 {
-    int32_t dma_channel;
-    struct dma_desc **d = gpmi_dma_desc;
     uint32_t command_mode;
     uint32_t address;
-    int32_t error;
-
+    uint32_t ecc_command;
+    uint32_t buffer_mask;
 
-    /* 写命令 */
+    /* 等待nandflash准备完成 */
     command_mode = BV_GPMI_CTRL0_COMMAND_MODE__WRITE;
-    address = BV_GPMI_CTRL0_ADDRESS__NAND_CLE;
-
-    /* 确定dma通道 */
-    dma_channel = DMA_CHANNEL_AHB_APBH_GPMI0 + chipnum;
+    address = BV_GPMI_CTRL0_ADDRESS__NAND_DATA;
 
-    /* 写dma命令 */
     (*d)->cmd.cmd.data = 0;
-
-    (*d)->cmd.cmd.bits.command = DMA_READ;
+    (*d)->cmd.cmd.bits.command = NO_DMA_XFER;
     (*d)->cmd.cmd.bits.chain = 1;
-    (*d)->cmd.cmd.bits.irq_complete = 1;
+    (*d)->cmd.cmd.bits.irq_complete = 0;
     (*d)->cmd.cmd.bits.nand_lock = 0;
-    (*d)->cmd.cmd.bits.nand_wait4ready = 0;
+    (*d)->cmd.cmd.bits.nand_wait4ready = 1;
     (*d)->cmd.cmd.bits.dec_sem = 1;
     (*d)->cmd.cmd.bits.cmd_wait4end = 1;
     (*d)->cmd.cmd.bits.halt_on_terminate = 0;
-    (*d)->cmd.cmd.bits.num_pio_words = 3;
-    (*d)->cmd.cmd.bits.num_trans_bytes = length;
+    (*d)->cmd.cmd.bits.num_pio_words = 1;
+    (*d)->cmd.cmd.bits.num_trans_bytes = 0;
 
-    (*d)->cmd.bufaddr = buffer;
+    (*d)->cmd.bufaddr = 0;
 
     (*d)->cmd.pio_words[0] =
         BF_GPMI_CTRL0_COMMAND_MODE(command_mode) |
-		BM_GPMI_CTRL0_WORD_LENGTH                |
-		BF_GPMI_CTRL0_CS(chipnum)                |
-		BF_GPMI_CTRL0_ADDRESS(address)           |
-		/* 一个周期后从CLE转到ALE，方便发送命令之后接着发送地址，实现CLE到ALE的快速转换 */
-		BM_GPMI_CTRL0_ADDRESS_INCREMENT          |
-		BF_GPMI_CTRL0_XFER_COUNT(length)         ;
+        BM_GPMI_CTRL0_WORD_LENGTH                |
+        BF_GPMI_CTRL0_CS(0)                      |
+        BF_GPMI_CTRL0_ADDRESS(address)           |
+        BF_GPMI_CTRL0_XFER_COUNT(0)              ;
 
-    /* 禁止BCH/ECC */
-    (*d)->cmd.pio_words[1] = 0;
-    (*d)->cmd.pio_words[2] = 0;
+    d++;
 
-    dma_desc_append(dma_channel, (*d));
-    error = dma_go(dma_channel);
+    /* BCH读数据 */
+    command_mode = BV_GPMI_CTRL0_COMMAND_MODE__READ;
+    ecc_command = BV_GPMI_ECCCTRL_ECC_CMD__DECODE;
+    buffer_mask = BV_GPMI_ECCCTRL_BUFFER_MASK__BCH_PAGE;
 
-    if(error)
-        printl(LOG_LEVEL_ERR, "[GPMI:ERR] send command dma error, code = %d!\n", -error);
+    (*d)->cmd.cmd.data = 0;
+    (*d)->cmd.cmd.bits.command = NO_DMA_XFER;
+    (*d)->cmd.cmd.bits.chain = 1;
+    (*d)->cmd.cmd.bits.irq_complete = 0;
+    (*d)->cmd.cmd.bits.nand_lock = 0;
+    (*d)->cmd.cmd.bits.nand_wait4ready = 0;
+    (*d)->cmd.cmd.bits.dec_sem = 1;
+    (*d)->cmd.cmd.bits.cmd_wait4end = 1;
+    (*d)->cmd.cmd.bits.halt_on_terminate = 0;
+    (*d)->cmd.cmd.bits.num_pio_words = 6;
+    (*d)->cmd.cmd.bits.num_trans_bytes = 0;
 
-    return error;
-}
+    (*d)->cmd.bufaddr = 0;
 
-/********************************************************************************
-* 函数: static int32_t send_data(__in uint32_t chipnum, __in uint32_t buffer,
-                                __in uint32_t length)
-* 描述: 写原始数据到nandflash, 地址可以是一页内的任何地址
-* 输入: chipnum: 芯片号
-       buffer: 需要写的数据缓冲区
-       length: 数据长度
-* 输出: none
-* 返回: 0: 成功
-       -ETIMEDOUT: 写数据超时
-* 作者:
-* 版本: v1.0
-**********************************************************************************/
-static int32_t send_data(__in uint32_t chipnum, __in uint32_t buffer,
-                           __in uint32_t length)
-{
-    int32_t dma_channel;
-    struct dma_desc **d = gpmi_dma_desc;
-    uint32_t command_mode;
-    uint32_t address;
-    int32_t error;
+    (*d)->cmd.pio_words[0] =
+        BF_GPMI_CTRL0_COMMAND_MODE(command_mode) |
+        BM_GPMI_CTRL0_WORD_LENGTH                |
+        BF_GPMI_CTRL0_CS(0)                      |
+        BF_GPMI_CTRL0_ADDRESS(address)           |
+        BF_GPMI_CTRL0_XFER_COUNT(0)              ;
 
+    (*d)->cmd.pio_words[1] = 0;
 
-    /* 写数据 */
-    command_mode = BV_GPMI_CTRL0_COMMAND_MODE__WRITE;
-    address = BV_GPMI_CTRL0_ADDRESS__NAND_DATA;
+    (*d)->cmd.pio_words[2] =
+        BM_GPMI_ECCCTRL_ENABLE_ECC               |
+        BF_GPMI_ECCCTRL_ECC_CMD(ecc_command)     |
+        BF_GPMI_ECCCTRL_BUFFER_MASK(buffer_mask) ;
 
-    /* 确定dma通道 */
-    dma_channel = DMA_CHANNEL_AHB_APBH_GPMI0 + chipnum;
+    (*d)->cmd.pio_words[3] = 0;
+    (*d)->cmd.pio_words[4] = 0;
+    (*d)->cmd.pio_words[5] = 0;
 
-    /* 写dma命令 */
-    (*d)->cmd.cmd.data = 0;
+    d++;
+
+    /* 禁止BCH/ECC，等待读取完成 */
+    command_mode = BV_GPMI_CTRL0_COMMAND_MODE__WAIT_FOR_READY;
 
-    (*d)->cmd.cmd.bits.command = DMA_READ;
-    (*d)->cmd.cmd.bits.chain = 0;
-    (*d)->cmd.cmd.bits.irq_complete = 1;
+    (*d)->cmd.cmd.data = 0;
+    (*d)->cmd.cmd.bits.command = NO_DMA_XFER;
+    (*d)->cmd.cmd.bits.chain = 1;
+    (*d)->cmd.cmd.bits.irq_complete = 0;
     (*d)->cmd.cmd.bits.nand_lock = 0;
-    (*d)->cmd.cmd.bits.nand_wait4ready = 0;
+    (*d)->cmd.cmd.bits.nand_wait4ready = 1;
     (*d)->cmd.cmd.bits.dec_sem = 1;
     (*d)->cmd.cmd.bits.cmd_wait4end = 1;
     (*d)->cmd.cmd.bits.halt_on_terminate = 0;
-    (*d)->cmd.cmd.bits.num_pio_words = 4;
-    (*d)->cmd.cmd.bits.num_trans_bytes = length;
+    (*d)->cmd.cmd.bits.num_pio_words = 3;
+    (*d)->cmd.cmd.bits.num_trans_bytes = 0;
 
-    (*d)->cmd.bufaddr = buffer;
+    (*d)->cmd.bufaddr = 0;
 
     (*d)->cmd.pio_words[0] =
         BF_GPMI_CTRL0_COMMAND_MODE(command_mode) |
-		BM_GPMI_CTRL0_WORD_LENGTH                |
-		BF_GPMI_CTRL0_CS(chipnum)                   |
-		BF_GPMI_CTRL0_ADDRESS(address)           |
-		BF_GPMI_CTRL0_XFER_COUNT(length)         ;
+        BM_GPMI_CTRL0_WORD_LENGTH                |
+        BF_GPMI_CTRL0_CS(0)                      |
+        BF_GPMI_CTRL0_ADDRESS(address)           |
+        BF_GPMI_CTRL0_XFER_COUNT(0)              ;
 
-    /* 禁止BCH/ECC */
     (*d)->cmd.pio_words[1] = 0;
     (*d)->cmd.pio_words[2] = 0;
-    (*d)->cmd.pio_words[3] = 0;
-
-    dma_desc_append(dma_channel, (*d));
-    error = dma_go(dma_channel);
-
-    if(error)
-        printl(LOG_LEVEL_ERR, "[GPMI:ERR] send data dma error, code = %d!\n", -error);
-
-    return error;
 }
 
+/********************************************************************************
+* 函数: static void gpmi_build_deselect_template(__in struct dma_desc *d)
+* 描述: 建立不选中nandflash的描述器模板，作为dma链的最后一条指令
+* 输入: d: 描述器
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void gpmi_build_deselect_template(__in struct dma_desc *d)
+{
+    d->cmd.cmd.data = 0;
+    d->cmd.cmd.bits.command = NO_DMA_XFER;
+    d->cmd.cmd.bits.chain = 0;
+    d->cmd.cmd.bits.irq_complete = 1;
+    d->cmd.cmd.bits.nand_lock = 0;
+    d->cmd.cmd.bits.nand_wait4ready = 0;
+    d->cmd.cmd.bits.dec_sem = 1;
+    d->cmd.cmd.bits.cmd_wait4end = 0;
+    d->cmd.cmd.bits.halt_on_terminate = 0;
+    d->cmd.cmd.bits.num_pio_words = 0;
+    d->cmd.cmd.bits.num_trans_bytes = 0;
+
+    d->cmd.bufaddr = 0;
+}
 
 /********************************************************************************
-* 函数: static int32_t read_data(__in uint32_t chipnum, __out uint32_t buffer,
-                           __in uint32_t length)
-* 描述: 读nandflash原始数据，地址可以是一页内的任何地址
-* 输入: chipnum: 芯片号
-       length: 需要读取的数据长度
-* 输出: buffer: 数据输出缓冲区
-* 返回: 0: 成功
-       -ETIMEDOUT: 读数据超时
+* 函数: static void gpmi_build_prog_page_template(__in struct dma_desc **d)
+* 描述: 建立编程一页的描述器模板: 发送写命令和地址，BCH写数据或者原始写data区和
+       oob区，发送编程命令，取消片选. 编程命令之后不等待就绪，由调用者决定什么时候等待
+* 输入: d: 连续GPMI_PROG_PAGE_DESC_CNT个描述器
+* 输出: none
+* 返回: none
 * 作者:
 * 版本: v1.0
 **********************************************************************************/
-static int32_t read_data(__in uint32_t chipnum, __in uint32_t buffer,
-                           __in uint32_t length)
+static void gpmi_build_prog_page_template(__in struct dma_desc **d)
 {
-    int32_t dma_channel;
-    struct dma_desc **d = gpmi_dma_desc;
+    struct dma_desc *pdesc;
     uint32_t command_mode;
     uint32_t address;
-    int32_t error;
+    uint32_t ecc_command;
+    uint32_t buffer_mask;
+    int32_t i;
+
+    /* 发送写命令和地址 */
+    command_mode = BV_GPMI_CTRL0_COMMAND_MODE__WRITE;
+    address = BV_GPMI_CTRL0_ADDRESS__NAND_CLE;
+
+    pdesc = d[GPMI_PROG_SEQIN];
+
+    pdesc->cmd.cmd.data = 0;
+    pdesc->cmd.cmd.bits.command = DMA_READ;
+    pdesc->cmd.cmd.bits.chain = 1;
+    pdesc->cmd.cmd.bits.irq_complete = 0;
+    pdesc->cmd.cmd.bits.nand_lock = 0;
+    pdesc->cmd.cmd.bits.nand_wait4ready = 0;
+    pdesc->cmd.cmd.bits.dec_sem = 1;
+    pdesc->cmd.cmd.bits.cmd_wait4end = 1;
+    pdesc->cmd.cmd.bits.halt_on_terminate = 0;
+    pdesc->cmd.cmd.bits.num_pio_words = 3;
+    pdesc->cmd.cmd.bits.num_trans_bytes = 0;
+
+    pdesc->cmd.bufaddr = 0;
+
+    pdesc->cmd.pio_words[0] =
+        BF_GPMI_CTRL0_COMMAND_MODE(command_mode) |
+        BM_GPMI_CTRL0_WORD_LENGTH                |
+        BF_GPMI_CTRL0_CS(0)                      |
+        BF_GPMI_CTRL0_ADDRESS(address)           |
+        BM_GPMI_CTRL0_ADDRESS_INCREMENT          |
+        BF_GPMI_CTRL0_XFER_COUNT(0)              ;
+
+    pdesc->cmd.pio_words[1] = 0;
+    pdesc->cmd.pio_words[2] = 0;
+
+    /* BCH写数据 */
+    address = BV_GPMI_CTRL0_ADDRESS__NAND_DATA;
+    ecc_command = BV_GPMI_ECCCTRL_ECC_CMD__ENCODE;
+    buffer_mask = BV_GPMI_ECCCTRL_BUFFER_MASK__BCH_PAGE;
+
+    pdesc = d[GPMI_PROG_ECC];
+
+    pdesc->cmd.cmd.data = 0;
+    pdesc->cmd.cmd.bits.command = NO_DMA_XFER;
+    pdesc->cmd.cmd.bits.chain = 1;
+    pdesc->cmd.cmd.bits.irq_complete = 0;
+    pdesc->cmd.cmd.bits.nand_lock = 0;
+    pdesc->cmd.cmd.bits.nand_wait4ready = 0;
+    pdesc->cmd.cmd.bits.dec_sem = 1;
+    pdesc->cmd.cmd.bits.cmd_wait4end = 1;
+    pdesc->cmd.cmd.bits.halt_on_terminate = 0;
+    pdesc->cmd.cmd.bits.num_pio_words = 6;
+    pdesc->cmd.cmd.bits.num_trans_bytes = 0;
+
+    pdesc->cmd.bufaddr = 0;
+
+    pdesc->cmd.pio_words[0] =
+        BF_GPMI_CTRL0_COMMAND_MODE(command_mode) |
+        BM_GPMI_CTRL0_WORD_LENGTH                |
+        BF_GPMI_CTRL0_CS(0)                      |
+        BF_GPMI_CTRL0_ADDRESS(address)           |
+        BF_GPMI_CTRL0_XFER_COUNT(0)              ;
+
+    pdesc->cmd.pio_words[1] = 0;
+
+    pdesc->cmd.pio_words[2] =
+        BM_GPMI_ECCCTRL_ENABLE_ECC               |
+        BF_GPMI_ECCCTRL_ECC_CMD(ecc_command)     |
+        BF_GPMI_ECCCTRL_BUFFER_MASK(buffer_mask) ;
+
+    pdesc->cmd.pio_words[3] = 0;
+    pdesc->cmd.pio_words[4] = 0;
+    pdesc->cmd.pio_words[5] = 0;
+
+    /* 原始写data区和oob区，禁止BCH/ECC */
+    for(i = GPMI_PROG_DATA; i <= GPMI_PROG_OOB; i++)
+    {
+        pdesc = d[i];
+
+        pdesc->cmd.cmd.data = 0;
+        pdesc->cmd.cmd.bits.command = DMA_READ;
+        pdesc->cmd.cmd.bits.chain = 1;
+        pdesc->cmd.cmd.bits.irq_complete = 0;
+        pdesc->cmd.cmd.bits.nand_lock = 0;
+        pdesc->cmd.cmd.bits.nand_wait4ready = 0;
+        pdesc->cmd.cmd.bits.dec_sem = 1;
+        pdesc->cmd.cmd.bits.cmd_wait4end = 1;
+        pdesc->cmd.cmd.bits.halt_on_terminate = 0;
+        pdesc->cmd.cmd.bits.num_pio_words = 4;
+        pdesc->cmd.cmd.bits.num_trans_bytes = 0;
+
+        pdesc->cmd.bufaddr = 0;
+
+        pdesc->cmd.pio_words[0] =
+            BF_GPMI_CTRL0_COMMAND_MODE(command_mode) |
+            BM_GPMI_CTRL0_WORD_LENGTH                |
+            BF_GPMI_CTRL0_CS(0)                      |
+            BF_GPMI_CTRL0_ADDRESS(address)           |
+            BF_GPMI_CTRL0_XFER_COUNT(0)              ;
+
+        pdesc->cmd.pio_words[1] = 0;
+        pdesc->cmd.pio_words[2] = 0;
+        pdesc->cmd.pio_words[3] = 0;
+    }
+
+    /* 发送编程命令(0x10或者0x15) */
+    address = BV_GPMI_CTRL0_ADDRESS__NAND_CLE;
+
+    pdesc = d[GPMI_PROG_CMD];
+
+    pdesc->cmd.cmd.data = 0;
+    pdesc->cmd.cmd.bits.command = DMA_READ;
+    pdesc->cmd.cmd.bits.chain = 1;
+    pdesc->cmd.cmd.bits.irq_complete = 0;
+    pdesc->cmd.cmd.bits.nand_lock = 0;
+    pdesc->cmd.cmd.bits.nand_wait4ready = 0;
+    pdesc->cmd.cmd.bits.dec_sem = 1;
+    pdesc->cmd.cmd.bits.cmd_wait4end = 1;
+    pdesc->cmd.cmd.bits.halt_on_terminate = 0;
+    pdesc->cmd.cmd.bits.num_pio_words = 3;
+    pdesc->cmd.cmd.bits.num_trans_bytes = 1;
+
+    pdesc->cmd.bufaddr = 0;
+
+    pdesc->cmd.pio_words[0] =
+        BF_GPMI_CTRL0_COMMAND_MODE(command_mode) |
+        BM_GPMI_CTRL0_WORD_LENGTH                |
+        BF_GPMI_CTRL0_CS(0)                      |
+        BF_GPMI_CTRL0_ADDRESS(address)           |
+        BF_GPMI_CTRL0_XFER_COUNT(1)              ;
+
+    pdesc->cmd.pio_words[1] = 0;
+    pdesc->cmd.pio_words[2] = 0;
+
+    /* 取消片选，产生完成中断 */
+    gpmi_build_deselect_template(d[GPMI_PROG_DESELECT]);
+}
+
+/********************************************************************************
+* 函数: static void gpmi_build_dma_templates(void)
+* 描述: 预先建立所有gpmi操作的dma描述器模板，芯片号和传输长度填0，执行时
+       只需要修改片选，传输长度和缓冲区地址
+* 输入: none
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void gpmi_build_dma_templates(void)
+{
+    struct dma_desc *d;
+    uint32_t command_mode;
+    uint32_t address;
+    uint32_t ecc_command;
+    uint32_t buffer_mask;
+    int32_t i;
+
+    /* 发送命令 */
+    command_mode = BV_GPMI_CTRL0_COMMAND_MODE__WRITE;
+    address = BV_GPMI_CTRL0_ADDRESS__NAND_CLE;
+
+    d = gpmi_dma_desc[GPMI_DESC_COMMAND];
+
+    d->cmd.cmd.data = 0;
+    d->cmd.cmd.bits.command = DMA_READ;
+    d->cmd.cmd.bits.chain = 1;
+    d->cmd.cmd.bits.irq_complete = 1;
+    d->cmd.cmd.bits.nand_lock = 0;
+    d->cmd.cmd.bits.nand_wait4ready = 0;
+    d->cmd.cmd.bits.dec_sem = 1;
+    d->cmd.cmd.bits.cmd_wait4end = 1;
+    d->cmd.cmd.bits.halt_on_terminate = 0;
+    d->cmd.cmd.bits.num_pio_words = 3;
+    d->cmd.cmd.bits.num_trans_bytes = 0;
+
+    d->cmd.bufaddr = 0;
+
+    d->cmd.pio_words[0] =
+        BF_GPMI_CTRL0_COMMAND_MODE(command_mode) |
+        BM_GPMI_CTRL0_WORD_LENGTH                |
+        BF_GPMI_CTRL0_CS(0)                      |
+        BF_GPMI_CTRL0_ADDRESS(address)           |
+        /* 一个周期后从CLE转到ALE，方便发送命令之后接着发送地址，实现CLE到ALE的快速转换 */
+        BM_GPMI_CTRL0_ADDRESS_INCREMENT          |
+        BF_GPMI_CTRL0_XFER_COUNT(0)              ;
+
+    /* 禁止BCH/ECC */
+    d->cmd.pio_words[1] = 0;
+    d->cmd.pio_words[2] = 0;
+
+    /* 写原始数据 */
+    command_mode = BV_GPMI_CTRL0_COMMAND_MODE__WRITE;
+    address = BV_GPMI_CTRL0_ADDRESS__NAND_DATA;
+
+    d = gpmi_dma_desc[GPMI_DESC_SEND_DATA];
+
+    d->cmd.cmd.data = 0;
+    d->cmd.cmd.bits.command = DMA_READ;
+    d->cmd.cmd.bits.chain = 0;
+    d->cmd.cmd.bits.irq_complete = 1;
+    d->cmd.cmd.bits.nand_lock = 0;
+    d->cmd.cmd.bits.nand_wait4ready = 0;
+    d->cmd.cmd.bits.dec_sem = 1;
+    d->cmd.cmd.bits.cmd_wait4end = 1;
+    d->cmd.cmd.bits.halt_on_terminate = 0;
+    d->cmd.cmd.bits.num_pio_words = 4;
+    d->cmd.cmd.bits.num_trans_bytes = 0;
+
+    d->cmd.bufaddr = 0;
 
+    d->cmd.pio_words[0] =
+        BF_GPMI_CTRL0_COMMAND_MODE(command_mode) |
+        BM_GPMI_CTRL0_WORD_LENGTH                |
+        BF_GPMI_CTRL0_CS(0)                      |
+        BF_GPMI_CTRL0_ADDRESS(address)           |
+        BF_GPMI_CTRL0_XFER_COUNT(0)              ;
+
+    /* 禁止BCH/ECC */
+    d->cmd.pio_words[1] = 0;
+    d->cmd.pio_words[2] = 0;
+    d->cmd.pio_words[3] = 0;
 
-    /* 写数据 */
+    /* 读原始数据 */
     command_mode = BV_GPMI_CTRL0_COMMAND_MODE__READ;
     address = BV_GPMI_CTRL0_ADDRESS__NAND_DATA;
 
+    d = gpmi_dma_desc[GPMI_DESC_READ_DATA];
+
+    d->cmd.cmd.data = 0;
+    d->cmd.cmd.bits.command = DMA_WRITE;
+    d->cmd.cmd.bits.chain = 1;
+    d->cmd.cmd.bits.irq_complete = 0;
+    d->cmd.cmd.bits.nand_lock = 0;
+    d->cmd.cmd.bits.nand_wait4ready = 0;
+    d->cmd.cmd.bits.dec_sem = 1;
+    d->cmd.cmd.bits.cmd_wait4end = 1;
+    d->cmd.cmd.bits.halt_on_terminate = 0;
+    d->cmd.cmd.bits.num_pio_words = 1;
+    d->cmd.cmd.bits.num_trans_bytes = 0;
+
+    d->cmd.bufaddr = 0;
+
+    d->cmd.pio_words[0] =
+        BF_GPMI_CTRL0_COMMAND_MODE(command_mode) |
+        BM_GPMI_CTRL0_WORD_LENGTH                |
+        BF_GPMI_CTRL0_CS(0)                      |
+        BF_GPMI_CTRL0_ADDRESS(address)           |
+        BF_GPMI_CTRL0_XFER_COUNT(0)              ;
+
+    /* 读原始数据之后等待nandflash就绪 */
+    command_mode = BV_GPMI_CTRL0_COMMAND_MODE__WAIT_FOR_READY;
+
+    d = gpmi_dma_desc[GPMI_DESC_READ_DATA + 1];
+
+    d->cmd.cmd.data = 0;
+    d->cmd.cmd.bits.command = NO_DMA_XFER;
+    d->cmd.cmd.bits.chain = 0;
+    d->cmd.cmd.bits.irq_complete = 1;
+    d->cmd.cmd.bits.nand_lock = 0;
+    d->cmd.cmd.bits.nand_wait4ready = 1;
+    d->cmd.cmd.bits.dec_sem = 1;
+    d->cmd.cmd.bits.cmd_wait4end = 1;
+    d->cmd.cmd.bits.halt_on_terminate = 0;
+    d->cmd.cmd.bits.num_pio_words = 4;
+    d->cmd.cmd.bits.num_trans_bytes = 0;
+
+    d->cmd.bufaddr = 0;
+
+    d->cmd.pio_words[0] =
+        BF_GPMI_CTRL0_COMMAND_MODE(command_mode) |
+        BM_GPMI_CTRL0_WORD_LENGTH                |
+        BF_GPMI_CTRL0_CS(0)                      |
+        BF_GPMI_CTRL0_ADDRESS(address)           |
+        BF_GPMI_CTRL0_XFER_COUNT(0)              ;
+
+    /* 禁止BCH/ECC */
+    d->cmd.pio_words[1] = 0;
+    d->cmd.pio_words[2] = 0;
+    d->cmd.pio_words[3] = 0;
+
+    /* BCH写一页 */
+    command_mode = BV_GPMI_CTRL0_COMMAND_MODE__WRITE;
+    address = BV_GPMI_CTRL0_ADDRESS__NAND_DATA;
+    ecc_command = BV_GPMI_ECCCTRL_ECC_CMD__ENCODE;
+    buffer_mask = BV_GPMI_ECCCTRL_BUFFER_MASK__BCH_PAGE;
+
+    d = gpmi_dma_desc[GPMI_DESC_SEND_PAGE];
+
+    d->cmd.cmd.data = 0;
+    d->cmd.cmd.bits.command = NO_DMA_XFER;
+    d->cmd.cmd.bits.chain = 0;
+    d->cmd.cmd.bits.irq_complete = 1;
+    d->cmd.cmd.bits.nand_lock = 0;
+    d->cmd.cmd.bits.nand_wait4ready = 0;
+    d->cmd.cmd.bits.dec_sem = 1;
+    d->cmd.cmd.bits.cmd_wait4end = 1;
+    d->cmd.cmd.bits.halt_on_terminate = 0;
+    d->cmd.cmd.bits.num_pio_words = 6;
+    d->cmd.cmd.bits.num_trans_bytes = 0;
+
+    d->cmd.bufaddr = 0;
+
+    d->cmd.pio_words[0] =
+        BF_GPMI_CTRL0_COMMAND_MODE(command_mode) |
+        BM_GPMI_CTRL0_WORD_LENGTH                |
+        BF_GPMI_CTRL0_CS(0)                      |
+        BF_GPMI_CTRL0_ADDRESS(address)           |
+        BF_GPMI_CTRL0_XFER_COUNT(0)              ;
+
+    d->cmd.pio_words[1] = 0;
+
+    d->cmd.pio_words[2] =
+        BM_GPMI_ECCCTRL_ENABLE_ECC               |
+        BF_GPMI_ECCCTRL_ECC_CMD(ecc_command)     |
+        BF_GPMI_ECCCTRL_BUFFER_MASK(buffer_mask) ;
+
+    d->cmd.pio_words[3] = 0;
+    d->cmd.pio_words[4] = 0;
+    d->cmd.pio_words[5] = 0;
+
+    /* BCH读一页，最后不选中nandflash */
+    gpmi_build_read_page_template(gpmi_dma_desc + GPMI_DESC_READ_PAGE);
+    gpmi_build_deselect_template(gpmi_dma_desc[GPMI_DESC_READ_PAGE + 3]);
+
+    /* 编程一页，多页写时每页重复使用 */
+    gpmi_build_prog_page_template(gpmi_dma_desc + GPMI_DESC_PROG_PAGE);
+
+    /* 多页读链，每页的描述器和单页读一样，前面多了发送读命令和地址的描述器 */
+    for(i = 0; i < GPMI_CHAIN_MAX_PAGES; i++)
+    {
+        command_mode = BV_GPMI_CTRL0_COMMAND_MODE__WRITE;
+        address = BV_GPMI_CTRL0_ADDRESS__NAND_CLE;
+
+        /* 发送读命令和地址 */
+        d = gpmi_chain_desc[i * GPMI_CHAIN_DESC_PER_PAGE];
+
+        d->cmd.cmd.data = 0;
+        d->cmd.cmd.bits.command = DMA_READ;
+        d->cmd.cmd.bits.chain = 1;
+        d->cmd.cmd.bits.irq_complete = 0;
+        d->cmd.cmd.bits.nand_lock = 0;
+        d->cmd.cmd.bits.nand_wait4ready = 0;
+        d->cmd.cmd.bits.dec_sem = 1;
+        d->cmd.cmd.bits.cmd_wait4end = 1;
+        d->cmd.cmd.bits.halt_on_terminate = 0;
+        d->cmd.cmd.bits.num_pio_words = 3;
+        d->cmd.cmd.bits.num_trans_bytes = 0;
+
+        d->cmd.bufaddr = 0;
+
+        d->cmd.pio_words[0] =
+            BF_GPMI_CTRL0_COMMAND_MODE(command_mode) |
+            BM_GPMI_CTRL0_WORD_LENGTH                |
+            BF_GPMI_CTRL0_CS(0)                      |
+            BF_GPMI_CTRL0_ADDRESS(address)           |
+            BM_GPMI_CTRL0_ADDRESS_INCREMENT          |
+            BF_GPMI_CTRL0_XFER_COUNT(0)              ;
+
+        d->cmd.pio_words[1] = 0;
+        d->cmd.pio_words[2] = 0;
+
+        /* 发送读确认命令 */
+        d = gpmi_chain_desc[i * GPMI_CHAIN_DESC_PER_PAGE + 1];
+
+        d->cmd.cmd.data = 0;
+        d->cmd.cmd.bits.command = DMA_READ;
+        d->cmd.cmd.bits.chain = 1;
+        d->cmd.cmd.bits.irq_complete = 0;
+        d->cmd.cmd.bits.nand_lock = 0;
+        d->cmd.cmd.bits.nand_wait4ready = 0;
+        d->cmd.cmd.bits.dec_sem = 1;
+        d->cmd.cmd.bits.cmd_wait4end = 1;
+        d->cmd.cmd.bits.halt_on_terminate = 0;
+        d->cmd.cmd.bits.num_pio_words = 3;
+        d->cmd.cmd.bits.num_trans_bytes = 1;
+
+        d->cmd.bufaddr = 0;
+
+        d->cmd.pio_words[0] =
+            BF_GPMI_CTRL0_COMMAND_MODE(command_mode) |
+            BM_GPMI_CTRL0_WORD_LENGTH                |
+            BF_GPMI_CTRL0_CS(0)                      |
+            BF_GPMI_CTRL0_ADDRESS(address)           |
+            BF_GPMI_CTRL0_XFER_COUNT(1)              ;
+
+        d->cmd.pio_words[1] = 0;
+        d->cmd.pio_words[2] = 0;
+
+        /* 等待就绪，BCH读数据，关闭BCH */
+        gpmi_build_read_page_template(gpmi_chain_desc + i * GPMI_CHAIN_DESC_PER_PAGE + 2);
+    }
+
+    /* 多页读最后不选中nandflash */
+    gpmi_build_deselect_template(gpmi_chain_desc[GPMI_CHAIN_DESC_CNT - 1]);
+}
+
+/********************************************************************************
+* 函数: static int32_t send_command(__in uint32_t chipnum,
+                                   __in uint32_t buffer,
+                                   __in uint32_t length)
+* 描述: 发送指令
+* 输入: chipnum: 芯片号
+       buffer: 命令地址缓冲区
+       length: 命令长度
+* 输出: none
+* 返回: 0: 成功
+       -ETIMEDOUT: 执行失败，超时
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t send_command(__in uint32_t chipnum, __in uint32_t buffer,
+                              __in uint32_t length)
+{
+    int32_t dma_channel;
+    struct dma_desc *d = gpmi_dma_desc[GPMI_DESC_COMMAND];
+    int32_t error;
+
     /* 确定dma通道 */
     dma_channel = DMA_CHANNEL_AHB_APBH_GPMI0 + chipnum;
 
-    /* 写dma命令 */
-    (*d)->cmd.cmd.data = 0;
+    /* 修改模板 */
+    d->cmd.cmd.bits.num_trans_bytes = length;
+    d->cmd.bufaddr = buffer;
+    d->cmd.pio_words[0] = GPMI_PIO0_PATCH(d->cmd.pio_words[0], chipnum, length);
 
-    (*d)->cmd.cmd.bits.command = DMA_WRITE;
-    (*d)->cmd.cmd.bits.chain = 1;
-    (*d)->cmd.cmd.bits.irq_complete = 0;
-    (*d)->cmd.cmd.bits.nand_lock = 0;
-    (*d)->cmd.cmd.bits.nand_wait4ready = 0;
-    (*d)->cmd.cmd.bits.dec_sem = 1;
-    (*d)->cmd.cmd.bits.cmd_wait4end = 1;
-    (*d)->cmd.cmd.bits.halt_on_terminate = 0;
-    (*d)->cmd.cmd.bits.num_pio_words = 1;
-    (*d)->cmd.cmd.bits.num_trans_bytes = length;
+    dma_desc_append(dma_channel, d);
+    error = dma_go(dma_channel);
 
-    (*d)->cmd.bufaddr = buffer;
+    if(error)
+        printl(LOG_LEVEL_ERR, "[GPMI:ERR] send command dma error, code = %d!\n", -error);
 
-    (*d)->cmd.pio_words[0] =
-        BF_GPMI_CTRL0_COMMAND_MODE(command_mode) |
-		BM_GPMI_CTRL0_WORD_LENGTH                |
-		BF_GPMI_CTRL0_CS(chipnum)                   |
-		BF_GPMI_CTRL0_ADDRESS(address)           |
-		BF_GPMI_CTRL0_XFER_COUNT(length)         ;
+    return error;
+}
+
+/********************************************************************************
+* 函数: static int32_t send_data(__in uint32_t chipnum, __in uint32_t buffer,
+                                __in uint32_t length)
+* 描述: 写原始数据到nandflash, 地址可以是一页内的任何地址
+* 输入: chipnum: 芯片号
+       buffer: 需要写的数据缓冲区
+       length: 数据长度
+* 输出: none
+* 返回: 0: 成功
+       -ETIMEDOUT: 写数据超时
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t send_data(__in uint32_t chipnum, __in uint32_t buffer,
+                           __in uint32_t length)
+{
+    int32_t dma_channel;
+    struct dma_desc *d = gpmi_dma_desc[GPMI_DESC_SEND_DATA];
+    int32_t error;
+
+    /* 确定dma通道 */
+    dma_channel = DMA_CHANNEL_AHB_APBH_GPMI0 + chipnum;
+
+    /* 修改模板 */
+    d->cmd.cmd.bits.num_trans_bytes = length;
+    d->cmd.bufaddr = buffer;
+    d->cmd.pio_words[0] = GPMI_PIO0_PATCH(d->cmd.pio_words[0], chipnum, length);
+
+    dma_desc_append(dma_channel, d);
+    error = dma_go(dma_channel);
+
+    if(error)
+        printl(LOG_LEVEL_ERR, "[GPMI:ERR] send data dma error, code = %d!\n", -error);
+
+    return error;
+}
+
+
+/********************************************************************************
+* 函数: static int32_t read_data(__in uint32_t chipnum, __out uint32_t buffer,
+                           __in uint32_t length)
+* 描述: 读nandflash原始数据，地址可以是一页内的任何地址
+* 输入: chipnum: 芯片号
+       length: 需要读取的数据长度
+* 输出: buffer: 数据输出缓冲区
+* 返回: 0: 成功
+       -ETIMEDOUT: 读数据超时
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t read_data(__in uint32_t chipnum, __in uint32_t buffer,
+                           __in uint32_t length)
+{
+    int32_t dma_channel;
+    struct dma_desc **d = gpmi_dma_desc + GPMI_DESC_READ_DATA;
+    int32_t error;
+
+    /* 确定dma通道 */
+    dma_channel = DMA_CHANNEL_AHB_APBH_GPMI0 + chipnum;
 
+    /* 读数据 */
+    (*d)->cmd.cmd.bits.num_trans_bytes = length;
+    (*d)->cmd.bufaddr = buffer;
+    (*d)->cmd.pio_words[0] = GPMI_PIO0_PATCH((*d)->cmd.pio_words[0], chipnum, length);
 
     dma_desc_append(dma_channel, (*d));
     d++;
 
-    command_mode = BV_GPMI_CTRL0_COMMAND_MODE__WAIT_FOR_READY;
-	address      = BV_GPMI_CTRL0_ADDRESS__NAND_DATA;
-
-	(*d)->cmd.cmd.data = 0;
-	(*d)->cmd.cmd.bits.command = NO_DMA_XFER;
-	(*d)->cmd.cmd.bits.chain = 0;
-	(*d)->cmd.cmd.bits.irq_complete = 1;
-	(*d)->cmd.cmd.bits.nand_lock = 0;
-	(*d)->cmd.cmd.bits.nand_wait4ready = 1;
-	(*d)->cmd.cmd.bits.dec_sem = 1;
-	(*d)->cmd.cmd.bits.cmd_wait4end = 1;
-	(*d)->cmd.cmd.bits.halt_on_terminate = 0;
-	(*d)->cmd.cmd.bits.num_pio_words = 4;
-	(*d)->cmd.cmd.bits.num_trans_bytes = 0;
-
-	(*d)->cmd.bufaddr = 0;
-
-	(*d)->cmd.pio_words[0] =
-		BF_GPMI_CTRL0_COMMAND_MODE(command_mode) |
-		BM_GPMI_CTRL0_WORD_LENGTH                |
-		BF_GPMI_CTRL0_CS(chipnum)                   |
-		BF_GPMI_CTRL0_ADDRESS(address)           |
-		BF_GPMI_CTRL0_XFER_COUNT(0)              ;
+    /* 等待就绪 */
+    (*d)->cmd.pio_words[0] = GPMI_PIO0_PATCH((*d)->cmd.pio_words[0], chipnum, 0);
 
-    /* 禁止BCH/ECC */
-	(*d)->cmd.pio_words[1] = 0;
-	(*d)->cmd.pio_words[2] = 0;
-	(*d)->cmd.pio_words[3] = 0;
+    dma_desc_append(dma_channel, (*d));
+
+    error = dma_go(dma_channel);
+
+    if(error)
+        printl(LOG_LEVEL_ERR, "[GPMI:ERR] read data dma error, code = %d!\n", -error);
+
+    return error;
+}
+
+
+
+/********************************************************************************
+* 函数: static int32_t send_page(__in struct mtd_info *mtd, __in uint32_t chipnum,
+                                __in uint32_t payload, __in uint32_t auxiliary)
+* 描述: 写一页经过bch/ecc校验布局的数据到nandflash，地址为页起始地址
+* 输入: mtd: nandflash设备的父类
+       chipnum: 芯片号
+       payload: data区数据
+       auxiliary: oob或metadata区数据
+* 输出: none
+* 返回: 0: 成功
+       -ETIMEDOUT: 写数据超时
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t send_page(__in struct mtd_info *mtd, __in uint32_t chipnum,
+                           __in uint32_t payload, __in uint32_t auxiliary)
+{
+    int32_t dma_channel;
+    struct dma_desc *d = gpmi_dma_desc[GPMI_DESC_SEND_PAGE];
+    int32_t error;
+
+    dma_channel = DMA_CHANNEL_AHB_APBH_GPMI0 + chipnum;
+
+    /* 修改模板 */
+    d->cmd.pio_words[0] = GPMI_PIO0_PATCH(d->cmd.pio_words[0], chipnum, 0);
+    d->cmd.pio_words[3] = (mtd->writesize + mtd->oobsize);
+    d->cmd.pio_words[4] = payload;
+    d->cmd.pio_words[5] = auxiliary;
+
+    dma_desc_append(dma_channel, d);
+
+    error = dma_go(dma_channel);
+
+     if(error)
+        printl(LOG_LEVEL_ERR, "[GPMI:ERR] send page dma error, code = %d!\n", -error);
+
+    error = wait_for_bch_completion(GPMI_BCH_TIMEOUT_US);
+    if(error)
+        printl(LOG_LEVEL_ERR, "[GPMI:ERR] send page bch error, code = %d!\n", -error);
+
+    clear_bch_irq();
+
+    return error;
+}
+
+/********************************************************************************
+* 函数: static void patch_read_page(__in struct dma_desc **d,
+                                   __in uint32_t chipnum,
+                                   __in uint32_t page_size,
+                                   __out uint32_t payload,
+                                   __out uint32_t auxiliary)
+* 描述: 修改读一页的描述器模板(等待就绪，BCH读数据，关闭BCH)
+* 输入: d: 读一页的第一个描述器
+       chipnum: 芯片号
+       page_size: 页大小，包括oob区
+* 输出: payload: data区数据
+       auxiliary: oob或metadata区数据
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void patch_read_page(__in struct dma_desc **d, __in uint32_t chipnum,
+                              __in uint32_t page_size, __out uint32_t payload,
+                              __out uint32_t auxiliary)
+{
+    d[0]->cmd.pio_words[0] = GPMI_PIO0_PATCH(d[0]->cmd.pio_words[0], chipnum, 0);
+
+    d[1]->cmd.pio_words[0] = GPMI_PIO0_PATCH(d[1]->cmd.pio_words[0], chipnum, page_size);
+    d[1]->cmd.pio_words[3] = page_size;
+    d[1]->cmd.pio_words[4] = payload;
+    d[1]->cmd.pio_words[5] = auxiliary;
+
+    d[2]->cmd.pio_words[0] = GPMI_PIO0_PATCH(d[2]->cmd.pio_words[0], chipnum, page_size);
+}
+
+/********************************************************************************
+* 函数: static int32_t read_chunks(__in uint32_t chipnum, __in uint32_t size,
+                                  __out uint32_t payload, __out uint32_t auxiliary)
+* 描述: 从当前列地址开始BCH解码size字节，BCH布局需要和size一致
+* 输入: chipnum: 芯片号
+       size: 传输的字节数，包括ecc校验字节
+* 输出: payload: data区数据
+       auxiliary: oob或metadata区数据
+* 返回: 0: 成功
+       -ETIMEDOUT: 读数据超时
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t read_chunks(__in uint32_t chipnum, __in uint32_t size,
+                             __out uint32_t payload, __out uint32_t auxiliary)
+{
+    int32_t dma_channel;
+    struct dma_desc **d = gpmi_dma_desc + GPMI_DESC_READ_PAGE;
+    int32_t error;
+    int32_t i;
+
+    dma_channel = DMA_CHANNEL_AHB_APBH_GPMI0 + chipnum;
+
+    /* 等待就绪，BCH读数据，关闭BCH，不选中nandflash */
+    patch_read_page(d, chipnum, size, payload, auxiliary);
+
+    for(i = 0; i < GPMI_READ_PAGE_DESC_CNT; i++)
+        dma_desc_append(dma_channel, d[i]);
+
+    error = dma_go(dma_channel);
+    if(error)
+    {
+        /* dma没有完成时BCH不会有结果，直接返回dma错误 */
+        printl(LOG_LEVEL_ERR, "[GPMI:ERR] read page dma error, code = %d!\n", -error);
+        clear_bch_irq();
+        return error;
+    }
+
+    error = wait_for_bch_completion(GPMI_BCH_TIMEOUT_US);
+    if(error)
+        printl(LOG_LEVEL_ERR, "[GPMI:ERR] read page bch error, code = %d!\n", -error);
+
+    clear_bch_irq();
+
+    return error;
+}
+
+/********************************************************************************
+* 函数: static static int32_t read_page(__in struct mtd_info *mtd,
+                                       __in uint32_t chipnum,
+                                       __out uint32_t payload,
+                                       __out uint32_t auxiliary)
+* 描述: 读一页经过bch/ecc校验布局的nandflash数据到内存，地址是页起始地址
+* 输入: mtd: nandflash设备的父类
+       chipnum: 芯片号
+* 输出: payload: data区数据
+       auxiliary: oob或metadata区数据
+* 返回: 0: 成功
+       -ETIMEDOUT: 读数据超时
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t read_page(__in struct mtd_info *mtd, __in uint32_t chipnum,
+                           __out uint32_t payload, __out uint32_t auxiliary)
+{
+    return read_chunks(chipnum, mtd->writesize + mtd->oobsize, payload, auxiliary);
+}
+
+
+/********************************************************************************
+* 函数: static int32_t read_pages_start(__in struct mtd_info *mtd, __in uint32_t chipnum,
+                                       __in int32_t page, __in int32_t count,
+                                       __out uint32_t payload)
+* 描述: 把连续多页的读命令和BCH解码放到一条dma链中并开始执行，不等待完成，之后
+       必须调用read_pages_finish. 页与页之间控制器不需要重新启动，地址是页起始地址.
+       芯片支持缓存读时，先装载第一页，链中每页只发送0x31(最后一页0x3f)，读出当前
+       页时芯片同时装载下一页
+* 输入: mtd: nandflash设备的父类
+       chipnum: 芯片号
+       page: 起始页(芯片内页号)
+       count: 页数，不超过GPMI_CHAIN_MAX_PAGES
+* 输出: payload: data区数据，长度为count页，dma链执行完之后有效
+* 返回: 0: dma链已经开始执行
+       -ETIMEDOUT: 缓存读装载第一页超时
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t read_pages_start(__in struct mtd_info *mtd, __in uint32_t chipnum,
+                                  __in int32_t page, __in int32_t count,
+                                  __out uint32_t payload)
+{
+    struct nand_chip *this = mtd->priv;
+    struct gpmi_info *gpmi = this->priv;
+    int32_t dma_channel;
+    struct dma_desc **d = gpmi_chain_desc;
+    uint32_t page_size = mtd->writesize + mtd->oobsize;
+    bool cache = NAND_HAS_CACHEREAD(this) ? true : false;
+    uint8_t *cmd_buf;
+    uint32_t cmd_len;
+    uint32_t start;
+    int32_t error;
+    int32_t i, j;
+
+    dma_channel = DMA_CHANNEL_AHB_APBH_GPMI0 + chipnum;
+
+    for(i = 0; i < count; i++, page++)
+    {
+        /* 缓存读只有第一页需要发送地址 */
+        if(!cache || !i)
+        {
+            /* 组织读命令和地址，列地址固定为0 */
+            cmd_buf = gpmi->chain_cmd_buf + i * GPMI_CHAIN_CMD_SIZE;
+            cmd_len = 0;
+            cmd_buf[cmd_len++] = NAND_CMD_READ0;
+            cmd_buf[cmd_len++] = 0;
+            cmd_buf[cmd_len++] = 0;
+            cmd_buf[cmd_len++] = page & 0xff;
+            cmd_buf[cmd_len++] = (page >> 8) & 0xff;
+            /* 大于128MiB的设备多一个页地址字节 */
+            if(this->chipsize > (128 << 20))
+                cmd_buf[cmd_len++] = (page >> 16) & 0xff;
+        }
+
+        if(cache && !i)
+        {
+            /* 装载第一页到数据寄存器 */
+            error = send_command(chipnum, (uint32_t)cmd_buf, cmd_len);
+            if(!error)
+                error = send_command(chipnum, (uint32_t)GPMI_CMD_SLOT(gpmi, GPMI_SLOT_READSTART), 1);
+            if(error)
+                return error;
+
+            /* tWB之后才会变为忙 */
+            ndelay(100);
+            start = get_timer_us(0);
+            while(!is_ready(chipnum))
+            {
+                if(get_timer_us(start) > GPMI_BCH_TIMEOUT_US)
+                {
+                    printl(LOG_LEVEL_ERR, "[GPMI:ERR] cache read wait ready timeout.\n");
+                    return -ETIMEDOUT;
+                }
+            }
+        }
+
+        /* 填充BCH状态，用于判断此页是否已经解码完成 */
+        memset(gpmi->chain_aux_buf + i * GPMI_CHAIN_AUX_SIZE + gpmi->aux_status_ofs,
+               GPMI_BCH_STATUS_PENDING, gpmi->ecc_chunk_cnt);
+
+        if(cache)
+        {
+            /* 把页移到缓存寄存器，除最后一页外同时开始装载下一页 */
+            cmd_buf = GPMI_CMD_SLOT(gpmi, (i == count - 1) ? GPMI_SLOT_CACHEREADEND : GPMI_SLOT_CACHEREAD);
+
+            d[0]->cmd.cmd.bits.num_trans_bytes = 1;
+            d[0]->cmd.bufaddr = (uint32_t)cmd_buf;
+            d[0]->cmd.pio_words[0] = GPMI_PIO0_PATCH(d[0]->cmd.pio_words[0], chipnum, 1);
+        }
+        else
+        {
+            /* 发送读命令和地址 */
+            d[0]->cmd.cmd.bits.num_trans_bytes = cmd_len;
+            d[0]->cmd.bufaddr = (uint32_t)cmd_buf;
+            d[0]->cmd.pio_words[0] = GPMI_PIO0_PATCH(d[0]->cmd.pio_words[0], chipnum, cmd_len);
+
+            /* 发送读确认命令 */
+            d[1]->cmd.bufaddr = (uint32_t)GPMI_CMD_SLOT(gpmi, GPMI_SLOT_READSTART);
+            d[1]->cmd.pio_words[0] = GPMI_PIO0_PATCH(d[1]->cmd.pio_words[0], chipnum, 1);
+        }
+
+        /* 等待就绪，BCH读数据，关闭BCH */
+        patch_read_page(d + 2, chipnum, page_size, payload + i * mtd->writesize,
+                        (uint32_t)(gpmi->chain_aux_buf + i * GPMI_CHAIN_AUX_SIZE));
+
+        for(j = 0; j < GPMI_CHAIN_DESC_PER_PAGE; j++)
+        {
+            /* 缓存读不需要读确认命令 */
+            if(cache && (j == 1))
+                continue;
+
+            dma_desc_append(dma_channel, d[j]);
+        }
+
+        d += GPMI_CHAIN_DESC_PER_PAGE;
+    }
+
+    /* 不选中nandflash */
+    dma_desc_append(dma_channel, gpmi_chain_desc[GPMI_CHAIN_DESC_CNT - 1]);
+
+    /* 清除上一次的bch完成标记 */
+    clear_bch_irq();
+
+    dma_start(dma_channel);
+
+    return 0;
+}
+
+/********************************************************************************
+* 函数: static int32_t read_pages_finish(__in uint32_t chipnum, __in uint32_t timeout)
+* 描述: 等待read_pages_start开始的dma链执行完毕
+* 输入: chipnum: 芯片号
+       timeout: 最多等待的时间，单位微秒
+* 输出: none
+* 返回: 0: 成功
+       -ETIMEDOUT: 读数据超时
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t read_pages_finish(__in uint32_t chipnum, __in uint32_t timeout)
+{
+    int32_t error;
+
+    error = dma_finish(DMA_CHANNEL_AHB_APBH_GPMI0 + chipnum, timeout);
+    if(error)
+        printl(LOG_LEVEL_ERR, "[GPMI:ERR] read pages dma error, code = %d!\n", -error);
+
+    return error;
+}
+
+/********************************************************************************
+* 函数: static int32_t read_pages(__in struct mtd_info *mtd, __in uint32_t chipnum,
+                                 __in int32_t page, __in int32_t count,
+                                 __out uint32_t payload)
+* 描述: 用一条dma链读取连续多页并等待完成
+* 输入: mtd: nandflash设备的父类
+       chipnum: 芯片号
+       page: 起始页(芯片内页号)
+       count: 页数，不超过GPMI_CHAIN_MAX_PAGES
+* 输出: payload: data区数据，长度为count页
+* 返回: 0: 成功
+       -ETIMEDOUT: 读数据超时
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t read_pages(__in struct mtd_info *mtd, __in uint32_t chipnum,
+                            __in int32_t page, __in int32_t count,
+                            __out uint32_t payload)
+{
+    int32_t error;
+
+    error = read_pages_start(mtd, chipnum, page, count, payload);
+    if(error)
+        return error;
+
+    return read_pages_finish(chipnum, GPMI_CHAIN_TIMEOUT_US(count));
+}
+
+/********************************************************************************
+* 函数: static int32_t read_marks(__in struct mtd_info *mtd, __in uint32_t chipnum,
+                                 __in const int32_t *pages, __in int32_t count,
+                                 __in uint32_t column, __in uint32_t len)
+* 描述: 把多页的读命令和原始读取坏块标记放到一条dma链中执行. 借用多页读链的
+       描述器，每页第4个描述器临时改为原始读取len字节，执行完成后恢复模板
+* 输入: mtd: nandflash设备的父类
+       chipnum: 芯片号
+       pages: 每页的芯片内页号
+       count: 页数，不超过GPMI_CHAIN_MAX_PAGES
+       column: 标记的列地址(data区+oob区内偏移)
+       len: 标记长度，不超过GPMI_CHAIN_AUX_SIZE
+* 输出: 第i页的标记存放在chain_aux_buf + i * GPMI_CHAIN_AUX_SIZE
+* 返回: 0: 成功
+       -ETIMEDOUT: 读数据超时
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t read_marks(__in struct mtd_info *mtd, __in uint32_t chipnum,
+                            __in const int32_t *pages, __in int32_t count,
+                            __in uint32_t column, __in uint32_t len)
+{
+    struct nand_chip *this = mtd->priv;
+    struct gpmi_info *gpmi = this->priv;
+    struct dma_desc *raw = gpmi_dma_desc[GPMI_DESC_READ_DATA];
+    struct dma_desc **d = gpmi_chain_desc;
+    int32_t dma_channel;
+    uint8_t *cmd_buf;
+    uint32_t cmd_len;
+    int32_t error;
+    int32_t i;
+
+    dma_channel = DMA_CHANNEL_AHB_APBH_GPMI0 + chipnum;
+
+    for(i = 0; i < count; i++)
+    {
+        /* 组织读命令和地址，列地址指向标记 */
+        cmd_buf = gpmi->chain_cmd_buf + i * GPMI_CHAIN_CMD_SIZE;
+        cmd_len = 0;
+        cmd_buf[cmd_len++] = NAND_CMD_READ0;
+        cmd_buf[cmd_len++] = column & 0xff;
+        cmd_buf[cmd_len++] = (column >> 8) & 0xff;
+        cmd_buf[cmd_len++] = pages[i] & 0xff;
+        cmd_buf[cmd_len++] = (pages[i] >> 8) & 0xff;
+        /* 大于128MiB的设备多一个页地址字节 */
+        if(this->chipsize > (128 << 20))
+            cmd_buf[cmd_len++] = (pages[i] >> 16) & 0xff;
+
+        /* 发送读命令和地址 */
+        d[0]->cmd.cmd.bits.num_trans_bytes = cmd_len;
+        d[0]->cmd.bufaddr = (uint32_t)cmd_buf;
+        d[0]->cmd.pio_words[0] = GPMI_PIO0_PATCH(d[0]->cmd.pio_words[0], chipnum, cmd_len);
+
+        /* 发送读确认命令 */
+        d[1]->cmd.bufaddr = (uint32_t)GPMI_CMD_SLOT(gpmi, GPMI_SLOT_READSTART);
+        d[1]->cmd.pio_words[0] = GPMI_PIO0_PATCH(d[1]->cmd.pio_words[0], chipnum, 1);
+
+        /* 等待就绪 */
+        d[2]->cmd.pio_words[0] = GPMI_PIO0_PATCH(d[2]->cmd.pio_words[0], chipnum, 0);
+
+        /* 原始读取标记，不经过BCH */
+        d[3]->cmd.cmd.data = raw->cmd.cmd.data;
+        d[3]->cmd.cmd.bits.num_pio_words = 3;
+        d[3]->cmd.cmd.bits.num_trans_bytes = len;
+        d[3]->cmd.bufaddr = (uint32_t)(gpmi->chain_aux_buf + i * GPMI_CHAIN_AUX_SIZE);
+        d[3]->cmd.pio_words[0] = GPMI_PIO0_PATCH(raw->cmd.pio_words[0], chipnum, len);
+        d[3]->cmd.pio_words[1] = 0;
+        d[3]->cmd.pio_words[2] = 0;
+
+        dma_desc_append(dma_channel, d[0]);
+        dma_desc_append(dma_channel, d[1]);
+        dma_desc_append(dma_channel, d[2]);
+        dma_desc_append(dma_channel, d[3]);
+
+        d += GPMI_CHAIN_DESC_PER_PAGE;
+    }
+
+    /* 不选中nandflash */
+    dma_desc_append(dma_channel, gpmi_chain_desc[GPMI_CHAIN_DESC_CNT - 1]);
+
+    error = dma_go_timeout(dma_channel, GPMI_CHAIN_TIMEOUT_US(count));
+    if(error)
+        printl(LOG_LEVEL_ERR, "[GPMI:ERR] read marks dma error, code = %d!\n", -error);
+
+    /* 恢复BCH读页模板 */
+    for(i = 0; i < count; i++)
+        gpmi_build_read_page_template(gpmi_chain_desc + i * GPMI_CHAIN_DESC_PER_PAGE + 2);
+
+    return error;
+}
+
+/********************************************************************************
+* 函数: static void prog_page_start(__in struct mtd_info *mtd, __in uint32_t chipnum,
+                                   __in int32_t page, __in uint32_t idx,
+                                   __in uint32_t prog_slot, __in int32_t raw)
+* 描述: 开始编程一页，数据来自第idx块编程缓冲区. dma启动后立即返回，调用者可以
+       在传输期间填充另一块缓冲区，之后调用prog_page_finish等待传输结束
+* 输入: mtd: nandflash设备的父类
+       chipnum: 芯片号
+       page: 页(芯片内页号)
+       idx: 编程缓冲区序号，0或1
+       prog_slot: 编程命令所在的命令槽，页编程(0x10)，缓存编程(0x15)或多plane编程(0x11)
+       raw: 是否原始写入，不经过BCH
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void prog_page_start(__in struct mtd_info *mtd, __in uint32_t chipnum,
+                              __in int32_t page, __in uint32_t idx,
+                              __in uint32_t prog_slot, __in int32_t raw)
+{
+    struct nand_chip *this = mtd->priv;
+    struct gpmi_info *gpmi = this->priv;
+    struct dma_desc **d = gpmi_dma_desc + GPMI_DESC_PROG_PAGE;
+    int32_t dma_channel;
+    uint8_t *cmd_buf;
+    uint32_t cmd_len = 0;
+
+    dma_channel = DMA_CHANNEL_AHB_APBH_GPMI0 + chipnum;
+
+    /* 写命令和地址，前一页的链可能还在读它的命令槽，两块缓冲区各用一个命令槽 */
+    cmd_buf = GPMI_CMD_SLOT(gpmi, idx);
+    cmd_buf[cmd_len++] = NAND_CMD_SEQIN;
+    cmd_buf[cmd_len++] = 0;
+    cmd_buf[cmd_len++] = 0;
+    cmd_buf[cmd_len++] = page & 0xff;
+    cmd_buf[cmd_len++] = (page >> 8) & 0xff;
+    /* 大于128MiB的设备多一个页地址字节 */
+    if(this->chipsize > (128 << 20))
+        cmd_buf[cmd_len++] = (page >> 16) & 0xff;
+
+    d[GPMI_PROG_SEQIN]->cmd.cmd.bits.num_trans_bytes = cmd_len;
+    d[GPMI_PROG_SEQIN]->cmd.bufaddr = (uint32_t)cmd_buf;
+    d[GPMI_PROG_SEQIN]->cmd.pio_words[0] =
+        GPMI_PIO0_PATCH(d[GPMI_PROG_SEQIN]->cmd.pio_words[0], chipnum, cmd_len);
+    dma_desc_append(dma_channel, d[GPMI_PROG_SEQIN]);
+
+    if(raw)
+    {
+        d[GPMI_PROG_DATA]->cmd.cmd.bits.num_trans_bytes = mtd->writesize;
+        d[GPMI_PROG_DATA]->cmd.bufaddr = (uint32_t)gpmi->prog_data_buf[idx];
+        d[GPMI_PROG_DATA]->cmd.pio_words[0] =
+            GPMI_PIO0_PATCH(d[GPMI_PROG_DATA]->cmd.pio_words[0], chipnum, mtd->writesize);
+        dma_desc_append(dma_channel, d[GPMI_PROG_DATA]);
+
+        d[GPMI_PROG_OOB]->cmd.cmd.bits.num_trans_bytes = mtd->oobsize;
+        d[GPMI_PROG_OOB]->cmd.bufaddr = (uint32_t)gpmi->prog_oob_buf[idx];
+        d[GPMI_PROG_OOB]->cmd.pio_words[0] =
+            GPMI_PIO0_PATCH(d[GPMI_PROG_OOB]->cmd.pio_words[0], chipnum, mtd->oobsize);
+        dma_desc_append(dma_channel, d[GPMI_PROG_OOB]);
+    }
+    else
+    {
+        d[GPMI_PROG_ECC]->cmd.pio_words[0] =
+            GPMI_PIO0_PATCH(d[GPMI_PROG_ECC]->cmd.pio_words[0], chipnum, 0);
+        d[GPMI_PROG_ECC]->cmd.pio_words[3] = (mtd->writesize + mtd->oobsize);
+        d[GPMI_PROG_ECC]->cmd.pio_words[4] = (uint32_t)gpmi->prog_data_buf[idx];
+        d[GPMI_PROG_ECC]->cmd.pio_words[5] = (uint32_t)gpmi->prog_oob_buf[idx];
+        dma_desc_append(dma_channel, d[GPMI_PROG_ECC]);
+    }
+
+    /* 编程命令，缓存编程时芯片把数据移到页寄存器后就可以接收下一页 */
+    d[GPMI_PROG_CMD]->cmd.bufaddr = (uint32_t)GPMI_CMD_SLOT(gpmi, prog_slot);
+    d[GPMI_PROG_CMD]->cmd.pio_words[0] =
+        GPMI_PIO0_PATCH(d[GPMI_PROG_CMD]->cmd.pio_words[0], chipnum, 1);
+    dma_desc_append(dma_channel, d[GPMI_PROG_CMD]);
+
+    dma_desc_append(dma_channel, d[GPMI_PROG_DESELECT]);
+
+    /* 清除上一次的bch完成标记 */
+    if(!raw)
+        clear_bch_irq();
+
+    dma_start(dma_channel);
+}
+
+/********************************************************************************
+* 函数: static int32_t prog_page_finish(__in uint32_t chipnum, __in int32_t raw)
+* 描述: 等待prog_page_start开始的一页传输结束，不等待芯片编程完成
+* 输入: chipnum: 芯片号
+       raw: 是否原始写入，不经过BCH
+* 输出: none
+* 返回: 0: 成功
+       -ETIMEDOUT: 写数据超时
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t prog_page_finish(__in uint32_t chipnum, __in int32_t raw)
+{
+    int32_t error;
+
+    error = dma_finish(DMA_CHANNEL_AHB_APBH_GPMI0 + chipnum, GPMI_CHAIN_TIMEOUT_US(1));
+    if(error)
+        printl(LOG_LEVEL_ERR, "[GPMI:ERR] program page dma error, code = %d!\n", -error);
+
+    if(!raw)
+    {
+        if(!error)
+        {
+            error = wait_for_bch_completion(GPMI_BCH_TIMEOUT_US);
+            if(error)
+                printl(LOG_LEVEL_ERR, "[GPMI:ERR] program page bch error, code = %d!\n", -error);
+        }
+
+        clear_bch_irq();
+    }
+
+    return error;
+}
+
+
+
+
+/********************************************************************************
+---------------------------------------------------------------------------------
+---------------------------------------------------------------------------------
+*********************************************************************************/
+
+
+
+/********************************************************************************
+* 函数: static void gpmi_cmd_ctrl(__in struct mtd_info *mtd, __in int32_t data,
+                                 __in uint32_t ctrl)
+* 描述: 通过gpmi发送命令
+* 输入: mtd: nandflash设备的父类
+       data: 命令包含的数据
+       ctrl: 命令类型
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void gpmi_cmd_ctrl(__in struct mtd_info *mtd, __in int32_t data, __in uint32_t ctrl)
+{
+    struct nand_chip *chip = mtd->priv;
+    struct gpmi_info *gpmi = chip->priv;
+    uint32_t error;
+
+    /* 用static变量把所有命令数据和地址数据组织在一起发送 */
+    static uint8_t *cmd_queue = NULL;
+    static uint32_t cmd_q_len;
+
+    /* 第一次初始化cmd_queue */
+    if(!cmd_queue)
+    {
+        cmd_queue = dlmemalign(DMA_ALIGNMENT, GPMI_COMMAND_BUFFER_SIZE);
+
+        if(!cmd_queue)
+        {
+            printl(LOG_LEVEL_ERR, "[GPMI:ERR] failed to alloc command queue buffer\n");
+            return ;
+        }
+
+        memset(cmd_queue, 0, GPMI_COMMAND_BUFFER_SIZE);
+        cmd_q_len = 0;
+    }
+
+    /* 组织命令 */
+    if((ctrl & (NAND_ALE | NAND_CLE)))
+    {
+        if(data != NAND_CMD_NONE)
+            cmd_queue[cmd_q_len++] = data;
+
+        return ;
+    }
+
+    if(!cmd_q_len)
+        return ;
+
+    error = send_command(gpmi->cur_chip, (uint32_t)cmd_queue, cmd_q_len);
+
+    if(error)
+        printl(LOG_LEVEL_ERR, "[GPMI:ERR] send command failed, error = %d", error);
+
+    cmd_q_len = 0;
+}
+
+/********************************************************************************
+* 函数: static int32_t gpmi_dev_ready(__in struct mtd_info *mtd)
+* 描述: 检测gpmi是否空闲
+* 输入: mtd: nandflash设备的父类
+* 输出: none
+* 返回: 0: 空闲
+       1: 不空闲
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t gpmi_dev_ready(__in struct mtd_info *mtd)
+{
+    struct gpmi_info *gpmi = ((struct nand_chip *)(mtd->priv))->priv;
+    return (is_ready(gpmi->cur_chip) ? 1 : 0);
+}
+
+/********************************************************************************
+* 函数: static void gpmi_select_chip(__in struct mtd_info *mtd,
+                                    __in int32_t chipnum)
+* 描述: 选择nandflash芯片
+* 输入: mtd: nandflash设备的父类
+       chipnum: 芯片号
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void gpmi_select_chip(__in struct mtd_info *mtd, __in int32_t chipnum)
+{
+    struct nand_chip *chip = mtd->priv;
+    struct gpmi_info *gpmi = chip->priv;
+
+    /* gpmi时钟改变之后重新计算时序 */
+    if((chipnum >= 0) && gpmi->timing &&
+       (clk_gpmi.get_rate(&clk_gpmi) != gpmi->timing_clk_rate))
+        set_hw_timing(chip, gpmi->timing);
+
+    gpmi->cur_chip = chipnum;
+}
+
+
+/********************************************************************************
+* 函数: static void gpmi_read_buf(__in struct mtd_info *mtd,
+                                 __out uint8_t *buf, __in int32_t len)
+* 描述: 读取nandflash原始数据，地址可以是一页内的任何地址
+* 输入: mtd: nandflash的mtd父类
+       len: 数据长度
+* 输出: buf: 数据输出缓冲区
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void gpmi_read_buf(__in struct mtd_info *mtd, __out uint8_t *buf, __in int32_t len)
+{
+    struct nand_chip *chip = mtd->priv;
+    struct gpmi_info *gpmi = chip->priv;
+
+    if(len > NAND_MAX_PAGESIZE)
+        printl(LOG_LEVEL_WARN, "[GPMI:WARN] len too long\n");
+
+    if(!buf)
+        printl(LOG_LEVEL_WARN, "[GPMI:WARN] buffer point is NULL\n");
+
+
+    read_data(gpmi->cur_chip, (uint32_t)buf, len);
+}
+
+
+/********************************************************************************
+* 函数: static void gpmi_write_buf(__in struct mtd_info *mtd, __in uint8_t *buf,
+                                  __in int32_t len)
+* 描述: 写nandflash原始数据，地址可以时一页内的任何地址
+* 输入: mtd: nandflash设备的mtd设备父类
+       buf: 需要写入的数据缓冲区
+       len: 需要写入的数据长度
+* 输出: none
+* 返回: 0
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void gpmi_write_buf(__in struct mtd_info *mtd, __in const uint8_t *buf, __in int32_t len)
+{
+    struct gpmi_info *gpmi = ((struct nand_chip *)(mtd->priv))->priv;
+
+    if(len > NAND_MAX_PAGESIZE)
+        printl(LOG_LEVEL_WARN, "[GPMI:WARN] len too long\n");
+
+    if(!buf)
+        printl(LOG_LEVEL_WARN, "[GPMI:WARN] buffer point is NULL\n");
+
+    send_data(gpmi->cur_chip, (uint32_t)buf, len);
+}
+
+
+/********************************************************************************
+* 函数: static uint8_t gpmi_read_byte(__in struct mtd_info *mtd)
+* 描述: 读取nandflash一页数据中的一个字节，地址可以是一页内的任何地址
+* 输入: mtd: nandflash设备的mtd设备父类
+* 输出: none
+* 返回: 读取到的字节
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static uint8_t gpmi_read_byte(__in struct mtd_info *mtd)
+{
+    uint8_t byte;
+
+    gpmi_read_buf(mtd, (uint8_t *)&byte, 1);
+
+    return byte;
+}
+
+/********************************************************************************
+* 函数: static int32_t gpmi_read_bbm(__in struct mtd_info *mtd,
+                                    __in const int32_t *pages,
+                                    __in int32_t count,
+                                    __in int32_t column,
+                                    __in int32_t len,
+                                    __out uint8_t *buf)
+* 描述: 批量读取当前芯片上多页oob区中的坏块标记，每GPMI_CHAIN_MAX_PAGES页
+       启动一次dma链，不经过cmdfunc
+* 输入: mtd: nandflash设备的父类
+       pages: 每页的芯片内页号
+       count: 页数
+       column: 标记在oob区中的偏移
+       len: 标记长度
+* 输出: buf: 标记输出缓冲区，每页len字节
+* 返回: 0: 成功
+       -EINVAL: 参数无效
+       -ETIMEDOUT: 读数据超时
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t gpmi_read_bbm(__in struct mtd_info *mtd, __in const int32_t *pages,
+                               __in int32_t count, __in int32_t column,
+                               __in int32_t len, __out uint8_t *buf)
+{
+    struct nand_chip *this = mtd->priv;
+    struct gpmi_info *gpmi = this->priv;
+    int32_t error;
+    int32_t num;
+    int32_t i;
+
+    if((len <= 0) || (len > GPMI_CHAIN_AUX_SIZE))
+        return -EINVAL;
+
+    while(count > 0)
+    {
+        num = min_t(int32_t, count, GPMI_CHAIN_MAX_PAGES);
+
+        error = read_marks(mtd, gpmi->cur_chip, pages, num, mtd->writesize + column, len);
+        if(error)
+            return error;
+
+        for(i = 0; i < num; i++)
+        {
+            memcpy(buf, gpmi->chain_aux_buf + i * GPMI_CHAIN_AUX_SIZE, len);
+            buf += len;
+        }
+
+        gpmi->bbm_read_cnt += num;
+        pages += num;
+        count -= num;
+    }
+
+    return 0;
+}
+
+/********************************************************************************
+* 函数: static uint32_t gpmi_count_zero_bits(__in const uint8_t *buf,
+                                            __in uint32_t len,
+                                            __in uint32_t limit)
+* 描述: 按字统计数据中为0的位数，超过limit时提前返回
+* 输入: buf: 数据
+       len: 数据长度
+       limit: 上限
+* 输出: none
+* 返回: 为0的位数，超过limit时返回值大于limit
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static uint32_t gpmi_count_zero_bits(__in const uint8_t *buf, __in uint32_t len,
+                                     __in uint32_t limit)
+{
+    const uint32_t *word;
+    uint32_t zeros = 0;
+
+    for(; len && ((uint32_t)buf & 0x03); len--)
+        zeros += generic_hweight8(~*buf++);
+
+    for(word = (const uint32_t *)buf; len >= 4; len -= 4, word++)
+    {
+        if(*word == 0xffffffff)
+            continue;
+
+        zeros += generic_hweight32(~*word);
+        if(zeros > limit)
+            return zeros;
+    }
+
+    for(buf = (const uint8_t *)word; len; len--)
+        zeros += generic_hweight8(~*buf++);
+
+    return zeros;
+}
+
+/********************************************************************************
+* 函数: static int32_t gpmi_ecc_check_erased(__in struct mtd_info *mtd,
+                                            __inout uint8_t *payload,
+                                            __inout uint8_t *aux,
+                                            __in uint32_t meta)
+* 描述: 检查擦除页. 擦除页的ecc区也是0xff，出现翻转位时BCH会报告无法纠正，
+       对这样的ecc块统计payload中为0的位数，不超过ecc强度时按擦除块处理:
+       数据填充0xff，状态改为翻转位数，由gpmi_ecc_count按纠正统计
+* 输入: mtd: nandflash设备的父类
+       payload: BCH解码后的数据，每块GPMI_ECC_BLOCK_SIZE字节
+       aux: auxiliary区数据，使用gpmi->ecc_chunk_cnt和gpmi->aux_status_ofs
+       meta: 第一个ecc块包含的metadata字节数
+* 输出: payload: 按擦除处理的块填充为0xff
+       aux: 按擦除处理的块状态改为翻转位数
+* 返回: 1: 所有ecc块都是擦除块
+       0: 存在数据块
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t gpmi_ecc_check_erased(__in struct mtd_info *mtd, __inout uint8_t *payload,
+                                     __inout uint8_t *aux, __in uint32_t meta)
+{
+    struct gpmi_info *gpmi = ((struct nand_chip *)(mtd->priv))->priv;
+    uint8_t *status = aux + gpmi->aux_status_ofs;
+    uint8_t *chunk;
+    uint32_t i, zeros;
+    int32_t erased = 1;
+
+    for(i = 0; i < gpmi->ecc_chunk_cnt; i++)
+    {
+        if(status[i] == 0xff)
+            continue;
+
+        if(status[i] != 0xfe)
+        {
+            erased = 0;
+            continue;
+        }
+
+        chunk = payload + i * GPMI_ECC_BLOCK_SIZE;
+        zeros = gpmi_count_zero_bits(chunk, GPMI_ECC_BLOCK_SIZE, gpmi->ecc_strength);
+        if(!i && meta && (zeros <= gpmi->ecc_strength))
+            zeros += gpmi_count_zero_bits(aux, meta, gpmi->ecc_strength - zeros);
+
+        if(zeros > gpmi->ecc_strength)
+        {
+            erased = 0;
+            continue;
+        }
+
+        memset(chunk, 0xff, GPMI_ECC_BLOCK_SIZE);
+        if(!i && meta)
+            memset(aux, 0xff, meta);
+        if(zeros)
+        {
+            status[i] = zeros;
+            gpmi->erased_bitflip_cnt++;
+        }
+        else
+            status[i] = 0xff;
+    }
+
+    return erased;
+}
+
+/********************************************************************************
+* 函数: static int32_t gpmi_ecc_count(__in struct mtd_info *mtd, __in uint8_t *aux)
+* 描述: 根据BCH写回的状态统计纠正和失败的位数，每块一个状态字节，
+       状态区4字节对齐，每次读取4个状态，4块全部无错或全部擦除时直接跳过;
+       同时按每块翻转位数更新直方图和最大翻转位数
+* 输入: mtd: nandflash设备的父类
+       aux: 一页的auxiliary区数据
+* 输出: none
+* 返回: >=0: 本页单个ecc块中最多的翻转位数
+       -EBADMSG: 存在无法纠正的ecc块
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t gpmi_ecc_count(__in struct mtd_info *mtd, __in uint8_t *aux)
+{
+    struct gpmi_info *gpmi = ((struct nand_chip *)(mtd->priv))->priv;
+    struct mtd_ecc_stats *stats = &mtd->ecc_stats;
+    uint32_t failed = 0;
+    uint32_t corrected = 0;
+    uint32_t max = 0;
+    const uint32_t *status;
+    uint32_t word, mask, cnt, i, j;
+    uint8_t st;
+
+    status = (const uint32_t *)(aux + gpmi->aux_status_ofs);
+
+    for(i = 0; i < gpmi->ecc_chunk_cnt; i += 4)
+    {
+        cnt = min_t(uint32_t, gpmi->ecc_chunk_cnt - i, 4);
+        mask = (cnt == 4) ? 0xffffffff : ((1 << (cnt * 8)) - 1);
+        word = *status++ & mask;
+
+        /* 无错(0x00)或擦除(0xff) */
+        if(!word || (word == mask))
+        {
+            stats->bitflip_hist[0] += cnt;
+            continue;
+        }
+
+        for(j = 0; j < cnt; j++)
+        {
+            st = (word >> (j * 8)) & 0xff;
+            if((st == 0x00) || (st == 0xff))
+            {
+                stats->bitflip_hist[0]++;
+                continue;
+            }
 
-	dma_desc_append(dma_channel, (*d));
+            if(st == 0xfe)
+            {
+                failed++;
+                continue;
+            }
 
-    error = dma_go(dma_channel);
+            corrected += st;
+            if(st > max)
+                max = st;
+            stats->bitflip_hist[min_t(uint32_t, st, MTD_ECC_HIST_SIZE - 1)]++;
+        }
+    }
 
-    if(error)
-        printl(LOG_LEVEL_ERR, "[GPMI:ERR] read data dma error, code = %d!\n", -error);
+    /* 设置mtd层参数 */
+    stats->failed += failed;
+    stats->corrected += corrected;
+    if(max > stats->max_bitflips)
+        stats->max_bitflips = max;
 
-    return error;
+    return failed ? -EBADMSG : max;
 }
 
 
-
 /********************************************************************************
-* 函数: static int32_t send_page(__in struct mtd_info *mtd, __in uint32_t chipnum,
-                                __in uint32_t payload, __in uint32_t auxiliary)
-* 描述: 写一页经过bch/ecc校验布局的数据到nandflash，地址为页起始地址
+* 函数: static int32_t gpmi_ecc_read_page(__in struct mtd_info *mtd,
+                                         __out uint8_t *buf)
+* 描述: 读nandflash一页经过ecc校验的数据，地址必须时页起始地址
+       buf满足dma对齐时直接作为BCH payload缓冲区，省去一次整页拷贝，
+       否则先读到gpmi->data_buf再拷贝到buf
 * 输入: mtd: nandflash设备的父类
-       chipnum: 芯片号
-       payload: data区数据
-       auxiliary: oob或metadata区数据
-* 输出: none
-* 返回: 0: 成功
-       -ETIMEDOUT: 写数据超时
+* 输出: buf: 取出来的数据缓冲区，长度至少为一页
+* 返回: >=0: 单个ecc块中最多的翻转位数
+       -EBADMSG: 存在无法纠正的ecc块，已经计入ecc统计，数据仍然拷贝到buf
+       -ETIMEDOUT: 读数据超时
 * 作者:
 * 版本: v1.0
 **********************************************************************************/
-static int32_t send_page(__in struct mtd_info *mtd, __in uint32_t chipnum,
-                           __in uint32_t payload, __in uint32_t auxiliary)
+static int32_t gpmi_ecc_read_page(__in struct mtd_info *mtd, __out uint8_t *buf)
 {
-    int32_t dma_channel;
-    struct dma_desc **d = gpmi_dma_desc;
-    uint32_t command_mode;
-    uint32_t address;
-    uint32_t ecc_command;
-    uint32_t buffer_mask;
+    struct nand_chip *this = mtd->priv;
+    struct gpmi_info *gpmi = this->priv;
     int32_t error;
+    int32_t erased;
+    uint8_t *payload;
 
-    dma_channel = DMA_CHANNEL_AHB_APBH_GPMI0 + chipnum;
-
-    command_mode = BV_GPMI_CTRL0_COMMAND_MODE__WRITE;
-    address = BV_GPMI_CTRL0_ADDRESS__NAND_DATA;
-    ecc_command = BV_GPMI_ECCCTRL_ECC_CMD__ENCODE;
-    buffer_mask = BV_GPMI_ECCCTRL_BUFFER_MASK__BCH_PAGE;
-
-    (*d)->cmd.cmd.data = 0;
-	(*d)->cmd.cmd.bits.command = NO_DMA_XFER;
-	(*d)->cmd.cmd.bits.chain = 0;
-	(*d)->cmd.cmd.bits.irq_complete = 1;
-	(*d)->cmd.cmd.bits.nand_lock = 0;
-	(*d)->cmd.cmd.bits.nand_wait4ready = 0;
-	(*d)->cmd.cmd.bits.dec_sem = 1;
-	(*d)->cmd.cmd.bits.cmd_wait4end = 1;
-	(*d)->cmd.cmd.bits.halt_on_terminate = 0;
-	(*d)->cmd.cmd.bits.num_pio_words = 6;
-	(*d)->cmd.cmd.bits.num_trans_bytes = 0;
-
-    (*d)->cmd.bufaddr = 0;
-
-    (*d)->cmd.pio_words[0] =
-		BF_GPMI_CTRL0_COMMAND_MODE(command_mode) |
-		BM_GPMI_CTRL0_WORD_LENGTH                |
-		BF_GPMI_CTRL0_CS(chipnum)                   |
-		BF_GPMI_CTRL0_ADDRESS(address)           |
-		BF_GPMI_CTRL0_XFER_COUNT(0)              ;
-
-	(*d)->cmd.pio_words[1] = 0;
-
-	(*d)->cmd.pio_words[2] =
-		BM_GPMI_ECCCTRL_ENABLE_ECC               |
-		BF_GPMI_ECCCTRL_ECC_CMD(ecc_command)     |
-		BF_GPMI_ECCCTRL_BUFFER_MASK(buffer_mask) ;
-
-	(*d)->cmd.pio_words[3] = (mtd->writesize + mtd->oobsize);
-	(*d)->cmd.pio_words[4] = payload;
-	(*d)->cmd.pio_words[5] = auxiliary;
+    /* 选择payload缓冲区，不对齐时使用中转缓冲区 */
+    if(GPMI_DMA_ALIGNED(buf))
+    {
+        payload = buf;
+        gpmi->direct_read_cnt++;
+    }
+    else
+    {
+        payload = gpmi->data_buf;
+        gpmi->bounce_read_cnt++;
+    }
 
-	dma_desc_append(dma_channel, (*d));
-	d++;
+    error = read_page(mtd, gpmi->cur_chip, (uint32_t)payload, (uint32_t)(gpmi->oob_buf));
 
-    error = dma_go(dma_channel);
+    if(error)
+    {
+        printl(LOG_LEVEL_ERR, "[GPMI:ERR] read ecc based page failed, error = %d", error);
+        return error;
+    }
 
-     if(error)
-        printl(LOG_LEVEL_ERR, "[GPMI:ERR] send page dma error, code = %d!\n", -error);
+    erased = gpmi_ecc_check_erased(mtd, payload, gpmi->oob_buf, GPMI_ECC_METADATA_SIZE);
+    error = gpmi_ecc_count(mtd, gpmi->oob_buf);
 
-    error = wait_for_bch_completion(10000);
-    if(error)
-        printl(LOG_LEVEL_ERR, "[GPMI:ERR] send page bch error, code = %d!\n", -error);
+    /* oob区对应BCH的metadata，其余为0xff */
+    memset(this->oob_poi, 0xff, mtd->oobsize);
+    memcpy(this->oob_poi, gpmi->oob_buf, GPMI_ECC_METADATA_SIZE);
 
-    clear_bch_irq();
+    /* 擦除页不需要从中转缓冲区拷贝 */
+    if(erased)
+    {
+        gpmi->erased_read_cnt++;
+        if(payload != buf)
+            memset(buf, 0xff, mtd->writesize);
+    }
+    else if(payload != buf)
+        memcpy(buf, payload, mtd->writesize);
 
     return error;
 }
 
+
 /********************************************************************************
-* 函数: static static int32_t read_page(__in struct mtd_info *mtd,
-                                       __in uint32_t chipnum,
-                                       __out uint32_t payload,
-                                       __out uint32_t auxiliary)
-* 描述: 读一页经过bch/ecc校验布局的nandflash数据到内存，地址是页起始地址
+* 函数: static int32_t gpmi_ecc_read_subpage(__in struct mtd_info *mtd,
+                                            __in uint32_t offs,
+                                            __in uint32_t len,
+                                            __out uint8_t *buf)
+* 描述: 只读取并解码覆盖[offs, offs + len)的ecc块. 临时把BCH布局改成只包含这些
+       ecc块，从第一个块在页中的位置开始传输，读完之后恢复整页布局. 不包含第一个
+       块时metadata不读取，oob_poi全部为0xff. 调用之前需要已经发送读命令
 * 输入: mtd: nandflash设备的父类
-       chipnum: 芯片号
-* 输出: payload: data区数据
-       auxiliary: oob或metadata区数据
-* 返回: 0: 成功
+       offs: 数据在一页中的偏移地址
+       len: 数据长度
+* 输出: buf: 页缓冲区，数据出现在偏移offs的位置
+* 返回: >=0: 读取的ecc块中最多的翻转位数
+       -EBADMSG: 存在无法纠正的ecc块，已经计入ecc统计，数据仍然拷贝到buf
        -ETIMEDOUT: 读数据超时
 * 作者:
 * 版本: v1.0
 **********************************************************************************/
-static int32_t read_page(__in struct mtd_info *mtd, __in uint32_t chipnum,
-                           __out uint32_t payload, __out uint32_t auxiliary)
+static int32_t gpmi_ecc_read_subpage(__in struct mtd_info *mtd, __in uint32_t offs,
+                                       __in uint32_t len, __out uint8_t *buf)
 {
-    int32_t dma_channel;
-    struct dma_desc **d = gpmi_dma_desc;
-    uint32_t command_mode;
-    uint32_t address;
-    uint32_t ecc_command;
-    uint32_t buffer_mask;
+    struct nand_chip *this = mtd->priv;
+    struct gpmi_info *gpmi = this->priv;
+    uint32_t ecc_bytes = (gpmi->ecc_strength * 13) >> 3;
+    uint32_t meta = GPMI_ECC_METADATA_SIZE;
+    uint32_t first, last, count;
+    uint32_t column = 0;
+    uint32_t size;
+    uint32_t chunk_cnt, status_ofs;
+    uint8_t *payload;
     int32_t error;
-    uint32_t page_size = mtd->writesize + mtd->oobsize;
 
-    dma_channel = DMA_CHANNEL_AHB_APBH_GPMI0 + chipnum;
+    first = offs / GPMI_ECC_BLOCK_SIZE;
+    last = (offs + len - 1) / GPMI_ECC_BLOCK_SIZE;
+    count = last - first + 1;
 
+    /* 不包含第一个ecc块时跳过metadata和前面的块 */
+    if(first)
+    {
+        column = meta + first * (GPMI_ECC_BLOCK_SIZE + ecc_bytes);
+        meta = 0;
+    }
+    size = meta + count * (GPMI_ECC_BLOCK_SIZE + ecc_bytes);
 
-    /* 等待nandflash准备完成 */
-    command_mode = BV_GPMI_CTRL0_COMMAND_MODE__WRITE;
-    address = BV_GPMI_CTRL0_ADDRESS__NAND_DATA;
+    if(column)
+        this->cmdfunc(mtd, NAND_CMD_RNDOUT, column, -1);
 
-    (*d)->cmd.cmd.data = 0;
-	(*d)->cmd.cmd.bits.command = NO_DMA_XFER;
-	(*d)->cmd.cmd.bits.chain = 1;
-	(*d)->cmd.cmd.bits.irq_complete = 0;
-	(*d)->cmd.cmd.bits.nand_lock = 0;
-	(*d)->cmd.cmd.bits.nand_wait4ready = 1;
-	(*d)->cmd.cmd.bits.dec_sem = 1;
-	(*d)->cmd.cmd.bits.cmd_wait4end = 1;
-	(*d)->cmd.cmd.bits.halt_on_terminate = 0;
-	(*d)->cmd.cmd.bits.num_pio_words = 1;
-	(*d)->cmd.cmd.bits.num_trans_bytes = 0;
+    buf += first * GPMI_ECC_BLOCK_SIZE;
+    payload = GPMI_DMA_ALIGNED(buf) ? buf : gpmi->data_buf;
 
-    (*d)->cmd.bufaddr = 0;
+    write_bch_layout(count - 1, meta, size, gpmi->ecc_strength);
+    error = read_chunks(gpmi->cur_chip, size, (uint32_t)payload, (uint32_t)(gpmi->oob_buf));
+    write_bch_layout(gpmi->ecc_chunk_cnt - 1, GPMI_ECC_METADATA_SIZE,
+                     mtd->writesize + mtd->oobsize, gpmi->ecc_strength);
 
-    (*d)->cmd.pio_words[0] =
-		BF_GPMI_CTRL0_COMMAND_MODE(command_mode) |
-		BM_GPMI_CTRL0_WORD_LENGTH                |
-		BF_GPMI_CTRL0_CS(chipnum)                |
-		BF_GPMI_CTRL0_ADDRESS(address)           |
-		BF_GPMI_CTRL0_XFER_COUNT(0)              ;
+    if(error)
+    {
+        printl(LOG_LEVEL_ERR, "[GPMI:ERR] read ecc based subpage failed, error = %d", error);
+        return error;
+    }
 
-	dma_desc_append(dma_channel, (*d));
-    d++;
+    /* 只统计读取的ecc块，状态紧跟在metadata之后 */
+    chunk_cnt = gpmi->ecc_chunk_cnt;
+    status_ofs = gpmi->aux_status_ofs;
+    gpmi->ecc_chunk_cnt = count;
+    gpmi->aux_status_ofs = (meta + 0x03) & ~0x03;
+    gpmi_ecc_check_erased(mtd, payload, gpmi->oob_buf, meta);
+    error = gpmi_ecc_count(mtd, gpmi->oob_buf);
+    gpmi->ecc_chunk_cnt = chunk_cnt;
+    gpmi->aux_status_ofs = status_ofs;
+
+    /* 和整页读取一样，oob区对应完整的BCH metadata，没有读取metadata时全部为0xff */
+    memset(this->oob_poi, 0xff, mtd->oobsize);
+    if(meta)
+        memcpy(this->oob_poi, gpmi->oob_buf, meta);
 
-    /* BCH读数据 */
-    command_mode = BV_GPMI_CTRL0_COMMAND_MODE__READ;
-    address = BV_GPMI_CTRL0_ADDRESS__NAND_DATA;
-    ecc_command = BV_GPMI_ECCCTRL_ECC_CMD__DECODE;
-    buffer_mask = BV_GPMI_ECCCTRL_BUFFER_MASK__BCH_PAGE;
+    if(payload != buf)
+        memcpy(buf, payload, count * GPMI_ECC_BLOCK_SIZE);
 
-    (*d)->cmd.cmd.data = 0;
-	(*d)->cmd.cmd.bits.command = NO_DMA_XFER;
-	(*d)->cmd.cmd.bits.chain = 1;
-	(*d)->cmd.cmd.bits.irq_complete = 0;
-	(*d)->cmd.cmd.bits.nand_lock = 0;
-	(*d)->cmd.cmd.bits.nand_wait4ready = 0;
-	(*d)->cmd.cmd.bits.dec_sem = 1;
-	(*d)->cmd.cmd.bits.cmd_wait4end = 1;
-	(*d)->cmd.cmd.bits.halt_on_terminate = 0;
-	(*d)->cmd.cmd.bits.num_pio_words = 6;
-	(*d)->cmd.cmd.bits.num_trans_bytes = 0;
+    gpmi->subpage_read_cnt++;
 
-    (*d)->cmd.bufaddr = 0;
+    return error;
+}
 
-    (*d)->cmd.pio_words[0] =
-		BF_GPMI_CTRL0_COMMAND_MODE(command_mode) |
-		BM_GPMI_CTRL0_WORD_LENGTH                |
-		BF_GPMI_CTRL0_CS(chipnum)                   |
-		BF_GPMI_CTRL0_ADDRESS(address)           |
-		BF_GPMI_CTRL0_XFER_COUNT(page_size)              ;
 
-	(*d)->cmd.pio_words[1] = 0;
+/********************************************************************************
+* 函数: static int32_t gpmi_chain_collect(__in struct mtd_info *mtd, __in int32_t page,
+                                         __in int32_t count, __inout uint8_t *buf)
+* 描述: 多页读dma链执行完后按顺序收集每页的BCH状态，更新ecc统计，oob区保留最后
+       一页的metadata
+* 输入: mtd: nandflash设备的父类
+       page: 起始页(芯片内页号)
+       count: 链中的页数
+       buf: 链读取的数据
+* 输出: buf: 擦除页填充为0xff
+* 返回: >=0: 所有页中单个ecc块最多的翻转位数
+       -EBADMSG: 存在无法纠正的ecc块，其余页照常收集
+       -ETIMEDOUT: BCH解码超时
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t gpmi_chain_collect(__in struct mtd_info *mtd, __in int32_t page,
+                                    __in int32_t count, __inout uint8_t *buf)
+{
+    struct nand_chip *this = mtd->priv;
+    struct gpmi_info *gpmi = this->priv;
+    volatile uint8_t *status;
+    uint8_t *aux = NULL;
+    uint32_t start;
+    int32_t ret = 0;
+    int32_t bitflips;
+    int32_t i;
 
-	(*d)->cmd.pio_words[2] =
-		BM_GPMI_ECCCTRL_ENABLE_ECC               |
-		BF_GPMI_ECCCTRL_ECC_CMD(ecc_command)     |
-		BF_GPMI_ECCCTRL_BUFFER_MASK(buffer_mask) ;
+    for(i = 0; i < count; i++)
+    {
+        aux = gpmi->chain_aux_buf + i * GPMI_CHAIN_AUX_SIZE;
+        status = aux + gpmi->aux_status_ofs + gpmi->ecc_chunk_cnt - 1;
 
-	(*d)->cmd.pio_words[3] = page_size;
-	(*d)->cmd.pio_words[4] = payload;
-	(*d)->cmd.pio_words[5] = auxiliary;
+        start = get_timer_us(0);
+        while((*status == GPMI_BCH_STATUS_PENDING) &&
+              (get_timer_us(start) <= GPMI_BCH_TIMEOUT_US));
 
-	dma_desc_append(dma_channel, (*d));
-	d++;
+        if(*status == GPMI_BCH_STATUS_PENDING)
+        {
+            printl(LOG_LEVEL_ERR, "[GPMI:ERR] read pages bch timeout, page = %d!\n", page + i);
+            clear_bch_irq();
+            return -ETIMEDOUT;
+        }
 
-    /* 禁止BCH/ECC，等待读取完成 */
-	command_mode = BV_GPMI_CTRL0_COMMAND_MODE__WAIT_FOR_READY;
-	address = BV_GPMI_CTRL0_ADDRESS__NAND_DATA;
-
-	(*d)->cmd.cmd.data = 0;
-	(*d)->cmd.cmd.bits.command = NO_DMA_XFER;
-	(*d)->cmd.cmd.bits.chain = 1;
-	(*d)->cmd.cmd.bits.irq_complete = 0;
-	(*d)->cmd.cmd.bits.nand_lock = 0;
-	(*d)->cmd.cmd.bits.nand_wait4ready = 1;
-	(*d)->cmd.cmd.bits.dec_sem = 1;
-	(*d)->cmd.cmd.bits.cmd_wait4end = 1;
-	(*d)->cmd.cmd.bits.halt_on_terminate = 0;
-	(*d)->cmd.cmd.bits.num_pio_words = 3;
-	(*d)->cmd.cmd.bits.num_trans_bytes = 0;
-
-	(*d)->cmd.bufaddr = 0;
-
-	(*d)->cmd.pio_words[0] =
-		BF_GPMI_CTRL0_COMMAND_MODE(command_mode) |
-		BM_GPMI_CTRL0_WORD_LENGTH                |
-		BF_GPMI_CTRL0_CS(chipnum)                   |
-		BF_GPMI_CTRL0_ADDRESS(address)           |
-		BF_GPMI_CTRL0_XFER_COUNT(page_size) ;
-
-	(*d)->cmd.pio_words[1] = 0;
-	(*d)->cmd.pio_words[2] = 0;
-
-	dma_desc_append(dma_channel, (*d));
-	d++;
-
-	/* 不选中nandflash */
-	(*d)->cmd.cmd.data = 0;
-	(*d)->cmd.cmd.bits.command = NO_DMA_XFER;
-	(*d)->cmd.cmd.bits.chain = 0;
-	(*d)->cmd.cmd.bits.irq_complete = 1;
-	(*d)->cmd.cmd.bits.nand_lock = 0;
-	(*d)->cmd.cmd.bits.nand_wait4ready = 0;
-	(*d)->cmd.cmd.bits.dec_sem = 1;
-	(*d)->cmd.cmd.bits.cmd_wait4end = 0;
-	(*d)->cmd.cmd.bits.halt_on_terminate = 0;
-	(*d)->cmd.cmd.bits.num_pio_words = 0;
-	(*d)->cmd.cmd.bits.num_trans_bytes = 0;
-
-	(*d)->cmd.bufaddr = 0;
-
-	dma_desc_append(dma_channel, (*d));
-	d++;
-
-	error = dma_go(dma_channel);
-    if(error)
-        printl(LOG_LEVEL_ERR, "[GPMI:ERR] read page dma error, code = %d!\n", -error);
+        if(gpmi_ecc_check_erased(mtd, buf + i * mtd->writesize, aux,
+                                 GPMI_ECC_METADATA_SIZE))
+            gpmi->erased_read_cnt++;
 
-	error = wait_for_bch_completion(10000);
-    if(error)
-        printl(LOG_LEVEL_ERR, "[GPMI:ERR] read page bch error, code = %d!\n", -error);
+        bitflips = gpmi_ecc_count(mtd, aux);
+        if((bitflips < 0) || ((ret >= 0) && (bitflips > ret)))
+            ret = bitflips;
+    }
 
     clear_bch_irq();
 
-    return error;
-}
-
-
-
-
+    gpmi->chain_read_cnt += count;
+    if(NAND_HAS_CACHEREAD(this))
+        gpmi->cache_read_cnt += count;
 
-/********************************************************************************
----------------------------------------------------------------------------------
----------------------------------------------------------------------------------
-*********************************************************************************/
+    /* oob区保留最后一页的metadata */
+    memset(this->oob_poi, 0xff, mtd->oobsize);
+    memcpy(this->oob_poi, aux, GPMI_ECC_METADATA_SIZE);
 
+    return ret;
+}
 
 
 /********************************************************************************
-* 函数: static void gpmi_cmd_ctrl(__in struct mtd_info *mtd, __in int32_t data,
-                                 __in uint32_t ctrl)
-* 描述: 通过gpmi发送命令
+* 函数: static int32_t gpmi_ecc_read_multi_page(__in struct mtd_info *mtd,
+                                               __in int32_t page,
+                                               __in int32_t count,
+                                               __out uint8_t *buf)
+* 描述: 连续读取多页经过ecc校验的数据，每GPMI_CHAIN_MAX_PAGES页组成一条dma链，
+       链执行完后按顺序收集每页的BCH状态. 页不能跨块
 * 输入: mtd: nandflash设备的父类
-       data: 命令包含的数据
-       ctrl: 命令类型
-* 输出: none
-* 返回: none
+       page: 起始页(芯片内页号)
+       count: 页数
+* 输出: buf: 取出来的数据缓冲区，长度为count页
+* 返回: >=0: 所有页中单个ecc块最多的翻转位数
+       -EBADMSG: 存在无法纠正的ecc块，所有页都已读取
+       -ETIMEDOUT: 读数据超时
 * 作者:
 * 版本: v1.0
 **********************************************************************************/
-static void gpmi_cmd_ctrl(__in struct mtd_info *mtd, __in int32_t data, __in uint32_t ctrl)
+static int32_t gpmi_ecc_read_multi_page(__in struct mtd_info *mtd, __in int32_t page,
+                                          __in int32_t count, __out uint8_t *buf)
 {
-    struct nand_chip *chip = mtd->priv;
-    struct gpmi_info *gpmi = chip->priv;
-    uint32_t error;
-
-    /* 用static变量把所有命令数据和地址数据组织在一起发送 */
-    static uint8_t *cmd_queue = NULL;
-    static uint32_t cmd_q_len;
+    struct nand_chip *this = mtd->priv;
+    struct gpmi_info *gpmi = this->priv;
+    int32_t error = 0;
+    int32_t ret = 0;
+    int32_t num;
+    int32_t i;
 
-    /* 第一次初始化cmd_queue */
-    if(!cmd_queue)
+    /* 缓冲区不对齐，只能一页一页中转读取 */
+    if(!GPMI_DMA_ALIGNED(buf))
     {
-        cmd_queue = dlmemalign(DMA_ALIGNMENT, GPMI_COMMAND_BUFFER_SIZE);
-
-        if(!cmd_queue)
+        for(i = 0; i < count; i++)
         {
-            printl(LOG_LEVEL_ERR, "[GPMI:ERR] failed to alloc command queue buffer\n");
-            return ;
+            this->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page + i);
+            error = gpmi_ecc_read_page(mtd, buf + i * mtd->writesize);
+            if((error < 0) && (error != -EBADMSG))
+                return error;
+
+            if((error < 0) || ((ret >= 0) && (error > ret)))
+                ret = error;
         }
 
-        memset(cmd_queue, 0, GPMI_COMMAND_BUFFER_SIZE);
-        cmd_q_len = 0;
+        return ret;
     }
 
-    /* 组织命令 */
-    if((ctrl & (NAND_ALE | NAND_CLE)))
+    while(count > 0)
     {
-        if(data != NAND_CMD_NONE)
-            cmd_queue[cmd_q_len++] = data;
+        num = min_t(int32_t, count, GPMI_CHAIN_MAX_PAGES);
 
-        return ;
+        error = read_pages(mtd, gpmi->cur_chip, page, num, (uint32_t)buf);
+        if(error)
+        {
+            printl(LOG_LEVEL_ERR, "[GPMI:ERR] read ecc based pages failed, error = %d", error);
+            return error;
+        }
+
+        error = gpmi_chain_collect(mtd, page, num, buf);
+        if((error < 0) && (error != -EBADMSG))
+            return error;
+
+        if((error < 0) || ((ret >= 0) && (error > ret)))
+            ret = error;
+
+        page += num;
+        buf += num * mtd->writesize;
+        count -= num;
     }
 
-    if(!cmd_q_len)
-        return ;
+    return ret;
+}
 
-    error = send_command(gpmi->cur_chip, (uint32_t)cmd_queue, cmd_q_len);
 
+/********************************************************************************
+* 函数: static int32_t gpmi_ecc_read_multi_start(__in struct mtd_info *mtd,
+                                                __in int32_t page,
+                                                __in int32_t count,
+                                                __out uint8_t *buf)
+* 描述: 在当前芯片上开始一条多页读dma链后立即返回，dma链执行期间cpu可以处理
+       其他工作，之后调用gpmi_ecc_read_multi_finish收集结果. 页不能跨块
+* 输入: mtd: nandflash设备的父类
+       page: 起始页(芯片内页号)
+       count: 页数，超过GPMI_CHAIN_MAX_PAGES时只开始前GPMI_CHAIN_MAX_PAGES页
+* 输出: buf: 数据缓冲区，gpmi_ecc_read_multi_finish成功之后有效
+* 返回: >0: 开始读取的页数
+       0: 缓冲区不能直接dma或者有异步编程正在进行，调用者需要使用同步读取
+       <0: 开始失败
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t gpmi_ecc_read_multi_start(__in struct mtd_info *mtd, __in int32_t page,
+                                           __in int32_t count, __out uint8_t *buf)
+{
+    struct nand_chip *this = mtd->priv;
+    struct gpmi_info *gpmi = this->priv;
+    int32_t error;
+    int32_t num;
+
+    if(!GPMI_DMA_ALIGNED(buf) || gpmi->async_count || gpmi->prog_async)
+        return 0;
+
+    num = min_t(int32_t, count, GPMI_CHAIN_MAX_PAGES);
+
+    error = read_pages_start(mtd, gpmi->cur_chip, page, num, (uint32_t)buf);
     if(error)
-        printl(LOG_LEVEL_ERR, "[GPMI:ERR] send command failed, error = %d", error);
+    {
+        printl(LOG_LEVEL_ERR, "[GPMI:ERR] start ecc based pages failed, error = %d", error);
+        return error;
+    }
 
-    cmd_q_len = 0;
+    gpmi->async_chip = gpmi->cur_chip;
+    gpmi->async_page = page;
+    gpmi->async_count = num;
+    gpmi->async_buf = buf;
+    gpmi->async_start = get_timer_us(0);
+
+    return num;
 }
 
+
 /********************************************************************************
-* 函数: static int32_t gpmi_dev_ready(__in struct mtd_info *mtd)
-* 描述: 检测gpmi是否空闲
+* 函数: static int32_t gpmi_ecc_read_multi_finish(__in struct mtd_info *mtd,
+                                                 __in int32_t wait)
+* 描述: 收集gpmi_ecc_read_multi_start开始的dma链的结果
 * 输入: mtd: nandflash设备的父类
+       wait: 0: dma链还在执行时立即返回 1: 等待dma链执行完毕
 * 输出: none
-* 返回: 0: 空闲
-       1: 不空闲
+* 返回: >=0: 成功，所有页中单个ecc块最多的翻转位数，没有正在执行的dma链时返回0
+       -EBADMSG: 存在无法纠正的ecc块，所有页都已读取
+       -EBUSY: dma链还在执行
+       -ETIMEDOUT: 读数据超时
 * 作者:
 * 版本: v1.0
 **********************************************************************************/
-static int32_t gpmi_dev_ready(__in struct mtd_info *mtd)
+static int32_t gpmi_ecc_read_multi_finish(__in struct mtd_info *mtd, __in int32_t wait)
 {
-    struct gpmi_info *gpmi = ((struct nand_chip *)(mtd->priv))->priv;
-    return (is_ready(gpmi->cur_chip) ? 1 : 0);
+    struct nand_chip *this = mtd->priv;
+    struct gpmi_info *gpmi = this->priv;
+    uint32_t timeout, elapsed;
+    int32_t error;
+
+    if(!gpmi->async_count)
+        return 0;
+
+    timeout = GPMI_CHAIN_TIMEOUT_US(gpmi->async_count);
+    elapsed = get_timer_us(gpmi->async_start);
+
+    if(!wait && (elapsed <= timeout) &&
+       !dma_is_finished(DMA_CHANNEL_AHB_APBH_GPMI0 + gpmi->async_chip))
+        return -EBUSY;
+
+    error = read_pages_finish(gpmi->async_chip, (elapsed < timeout) ? (timeout - elapsed) : 0);
+    if(!error)
+        error = gpmi_chain_collect(mtd, gpmi->async_page, gpmi->async_count, gpmi->async_buf);
+
+    if((error >= 0) || (error == -EBADMSG))
+        gpmi->async_read_cnt += gpmi->async_count;
+
+    gpmi->async_count = 0;
+
+    return error;
 }
 
+
 /********************************************************************************
-* 函数: static void gpmi_select_chip(__in struct mtd_info *mtd,
-                                    __in int32_t chipnum)
-* 描述: 选择nandflash芯片
+* 函数: static int32_t gpmi_ecc_read_interleave(__in struct mtd_info *mtd,
+                                               __in int32_t count,
+                                               __in const int32_t *chips,
+                                               __in const int32_t *pages,
+                                               __out uint8_t **bufs)
+* 描述: 从count个不同芯片各读一页经过ecc校验的数据. 先给所有芯片发送读命令，
+       各芯片同时开始装载页寄存器(tR)，再按顺序在各自的dma通道上等待就绪并
+       通过BCH读取数据，后面芯片的tR和前面芯片的数据传输重叠
 * 输入: mtd: nandflash设备的父类
-       chipnum: 芯片号
-* 输出: none
-* 返回: none
+       count: 芯片数量，不超过GPMI_CHAIN_MAX_PAGES
+       chips: 每页所在的芯片号，不能重复
+       pages: 每页的芯片内页号
+* 输出: bufs: 每页的数据缓冲区
+* 返回: >=0: 所有页中单个ecc块最多的翻转位数
+       -EBADMSG: 存在无法纠正的ecc块，所有页都已读取
+       -EINVAL: 参数无效
+       -ETIMEDOUT: 读数据超时
 * 作者:
 * 版本: v1.0
 **********************************************************************************/
-static void gpmi_select_chip(__in struct mtd_info *mtd, __in int32_t chipnum)
+static int32_t gpmi_ecc_read_interleave(__in struct mtd_info *mtd, __in int32_t count,
+                                          __in const int32_t *chips, __in const int32_t *pages,
+                                          __out uint8_t **bufs)
 {
-    struct gpmi_info *gpmi = ((struct nand_chip *)(mtd->priv))->priv;
+    struct nand_chip *this = mtd->priv;
+    struct gpmi_info *gpmi = this->priv;
+    uint8_t *cmd_buf;
+    uint8_t *payload;
+    uint32_t cmd_len;
+    int32_t error;
+    int32_t ret = 0;
+    int32_t i;
+
+    if((count <= 0) || (count > GPMI_CHAIN_MAX_PAGES))
+        return -EINVAL;
+
+    /* 所有芯片同时开始装载页寄存器 */
+    for(i = 0; i < count; i++)
+    {
+        cmd_buf = gpmi->chain_cmd_buf + i * GPMI_CHAIN_CMD_SIZE;
+        cmd_len = 0;
+        cmd_buf[cmd_len++] = NAND_CMD_READ0;
+        cmd_buf[cmd_len++] = 0;
+        cmd_buf[cmd_len++] = 0;
+        cmd_buf[cmd_len++] = pages[i] & 0xff;
+        cmd_buf[cmd_len++] = (pages[i] >> 8) & 0xff;
+        /* 大于128MiB的设备多一个页地址字节 */
+        if(this->chipsize > (128 << 20))
+            cmd_buf[cmd_len++] = (pages[i] >> 16) & 0xff;
+
+        error = send_command(chips[i], (uint32_t)cmd_buf, cmd_len);
+        if(!error)
+            error = send_command(chips[i], (uint32_t)GPMI_CMD_SLOT(gpmi, GPMI_SLOT_READSTART), 1);
+        if(error)
+            return error;
+    }
+
+    /* 按顺序等待就绪并读取数据 */
+    for(i = 0; i < count; i++)
+    {
+        if(GPMI_DMA_ALIGNED(bufs[i]))
+        {
+            payload = bufs[i];
+            gpmi->direct_read_cnt++;
+        }
+        else
+        {
+            payload = gpmi->data_buf;
+            gpmi->bounce_read_cnt++;
+        }
+
+        error = read_page(mtd, chips[i], (uint32_t)payload, (uint32_t)(gpmi->oob_buf));
+        if(error)
+        {
+            printl(LOG_LEVEL_ERR, "[GPMI:ERR] interleave read chip %d page %d failed, error = %d",
+                   chips[i], pages[i], error);
+            return error;
+        }
+
+        if(gpmi_ecc_check_erased(mtd, payload, gpmi->oob_buf, GPMI_ECC_METADATA_SIZE))
+        {
+            gpmi->erased_read_cnt++;
+            if(payload != bufs[i])
+                memset(bufs[i], 0xff, mtd->writesize);
+        }
+        else if(payload != bufs[i])
+            memcpy(bufs[i], payload, mtd->writesize);
 
-//    set_hw_timing(mtd);
+        error = gpmi_ecc_count(mtd, gpmi->oob_buf);
+        if((error < 0) || ((ret >= 0) && (error > ret)))
+            ret = error;
+    }
 
-    gpmi->cur_chip = chipnum;
+    gpmi->interleave_read_cnt += count;
+
+    /* oob区保留最后一页的metadata */
+    memset(this->oob_poi, 0xff, mtd->oobsize);
+    memcpy(this->oob_poi, gpmi->oob_buf, GPMI_ECC_METADATA_SIZE);
+
+    return ret;
 }
 
 
 /********************************************************************************
-* 函数: static void gpmi_read_buf(__in struct mtd_info *mtd,
-                                 __out uint8_t *buf, __in int32_t len)
-* 描述: 读取nandflash原始数据，地址可以是一页内的任何地址
-* 输入: mtd: nandflash的mtd父类
-       len: 数据长度
-* 输出: buf: 数据输出缓冲区
-* 返回: none
+* 函数: static int32_t gpmi_ecc_write_page(__in struct mtd_info *mtd,
+                                          __out uint8_t *buf)
+* 描述: 写nandflash一页经过ecc校验的数据，地址必须时页起始地址
+* 输入: mtd: nandflash设备的父类
+       buf: 需要写的数据缓冲区
+* 输出: none
+* 返回: 0: 成功
+       -ETIMEDOUT: 读数据超时
 * 作者:
 * 版本: v1.0
 **********************************************************************************/
-static void gpmi_read_buf(__in struct mtd_info *mtd, __out uint8_t *buf, __in int32_t len)
+static int32_t gpmi_ecc_write_page(__in struct mtd_info *mtd, __in const uint8_t *buf)
 {
-    struct nand_chip *chip = mtd->priv;
-    struct gpmi_info *gpmi = chip->priv;
+    uint32_t error = 0;
+    struct nand_chip *this = mtd->priv;
+    struct gpmi_info *gpmi = this->priv;
 
-    if(len > NAND_MAX_PAGESIZE)
-        printl(LOG_LEVEL_WARN, "[GPMI:WARN] len too long\n");
 
-    if(!buf)
-        printl(LOG_LEVEL_WARN, "[GPMI:WARN] buffer point is NULL\n");
+    uint8_t *data_buf = gpmi->data_buf;
+    uint8_t *oob_buf = gpmi->oob_buf;
+
+    memcpy(data_buf, buf, mtd->writesize);
+    memcpy(oob_buf, this->oob_poi, mtd->oobsize);
 
+    error = send_page(mtd, gpmi->cur_chip, (uint32_t)gpmi->data_buf, (uint32_t)gpmi->oob_buf);
 
-    read_data(gpmi->cur_chip, (uint32_t)buf, len);
+    if(error)
+        printl(LOG_LEVEL_ERR, "[GPMI:ERR] write ecc based page failed, error = %d", error);
+
+    return error;
 }
 
 
 /********************************************************************************
-* 函数: static void gpmi_write_buf(__in struct mtd_info *mtd, __in uint8_t *buf,
-                                  __in int32_t len)
-* 描述: 写nandflash原始数据，地址可以时一页内的任何地址
-* 输入: mtd: nandflash设备的mtd设备父类
-       buf: 需要写入的数据缓冲区
-       len: 需要写入的数据长度
+* 函数: static int32_t gpmi_ecc_write_multi_page(__in struct mtd_info *mtd,
+                                                __in int32_t page,
+                                                __in int32_t count,
+                                                __in const uint8_t *buf,
+                                                __in int32_t raw)
+* 描述: 连续写入一块内的多页. 两块编程缓冲区交替使用，一页在传输和编程时cpu填充
+       另一块缓冲区; 芯片支持缓存编程时除最后一页外都使用0x15，下一页的数据传输
+       和上一页的编程同时进行. 所有页在同一芯片的同一块内，最后一页总是以0x10
+       结束并检查状态. oob区使用oob_poi
+* 输入: mtd: nandflash设备的父类
+       page: 起始页(芯片内页号)
+       count: 页数
+       buf: 需要写入的数据，长度为count页
+       raw: 是否原始写入，不经过BCH
 * 输出: none
-* 返回: 0
+* 返回: 0: 成功
+       -ETIMEDOUT: 写数据超时
+       -EIO: 编程失败
 * 作者:
 * 版本: v1.0
 **********************************************************************************/
-static void gpmi_write_buf(__in struct mtd_info *mtd, __in const uint8_t *buf, __in int32_t len)
+static int32_t gpmi_ecc_write_multi_page(__in struct mtd_info *mtd, __in int32_t page,
+                                           __in int32_t count, __in const uint8_t *buf,
+                                           __in int32_t raw)
 {
-    struct gpmi_info *gpmi = ((struct nand_chip *)(mtd->priv))->priv;
+    struct nand_chip *this = mtd->priv;
+    struct gpmi_info *gpmi = this->priv;
+    int32_t cache = NAND_HAS_CACHEPROG(this) ? 1 : 0;
+    int32_t chipnum = gpmi->cur_chip;
+    int32_t status;
+    int32_t error;
+    int32_t i;
 
-    if(len > NAND_MAX_PAGESIZE)
-        printl(LOG_LEVEL_WARN, "[GPMI:WARN] len too long\n");
+    for(i = 0; i < count; i++)
+    {
+        /* 上一页还在传输或者编程，填充另一块缓冲区 */
+        memcpy(gpmi->prog_data_buf[i & 0x01], buf + i * mtd->writesize, mtd->writesize);
+        memcpy(gpmi->prog_oob_buf[i & 0x01], this->oob_poi, mtd->oobsize);
 
-    if(!buf)
-        printl(LOG_LEVEL_WARN, "[GPMI:WARN] buffer point is NULL\n");
+        if(i)
+        {
+            error = prog_page_finish(chipnum, raw);
+            if(error)
+                return error;
+
+            /* 缓存编程时就绪表示第i-1页已经进入数据寄存器开始编程，FAIL_N1是再前
+               一页(第i-2页)的编程结果; 不使用缓存编程时FAIL是第i-1页的结果 */
+            status = this->waitfunc(mtd);
+            if(cache)
+            {
+                if((i >= 2) && (status & NAND_STATUS_FAIL_N1))
+                {
+                    printl(LOG_LEVEL_ERR, "[GPMI:ERR] program page %d failed.\n", page + i - 2);
+                    return -EIO;
+                }
+            }
+            else if(status & NAND_STATUS_FAIL)
+            {
+                printl(LOG_LEVEL_ERR, "[GPMI:ERR] program page %d failed.\n", page + i - 1);
+                return -EIO;
+            }
+        }
 
-    send_data(gpmi->cur_chip, (uint32_t)buf, len);
-}
+        prog_page_start(mtd, chipnum, page + i, i & 0x01,
+                        (cache && (i != count - 1)) ? GPMI_SLOT_CACHEDPROG : GPMI_SLOT_PAGEPROG, raw);
+    }
 
+    error = prog_page_finish(chipnum, raw);
+    if(error)
+        return error;
 
-/********************************************************************************
-* 函数: static uint8_t gpmi_read_byte(__in struct mtd_info *mtd)
-* 描述: 读取nandflash一页数据中的一个字节，地址可以是一页内的任何地址
-* 输入: mtd: nandflash设备的mtd设备父类
-* 输出: none
-* 返回: 读取到的字节
-* 作者:
-* 版本: v1.0
-**********************************************************************************/
-static uint8_t gpmi_read_byte(__in struct mtd_info *mtd)
-{
-    uint8_t byte;
+    /* 最后一页使用0x10，等待所有页编程完成. FAIL是最后一页的结果，缓存编程时
+       FAIL_N1是倒数第二页的结果 */
+    status = this->waitfunc(mtd);
+    if(cache && (count >= 2) && (status & NAND_STATUS_FAIL_N1))
+    {
+        printl(LOG_LEVEL_ERR, "[GPMI:ERR] program page %d failed.\n", page + count - 2);
+        return -EIO;
+    }
+    if(status & NAND_STATUS_FAIL)
+    {
+        printl(LOG_LEVEL_ERR, "[GPMI:ERR] program page %d failed.\n", page + count - 1);
+        return -EIO;
+    }
 
-    gpmi_read_buf(mtd, (uint8_t *)&byte, 1);
+    if(cache)
+        gpmi->cache_prog_cnt += count;
 
-    return byte;
+    return 0;
 }
 
+
 /********************************************************************************
-* 函数: static int32_t gpmi_ecc_read_page(__in struct mtd_info *mtd,
-                                         __out uint8_t *buf)
-* 描述: 读nandflash一页经过ecc校验的数据，地址必须时页起始地址
+* 函数: static int32_t gpmi_ecc_write_multi_plane(__in struct mtd_info *mtd,
+                                                 __in int32_t page,
+                                                 __in int32_t count,
+                                                 __in const uint8_t *buf0,
+                                                 __in const uint8_t *buf1,
+                                                 __in int32_t raw)
+* 描述: 两个plane上成对的块从page开始各写count页. plane0的页使用编程缓冲区0，
+       以0x11结束，plane1的页使用编程缓冲区1，以0x10或者0x15结束，两页一起编程.
+       一页传输时cpu填充另一块缓冲区. oob区使用oob_poi
 * 输入: mtd: nandflash设备的父类
-* 输出: buf: 取出来的数据缓冲区
+       page: plane0上的起始页(芯片内页号)，plane1上为下一块的对应页
+       count: 每个plane写入的页数
+       buf0: plane0的数据
+       buf1: plane1的数据
+       raw: 是否原始写入，不经过BCH
+* 输出: none
 * 返回: 0: 成功
-       -ETIMEDOUT: 读数据超时
+       -ETIMEDOUT: 写数据超时
+       -EIO: 编程失败
 * 作者:
 * 版本: v1.0
 **********************************************************************************/
-static int32_t gpmi_ecc_read_page(__in struct mtd_info *mtd, __out uint8_t *buf)
+static int32_t gpmi_ecc_write_multi_plane(__in struct mtd_info *mtd, __in int32_t page,
+                                            __in int32_t count, __in const uint8_t *buf0,
+                                            __in const uint8_t *buf1, __in int32_t raw)
 {
     struct nand_chip *this = mtd->priv;
     struct gpmi_info *gpmi = this->priv;
-    uint32_t error;
-    uint32_t failed = 0;
-    uint32_t corrected = 0;
-    uint8_t *status;
-    int32_t i = 0;
+    int32_t cache = NAND_HAS_CACHEPROG(this) ? 1 : 0;
+    int32_t pages_per_block = 1 << (this->phys_erase_shift - this->page_shift);
+    int32_t chipnum = gpmi->cur_chip;
+    int32_t status, planes;
+    int32_t error;
+    int32_t i;
 
-    error = read_page(mtd, gpmi->cur_chip, (uint32_t)(gpmi->data_buf), (uint32_t)(gpmi->oob_buf));
+    memcpy(gpmi->prog_data_buf[0], buf0, mtd->writesize);
+    memcpy(gpmi->prog_oob_buf[0], this->oob_poi, mtd->oobsize);
 
-    if(error)
+    for(i = 0; i < count; i++)
     {
-        printl(LOG_LEVEL_ERR, "[GPMI:ERR] read ecc based page failed, error = %d", error);
-        return error;
-    }
+        /* plane0的页 */
+        prog_page_start(mtd, chipnum, page + i, 0, GPMI_SLOT_MULTIPROG, raw);
 
-    status = gpmi->oob_buf + gpmi->aux_status_ofs;
+        /* 上一对页的plane1已经传输完成，填充plane1的缓冲区 */
+        memcpy(gpmi->prog_data_buf[1], buf1 + i * mtd->writesize, mtd->writesize);
+        memcpy(gpmi->prog_oob_buf[1], this->oob_poi, mtd->oobsize);
 
-    for(i = 0; i < gpmi->ecc_chunk_cnt; i++)
-    {
-        if((*status == 0x00) || (*status == 0xff))
-            continue;
+        error = prog_page_finish(chipnum, raw);
+        if(error)
+            return error;
 
-        if(*status == 0xfe)
+        /* 0x11之后芯片忙tDBSY，缓存编程时FAIL_N1是上一对页的编程结果 */
+        status = this->waitfunc(mtd);
+        if(cache && i && (status & NAND_STATUS_FAIL_N1))
         {
-            failed++;
-            continue;
+            printl(LOG_LEVEL_ERR, "[GPMI:ERR] program page %d failed.\n", page + i - 1);
+            return -EIO;
+        }
+
+        /* plane1的页，两页一起编程 */
+        prog_page_start(mtd, chipnum, page + pages_per_block + i, 1,
+                        (cache && (i != count - 1)) ? GPMI_SLOT_CACHEDPROG : GPMI_SLOT_PAGEPROG, raw);
+
+        /* 传输期间填充下一对页plane0的缓冲区 */
+        if(i != count - 1)
+        {
+            memcpy(gpmi->prog_data_buf[0], buf0 + (i + 1) * mtd->writesize, mtd->writesize);
+            memcpy(gpmi->prog_oob_buf[0], this->oob_poi, mtd->oobsize);
+        }
+
+        error = prog_page_finish(chipnum, raw);
+        if(error)
+            return error;
+
+        /* 缓存编程时就绪表示可以接收下一对页，FAIL_N1是上一对页的编程结果 */
+        status = this->waitfunc(mtd);
+        if(cache && i && (status & NAND_STATUS_FAIL_N1))
+        {
+            printl(LOG_LEVEL_ERR, "[GPMI:ERR] program page %d failed.\n", page + i - 1);
+            return -EIO;
         }
 
-        corrected += *status;
+        /* 最后一对页以0x10结束，FAIL是这一对页的结果，使用0x71区分失败的plane */
+        if((i == count - 1) && (status & NAND_STATUS_FAIL))
+        {
+            planes = nand_plane_status(mtd);
+            if(planes & NAND_STATUS_FAIL_PLANE0)
+                printl(LOG_LEVEL_ERR, "[GPMI:ERR] program page %d failed.\n", page + i);
+            if(planes & NAND_STATUS_FAIL_PLANE1)
+                printl(LOG_LEVEL_ERR, "[GPMI:ERR] program page %d failed.\n",
+                       page + pages_per_block + i);
+            return -EIO;
+        }
     }
 
-    /* 设置mtd层参数 */
-    mtd->ecc_stats.failed += failed;
-    mtd->ecc_stats.corrected += corrected;
+    gpmi->multi_plane_prog_cnt += count << 1;
 
-    memset(this->oob_poi, 0xff, mtd->oobsize);
-    this->oob_poi[0] = gpmi->oob_buf[0];
+    return 0;
+}
 
-    memcpy(buf, gpmi->data_buf, mtd->writesize);
 
-    return error;
+/********************************************************************************
+* 函数: static int32_t gpmi_ecc_write_page_start(__in struct mtd_info *mtd,
+                                                __in int32_t page,
+                                                __in const uint8_t *buf,
+                                                __in int32_t raw)
+* 描述: 在当前芯片上开始编程一页后立即返回，数据拷贝到编程缓冲区1，oob区使用
+       oob_poi. 数据传输和芯片编程期间cpu可以处理其他工作，之后调用
+       gpmi_ecc_write_page_finish收集结果
+* 输入: mtd: nandflash设备的父类
+       page: 页(芯片内页号)
+       buf: 需要写的数据，返回之后可以修改
+       raw: 是否原始写入，不经过BCH
+* 输出: none
+* 返回: 1: 已经开始
+       0: 有异步操作正在进行，调用者需要使用同步写入
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t gpmi_ecc_write_page_start(__in struct mtd_info *mtd, __in int32_t page,
+                                           __in const uint8_t *buf, __in int32_t raw)
+{
+    struct nand_chip *this = mtd->priv;
+    struct gpmi_info *gpmi = this->priv;
+
+    if(gpmi->prog_async || gpmi->async_count)
+        return 0;
+
+    memcpy(gpmi->prog_data_buf[1], buf, mtd->writesize);
+    memcpy(gpmi->prog_oob_buf[1], this->oob_poi, mtd->oobsize);
+
+    prog_page_start(mtd, gpmi->cur_chip, page, 1, GPMI_SLOT_PAGEPROG, raw);
+
+    gpmi->prog_async = 1;
+    gpmi->prog_async_chip = gpmi->cur_chip;
+    gpmi->prog_async_page = page;
+    gpmi->prog_async_raw = raw;
+    gpmi->prog_async_start = get_timer_us(0);
+
+    return 1;
 }
 
 
 /********************************************************************************
-* 函数: static int32_t gpmi_ecc_write_page(__in struct mtd_info *mtd,
-                                          __out uint8_t *buf)
-* 描述: 写nandflash一页经过ecc校验的数据，地址必须时页起始地址
+* 函数: static int32_t gpmi_ecc_write_page_finish(__in struct mtd_info *mtd,
+                                                 __in int32_t wait)
+* 描述: 收集gpmi_ecc_write_page_start开始的编程结果. 先等待dma传输结束，再等待
+       芯片编程完成并检查状态
 * 输入: mtd: nandflash设备的父类
-       buf: 需要写的数据缓冲区
+       wait: 0: 传输或者编程还在进行时立即返回 1: 等待完成
 * 输出: none
-* 返回: 0: 成功
-       -ETIMEDOUT: 读数据超时
+* 返回: 0: 成功，没有正在进行的编程时也返回0
+       -EBUSY: 传输或者编程还在进行
+       -ETIMEDOUT: 写数据超时
+       -EIO: 编程失败
 * 作者:
 * 版本: v1.0
 **********************************************************************************/
-static int32_t gpmi_ecc_write_page(__in struct mtd_info *mtd, __in const uint8_t *buf)
+static int32_t gpmi_ecc_write_page_finish(__in struct mtd_info *mtd, __in int32_t wait)
 {
-    uint32_t error = 0;
     struct nand_chip *this = mtd->priv;
     struct gpmi_info *gpmi = this->priv;
+    int32_t status;
+    int32_t error;
 
+    if(!gpmi->prog_async)
+        return 0;
 
-    uint8_t *data_buf = gpmi->data_buf;
-    uint8_t *oob_buf = gpmi->oob_buf;
+    if(gpmi->prog_async == 1)
+    {
+        if(!wait && (get_timer_us(gpmi->prog_async_start) <= GPMI_CHAIN_TIMEOUT_US(1)) &&
+           !dma_is_finished(DMA_CHANNEL_AHB_APBH_GPMI0 + gpmi->prog_async_chip))
+            return -EBUSY;
 
-    memcpy(data_buf, buf, mtd->writesize);
-    memcpy(oob_buf, this->oob_poi, mtd->oobsize);
+        error = prog_page_finish(gpmi->prog_async_chip, gpmi->prog_async_raw);
+        if(error)
+        {
+            gpmi->prog_async = 0;
+            return error;
+        }
 
-    error = send_page(mtd, gpmi->cur_chip, (uint32_t)gpmi->data_buf, (uint32_t)gpmi->oob_buf);
+        gpmi->prog_async = 2;
+    }
 
-    if(error)
-        printl(LOG_LEVEL_ERR, "[GPMI:ERR] write ecc based page failed, error = %d", error);
+    /* 超过编程等待时间之后交给waitfunc，由它报告超时 */
+    if(!wait && !is_ready(gpmi->prog_async_chip) &&
+       (get_timer_us(gpmi->prog_async_start) <= GPMI_PROG_TIMEOUT_US))
+        return -EBUSY;
 
-    return error;
+    gpmi->prog_async = 0;
+
+    /* 两次轮询之间可能选中过其他芯片 */
+    this->select_chip(mtd, gpmi->prog_async_chip);
+    status = this->waitfunc(mtd);
+    if(status & NAND_STATUS_FAIL)
+    {
+        printl(LOG_LEVEL_ERR, "[GPMI:ERR] program page %d failed.\n", gpmi->prog_async_page);
+        return -EIO;
+    }
+
+    gpmi->async_prog_cnt++;
+
+    return 0;
 }
 
 
@@ -1245,22 +3138,164 @@ static int32_t gpmi_alloc_buf(__in struct gpmi_info *gpmi)
 {
     uint8_t *pBuf = NULL;
 
-    pBuf = (uint8_t *)dlmemalign(DMA_ALIGNMENT, NAND_MAX_PAGESIZE + NAND_MAX_OOBSIZE);
+    /* data_buf/oob_buf之后再分配一组，多页写时两组交替使用 */
+    pBuf = (uint8_t *)dlmemalign(DMA_ALIGNMENT, 2 * GPMI_PAGE_BUF_SIZE);
 
     if(!pBuf)
     {
         printl(LOG_LEVEL_ERR, "[GPMI:ERR] failed to allocate buffer\n");
         return -ENOMEM;
     }
-    memset(pBuf, 0, NAND_MAX_PAGESIZE + NAND_MAX_OOBSIZE);
+    memset(pBuf, 0, 2 * GPMI_PAGE_BUF_SIZE);
 
     gpmi->data_buf = pBuf;
     gpmi->oob_buf = pBuf + NAND_MAX_PAGESIZE;
+    gpmi->prog_data_buf[0] = gpmi->data_buf;
+    gpmi->prog_oob_buf[0] = gpmi->oob_buf;
+    gpmi->prog_data_buf[1] = pBuf + GPMI_PAGE_BUF_SIZE;
+    gpmi->prog_oob_buf[1] = pBuf + GPMI_PAGE_BUF_SIZE + NAND_MAX_PAGESIZE;
+
+    /* 多页读的命令缓冲区和auxiliary缓冲区，最后几个命令槽存放单字节命令 */
+    pBuf = (uint8_t *)dlmemalign(DMA_ALIGNMENT, GPMI_CHAIN_CMD_SLOTS * GPMI_CHAIN_CMD_SIZE +
+                                                GPMI_CHAIN_MAX_PAGES * GPMI_CHAIN_AUX_SIZE);
+
+    if(!pBuf)
+    {
+        dlfree((int8_t *)gpmi->data_buf);
+        printl(LOG_LEVEL_ERR, "[GPMI:ERR] failed to allocate chain buffer\n");
+        return -ENOMEM;
+    }
+    memset(pBuf, 0, GPMI_CHAIN_CMD_SLOTS * GPMI_CHAIN_CMD_SIZE);
+
+    gpmi->chain_cmd_buf = pBuf;
+    *GPMI_CMD_SLOT(gpmi, GPMI_SLOT_READSTART) = NAND_CMD_READSTART;
+    *GPMI_CMD_SLOT(gpmi, GPMI_SLOT_CACHEREAD) = NAND_CMD_CACHEREADSTART;
+    *GPMI_CMD_SLOT(gpmi, GPMI_SLOT_CACHEREADEND) = NAND_CMD_CACHEREADEND;
+    *GPMI_CMD_SLOT(gpmi, GPMI_SLOT_PAGEPROG) = NAND_CMD_PAGEPROG;
+    *GPMI_CMD_SLOT(gpmi, GPMI_SLOT_CACHEDPROG) = NAND_CMD_CACHEDPROG;
+    *GPMI_CMD_SLOT(gpmi, GPMI_SLOT_MULTIPROG) = NAND_CMD_MULTI_PROG;
+    gpmi->chain_aux_buf = pBuf + GPMI_CHAIN_CMD_SLOTS * GPMI_CHAIN_CMD_SIZE;
 
     return 0;
 }
 
 
+/*
+* 基于flash的bbt描述符. 使用BCH时oob只有metadata受ecc保护，第0字节是坏块标记，
+* 标记和版本号放在metadata的第1~5字节
+*/
+static uint8_t gpmi_bbt_pattern[] = {'B', 'b', 't', '0'};
+static uint8_t gpmi_mirror_pattern[] = {'1', 't', 'b', 'B'};
+
+static struct nand_bbt_desc gpmi_bbt_main_desc =
+{
+    .options = NAND_BBT_LASTBLOCK | NAND_BBT_CREATE | NAND_BBT_WRITE
+        | NAND_BBT_2BIT | NAND_BBT_VERSION | NAND_BBT_PERCHIP,
+    .offs = 1,
+    .len = 4,
+    .veroffs = 5,
+    .maxblocks = 4,
+    .pattern = gpmi_bbt_pattern
+};
+
+static struct nand_bbt_desc gpmi_bbt_mirror_desc =
+{
+    .options = NAND_BBT_LASTBLOCK | NAND_BBT_CREATE | NAND_BBT_WRITE
+        | NAND_BBT_2BIT | NAND_BBT_VERSION | NAND_BBT_PERCHIP,
+    .offs = 1,
+    .len = 4,
+    .veroffs = 5,
+    .maxblocks = 4,
+    .pattern = gpmi_mirror_pattern
+};
+
+
+#ifdef CONFIG_SYS_NAND_BENCH
+/********************************************************************************
+* 函数: static uint32_t gpmi_bench_timing_pass(__in struct mtd_info *mtd,
+                                             __in size_t len, __in uint8_t *buf)
+* 描述: 使用当前时序反复读取芯片0的第0块，一共读取len字节，计算读取速度
+* 输入: mtd: nandflash设备的父类
+       len: 读取的总字节数，块大小的整数倍
+       buf: 读取缓冲区，长度为一块
+* 输出: none
+* 返回: 读取速度，单位KiB/s，读取失败返回0
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static uint32_t gpmi_bench_timing_pass(__in struct mtd_info *mtd, __in size_t len,
+                                         __in uint8_t *buf)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t pages = 1 << (this->phys_erase_shift - this->page_shift);
+    uint32_t start, us;
+    size_t done;
+    int32_t ret;
+
+    this->select_chip(mtd, 0);
+
+    start = get_timer_us(0);
+    for(done = 0; done < len; done += mtd->erasesize)
+    {
+        ret = gpmi_ecc_read_multi_page(mtd, 0, pages, buf);
+        if((ret < 0) && (ret != -EBADMSG))
+        {
+            printl(LOG_LEVEL_ERR, "[GPMI:ERR] timing bench read failed, error = %d\n", ret);
+            return 0;
+        }
+    }
+    us = get_timer_us(start);
+    if(!us)
+        us = 1;
+
+    this->select_chip(mtd, -1);
+
+    return (uint32_t)(((uint64_t)(len >> 10) * 1000000) / us);
+}
+
+/********************************************************************************
+* 函数: static void gpmi_bench_timing(__in struct mtd_info *mtd, __in size_t len)
+* 描述: 比较安全时序和芯片时序(EDO和dll采样)下的读取速度，测试结束后恢复芯片时序.
+       测试期间的ecc统计不计入设备
+* 输入: mtd: nandflash设备的父类
+       len: 每种时序读取的字节数
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void gpmi_bench_timing(__in struct mtd_info *mtd, __in size_t len)
+{
+    struct nand_chip *this = mtd->priv;
+    struct mtd_ecc_stats stats = mtd->ecc_stats;
+    uint32_t safe, fast;
+    uint8_t *buf;
+
+    len -= len % mtd->erasesize;
+    if(!len)
+        return;
+
+    buf = dlmalloc(mtd->erasesize);
+    if(!buf)
+    {
+        printl(LOG_LEVEL_ERR, "[GPMI:ERR] timing bench failed to allocate %d bytes\n", mtd->erasesize);
+        return;
+    }
+
+    set_hw_timing(this, &(nand_device_get_safenand_info()->timing));
+    safe = gpmi_bench_timing_pass(mtd, len, buf);
+
+    set_hw_timing(this, this->timing);
+    fast = gpmi_bench_timing_pass(mtd, len, buf);
+
+    printl(LOG_LEVEL_INFO, "gpmi read %u KiB: safe timing %u KiB/s, chip timing %u KiB/s\n",
+           len >> 10, safe, fast);
+
+    mtd->ecc_stats = stats;
+    dlfree((int8_t *)buf);
+}
+#endif
+
 /********************************************************************************
 * 函数: static int32_t gpmi_scan_bbt(mtd_info *mtd)
 * 描述: gpmi层扫描bbt，在调用上层之前处理一些具体数据
@@ -1293,10 +3328,65 @@ static int32_t gpmi_scan_bbt(struct mtd_info *mtd)
 	if (error)
 		return error;
 
+#ifdef CONFIG_SYS_NAND_BENCH
+    gpmi_bench_timing(mtd, CONFIG_SYS_NAND_BENCH);
+#endif
+
+    /* 默认使用flash中的bbt，启动时只需读取bbt所在页 */
+    if(!this->bbt_td)
+    {
+        this->bbt_td = &gpmi_bbt_main_desc;
+        this->bbt_md = &gpmi_bbt_mirror_desc;
+    }
+    this->options |= NAND_USE_FLASH_BBT;
+
     return nand_default_bbt(mtd);
 }
 
 
+#ifdef CONFIG_SYS_NAND_BENCH
+/* 描述器构建测试的次数 */
+#define GPMI_BENCH_DESC_LOOPS     10000
+
+/********************************************************************************
+* 函数: static void gpmi_bench_desc(void)
+* 描述: 测试准备读一页描述器的开销. 每次从头写出全部字段(模板之前的做法)和
+       只修改模板中片选，传输长度和缓冲区地址两种方式，分别给出每页的时间.
+       只修改内存中的描述器，不启动dma，结束后恢复模板
+* 输入: none
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void gpmi_bench_desc(void)
+{
+    struct dma_desc **d = gpmi_dma_desc + GPMI_DESC_READ_PAGE;
+    uint32_t start, build, patch;
+    int32_t i;
+
+    start = get_timer_us(0);
+    for(i = 0; i < GPMI_BENCH_DESC_LOOPS; i++)
+    {
+        gpmi_build_read_page_template(d);
+        gpmi_build_deselect_template(d[3]);
+        patch_read_page(d, i & 0x07, 2112, 0x40000000, 0x40001000);
+    }
+    build = get_timer_us(start);
+
+    start = get_timer_us(0);
+    for(i = 0; i < GPMI_BENCH_DESC_LOOPS; i++)
+        patch_read_page(d, i & 0x07, 2112, 0x40000000, 0x40001000);
+    patch = get_timer_us(start);
+
+    gpmi_build_read_page_template(d);
+    gpmi_build_deselect_template(d[3]);
+
+    printl(LOG_LEVEL_INFO, "gpmi read page descriptors: build %u ns, patch %u ns per page\n",
+           (build * 1000) / GPMI_BENCH_DESC_LOOPS, (patch * 1000) / GPMI_BENCH_DESC_LOOPS);
+}
+#endif
+
 /********************************************************************************
 * 函数: int32_t board_nand_init(__in struct nand_chip *chip)
 * 描述: 初始化板载的nandflash芯片
@@ -1329,7 +3419,16 @@ int32_t board_nand_init(__in struct nand_chip *chip)
     }
 
     /* 初始化gpmi */
-    gpmi_init();
+    error = gpmi_init();
+    if(error)
+        return error;
+
+    /* 建立dma描述器模板 */
+    gpmi_build_dma_templates();
+
+#ifdef CONFIG_SYS_NAND_BENCH
+    gpmi_bench_desc();
+#endif
 
     chip->priv = gpmi;
 
@@ -1340,12 +3439,25 @@ int32_t board_nand_init(__in struct nand_chip *chip)
     chip->read_byte = gpmi_read_byte;
     chip->read_buf = gpmi_read_buf;
     chip->write_buf = gpmi_write_buf;
+    chip->read_bbm = gpmi_read_bbm;
 
     chip->ecc_ctrl.read_page = gpmi_ecc_read_page;
+    chip->ecc_ctrl.read_subpage = gpmi_ecc_read_subpage;
+    chip->ecc_ctrl.read_multi_page = gpmi_ecc_read_multi_page;
+    chip->ecc_ctrl.read_multi_start = gpmi_ecc_read_multi_start;
+    chip->ecc_ctrl.read_multi_finish = gpmi_ecc_read_multi_finish;
     chip->ecc_ctrl.write_page = gpmi_ecc_write_page;
+    chip->ecc_ctrl.write_multi_page = gpmi_ecc_write_multi_page;
+    chip->ecc_ctrl.write_multi_plane = gpmi_ecc_write_multi_plane;
+    chip->ecc_ctrl.write_page_start = gpmi_ecc_write_page_start;
+    chip->ecc_ctrl.write_page_finish = gpmi_ecc_write_page_finish;
 
     chip->options |= NAND_NO_SUBPAGE_WRITE;
 
+    /* 多片nand按块条带，读取时在芯片间交错进行，条带芯片数为1时不使用 */
+    chip->stripe_chips = CONFIG_SYS_NAND_STRIPE_CHIPS;
+    chip->ecc_ctrl.read_interleave = gpmi_ecc_read_interleave;
+
     chip->ecc_ctrl.mode = NAND_ECC_HW;
     chip->ecc_ctrl.ecc_bytes_per_step = 9;
     chip->ecc_ctrl.data_size_per_step = 512;
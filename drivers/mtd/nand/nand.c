@@ -1,8 +1,12 @@
 #include "stddef.h"
 #include "mtd/mtd.h"
 #include "mtd/nand/nand.h"
+#include "mtd/concat.h"
 #include "global_data.h"
 #include "log.h"
+#include "common.h"
+#include "malloc.h"
+#include "errno.h"
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -77,6 +81,110 @@ static void nand_init_chip(__out struct mtd_info *mtd, __in struct nand_chip *na
 }
 
 
+#ifdef CONFIG_SYS_NAND_BENCH
+/********************************************************************************
+* 函数: static uint32_t nand_bench_pass(__in struct mtd_info *mtd, __in size_t len,
+                                      __in size_t chunk, __in uint8_t *buf)
+* 描述: 从地址0开始每次读取chunk字节，一共读取len字节，计算读取速度
+* 输入: mtd: nandflash设备
+       len: 读取的总字节数，chunk的整数倍
+       chunk: 每次读取的字节数
+       buf: 读取缓冲区，长度为chunk
+* 输出: none
+* 返回: 读取速度，单位KiB/s，读取失败返回0
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static uint32_t nand_bench_pass(__in struct mtd_info *mtd, __in size_t len,
+                                  __in size_t chunk, __in uint8_t *buf)
+{
+    struct nand_chip *this = mtd->priv;
+    size_t done, retlen;
+    uint32_t start, us;
+    int32_t i, ret;
+
+    /* 清空页缓存，两次测试读取的页不能命中上一次的缓存 */
+    for(i = 0; i < CONFIG_SYS_NAND_PAGE_CACHE; i++)
+        this->page_cache[i].page = -1;
+
+    start = get_timer_us(0);
+    for(done = 0; done < len; done += chunk)
+    {
+        ret = mtd->read(mtd, done, chunk, &retlen, buf);
+        if((ret < 0) && (ret != -EUCLEAN) && (ret != -EBADMSG))
+        {
+            printl(LOG_LEVEL_ERR, "[NAND:ERR] bench read at 0x%x failed, code = %d\n", done, -ret);
+            return 0;
+        }
+    }
+    us = get_timer_us(start);
+    if(!us)
+        us = 1;
+
+    return (uint32_t)(((uint64_t)(len >> 10) * 1000000) / us);
+}
+
+/********************************************************************************
+* 函数: static void nand_bench_read(__in struct mtd_info *mtd, __in size_t len)
+* 描述: 测试nandflash顺序读取速度. 使用条带时先关闭条带读一遍，再打开条带读一遍，
+       两次读取的物理块不同，只比较速度，不比较数据. 芯片支持缓存读时再关闭缓存读
+       读一遍，和使用缓存读的速度比较
+* 输入: mtd: nandflash设备
+       len: 读取的字节数
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void nand_bench_read(__in struct mtd_info *mtd, __in size_t len)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t stripe = this->stripe_chips;
+    size_t chunk;
+    uint8_t *buf;
+    uint32_t speed;
+
+    /* 每次读取一组条带块，条带时每次读取都能交给交错读 */
+    chunk = mtd->erasesize * ((stripe > 1) ? stripe : 1);
+    if(len > mtd->size)
+        len = mtd->size;
+    len -= len % chunk;
+    if(!len)
+        return;
+
+    buf = dlmalloc(chunk);
+    if(!buf)
+    {
+        printl(LOG_LEVEL_ERR, "[NAND:ERR] bench failed to allocate %d bytes\n", chunk);
+        return;
+    }
+
+    if(stripe > 1)
+    {
+        this->stripe_chips = 1;
+        speed = nand_bench_pass(mtd, len, chunk, buf);
+        this->stripe_chips = stripe;
+        printl(LOG_LEVEL_INFO, "nand read %u KiB linear: %u KiB/s\n", len >> 10, speed);
+    }
+
+    speed = nand_bench_pass(mtd, len, chunk, buf);
+    printl(LOG_LEVEL_INFO, "nand read %u KiB %s: %u KiB/s\n", len >> 10,
+           (stripe > 1) ? "striped" : "linear", speed);
+
+    if(NAND_HAS_CACHEREAD(this))
+    {
+        this->options &= ~NAND_CACHEREAD;
+        speed = nand_bench_pass(mtd, len, chunk, buf);
+        this->options |= NAND_CACHEREAD;
+        printl(LOG_LEVEL_INFO, "nand read %u KiB without cache read: %u KiB/s\n",
+               len >> 10, speed);
+    }
+
+    dlfree((int8_t *)buf);
+}
+#endif
+
+
 /********************************************************************************
 * 函数: void nand_init(void)
 * 描述: 初始化nand设备
@@ -99,6 +207,21 @@ void nand_init(void)
 	}
 	printl(LOG_LEVEL_INFO, "nand device total size: %u MiB\n", size / SZ_1K);
 
+#ifdef CONFIG_SYS_NAND_BENCH
+	if(nand_info[0].size)
+		nand_bench_read(&nand_info[0], CONFIG_SYS_NAND_BENCH);
+#endif
+
+#if defined(CONFIG_SYS_MTD_CONCAT_BENCH) && (CONFIG_SYS_MAX_NAND_DEVICE > 1)
+	/* 两个nand设备首尾相接和条带的速度比较 */
+	if(nand_info[0].size && nand_info[1].size)
+	{
+		struct mtd_info *subdev[2] = {&nand_info[0], &nand_info[1]};
+
+		mtd_concat_bench(subdev, 2, CONFIG_SYS_MTD_CONCAT_BENCH);
+	}
+#endif
+
 #ifdef CONFIG_SYS_NAND_SELECT_DEVICE
 	board_nand_select_device(nand_info[nand_curr_device].priv, nand_curr_device);
 #endif
@@ -5,6 +5,7 @@
 #include "errno.h"
 #include "math.h"
 #include "ecc.h"
+#include "bch.h"
 #include "config.h"
 #include "mtd/nand/nand.h"
 #include "mtd/nand/nand_device_info.h"
@@ -17,9 +18,17 @@
 #endif
 
 
+/* 擦除时一段时间内没有任何芯片完成就按超时处理，单位微秒 */
+#define NAND_ERASE_TIMEOUT_US        (400 * 1000)
+
+
 /* 外部函数 */
 extern int32_t nand_default_bbt(__in struct mtd_info *mtd);
 
+/* 内部函数 */
+static void nand_req_quiesce(__in struct mtd_info *mtd);
+static int32_t nand_submit_wait(__in struct mtd_info *mtd, __inout struct mtd_request *req);
+
 
 /* ecc在oob区中的布局 */
 
@@ -98,6 +107,11 @@ static struct nand_ecclayout nand_oob_128 = {
     }
 };
 
+#ifdef CONFIG_NAND_ECC_BCH
+/* 软件bch的ecc布局，ecc放在oob区末尾，在nand_bch_init中生成 */
+static struct nand_ecclayout nand_bch_oob;
+#endif
+
 
 
 
@@ -105,7 +119,9 @@ static struct nand_ecclayout nand_oob_128 = {
 /********************************************************************************
 * 函数: static int32_t nand_get_device(__in struct mtd_info *mtd,
                                       __in int32_t new_state)
-* 描述: 取得nandflash设备, 设置nandflash设备的状态
+* 描述: 取得nandflash设备, 设置nandflash设备的状态. 异步请求正在硬件上进行的
+       操作(一条dma链、一页编程或者每个芯片上的一个擦除)先等待完成，队列中剩下的
+       部分留给之后的轮询，不会等待整个请求
 * 输入: mtd: nandflash设备父类
        new_state: nandflash设备新状态
 * 输出: none
@@ -116,6 +132,9 @@ static struct nand_ecclayout nand_oob_128 = {
 static int32_t nand_get_device(__in struct mtd_info *mtd, __in int32_t new_state)
 {
     struct nand_chip *this = mtd->priv;
+
+    nand_req_quiesce(mtd);
+
     this->state = new_state;
     return 0;
 }
@@ -137,6 +156,103 @@ static void nand_release_device(__in struct mtd_info *mtd)
 }
 
 
+/********************************************************************************
+* 函数: static int32_t nand_phys_page(__in struct nand_chip *this, __in loff_t ofs)
+* 描述: 逻辑地址转换成物理页号. 条带以擦除块为单位，每stripe_chips个芯片为一组，
+       组内连续的逻辑块轮流分布到各个芯片上. 不使用条带时逻辑地址就是物理地址
+* 输入: this: nandflash设备自身指针
+       ofs: 逻辑地址
+* 输出: none
+* 返回: 物理页号，右移(chip_shift - page_shift)位为芯片号
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_phys_page(__in struct nand_chip *this, __in loff_t ofs)
+{
+    uint32_t block, blocks_per_group, chip;
+
+    if(this->stripe_chips <= 1)
+        return (int32_t)(ofs >> this->page_shift);
+
+    blocks_per_group = this->stripe_chips << (this->chip_shift - this->phys_erase_shift);
+    block = (uint32_t)(ofs >> this->phys_erase_shift);
+
+    chip = (block / blocks_per_group) * this->stripe_chips +
+           (block % blocks_per_group) % this->stripe_chips;
+    block = (block % blocks_per_group) / this->stripe_chips;
+
+    return (int32_t)((chip << (this->chip_shift - this->page_shift)) +
+                     (block << (this->phys_erase_shift - this->page_shift)) +
+                     (((uint32_t)ofs & ((1 << this->phys_erase_shift) - 1)) >> this->page_shift));
+}
+
+
+/********************************************************************************
+* 函数: static int32_t nand_seek_page(__in struct mtd_info *mtd,
+                                     __in int32_t realpage,
+                                     __in loff_t ofs,
+                                     __inout int32_t *chipnr)
+* 描述: 移动到下一个要操作的页，使用条带时到达逻辑块边界需要重新计算物理页，
+       芯片改变时重新选择芯片
+* 输入: mtd: nandflash设备父类
+       realpage: 不使用条带时下一个物理页号
+       ofs: 下一页的逻辑地址
+       chipnr: 当前选中的芯片
+* 输出: chipnr: 新选中的芯片
+* 返回: 下一个物理页号
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_seek_page(__in struct mtd_info *mtd, __in int32_t realpage,
+                                __in loff_t ofs, __inout int32_t *chipnr)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t chip;
+
+    if((this->stripe_chips > 1) && !(ofs & ((1 << this->phys_erase_shift) - 1)))
+        realpage = nand_phys_page(this, ofs);
+
+    chip = realpage >> (this->chip_shift - this->page_shift);
+    if(chip != *chipnr)
+    {
+        *chipnr = chip;
+        this->select_chip(mtd, -1);
+        this->select_chip(mtd, chip);
+    }
+
+    return realpage;
+}
+
+
+/********************************************************************************
+* 函数: static int32_t nand_plane_pair(__in struct nand_chip *this, __in loff_t ofs)
+* 描述: 判断逻辑地址ofs所在块和下一个逻辑块是否为同一芯片上两个plane的一对块，
+       plane地址是块号的最低位，偶数块和紧跟的奇数块组成一对. 使用条带时相邻
+       逻辑块在不同芯片上，不会组成一对
+* 输入: this: nandflash设备自身指针
+       ofs: 块对齐的逻辑地址，调用者保证下一块也在设备范围内
+* 输出: none
+* 返回: 1: 可以使用多plane操作
+       0: 不可以
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_plane_pair(__in struct nand_chip *this, __in loff_t ofs)
+{
+    int32_t block_shift = this->phys_erase_shift - this->page_shift;
+    int32_t page;
+
+    if(!NAND_HAS_MULTIPLANE(this))
+        return 0;
+
+    page = nand_phys_page(this, ofs);
+    if((page >> block_shift) & 0x01)
+        return 0;
+
+    return (nand_phys_page(this, ofs + (1 << this->phys_erase_shift)) == (page + (1 << block_shift)));
+}
+
+
 /********************************************************************************
 * 函数: static void nand_select_chip(__in struct mtd_info *mtd,
                                     __in int32_t chipnr)
@@ -448,11 +564,84 @@ static void single_erase_cmd(__in struct mtd_info *mtd, __in int32_t page)
     this->cmdfunc(mtd, NAND_CMD_ERASE2, -1, -1);
 }
 
+/********************************************************************************
+* 函数: static void multi_erase_cmd(__in struct mtd_info *mtd,
+                                   __in int32_t page)
+* 描述: 两个plane同时擦除，page所在块在plane0上，plane1上擦除下一块
+* 输入: mtd: nandflash设备父类
+       page: 擦除的起始页，擦除此页所在的块和下一块
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void multi_erase_cmd(__in struct mtd_info *mtd, __in int32_t page)
+{
+    struct nand_chip *this = mtd->priv;
+
+    /* 0xd1之后芯片忙tDBSY，cmdfunc会等待就绪 */
+    this->cmdfunc(mtd, NAND_CMD_ERASE1, -1, page);
+    this->cmdfunc(mtd, NAND_CMD_MULTI_ERASE2, -1, -1);
+    this->cmdfunc(mtd, NAND_CMD_ERASE1, -1, page + (1 << (this->phys_erase_shift - this->page_shift)));
+    this->cmdfunc(mtd, NAND_CMD_ERASE2, -1, -1);
+}
+
+/********************************************************************************
+* 函数: int32_t nand_plane_status(__in struct mtd_info *mtd)
+* 描述: 多plane编程或者擦除的状态(0x70)报告失败之后，使用0x71读取每个plane的结果.
+       只有0x71的bit0也报告失败并且给出了失败的plane时才按plane区分，否则(芯片
+       不支持0x71)认为两个plane都失败
+* 输入: mtd: nandflash设备父类，芯片已经选中并且就绪
+* 输出: none
+* 返回: NAND_STATUS_FAIL_PLANE0和NAND_STATUS_FAIL_PLANE1的组合
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+int32_t nand_plane_status(__in struct mtd_info *mtd)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t status;
+
+    this->cmdfunc(mtd, NAND_CMD_STATUS_MULTI, -1, -1);
+    status = this->read_byte(mtd);
+
+    if(!(status & NAND_STATUS_FAIL) ||
+       !(status & (NAND_STATUS_FAIL_PLANE0 | NAND_STATUS_FAIL_PLANE1)))
+        return NAND_STATUS_FAIL_PLANE0 | NAND_STATUS_FAIL_PLANE1;
+
+    return status & (NAND_STATUS_FAIL_PLANE0 | NAND_STATUS_FAIL_PLANE1);
+}
+
+
+/********************************************************************************
+* 函数: static void nand_cache_invalidate(__in struct nand_chip *this,
+                                         __in int32_t page, __in int32_t count)
+* 描述: 失效页缓存中从page开始的count页，写入和擦除之前调用
+* 输入: this: nandflash设备自身指针
+       page: 起始物理页
+       count: 页数
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void nand_cache_invalidate(__in struct nand_chip *this, __in int32_t page,
+                                    __in int32_t count)
+{
+    int32_t i;
+
+    for(i = 0; i < CONFIG_SYS_NAND_PAGE_CACHE; i++)
+    {
+        if((this->page_cache[i].page >= page) && (this->page_cache[i].page < page + count))
+            this->page_cache[i].page = -1;
+    }
+}
+
 
 /********************************************************************************
 * 函数: static int32_t nand_erase(__in struct mtd_info *mtd,
                                  __in struct erase_info *instr)
-* 描述: 擦除nandflash芯片一个或多个块
+* 描述: 擦除nandflash芯片一个或多个块，提交异步擦除请求并等待完成
 * 输入: mtd: nandflash设备父类
        instr: 擦除的信息
 * 输出: none
@@ -464,31 +653,263 @@ static void single_erase_cmd(__in struct mtd_info *mtd, __in int32_t page)
 **********************************************************************************/
 static int32_t nand_erase(__in struct mtd_info *mtd, __in struct erase_info *instr)
 {
-    return nand_erase_nand(mtd, instr, 0);
+    struct mtd_request req;
+
+    memset(&req, 0, sizeof(req));
+    req.type = MTD_REQ_ERASE;
+    req.instr = instr;
+
+    return nand_submit_wait(mtd, &req);
 }
 
 /********************************************************************************
-* 函数: int32_t nand_erase_nand(__in struct mtd_info *mtd,
-                               __in struct erase_info *instr,
-                               __in int32_t allowbbt)
-* 描述: 擦除nandflash芯片一个或多个块
+* 函数: static loff_t nand_erase_next(__in struct nand_chip *this, __in int32_t chip,
+                                     __in loff_t from, __in loff_t end)
+* 描述: 查找from之后第一个在指定芯片上的逻辑块
 * 输入: this: nandflash设备自身指针
+       chip: 芯片号
+       from: 起始逻辑地址，块对齐
+       end: 擦除区域的结束地址
+* 输出: none
+* 返回: 逻辑地址，没有时返回end
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static loff_t nand_erase_next(__in struct nand_chip *this, __in int32_t chip,
+                                __in loff_t from, __in loff_t end)
+{
+    loff_t chip_start, chip_end;
+
+    /* 不使用条带时每个芯片是一段连续的地址 */
+    if(this->stripe_chips <= 1)
+    {
+        chip_start = (loff_t)chip << this->chip_shift;
+        chip_end = chip_start + ((loff_t)1 << this->chip_shift);
+        if(from < chip_start)
+            from = chip_start;
+
+        return ((from < chip_end) && (from < end)) ? from : end;
+    }
+
+    for(; from < end; from += (1 << this->phys_erase_shift))
+    {
+        if((nand_phys_page(this, from) >> (this->chip_shift - this->page_shift)) == chip)
+            return from;
+    }
+
+    return end;
+}
+
+/********************************************************************************
+* 函数: static void nand_erase_record(__inout struct nand_erase_ctx *ctx, __in loff_t fail)
+* 描述: 记录一个没有擦除的块，fail_addr保持为最低的失败地址. 调用之后再增加
+       failed或者bad计数
+* 输入: ctx: 擦除进度
+       fail: 失败的块地址
+* 输出: ctx: instr->fail_addr
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void nand_erase_record(__inout struct nand_erase_ctx *ctx, __in loff_t fail)
+{
+    if(!(ctx->failed + ctx->bad) || ((uint64_t)fail < ctx->instr->fail_addr))
+        ctx->instr->fail_addr = fail;
+}
+
+/********************************************************************************
+* 函数: static void nand_erase_issue(__in struct mtd_info *mtd,
+                                    __inout struct nand_erase_ctx *ctx,
+                                    __in int32_t chip)
+* 描述: 在芯片上开始擦除下一个块(或者两个plane上的一对块)，不等待擦除完成. 区域中
+       有坏块时跳过坏块并记录在ctx中，擦除结束时一起报告
+* 输入: mtd: nandflash设备父类
+       ctx: 擦除进度
+       chip: 芯片在当前分组中的序号
+* 输出: ctx: 芯片更新后的擦除状态，没有需要擦除的块时ofs为-1
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void nand_erase_issue(__in struct mtd_info *mtd, __inout struct nand_erase_ctx *ctx,
+                               __in int32_t chip)
+{
+    struct nand_chip *this = mtd->priv;
+    struct nand_erase_slot *slot = &ctx->slots[chip];
+    int32_t pages_per_block = 1 << (this->phys_erase_shift - this->page_shift);
+    loff_t blksize = (loff_t)1 << this->phys_erase_shift;
+    loff_t ofs;
+    int32_t page;
+
+    this->select_chip(mtd, ctx->base + chip);
+
+    /* 跳过坏块，区域中没有坏块时不逐块检查 */
+    for(ofs = slot->next; ctx->check_bad && (ofs < ctx->end);
+        ofs = nand_erase_next(this, ctx->base + chip, ofs + blksize, ctx->end))
+    {
+        if(!nand_block_checkbad(mtd, ofs, 0, ctx->allowbbt))
+            break;
+
+        printl(LOG_LEVEL_WARN, "[NAND:WARN] nand_erase_nand: skip bad block at 0x%012llx\n",
+               (uint64_t)ofs);
+        nand_erase_record(ctx, ofs);
+        ctx->bad++;
+    }
+
+    if(ofs >= ctx->end)
+    {
+        slot->ofs = -1;
+        slot->next = ctx->end;
+        return;
+    }
+
+    page = nand_phys_page(this, ofs);
+    slot->pair = (((ctx->end - ofs) >> this->phys_erase_shift) >= 2) && nand_plane_pair(this, ofs) &&
+                 !(ctx->check_bad && nand_block_checkbad(mtd, ofs + blksize, 0, ctx->allowbbt));
+
+    /* 失效页缓存中属于擦除块的页 */
+    nand_cache_invalidate(this, page, pages_per_block << slot->pair);
+
+    if(slot->pair)
+        multi_erase_cmd(mtd, page & this->page_mask);
+    else
+        this->erase_cmd(mtd, page & this->page_mask);
+
+    slot->ofs = ofs;
+    slot->next = nand_erase_next(this, ctx->base + chip, ofs + (blksize << slot->pair), ctx->end);
+}
+
+/********************************************************************************
+* 函数: static int32_t nand_erase_poll(__in struct mtd_info *mtd, __in int32_t chip)
+* 描述: 查询芯片上的擦除是否完成，不等待
+* 输入: mtd: nandflash设备父类
+       chip: 芯片号
+* 输出: none
+* 返回: >=0: 擦除完成，芯片状态寄存器的值
+       -EBUSY: 还在擦除
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_erase_poll(__in struct mtd_info *mtd, __in int32_t chip)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t status;
+
+    this->select_chip(mtd, chip);
+
+    if(this->dev_ready && !this->dev_ready(mtd))
+        return -EBUSY;
+
+    this->cmdfunc(mtd, NAND_CMD_STATUS, -1, -1);
+    status = this->read_byte(mtd);
+
+    if(!this->dev_ready && !(status & NAND_STATUS_READY))
+        return -EBUSY;
+
+    return status;
+}
+
+/********************************************************************************
+* 函数: static int32_t nand_erase_check_bad(__in struct mtd_info *mtd, __in loff_t ofs,
+                                           __in uint64_t len, __in int32_t allowbbt)
+* 描述: 擦除之前一次检查整个区域是否可能有坏块，有bbt时按字扫描. 没有坏块时开始
+       擦除时不再逐块检查
+* 输入: mtd: nandflash设备父类
+       ofs: 起始地址，块对齐
+       len: 长度，块对齐
+       allowbbt: 是否允许擦除bbt区域
+* 输出: none
+* 返回: 0: 没有坏块
+       1: 有坏块或者没有bbt不能一次检查，需要逐块检查
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_erase_check_bad(__in struct mtd_info *mtd, __in loff_t ofs,
+                                      __in uint64_t len, __in int32_t allowbbt)
+{
+    struct nand_chip *this = mtd->priv;
+    loff_t bad;
+
+    /* 检测bbt是否建立和读取 */
+    if(!(this->options & NAND_BBT_SCANNED))
+    {
+        this->options |= NAND_BBT_SCANNED;
+        this->scan_bbt(mtd);
+    }
+
+    /* bbt中保留块按坏块处理，允许擦除bbt区域时逐块检查 */
+    if(this->bbt && !allowbbt)
+        return (nand_bbt_first_bad(mtd, ofs, len, &bad) != 0);
+
+    return 1;
+}
+
+/********************************************************************************
+* 函数: static void nand_erase_group(__in struct mtd_info *mtd,
+                                    __inout struct nand_erase_ctx *ctx)
+* 描述: 从ctx->base开始找到第一个有块需要擦除的芯片分组，每个芯片开始第一个擦除.
+       芯片数超过CONFIG_SYS_NAND_MAX_CHIPS时分组进行
+* 输入: mtd: nandflash设备父类
+       ctx: 擦除进度
+* 输出: ctx: 分组和每个芯片的擦除状态，没有需要擦除的块时busy为0
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void nand_erase_group(__in struct mtd_info *mtd, __inout struct nand_erase_ctx *ctx)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t nchips, chip;
+
+    ctx->busy = 0;
+
+    for(; ctx->base < this->numchips; ctx->base += CONFIG_SYS_NAND_MAX_CHIPS)
+    {
+        nchips = min_t(int32_t, this->numchips - ctx->base, CONFIG_SYS_NAND_MAX_CHIPS);
+
+        for(chip = 0; chip < CONFIG_SYS_NAND_MAX_CHIPS; chip++)
+        {
+            ctx->slots[chip].ofs = -1;
+            ctx->slots[chip].next = ctx->end;
+            if(chip >= nchips)
+                continue;
+
+            ctx->slots[chip].next = nand_erase_next(this, ctx->base + chip, ctx->instr->addr, ctx->end);
+            nand_erase_issue(mtd, ctx, chip);
+            if(ctx->slots[chip].ofs >= 0)
+                ctx->busy++;
+        }
+
+        if(ctx->busy)
+            break;
+    }
+
+    ctx->start = get_timer_us(0);
+}
+
+/********************************************************************************
+* 函数: static int32_t nand_erase_begin(__in struct mtd_info *mtd,
+                                       __inout struct erase_info *instr,
+                                       __in int32_t allowbbt,
+                                       __out struct nand_erase_ctx *ctx)
+* 描述: 检查擦除参数，在各芯片上开始擦除，不等待完成. 区域中的坏块跳过，和擦除
+       失败的块一起在结束时报告
+* 输入: mtd: nandflash设备父类
        instr: 擦除的信息
        allowbbt: 0: 不允许擦除bbt区域
                  1: 允许擦除bbt区域
-* 输出: none
-* 返回: 0: 擦除成功
-       -EINVAL: 参数无效
-       -EIO: 出现IO错误，1、擦除区域中有坏块，2、擦除出现错误
+* 输出: ctx: 擦除进度
+* 返回: 0: 擦除已经开始，之后调用nand_erase_step和nand_erase_end
+       -EINVAL: 参数无效，不调用擦除回调
+       -EIO: 设备写保护，擦除已经结束并且已经调用擦除回调
 * 作者:
 * 版本: v1.0
 **********************************************************************************/
-int32_t nand_erase_nand(__in struct mtd_info *mtd, __in struct erase_info *instr,
-                         __in int32_t allowbbt)
+static int32_t nand_erase_begin(__in struct mtd_info *mtd, __inout struct erase_info *instr,
+                                  __in int32_t allowbbt, __out struct nand_erase_ctx *ctx)
 {
     struct nand_chip *this = mtd->priv;
-    int32_t page, chipnr, pages_per_block, status, ret;
-    uint64_t len;
+    loff_t ofs;
 
     printl(LOG_LEVEL_INFO, "[NAND:INFO] nand_erase_nand: start = 0x%012llx, len = %llu\n",
            (uint64_t)instr->addr, (uint64_t)instr->len);
@@ -514,92 +935,240 @@ int32_t nand_erase_nand(__in struct mtd_info *mtd, __in struct erase_info *instr
         return -EINVAL;
     }
 
-    instr->fail_addr = 0xffffffff;
+    instr->fail_addr = MTD_FAIL_ADDR_UNKNOWN;
 
     /* 获取设备 */
     nand_get_device(mtd, FL_ERASING);
 
-    page = (int32_t)(instr->addr >> this->page_shift);
-    chipnr = (int32_t)(instr->addr >> this->chip_shift);
-
-    pages_per_block = 1 << (this->phys_erase_shift - this->page_shift);
+    ofs = instr->addr;
 
     /* 选择芯片 */
-    this->select_chip(mtd, chipnr);
+    this->select_chip(mtd, nand_phys_page(this, ofs) >> (this->chip_shift - this->page_shift));
 
     if(nand_check_wp(mtd))
     {
         printl(LOG_LEVEL_WARN, "[NAND:WARN] nand_erase_nand: device is write protected!\n");
         instr->state = MTD_ERASE_FAILED;
-        goto erase_exit;
+        nand_release_device(mtd);
+        mtd_erase_callback(instr);
+        return -EIO;
     }
 
-    len = instr->len;
-
     instr->state = MTD_ERASING;
 
-    /* 开始擦除 */
-    while(len)
+    ctx->instr = instr;
+    ctx->end = instr->addr + instr->len;
+    ctx->base = 0;
+    ctx->failed = 0;
+    ctx->bad = 0;
+    ctx->allowbbt = allowbbt;
+    ctx->active = 1;
+
+    /* 开始之前检查整个区域，没有坏块时擦除过程中不再逐块检查 */
+    ctx->check_bad = nand_erase_check_bad(mtd, instr->addr, instr->len, allowbbt);
+
+    nand_erase_group(mtd, ctx);
+
+    return 0;
+}
+
+/********************************************************************************
+* 函数: static int32_t nand_erase_step(__in struct mtd_info *mtd,
+                                      __inout struct nand_erase_ctx *ctx,
+                                      __in int32_t issue)
+* 描述: 轮询一遍当前分组中的芯片，收集完成的擦除状态之后立即开始该芯片上的下一块，
+       不等待. 擦除失败之后(instr->state为MTD_ERASE_FAILED)不再开始新的擦除，只等待
+       其他芯片上已经开始的擦除完成. 一段时间内没有任何芯片完成时剩下的擦除都按
+       超时失败处理. 分组完成后开始下一组. issue为0时只收集，不开始新的擦除，
+       之后issue为1的调用从空闲芯片的下一块继续
+* 输入: mtd: nandflash设备父类
+       ctx: 擦除进度
+       issue: 是否开始新的擦除
+* 输出: ctx: 擦除进度
+* 返回: 1: 所有块擦除完成
+       0: 还在擦除
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_erase_step(__in struct mtd_info *mtd, __inout struct nand_erase_ctx *ctx,
+                                 __in int32_t issue)
+{
+    struct nand_chip *this = mtd->priv;
+    struct erase_info *instr = ctx->instr;
+    int32_t chip, status, planes, i, progress = 0;
+    loff_t ofs, fail;
+
+    /* 暂停期间完成的芯片从下一块继续 */
+    if(issue && (instr->state != MTD_ERASE_FAILED))
     {
-        if(nand_block_checkbad(mtd, ((loff_t)page) << this->page_shift, 0, allowbbt))
+        for(chip = 0; chip < CONFIG_SYS_NAND_MAX_CHIPS; chip++)
         {
-            printl(LOG_LEVEL_WARN, "[NAND:WARN] nand_erase_nand: attempt to erase a bad block at page 0x%08x\n",
-                                    page);
-
-            instr->state = MTD_ERASE_FAILED;
+            if((ctx->slots[chip].ofs >= 0) || (ctx->slots[chip].next >= ctx->end))
+                continue;
 
-            goto erase_exit;
+            nand_erase_issue(mtd, ctx, chip);
+            if(ctx->slots[chip].ofs >= 0)
+                ctx->busy++;
         }
+    }
 
-        /* 检测当前擦除的块是否包含cache的页，包含就使cache的页失效 */
-        if((page <= this->pagebuf) && ((page + pages_per_block) > this->pagebuf))
-            this->pagebuf = -1;
+    for(chip = 0; ctx->busy && (chip < CONFIG_SYS_NAND_MAX_CHIPS); chip++)
+    {
+        if(ctx->slots[chip].ofs < 0)
+            continue;
 
-        this->erase_cmd(mtd, page & this->page_mask);
+        status = nand_erase_poll(mtd, ctx->base + chip);
+        if(status < 0)
+            continue;
 
-        status = this->waitfunc(mtd);
+        progress = 1;
+        ofs = ctx->slots[chip].ofs;
 
         if((status & NAND_STATUS_FAIL) && (this->errstat))
-            status = this->errstat(mtd, FL_ERASING, status, page);
+            status = this->errstat(mtd, FL_ERASING, status, nand_phys_page(this, ofs));
 
+        /* 两个plane一起擦除时状态是合并的，使用0x71区分失败的块 */
         if(status & NAND_STATUS_FAIL)
         {
-            printl(LOG_LEVEL_ERR, "[NAND:ERR] nand_erase_nand: failed erase, page 0x%08x\n", page);
+            planes = ctx->slots[chip].pair ? nand_plane_status(mtd) : NAND_STATUS_FAIL_PLANE0;
+            for(i = 0; i < 2; i++)
+            {
+                if(!(planes & (NAND_STATUS_FAIL_PLANE0 << i)))
+                    continue;
+
+                fail = ofs + ((loff_t)i << this->phys_erase_shift);
+                printl(LOG_LEVEL_ERR, "[NAND:ERR] nand_erase_nand: failed erase at 0x%012llx\n",
+                       (uint64_t)fail);
+                nand_erase_record(ctx, fail);
+                ctx->failed++;
+            }
+
             instr->state = MTD_ERASE_FAILED;
-            instr->fail_addr = ((loff_t)page << this->page_shift);
-            goto erase_exit;
         }
 
-        len -= (1 << this->phys_erase_shift);
-        page += pages_per_block;
+        ctx->busy--;
 
-        /* 擦除区域跨芯片 */
-        if(len && !(page & this->page_mask))
+        /* 出现失败之后或者暂停时不再开始新的擦除 */
+        if(!issue || (instr->state == MTD_ERASE_FAILED))
         {
-            chipnr++;
-            this->select_chip(mtd, -1);
-            this->select_chip(mtd, chipnr);
+            ctx->slots[chip].ofs = -1;
+            continue;
         }
+
+        nand_erase_issue(mtd, ctx, chip);
+        if(ctx->slots[chip].ofs >= 0)
+            ctx->busy++;
     }
 
-    instr->state = MTD_ERASE_DONE;
+    /* 异步擦除时两次轮询之间其他代码可能复位系统定时器，这里使用微秒计数器 */
+    if(progress)
+        ctx->start = get_timer_us(0);
+    else if(ctx->busy && (get_timer_us(ctx->start) > NAND_ERASE_TIMEOUT_US))
+    {
+        for(chip = 0; chip < CONFIG_SYS_NAND_MAX_CHIPS; chip++)
+        {
+            if(ctx->slots[chip].ofs < 0)
+                continue;
+
+            printl(LOG_LEVEL_ERR, "[NAND:ERR] nand_erase_nand: erase timeout at 0x%012llx\n",
+                   (uint64_t)ctx->slots[chip].ofs);
+            nand_erase_record(ctx, ctx->slots[chip].ofs);
+            ctx->failed++;
+            ctx->slots[chip].ofs = -1;
+        }
 
-erase_exit:
+        instr->state = MTD_ERASE_FAILED;
+        ctx->busy = 0;
+    }
 
-    ret = ((instr->state == MTD_ERASE_DONE) ? 0 : -EIO);
+    if(ctx->busy || !issue)
+        return 0;
 
-    /* 释放设备 */
-    nand_release_device(mtd);
+    if(instr->state == MTD_ERASE_FAILED)
+        return 1;
 
-    /* 未出现错误，调用回调函数 */
-    if(!ret)
-        mtd_erase_callback(instr);
+    ctx->base += CONFIG_SYS_NAND_MAX_CHIPS;
+    nand_erase_group(mtd, ctx);
 
-    return ret;
+    return !ctx->busy;
 }
 
+/********************************************************************************
+* 函数: static int32_t nand_erase_end(__in struct mtd_info *mtd,
+                                     __inout struct nand_erase_ctx *ctx)
+* 描述: 擦除全部结束之后汇总报告，跳过的坏块和擦除失败的块都按失败处理，fail_addr
+       为最低的失败地址. 释放设备之后调用一次擦除回调，成功和失败都调用
+* 输入: mtd: nandflash设备父类
+       ctx: 擦除进度
+* 输出: none
+* 返回: 0: 擦除成功
+       -EIO: 区域中有坏块或者擦除出现错误
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_erase_end(__in struct mtd_info *mtd, __inout struct nand_erase_ctx *ctx)
+{
+    struct erase_info *instr = ctx->instr;
+    int32_t ret;
+
+    if(ctx->failed || ctx->bad)
+    {
+        printl(LOG_LEVEL_ERR, "[NAND:ERR] nand_erase_nand: %d erase failures, %d bad blocks, first at 0x%012llx\n",
+               ctx->failed, ctx->bad, instr->fail_addr);
+        instr->state = MTD_ERASE_FAILED;
+    }
+    else
+        instr->state = MTD_ERASE_DONE;
+
+    ctx->active = 0;
+
+    ret = ((instr->state == MTD_ERASE_DONE) ? 0 : -EIO);
+
+    /* 释放设备 */
+    nand_release_device(mtd);
+
+    /* 调用者在回调中根据state和fail_addr处理结果 */
+    mtd_erase_callback(instr);
+
+    return ret;
+}
+
+/********************************************************************************
+* 函数: int32_t nand_erase_nand(__in struct mtd_info *mtd,
+                               __in struct erase_info *instr,
+                               __in int32_t allowbbt)
+* 描述: 擦除nandflash芯片一个或多个块并等待完成. 每个芯片同时进行一个擦除，某个
+       芯片擦除完成后立即开始该芯片上的下一块，状态在完成时收集. 坏块跳过，擦除失败
+       之后不再开始新的擦除，等待已经开始的擦除完成后汇总报告，fail_addr为最低的
+       失败地址，然后调用一次擦除回调
+* 输入: this: nandflash设备自身指针
+       instr: 擦除的信息
+       allowbbt: 0: 不允许擦除bbt区域
+                 1: 允许擦除bbt区域
+* 输出: none
+* 返回: 0: 擦除成功
+       -EINVAL: 参数无效
+       -EIO: 出现IO错误，1、擦除区域中有坏块，2、擦除出现错误
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+int32_t nand_erase_nand(__in struct mtd_info *mtd, __in struct erase_info *instr,
+                         __in int32_t allowbbt)
+{
+    struct nand_erase_ctx ctx;
+    int32_t ret;
+
+    ret = nand_erase_begin(mtd, instr, allowbbt, &ctx);
+    if(ret)
+        return ret;
+
+    while(!nand_erase_step(mtd, &ctx, 1));
+
+    return nand_erase_end(mtd, &ctx);
+}
+
+
 
-
 /********************************************************************************
 * 函数: void nand_wait_ready(__in struct mtd_info *mtd)
 * 描述: 等待nandflash执行命令结束, 等待R/B引脚
@@ -647,30 +1216,29 @@ static int32_t nand_wait(__in struct mtd_info *mtd)
     else
         timeo = (CONFIG_SYS_HZ * 20) / 1000;
 
-    if(state == FL_ERASING)
-        this->cmdfunc(mtd, NAND_CMD_STATUS, -1, -1);
+    /* 编程和擦除之后都通过状态寄存器判断结果 */
+    this->cmdfunc(mtd, NAND_CMD_STATUS, -1, -1);
 
-	reset_timer();
+    reset_timer();
 
-	while(get_timer(0) < timeo)
-	{
-		if (this->dev_ready)
-		{
-			if(this->dev_ready(mtd))
-				break;
-		}
-		else
-		{
-			if(this->read_byte(mtd) & NAND_STATUS_READY)
-				break;
-		}
-	}
+    while(get_timer(0) < timeo)
+    {
+        if(this->dev_ready)
+        {
+            if(this->dev_ready(mtd))
+                break;
+        }
+        else
+        {
+            if(this->read_byte(mtd) & NAND_STATUS_READY)
+                break;
+        }
+    }
 
     if(get_timer(0) > timeo)
         printl(LOG_LEVEL_WARN, "[NAND:WARN] nand wait timeout.\n");
 
-
-	return this->read_byte(mtd);
+    return this->read_byte(mtd);
 }
 
 
@@ -734,7 +1302,7 @@ static void nand_command(__in struct mtd_info *mtd, __in uint32_t command,
     /* 写列地址 */
     if(column != -1)
     {
-        if(this->options & NAND_BUSWIDTH_16)
+        if((this->options & NAND_BUSWIDTH_16) && !NAND_CMD_8BIT_ADDR(command))
             column >>= 1;
 
         this->cmd_ctrl(mtd, column, ctrl);
@@ -762,6 +1330,7 @@ static void nand_command(__in struct mtd_info *mtd, __in uint32_t command,
 	case NAND_CMD_ERASE2:
 	case NAND_CMD_SEQIN:
 	case NAND_CMD_STATUS:
+	case NAND_CMD_SET_FEATURES:
 		return;
 
 	case NAND_CMD_RESET:
@@ -826,11 +1395,13 @@ static void nand_command_lp(__in struct mtd_info *mtd, __in uint32_t command,
     ctrl = NAND_CTRL_ALE | NAND_CTRL_CHANGE;
     if(column != -1)
     {
-        if (this->options & NAND_BUSWIDTH_16)
+        if((this->options & NAND_BUSWIDTH_16) && !NAND_CMD_8BIT_ADDR(command))
             column >>= 1;
         this->cmd_ctrl(mtd, column, ctrl);
         ctrl &= ~NAND_CTRL_CHANGE;
-        this->cmd_ctrl(mtd, column >> 8, ctrl);
+        /* READID/PARAM等指令只有一个地址字节 */
+        if(!NAND_CMD_8BIT_ADDR(command))
+            this->cmd_ctrl(mtd, column >> 8, ctrl);
     }
 
 
@@ -856,6 +1427,8 @@ static void nand_command_lp(__in struct mtd_info *mtd, __in uint32_t command,
 	case NAND_CMD_SEQIN:
 	case NAND_CMD_RNDIN:
 	case NAND_CMD_STATUS:
+	case NAND_CMD_STATUS_MULTI:
+	case NAND_CMD_SET_FEATURES:
 		return ;
 
     /* 芯片复位 */
@@ -981,6 +1554,74 @@ static int32_t nand_read_page_swecc(__in struct mtd_info *mtd, __out uint8_t *bu
 }
 
 
+#ifdef CONFIG_NAND_ECC_BCH
+/********************************************************************************
+* 函数: static void nand_bch_calculate(__in struct nand_chip *this,
+                                      __in const uint8_t *data,
+                                      __out uint8_t *ecc_code)
+* 描述: 计算一块数据的软件bch ecc，并和擦除页掩码异或
+* 输入: this: nandflash芯片
+       data: 一块ecc数据
+* 输出: ecc_code: ecc数据
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void nand_bch_calculate(__in struct nand_chip *this, __in const uint8_t *data,
+                               __out uint8_t *ecc_code)
+{
+    int32_t i;
+
+    bch_encode(this->ecc_ctrl.bch, data, this->ecc_ctrl.data_size_per_step, ecc_code);
+    for(i = 0; i < this->ecc_ctrl.ecc_bytes_per_step; i++)
+        ecc_code[i] ^= this->ecc_ctrl.bch_eccmask[i];
+}
+
+
+/********************************************************************************
+* 函数: static int32_t nand_read_page_swbch(__in struct mtd_info *mtd,
+                                           __out uint8_t *buf)
+* 描述: 读取一页页数据，通过软件bch校准, oob区会全部读取
+* 输入: mtd: nandflash设备父类
+* 输出: buf: 经过ecc校准检验的页数据, 不包含oob区
+* 返回: 0
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_read_page_swbch(__in struct mtd_info *mtd, __out uint8_t *buf)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t i, stat, ecc_size = this->ecc_ctrl.data_size_per_step;
+	int32_t ecc_bytes = this->ecc_ctrl.ecc_bytes_per_step;
+	int32_t ecc_steps = this->ecc_ctrl.ecc_steps_per_page;
+	uint8_t *p = buf;
+	uint8_t *ecc_calc = this->ecc_ctrl.ecc_calcbuf;
+	uint8_t *ecc_code = this->ecc_ctrl.ecc_codebuf;
+	uint32_t *eccpos = this->ecc_ctrl.layout->eccpos;
+
+	this->ecc_ctrl.read_page_raw(mtd, buf);
+
+	for (i = 0; i < this->ecc_ctrl.ecc_total_bytes_per_page; i++)
+		ecc_code[i] = this->oob_poi[eccpos[i]];
+
+	for (i = 0; ecc_steps > 0; ecc_steps--)
+	{
+	    nand_bch_calculate(this, p, &ecc_calc[i]);
+		stat = bch_decode(this->ecc_ctrl.bch, p, ecc_size, &ecc_code[i], &ecc_calc[i]);
+		if (stat < 0)
+            mtd->ecc_stats.failed ++;
+		else
+            mtd->ecc_stats.corrected += stat;
+
+        i += ecc_bytes;
+        p += ecc_size;
+	}
+
+	return 0;
+}
+#endif
+
+
 /********************************************************************************
 * 函数: static int32_t nand_read_subpage(__in struct mtd_info *mtd,
                                         __in uint32_t offs,
@@ -1139,150 +1780,536 @@ static int32_t nand_read_page_hwecc(__in struct mtd_info *mtd, __out uint8_t *bu
 
 
 /********************************************************************************
-* 函数: static int32_t nand_read(__in struct mtd_info *mtd, __in loff_t from,
-                                __in size_t len, __out size_t *retlen,
-                                __out uint8_t *buf)
-* 描述: 读取nandflash经过ecc校验的数据
+* 函数: static int32_t nand_read_cache(__in struct mtd_info *mtd,
+                                      __in int32_t page, __in int32_t count,
+                                      __out uint8_t *buf)
+* 描述: 使用缓存读连续读取一块内的多页，每发送一次0x31，芯片把数据寄存器中的页
+       移到缓存寄存器并开始装载下一页，读出当前页的时间和下一页的装载时间重叠，
+       最后一页使用0x3f结束
 * 输入: mtd: nandflash设备父类
-       from: 读取的起始地址
-       len: 需要读取的长度
-* 输出: retlen: 成功读取的长度
-       buf: 经过ecc校验的数据
-* 返回: 0: 成功且数据没有错误产生
-       -EINVAL: 输入参数无效
-       -EBADMSG: 出现坏块
-       -EUCLEAN: 数据读取成功，错误位被纠正
+       page: 起始页(芯片内页号)
+       count: 页数
+* 输出: buf: 读取的数据，长度为count页
+* 返回: 0: 成功
+       <0: 读取失败
 * 作者:
 * 版本: v1.0
 **********************************************************************************/
-static int32_t nand_read(__in struct mtd_info *mtd, __in loff_t from, __in size_t len,
-                          __out size_t *retlen, __out uint8_t *buf)
+static int32_t nand_read_cache(__in struct mtd_info *mtd, __in int32_t page,
+                                 __in int32_t count, __out uint8_t *buf)
 {
     struct nand_chip *this = mtd->priv;
-    int32_t ret = 0;
-    int32_t chipnr, page, realpage, colume, bytes, aligned;
-    uint32_t readlen = len;
-    uint8_t *bufpoi = buf;
-    int32_t sndcmd = 1;
-    int32_t blkcheck = (1 << (this->phys_erase_shift - this->page_shift)) - 1;
-    struct mtd_ecc_stats stats = mtd->ecc_stats;
+    int32_t ret;
+    int32_t i;
 
+    /* 第一页装载到数据寄存器 */
+    this->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
 
-    if((from + len) > mtd->size)
-        return -EINVAL;
-    if(!len)
+    for(i = 0; i < count; i++)
     {
-        *retlen = 0;
-        return 0;
-    }
+        this->cmdfunc(mtd, (i == count - 1) ? NAND_CMD_CACHEREADEND : NAND_CMD_CACHEREADSTART,
+                      -1, -1);
 
-    /* 获取设备 */
-    nand_get_device(mtd, FL_READING);
+        ret = this->ecc_ctrl.read_page(mtd, buf + (i << this->page_shift));
+        if((ret < 0) && (ret != -EBADMSG))
+            return ret;
+    }
 
-    /* 计算读取的页和芯片 */
-    chipnr = (int32_t)(from >> this->chip_shift);
-    this->select_chip(mtd, chipnr);
+    return 0;
+}
 
-    realpage = (int32_t)(from >> this->page_shift);
-    page = realpage & this->page_mask;
 
-    /* 页内列地址 */
-    colume = (int32_t)(from & (mtd->writesize - 1));
+/********************************************************************************
+* 函数: static int32_t nand_read_interleave(__in struct mtd_info *mtd,
+                                           __in loff_t from,
+                                           __in int32_t count,
+                                           __out uint8_t *buf)
+* 描述: 条带时连续的count个逻辑块位于不同芯片，每次从每个芯片各读一页，一个芯片
+       把数据从存储阵列装载到页寄存器(tR)时可以传输另一个芯片的数据
+* 输入: mtd: nandflash设备父类
+       from: 逻辑地址，块对齐
+       count: 块数，不超过stripe_chips
+* 输出: buf: 读取的数据，长度为count块
+* 返回: 0: 成功
+       <0: 读取失败
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_read_interleave(__in struct mtd_info *mtd, __in loff_t from,
+                                      __in int32_t count, __out uint8_t *buf)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t chips[CONFIG_SYS_NAND_MAX_CHIPS];
+    int32_t pages[CONFIG_SYS_NAND_MAX_CHIPS];
+    uint8_t *bufs[CONFIG_SYS_NAND_MAX_CHIPS];
+    int32_t pages_per_block = 1 << (this->phys_erase_shift - this->page_shift);
+    int32_t realpage;
+    int32_t ret;
+    int32_t i, j;
 
-    while(1)
+    for(j = 0; j < count; j++)
     {
-        bytes = min_t(uint32_t, mtd->writesize - colume, readlen);
-        /* 读取地址是否页对齐 */
-        aligned = (bytes == mtd->writesize);
+        realpage = nand_phys_page(this, from + ((loff_t)j << this->phys_erase_shift));
+        chips[j] = realpage >> (this->chip_shift - this->page_shift);
+        pages[j] = realpage & this->page_mask;
+    }
 
-        if(realpage != this->pagebuf)
-        {
-            if(likely(sndcmd))
-            {
-                this->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
-                sndcmd = 0;
-            }
+    for(i = 0; i < pages_per_block; i++)
+    {
+        for(j = 0; j < count; j++)
+            bufs[j] = buf + (j << this->phys_erase_shift) + (i << this->page_shift);
 
-            if(aligned)
-                ret = this->ecc_ctrl.read_page(mtd, bufpoi);
-            else
-            {
-                if(this->ecc_ctrl.mode == NAND_ECC_SOFT)
-                    ret = this->ecc_ctrl.read_subpage(mtd, colume, bytes, this->page_databuf);
-                else
-                    ret = this->ecc_ctrl.read_page(mtd, this->page_databuf);
-            }
+        ret = this->ecc_ctrl.read_interleave(mtd, count, chips, pages, bufs);
+        if((ret < 0) && (ret != -EBADMSG))
+            return ret;
 
-            /* 数据读取出现错误 */
-            if(ret < 0)
-                break;
+        for(j = 0; j < count; j++)
+            pages[j]++;
+    }
 
-            /* 拷贝不对齐数据 */
-            if(!aligned)
-            {
-                this->pagebuf = realpage;
-                memcpy(bufpoi, this->page_databuf + colume, bytes);
-            }
+    return 0;
+}
 
-            /* 检测连续读取页是否要等待，一般不需要等待 */
-            if(!(this->options & NAND_NO_READRDY))
-            {
-                if(!this->dev_ready)
-                    udelay(this->chip_delay);
-                else
-                    nand_wait_ready(mtd);
-            }
-        }
-        else
-        {
-            memcpy(bufpoi, this->page_databuf + colume, bytes);
-        }
 
-        bufpoi += bytes;
-        readlen -= bytes;
+/********************************************************************************
+* 函数: static void nand_plane_read_cmd(__in struct mtd_info *mtd, __in int32_t page,
+                                       __in uint32_t confirm)
+* 描述: 发送多plane读的一个plane: 0x00-地址-confirm，plane0以0x32结束(芯片忙tDBSY)，
+       plane1以0x30结束，两个plane一起装载页寄存器(tR)
+* 输入: mtd: nandflash设备父类
+       page: 芯片内页号
+       confirm: NAND_CMD_MULTI_READSTART或者NAND_CMD_READSTART
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void nand_plane_read_cmd(__in struct mtd_info *mtd, __in int32_t page,
+                                 __in uint32_t confirm)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t ctrl = NAND_CTRL_ALE | NAND_CTRL_CHANGE;
 
-        if(!readlen)
-            break;
+    this->cmd_ctrl(mtd, NAND_CMD_READ0, NAND_CTRL_CLE | NAND_CTRL_CHANGE);
 
-        colume = 0;
+    /* 列地址为0 */
+    this->cmd_ctrl(mtd, 0x00, ctrl);
+    ctrl &= ~NAND_CTRL_CHANGE;
+    this->cmd_ctrl(mtd, 0x00, ctrl);
 
-        realpage++;
-        page = realpage & this->page_mask;
+    this->cmd_ctrl(mtd, page, ctrl);
+    this->cmd_ctrl(mtd, page >> 8, ctrl);
+    /* 大于128MiB的设备多一个页地址字节 */
+    if(this->chipsize > (128 << 20))
+        this->cmd_ctrl(mtd, page >> 16, ctrl);
 
-        /* 读取地址跨芯片 */
-        if(!page)
-        {
-            chipnr++;
-            this->select_chip(mtd, -1);
-            this->select_chip(mtd, chipnr);
-        }
+    this->cmd_ctrl(mtd, NAND_CMD_NONE, NAND_NCE | NAND_CTRL_CHANGE);
+    this->cmd_ctrl(mtd, confirm, NAND_NCE | NAND_CLE | NAND_CTRL_CHANGE);
+    this->cmd_ctrl(mtd, NAND_CMD_NONE, NAND_NCE | NAND_CTRL_CHANGE);
 
-        /* 检测芯片是否支持页自动增加或者跨了一个块 */
-        if((this->options & NAND_NO_AUTOINCR) || !(page & blkcheck))
-            sndcmd = 1;
+    if(!this->dev_ready)
+    {
+        udelay(this->chip_delay);
+        return;
     }
 
-    /* 计算读取的长度和返回值 */
-    *retlen = len - readlen;
-
-    /* 即测读取的数据是否有错误产生 */
-	if(mtd->ecc_stats.failed - stats.failed)
-		ret = -EBADMSG;
-    else if(mtd->ecc_stats.corrected - stats.corrected)
-        ret = -EUCLEAN;
-    else
-        ret  = 0;
-
-    /* 释放设备 */
-    nand_release_device(mtd);
-
-    return ret;
+    /* tWB */
+    ndelay(100);
+    nand_wait_ready(mtd);
 }
 
 
-
 /********************************************************************************
-* 函数: static uint8_t *nand_transfer_oob(__in struct nand_chip *this,
+* 函数: static int32_t nand_read_multi_plane(__in struct mtd_info *mtd,
+                                            __in int32_t page, __in int32_t count,
+                                            __out uint8_t *buf0, __out uint8_t *buf1)
+* 描述: 两个plane上成对的块从page开始各读count页. 每次两个plane的对应页一起装载
+       (0x00-0x32，0x00-0x30)，一次tR读出两页，再用0x06-0xe0分别选择plane输出数据
+* 输入: mtd: nandflash设备父类
+       page: plane0上的起始页(芯片内页号)，plane1上为下一块的对应页
+       count: 每个plane读取的页数
+* 输出: buf0: plane0的数据
+       buf1: plane1的数据
+* 返回: 0: 成功，无法纠正的错误计入ecc统计
+       <0: 读取失败
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_read_multi_plane(__in struct mtd_info *mtd, __in int32_t page,
+                                       __in int32_t count, __out uint8_t *buf0,
+                                       __out uint8_t *buf1)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t pages_per_block = 1 << (this->phys_erase_shift - this->page_shift);
+    int32_t ret;
+    int32_t i;
+
+    for(i = 0; i < count; i++)
+    {
+        nand_plane_read_cmd(mtd, page + i, NAND_CMD_MULTI_READSTART);
+        nand_plane_read_cmd(mtd, page + pages_per_block + i, NAND_CMD_READSTART);
+
+        this->cmdfunc(mtd, NAND_CMD_RNDOUT_PLANE, 0x00, page + i);
+        this->cmdfunc(mtd, NAND_CMD_RNDOUTSTART, -1, -1);
+        ret = this->ecc_ctrl.read_page(mtd, buf0 + (i << this->page_shift));
+        if((ret < 0) && (ret != -EBADMSG))
+            return ret;
+
+        this->cmdfunc(mtd, NAND_CMD_RNDOUT_PLANE, 0x00, page + pages_per_block + i);
+        this->cmdfunc(mtd, NAND_CMD_RNDOUTSTART, -1, -1);
+        ret = this->ecc_ctrl.read_page(mtd, buf1 + (i << this->page_shift));
+        if((ret < 0) && (ret != -EBADMSG))
+            return ret;
+    }
+
+    return 0;
+}
+
+
+/********************************************************************************
+* 函数: static struct nand_page_cache *nand_cache_find(__in struct nand_chip *this,
+                                                      __in int32_t page)
+* 描述: 在页缓存中查找一页，不更新时间戳和统计
+* 输入: this: nandflash设备自身指针
+       page: 物理页
+* 输出: none
+* 返回: 缓存项，没有找到返回NULL
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static struct nand_page_cache *nand_cache_find(__in struct nand_chip *this, __in int32_t page)
+{
+    int32_t i;
+
+    for(i = 0; i < CONFIG_SYS_NAND_PAGE_CACHE; i++)
+    {
+        if(this->page_cache[i].page == page)
+            return this->page_cache + i;
+    }
+
+    return NULL;
+}
+
+
+/********************************************************************************
+* 函数: static int32_t nand_cache_fill(__in struct mtd_info *mtd,
+                                      __in int32_t realpage,
+                                      __out uint8_t **data)
+* 描述: 从芯片读取一页到页缓存，优先使用无效项，否则替换最久没有命中的项.
+       出现不能纠正的错误时数据仍然返回，但是不保留在页缓存中
+* 输入: mtd: nandflash设备父类
+       realpage: 物理页，所在芯片已经选中
+* 输出: data: 读取到的data区数据
+* 返回: 0: 成功
+       <0: 读取失败
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_cache_fill(__in struct mtd_info *mtd, __in int32_t realpage,
+                                 __out uint8_t **data)
+{
+    struct nand_chip *this = mtd->priv;
+    struct nand_page_cache *entry = this->page_cache;
+    int32_t ret;
+    int32_t i;
+
+    for(i = 0; i < CONFIG_SYS_NAND_PAGE_CACHE; i++)
+    {
+        if(this->page_cache[i].page < 0)
+        {
+            entry = this->page_cache + i;
+            break;
+        }
+
+        if(this->page_cache[i].stamp < entry->stamp)
+            entry = this->page_cache + i;
+    }
+
+    if(entry->page >= 0)
+        this->cache_stats.evictions++;
+    entry->page = -1;
+
+    this->cmdfunc(mtd, NAND_CMD_READ0, 0x00, realpage & this->page_mask);
+    ret = this->ecc_ctrl.read_page(mtd, entry->data);
+    if((ret < 0) && (ret != -EBADMSG))
+        return ret;
+
+    *data = entry->data;
+
+    /* 无法纠正的页不放入缓存 */
+    if(ret != -EBADMSG)
+    {
+        entry->page = realpage;
+        entry->stamp = ++this->cache_clock;
+    }
+
+    return 0;
+}
+
+
+/********************************************************************************
+* 函数: static void nand_cache_readahead(__in struct mtd_info *mtd,
+                                        __in int32_t realpage)
+* 描述: 预读块内realpage之后的页到页缓存. 预读页的ecc结果不计入ecc_stats，
+       否则调用者没有请求的页中纠正的位会让本次读取返回-EUCLEAN，纠正的位数
+       单独记录在cache_stats.readahead_corrected中
+* 输入: mtd: nandflash设备父类
+       realpage: 当前读取的物理页
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void nand_cache_readahead(__in struct mtd_info *mtd, __in int32_t realpage)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t blkmask = (1 << (this->phys_erase_shift - this->page_shift)) - 1;
+    int32_t count = min_t(int32_t, CONFIG_SYS_NAND_READAHEAD, CONFIG_SYS_NAND_PAGE_CACHE - 1);
+    struct mtd_ecc_stats stats = mtd->ecc_stats;
+    uint8_t *data;
+    int32_t i;
+
+    for(i = 1; i <= count; i++)
+    {
+        /* 不跨块预读 */
+        if(!((realpage + i) & blkmask))
+            break;
+
+        if(nand_cache_find(this, realpage + i))
+            continue;
+
+        if(nand_cache_fill(mtd, realpage + i, &data) < 0)
+            break;
+
+        this->cache_stats.readahead++;
+    }
+
+    this->cache_stats.readahead_corrected += mtd->ecc_stats.corrected - stats.corrected;
+    mtd->ecc_stats = stats;
+}
+
+
+/********************************************************************************
+* 函数: static int32_t nand_do_read(__in struct mtd_info *mtd, __in loff_t from,
+                                   __in size_t len, __out size_t *retlen,
+                                   __out uint8_t *buf)
+* 描述: 同步读取nandflash经过ecc校验的数据，异步读请求中不能使用dma链的部分由它完成
+* 输入: mtd: nandflash设备父类
+       from: 读取的起始地址
+       len: 需要读取的长度
+* 输出: retlen: 成功读取的长度
+       buf: 经过ecc校验的数据
+* 返回: 0: 成功且数据没有错误产生
+       -EINVAL: 输入参数无效
+       -EBADMSG: 出现坏块
+       -EUCLEAN: 数据读取成功，错误位被纠正
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_do_read(__in struct mtd_info *mtd, __in loff_t from, __in size_t len,
+                             __out size_t *retlen, __out uint8_t *buf)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t ret = 0;
+    int32_t chipnr, page, realpage, colume, bytes, aligned, multi;
+    uint32_t readlen = len;
+    uint8_t *bufpoi = buf;
+    struct nand_page_cache *entry;
+    uint8_t *data;
+    int32_t sndcmd = 1;
+    int32_t blkcheck = (1 << (this->phys_erase_shift - this->page_shift)) - 1;
+    struct mtd_ecc_stats stats = mtd->ecc_stats;
+
+
+    if((from + len) > mtd->size)
+        return -EINVAL;
+    if(!len)
+    {
+        *retlen = 0;
+        return 0;
+    }
+
+    /* 获取设备 */
+    nand_get_device(mtd, FL_READING);
+
+    /* 计算读取的页和芯片 */
+    realpage = nand_phys_page(this, from);
+    page = realpage & this->page_mask;
+
+    chipnr = realpage >> (this->chip_shift - this->page_shift);
+    this->select_chip(mtd, chipnr);
+
+    /* 页内列地址 */
+    colume = (int32_t)(from & (mtd->writesize - 1));
+
+    while(1)
+    {
+        bytes = min_t(uint32_t, mtd->writesize - colume, readlen);
+        /* 读取地址是否页对齐 */
+        aligned = (bytes == mtd->writesize);
+
+        /* 条带时从块边界开始的多个整块，交给多芯片交错读 */
+        multi = 0;
+        if(aligned && (this->stripe_chips > 1) && this->ecc_ctrl.read_interleave &&
+           !(page & blkcheck) && ((readlen >> this->phys_erase_shift) >= 2))
+            multi = min_t(int32_t, readlen >> this->phys_erase_shift, this->stripe_chips);
+
+        if(multi)
+        {
+            ret = nand_read_interleave(mtd, from + (len - readlen), multi, bufpoi);
+            if(ret < 0)
+                break;
+
+            /* 交错读之后重新发送读命令和选择芯片 */
+            sndcmd = 1;
+            chipnr = -1;
+            bytes = multi << this->phys_erase_shift;
+        }
+        else if(aligned && !this->ecc_ctrl.read_multi_page && !NAND_HAS_CACHEREAD(this) &&
+                NAND_HAS_MULTIPLANE_READ(this) && !(page & blkcheck) &&
+                ((readlen >> this->phys_erase_shift) >= 2) &&
+                nand_plane_pair(this, from + (len - readlen)))
+        {
+            /* 从块起始读满两个plane上的一对块，两块的对应页一起装载，tR减半.
+               驱动支持多页DMA链时整块已经在一条链里连续读出，支持缓存读时tR已经
+               和数据传输重叠，这两种情况都不使用逐页命令的多plane读 */
+            ret = nand_read_multi_plane(mtd, page, blkcheck + 1, bufpoi,
+                                        bufpoi + (1 << this->phys_erase_shift));
+            if(ret < 0)
+                break;
+
+            sndcmd = 1;
+            bytes = 2 << this->phys_erase_shift;
+            realpage += ((blkcheck + 1) << 1) - 1;
+            this->cache_stats.misses += (blkcheck + 1) << 1;
+        }
+        else if((entry = nand_cache_find(this, realpage)) != NULL)
+        {
+            /* 页缓存命中 */
+            entry->stamp = ++this->cache_clock;
+            this->cache_stats.hits++;
+            memcpy(bufpoi, entry->data + colume, bytes);
+
+            /* 芯片没有读取这一页，之后的页需要重新发送读命令 */
+            sndcmd = 1;
+        }
+        else
+        {
+            /* 块内连续整页读取，交给多页读或者缓存读一次完成 */
+            multi = 0;
+            if(aligned && (this->ecc_ctrl.read_multi_page || NAND_HAS_CACHEREAD(this)))
+            {
+                multi = min_t(int32_t, readlen >> this->page_shift, (blkcheck + 1) - (page & blkcheck));
+                if(multi < 2)
+                    multi = 0;
+            }
+
+            if(multi)
+            {
+                if(this->ecc_ctrl.read_multi_page)
+                    ret = this->ecc_ctrl.read_multi_page(mtd, page, multi, bufpoi);
+                else
+                    ret = nand_read_cache(mtd, page, multi, bufpoi);
+
+                /* 多页读自己发送读命令，之后的页需要重新发送 */
+                sndcmd = 1;
+                bytes = multi << this->page_shift;
+                realpage += multi - 1;
+                this->cache_stats.misses += multi;
+            }
+            else if(aligned)
+            {
+                if(likely(sndcmd))
+                {
+                    this->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
+                    sndcmd = 0;
+                }
+
+                ret = this->ecc_ctrl.read_page(mtd, bufpoi);
+                this->cache_stats.misses++;
+            }
+            else if(this->ecc_ctrl.read_subpage &&
+                    (this->cache_last != realpage) && (this->cache_last != realpage - 1))
+            {
+                /* 第一次访问的页只读取覆盖的ecc块，不放入页缓存 */
+                this->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
+                ret = this->ecc_ctrl.read_subpage(mtd, colume, bytes, this->page_databuf);
+                if((ret >= 0) || (ret == -EBADMSG))
+                    memcpy(bufpoi, this->page_databuf + colume, bytes);
+
+                sndcmd = 1;
+                this->cache_stats.misses++;
+            }
+            else
+            {
+                /* 重复访问或者顺序访问的页整页读到页缓存中，顺序读时预读后面的页 */
+                ret = nand_cache_fill(mtd, realpage, &data);
+                if(ret >= 0)
+                {
+                    memcpy(bufpoi, data + colume, bytes);
+
+                    if(this->cache_last == realpage - 1)
+                        nand_cache_readahead(mtd, realpage);
+                }
+
+                sndcmd = 1;
+                this->cache_stats.misses++;
+            }
+
+            /* 数据读取出现错误，无法纠正的ecc块已经计入ecc统计，继续读取 */
+            if((ret < 0) && (ret != -EBADMSG))
+                break;
+
+            this->cache_last = realpage;
+
+            /* 检测连续读取页是否要等待，一般不需要等待 */
+            if(!(this->options & NAND_NO_READRDY))
+            {
+                if(!this->dev_ready)
+                    udelay(this->chip_delay);
+                else
+                    nand_wait_ready(mtd);
+            }
+        }
+
+        bufpoi += bytes;
+        readlen -= bytes;
+
+        if(!readlen)
+            break;
+
+        colume = 0;
+
+        /* 读取地址跨芯片或者跨条带块 */
+        realpage = nand_seek_page(mtd, realpage + 1, from + (len - readlen), &chipnr);
+        page = realpage & this->page_mask;
+
+        /* 检测芯片是否支持页自动增加或者跨了一个块 */
+        if((this->options & NAND_NO_AUTOINCR) || !(page & blkcheck))
+            sndcmd = 1;
+    }
+
+    /* 计算读取的长度和返回值 */
+    *retlen = len - readlen;
+
+    /* 即测读取的数据是否有错误产生 */
+	if(mtd->ecc_stats.failed - stats.failed)
+		ret = -EBADMSG;
+    else if(mtd->ecc_stats.corrected - stats.corrected)
+        ret = -EUCLEAN;
+    else
+        ret  = 0;
+
+    /* 释放设备 */
+    nand_release_device(mtd);
+
+    return ret;
+}
+
+
+
+/********************************************************************************
+* 函数: static uint8_t *nand_transfer_oob(__in struct nand_chip *this,
                                          __in uint8_t *oob,
                                          __in struct mtd_oob_ops *ops,
                                          __in size_t len)
@@ -1363,9 +2390,9 @@ static int32_t nand_read_oob_std(__in struct mtd_info *mtd, __in int32_t page,
 
 
 /********************************************************************************
-* 函数: static int32_t nand_read_oob(__in struct mtd_info *mtd,
-                                    __in loff_t from,
-                                    __inout struct mtd_oob_ops *ops)
+* 函数: static int32_t nand_do_read_oob(__in struct mtd_info *mtd,
+                                       __in loff_t from,
+                                       __inout struct mtd_oob_ops *ops)
 * 描述: 根据ops选项读取oob或者oob+data在一起的数据
 * 输入: mtd: nandflash设备父类
        from: 数据起始地址
@@ -1378,8 +2405,8 @@ static int32_t nand_read_oob_std(__in struct mtd_info *mtd, __in int32_t page,
 * 作者:
 * 版本: v1.0
 **********************************************************************************/
-static int32_t nand_read_oob(__in struct mtd_info *mtd, __in loff_t from,
-                               __in struct mtd_oob_ops *ops)
+static int32_t nand_do_read_oob(__in struct mtd_info *mtd, __in loff_t from,
+                                  __in struct mtd_oob_ops *ops)
 {
     struct nand_chip *this = mtd->priv;
     int32_t ret = 0;
@@ -1388,6 +2415,7 @@ static int32_t nand_read_oob(__in struct mtd_info *mtd, __in loff_t from,
 	int32_t oobreadlen = ops->ooblen;
 	uint8_t *oobbuf = ops->oobbuf;
     int32_t oob_per_pagelen;
+    loff_t ofs;
 
     if(ops->databuf && ((from + ops->len) > mtd->size))
     {
@@ -1409,11 +2437,14 @@ static int32_t nand_read_oob(__in struct mtd_info *mtd, __in loff_t from,
         goto out;
     }
 
-    chipnr = (int32_t)(from >> this->chip_shift);
+    realpage = nand_phys_page(this, from);
+    page = realpage & this->page_mask;
+
+    chipnr = realpage >> (this->chip_shift - this->page_shift);
     this->select_chip(mtd, chipnr);
 
-    realpage = (int32_t)(from >> this->page_shift);
-    page = realpage & this->page_mask;
+    /* 下一页的逻辑地址 */
+    ofs = (from & ~((loff_t)mtd->writesize - 1)) + mtd->writesize;
 
     if(ops->mode == MTD_OOB_AUTO)
         oob_per_pagelen = this->ecc_ctrl.layout->oobavail;
@@ -1442,15 +2473,9 @@ static int32_t nand_read_oob(__in struct mtd_info *mtd, __in loff_t from,
             if(!oobreadlen)
                 break;
 
-            realpage ++;
-
+            realpage = nand_seek_page(mtd, realpage + 1, ofs, &chipnr);
             page = realpage & this->page_mask;
-            if(!page)
-            {
-                chipnr++;
-                this->select_chip(mtd, -1);
-                this->select_chip(mtd, chipnr);
-            }
+            ofs += mtd->writesize;
 
             if((this->options & NAND_NO_AUTOINCR) || (page & blkcheck))
                 sndcmd = 1;
@@ -1477,44 +2502,35 @@ static int32_t nand_read_oob(__in struct mtd_info *mtd, __in loff_t from,
             /* 读取地址是否页对齐 */
             aligned = (bytes == mtd->writesize);
 
-            if(realpage != this->pagebuf)
+            /* 需要同时读取oob区，不使用页缓存 */
+            if(likely(sndcmd))
             {
-                if(likely(sndcmd))
-                {
-                    this->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
-                    sndcmd = 0;
-                }
+                this->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
+                sndcmd = 0;
+            }
 
-                if(aligned)
-                    if(ops->mode == MTD_MODE_RAW)
-                        this->ecc_ctrl.read_page_raw(mtd, buf);
-                    else
-                        this->ecc_ctrl.read_page(mtd, buf);
+            if(aligned)
+                if(ops->mode == MTD_MODE_RAW)
+                    this->ecc_ctrl.read_page_raw(mtd, buf);
                 else
-                    if(ops->mode == MTD_MODE_RAW)
-                        this->ecc_ctrl.read_page_raw(mtd, this->page_databuf);
-                    else
-                        this->ecc_ctrl.read_page(mtd, this->page_databuf);
-
-                /* 拷贝不对齐数据 */
-                if(!aligned)
-                {
-                    this->pagebuf = realpage;
-                    memcpy(buf, this->page_databuf + colume, bytes);
-                }
+                    this->ecc_ctrl.read_page(mtd, buf);
+            else
+                if(ops->mode == MTD_MODE_RAW)
+                    this->ecc_ctrl.read_page_raw(mtd, this->page_databuf);
+                else
+                    this->ecc_ctrl.read_page(mtd, this->page_databuf);
 
-                /* 检测连续读取页是否要等待，一般不需要等待 */
-                if(!(this->options & NAND_NO_READRDY))
-                {
-                    if(!this->dev_ready)
-                        udelay(this->chip_delay);
-                    else
-                        nand_wait_ready(mtd);
-                }
-            }
-            else
-            {
+            /* 拷贝不对齐数据 */
+            if(!aligned)
                 memcpy(buf, this->page_databuf + colume, bytes);
+
+            /* 检测连续读取页是否要等待，一般不需要等待 */
+            if(!(this->options & NAND_NO_READRDY))
+            {
+                if(!this->dev_ready)
+                    udelay(this->chip_delay);
+                else
+                    nand_wait_ready(mtd);
             }
 
             /* 拷贝oob段数据 */
@@ -1534,16 +2550,10 @@ static int32_t nand_read_oob(__in struct mtd_info *mtd, __in loff_t from,
 
             colume = 0;
 
-            realpage++;
+            /* 读取地址跨芯片或者跨条带块 */
+            realpage = nand_seek_page(mtd, realpage + 1, ofs, &chipnr);
             page = realpage & this->page_mask;
-
-            /* 读取地址跨芯片 */
-            if(!page)
-            {
-                chipnr++;
-                this->select_chip(mtd, -1);
-                this->select_chip(mtd, chipnr);
-            }
+            ofs += mtd->writesize;
 
             /* 检测芯片是否支持页自动增加或者跨了一个块 */
             if((this->options & NAND_NO_AUTOINCR) || !(page & blkcheck))
@@ -1632,6 +2642,47 @@ static int32_t nand_write_page_swecc(__in struct mtd_info *mtd, __in const uint8
 }
 
 
+#ifdef CONFIG_NAND_ECC_BCH
+/********************************************************************************
+* 函数: static int32_t nand_write_page_swbch(__in struct mtd_info *mtd,
+                                            __in const uint8_t *buf)
+* 描述: 写一页数据，通过软件bch校准, oob区会全部写入
+* 输入: mtd: nandflash设备父类
+       buf: 需要写入的原始数据缓冲区, 不包含oob区
+* 输出: none
+* 返回: 0
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_write_page_swbch(__in struct mtd_info *mtd, __in const uint8_t *buf)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t i, eccsize = this->ecc_ctrl.data_size_per_step;
+	int32_t eccbytes = this->ecc_ctrl.ecc_bytes_per_step;
+	int32_t eccsteps = this->ecc_ctrl.ecc_steps_per_page;
+	uint8_t *ecc_calc = this->ecc_ctrl.ecc_calcbuf;
+	const uint8_t *p = buf;
+	uint32_t *eccpos = this->ecc_ctrl.layout->eccpos;
+
+	/* 计算ecc校验值 */
+	for (i = 0; eccsteps; eccsteps--)
+	{
+	    nand_bch_calculate(this, p, &ecc_calc[i]);
+	    i += eccbytes;
+	    p += eccsize;
+	}
+
+    /* 插入ecc校验值 */
+	for (i = 0; i < this->ecc_ctrl.ecc_total_bytes_per_page; i++)
+		this->oob_poi[eccpos[i]] = ecc_calc[i];
+
+	this->ecc_ctrl.write_page_raw(mtd, buf);
+
+	return 0;
+}
+#endif
+
+
 
 /********************************************************************************
 * 函数: static int32_t nand_read_page_hwecc(__in struct mtd_info *mtd,
@@ -1676,13 +2727,12 @@ static int32_t nand_write_page_hwecc(__in struct mtd_info *mtd, __in const uint8
 /********************************************************************************
 * 函数: static int32_t nand_write_page(__in struct mtd_info *mtd,
                                       __in const uint8_t *buf,
-                                      __in int32_t page, __in int32_t cached,
-                                      __in int32_t raw)
-* 描述: 写入nandflash一页数据
+                                      __in int32_t page, __in int32_t raw)
+* 描述: 写入nandflash一页数据，使用0x10编程并等待完成. 块内连续多页的缓存编程
+       由ecc_ctrl.write_multi_page完成
 * 输入: mtd: nandflash设备的父类
        buf: 需要写入的缓冲区数据
        page: 写入的页
-       cached: 是否允许使用cache编程
        raw: 是否写原始数据
 * 输出: none
 * 返回: 0: 写入成功
@@ -1691,8 +2741,7 @@ static int32_t nand_write_page_hwecc(__in struct mtd_info *mtd, __in const uint8
 * 版本: v1.0
 **********************************************************************************/
 static int32_t nand_write_page(__in struct mtd_info *mtd, __in const uint8_t *buf,
-                                 __in int32_t page, __in int32_t cached,
-                                 __in int32_t raw)
+                                 __in int32_t page, __in int32_t raw)
 {
     struct nand_chip *this = mtd->priv;
     int32_t status;
@@ -1704,30 +2753,16 @@ static int32_t nand_write_page(__in struct mtd_info *mtd, __in const uint8_t *bu
 	else
 		this->ecc_ctrl.write_page(mtd, buf);
 
-	/*
-	   目前暂不支持cached写入，应为不确定速度提升(2.3->2.6Mib/s, 速度提升并不是很明显)
-	   带来的风险是否值得
-    */
-	cached = 0;
-
-	if (!cached || !(this->options & NAND_CACHEPRG))
-	{
-
-		this->cmdfunc(mtd, NAND_CMD_PAGEPROG, -1, -1);
-		status = this->waitfunc(mtd);
+	/* 单页写入不使用0x15缓存编程: 下一页可能在另一个芯片(条带)或者另一个块上 */
+	this->cmdfunc(mtd, NAND_CMD_PAGEPROG, -1, -1);
+	status = this->waitfunc(mtd);
 
-		/* 检测写入结果 */
-		if ((status & NAND_STATUS_FAIL) && (this->errstat))
-			status = this->errstat(mtd, FL_WRITING, status, page);
+	/* 检测写入结果 */
+	if ((status & NAND_STATUS_FAIL) && (this->errstat))
+		status = this->errstat(mtd, FL_WRITING, status, page);
 
-		if (status & NAND_STATUS_FAIL)
-			return -EIO;
-	}
-	else
-	{
-		this->cmdfunc(mtd, NAND_CMD_CACHEDPROG, -1, -1);
-		status = this->waitfunc(mtd);
-	}
+	if (status & NAND_STATUS_FAIL)
+		return -EIO;
 
 #ifdef CONFIG_MTD_NAND_VERIFY_WRITE
 	/* 校验写入的数据 */
@@ -1740,6 +2775,75 @@ static int32_t nand_write_page(__in struct mtd_info *mtd, __in const uint8_t *bu
 }
 
 
+/********************************************************************************
+* 函数: static int32_t nand_write_multi_plane(__in struct mtd_info *mtd,
+                                             __in int32_t page, __in int32_t count,
+                                             __in const uint8_t *buf0,
+                                             __in const uint8_t *buf1,
+                                             __in int32_t raw)
+* 描述: 两个plane上成对的块从page开始各写count页，每次两个plane的对应页一起编程.
+       驱动没有提供write_multi_plane时使用
+* 输入: mtd: nandflash设备的父类
+       page: plane0上的起始页(芯片内页号)，plane1上为下一块的对应页
+       count: 每个plane写入的页数
+       buf0: plane0的数据
+       buf1: plane1的数据
+       raw: 是否写原始数据
+* 输出: none
+* 返回: 0: 写入成功
+       -EIO: 写入失败
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_write_multi_plane(__in struct mtd_info *mtd, __in int32_t page,
+                                        __in int32_t count, __in const uint8_t *buf0,
+                                        __in const uint8_t *buf1, __in int32_t raw)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t pages_per_block = 1 << (this->phys_erase_shift - this->page_shift);
+    int32_t status, planes, fail, i;
+
+    for(i = 0; i < count; i++)
+    {
+        /* plane0的页，0x11之后芯片忙tDBSY，cmdfunc会等待就绪 */
+        this->cmdfunc(mtd, NAND_CMD_SEQIN, 0x00, page + i);
+        if(unlikely(raw))
+            this->ecc_ctrl.write_page_raw(mtd, buf0 + (i << this->page_shift));
+        else
+            this->ecc_ctrl.write_page(mtd, buf0 + (i << this->page_shift));
+        this->cmdfunc(mtd, NAND_CMD_MULTI_PROG, -1, -1);
+
+        /* plane1的页，两页一起编程 */
+        this->cmdfunc(mtd, NAND_CMD_SEQIN, 0x00, page + pages_per_block + i);
+        if(unlikely(raw))
+            this->ecc_ctrl.write_page_raw(mtd, buf1 + (i << this->page_shift));
+        else
+            this->ecc_ctrl.write_page(mtd, buf1 + (i << this->page_shift));
+        this->cmdfunc(mtd, NAND_CMD_PAGEPROG, -1, -1);
+
+        /* 状态寄存器是两个plane结果的合并，失败时使用0x71区分失败的页 */
+        status = this->waitfunc(mtd);
+        if(status & NAND_STATUS_FAIL)
+        {
+            planes = nand_plane_status(mtd);
+            fail = (planes & NAND_STATUS_FAIL_PLANE0) ? (page + i) : (page + pages_per_block + i);
+            if(this->errstat)
+                status = this->errstat(mtd, FL_WRITING, status, fail);
+        }
+
+        if(status & NAND_STATUS_FAIL)
+        {
+            printl(LOG_LEVEL_ERR, "[NAND:ERR] multi-plane program failed at page %d%s\n", fail,
+                   (planes == (NAND_STATUS_FAIL_PLANE0 | NAND_STATUS_FAIL_PLANE1)) ?
+                   " (both planes)" : "");
+            return -EIO;
+        }
+    }
+
+    return 0;
+}
+
+
 /********************************************************************************
 * 函数: static uint8_t *nand_fill_oob(__in struct nand_chip *this,
                                      __out uint8_t *oob,
@@ -1791,10 +2895,10 @@ static uint8_t *nand_fill_oob(__in struct nand_chip *this, __in uint8_t *oob,
 }
 
 /********************************************************************************
-* 函数: static int32_t nand_write(__in struct mtd_info *mtd, __in loff_t to,
-                                 __in size_t len, __out size_t *retlen,
-                                 __in const uint8_t *buf)
-* 描述: 读取nandflash经过ecc校验的数据
+* 函数: static int32_t nand_do_write(__in struct mtd_info *mtd, __in loff_t to,
+                                    __in size_t len, __out size_t *retlen,
+                                    __in const uint8_t *buf)
+* 描述: 同步写入nandflash数据，异步写请求每次轮询使用它写入一段
 * 输入: mtd: nandflash设备父类
        to: 写入的起始地址
        len: 需要写入的长度
@@ -1805,16 +2909,16 @@ static uint8_t *nand_fill_oob(__in struct nand_chip *this, __in uint8_t *oob,
 * 作者:
 * 版本: v1.0
 **********************************************************************************/
-static int32_t nand_write(__in struct mtd_info *mtd, __in loff_t to, __in size_t len,
-                            __out size_t *retlen, __in const uint8_t *buf)
+static int32_t nand_do_write(__in struct mtd_info *mtd, __in loff_t to, __in size_t len,
+                               __out size_t *retlen, __in const uint8_t *buf)
 {
     struct nand_chip *this = mtd->priv;
     int32_t chipnr, page, realpage, column;
-    int32_t blkcheck = (1 << (this->chip_shift - this->page_shift)) - 1;
+    int32_t blkmask = (1 << (this->phys_erase_shift - this->page_shift)) - 1;
     int32_t bytes;
     int32_t writelen = len;
     const uint8_t *writebuf = buf;
-    int32_t cached;
+    int32_t multi;
 	int ret;
 
 	/* 写入范围越界 */
@@ -1834,16 +2938,11 @@ static int32_t nand_write(__in struct mtd_info *mtd, __in loff_t to, __in size_t
 
     column = to & (mtd->writesize - 1);
 
-    chipnr = (int32_t)(to >> this->chip_shift);
-    this->select_chip(mtd, chipnr);
-
-    realpage = (int32_t)(to >> this->page_shift);
+    realpage = nand_phys_page(this, to);
     page = realpage & this->page_mask;
 
-    /* 当要写的页的范围包含cache的页时，失效cache的页 */
-    if((to <= (this->pagebuf << this->page_shift)) &&
-        ((this->pagebuf << this->page_shift) < (to + len)))
-        this->pagebuf = -1;
+    chipnr = realpage >> (this->chip_shift - this->page_shift);
+    this->select_chip(mtd, chipnr);
 
     /* oob区全部填充0xff */
     memset(this->oob_poi, 0xff, mtd->oobsize);
@@ -1852,10 +2951,58 @@ static int32_t nand_write(__in struct mtd_info *mtd, __in loff_t to, __in size_t
     while(1)
     {
         bytes = mtd->writesize;
-        cached = (writelen > bytes && page != blkcheck);
 
+        /* 从块起始写满两个plane上的一对块，两块的对应页一起编程 */
+        if(!column && !(page & blkmask) &&
+           (writelen >= (2 << this->phys_erase_shift)) &&
+           nand_plane_pair(this, to + (len - writelen)))
+        {
+            nand_cache_invalidate(this, realpage, (blkmask + 1) << 1);
+
+            if(this->ecc_ctrl.write_multi_plane)
+                ret = this->ecc_ctrl.write_multi_plane(mtd, page, blkmask + 1, writebuf,
+                                                       writebuf + (1 << this->phys_erase_shift),
+                                                       MTD_OOB_RAW);
+            else
+                ret = nand_write_multi_plane(mtd, page, blkmask + 1, writebuf,
+                                             writebuf + (1 << this->phys_erase_shift),
+                                             MTD_OOB_RAW);
+            if(ret)
+                break;
+
+            bytes = 2 << this->phys_erase_shift;
+            realpage += ((blkmask + 1) << 1) - 1;
+
+            writelen -= bytes;
+            if(!writelen)
+                break;
+
+            writebuf += bytes;
+            realpage = nand_seek_page(mtd, realpage + 1, to + (len - writelen), &chipnr);
+            page = realpage & this->page_mask;
+            continue;
+        }
+
+        /* 块内连续整页写入，交给多页写一次完成 */
+        multi = 0;
+        if(!column && this->ecc_ctrl.write_multi_page)
+        {
+            multi = min_t(int32_t, writelen >> this->page_shift, (blkmask + 1) - (page & blkmask));
+            if(multi < 2)
+                multi = 0;
+        }
+
+        /* 失效页缓存中将要写入的页 */
+        nand_cache_invalidate(this, realpage, multi ? multi : 1);
+
+        if(multi)
+        {
+            ret = this->ecc_ctrl.write_multi_page(mtd, page, multi, writebuf, MTD_OOB_RAW);
+            bytes = multi << this->page_shift;
+            realpage += multi - 1;
+        }
         /* 写一页的部分 */
-        if(unlikely(column || (writelen < (mtd->writesize - 1))))
+        else if(unlikely(column || (writelen < (mtd->writesize - 1))))
         {
             bytes = min_t(int32_t, bytes - column, writelen);
 
@@ -1864,12 +3011,14 @@ static int32_t nand_write(__in struct mtd_info *mtd, __in loff_t to, __in size_t
             memcpy(&this->page_databuf[column], writebuf, bytes);
 
             /* 不写oob区，使用RAW模式写data区 */
-            ret = nand_write_page(mtd, this->page_databuf, page, cached, MTD_OOB_RAW);
+            ret = nand_write_page(mtd, this->page_databuf, page, MTD_OOB_RAW);
         }
         else
         {
-            ret = nand_write_page(mtd, writebuf, page, cached, MTD_OOB_RAW);
+            ret = nand_write_page(mtd, writebuf, page, MTD_OOB_RAW);
         }
+        if(ret)
+            break;
 
         writelen -= bytes;
         if(!writelen)
@@ -1878,15 +3027,8 @@ static int32_t nand_write(__in struct mtd_info *mtd, __in loff_t to, __in size_t
         column = 0;
         writebuf += bytes;
 
-        realpage++;
+        realpage = nand_seek_page(mtd, realpage + 1, to + (len - writelen), &chipnr);
         page = realpage & this->page_mask;
-
-        if(!page)
-        {
-            chipnr++;
-            this->select_chip(mtd, -1);
-            this->select_chip(mtd, chipnr);
-        }
     }
 
     *retlen = len - writelen;
@@ -1948,7 +3090,6 @@ static int32_t nand_write_oob(__in struct mtd_info *mtd, __in loff_t to,
 {
     struct nand_chip *this = mtd->priv;
     int32_t page, realpage, chipnr;
-	int32_t blkcheck = (1 << (this->phys_erase_shift - this->page_shift)) - 1;
     int32_t ret = 0;
     int32_t ooblen_per_page;
     size_t writelen = ops->len;
@@ -1983,12 +3124,12 @@ static int32_t nand_write_oob(__in struct mtd_info *mtd, __in loff_t to,
 
 
 
-    chipnr = (int32_t)(to >> this->chip_shift);
-    this->select_chip(mtd, chipnr);
-
-    realpage = (int32_t)(to >> this->page_shift);
+    realpage = nand_phys_page(this, to);
     page = realpage & this->page_mask;
 
+    chipnr = realpage >> (this->chip_shift - this->page_shift);
+    this->select_chip(mtd, chipnr);
+
     //this->cmdfunc(this, NAND_CMD_RESET, -1, -1);
     /* 检测wp位 */
     if(nand_check_wp(mtd))
@@ -2012,9 +3153,8 @@ static int32_t nand_write_oob(__in struct mtd_info *mtd, __in loff_t to,
             return -EINVAL;
         }
 
-        /* 检测当前cache的页 */
-        if(realpage == this->pagebuf)
-            this->pagebuf = -1;
+        /* 失效页缓存中的当前页 */
+        nand_cache_invalidate(this, realpage, 1);
 
         memset(this->oob_poi, 0xff, mtd->oobsize);
         nand_fill_oob(this, oobwritebuf, ops);
@@ -2027,7 +3167,6 @@ static int32_t nand_write_oob(__in struct mtd_info *mtd, __in loff_t to,
     else
     {
         /* 写入oob+data区 */
-        int32_t cached;
         int32_t column;
 
 
@@ -2040,19 +3179,16 @@ static int32_t nand_write_oob(__in struct mtd_info *mtd, __in loff_t to,
 
         column = to & (mtd->writesize - 1);
 
-        /* 当要写的页的范围包含cache的页时，失效cache的页 */
-        if((to <= (this->pagebuf << this->page_shift)) &&
-            ((this->pagebuf << this->page_shift) < (to + writelen)))
-            this->pagebuf = -1;
-
 
         while(1)
         {
             bytes = mtd->writesize;
-            cached = (writelen > bytes && page != blkcheck);
             /* 填充oob区 */
             oobwritebuf = nand_fill_oob(this, oobwritebuf, ops);
 
+            /* 失效页缓存中将要写入的页 */
+            nand_cache_invalidate(this, realpage, 1);
+
             /* 写一页的部分 */
             if(unlikely(column || (writelen < (mtd->writesize - 1))))
             {
@@ -2062,12 +3198,13 @@ static int32_t nand_write_oob(__in struct mtd_info *mtd, __in loff_t to,
                 memset(this->page_databuf, 0xff, mtd->writesize);
                 memcpy(&this->page_databuf[column], writebuf, bytes);
 
-                /* 使用RAW模式写oob+data区 */
-                ret = nand_write_page(mtd, this->page_databuf, page, cached, MTD_OOB_RAW);
+                /* MTD_OOB_RAW模式不经过ecc写oob+data区 */
+                ret = nand_write_page(mtd, this->page_databuf, page,
+                                      ops->mode == MTD_OOB_RAW);
             }
             else
             {
-                ret = nand_write_page(mtd, writebuf, page, cached, MTD_OOB_RAW);
+                ret = nand_write_page(mtd, writebuf, page, ops->mode == MTD_OOB_RAW);
             }
             if(ret)
                 break;
@@ -2079,15 +3216,8 @@ static int32_t nand_write_oob(__in struct mtd_info *mtd, __in loff_t to,
             column = 0;
             writebuf += bytes;
 
-            realpage++;
+            realpage = nand_seek_page(mtd, realpage + 1, to + (ops->len - writelen), &chipnr);
             page = realpage & this->page_mask;
-
-            if(!page)
-            {
-                chipnr++;
-                this->select_chip(mtd, -1);
-                this->select_chip(mtd, chipnr);
-            }
         }
 
         ops->retlen = ops->len - writelen;
@@ -2102,91 +3232,790 @@ out:
 
 
 /********************************************************************************
-* 函数: static void nand_sync(__in struct mtd_info *mtd)
-* 描述: 同步nandflash设备
+* 函数: static int32_t nand_read(__in struct mtd_info *mtd, __in loff_t from,
+                                __in size_t len, __out size_t *retlen,
+                                __out uint8_t *buf)
+* 描述: 读取nandflash经过ecc校验的数据，提交异步读请求并等待完成
+* 输入: mtd: nandflash设备父类
+       from: 读取的起始地址
+       len: 需要读取的长度
+* 输出: retlen: 成功读取的长度
+       buf: 经过ecc校验的数据
+* 返回: 0: 成功且数据没有错误产生
+       -EINVAL: 输入参数无效
+       -EBADMSG: 出现坏块
+       -EUCLEAN: 数据读取成功，错误位被纠正
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_read(__in struct mtd_info *mtd, __in loff_t from, __in size_t len,
+                          __out size_t *retlen, __out uint8_t *buf)
+{
+    struct mtd_request req;
+    int32_t ret;
+
+    memset(&req, 0, sizeof(req));
+    req.type = MTD_REQ_READ;
+    req.addr = from;
+    req.len = len;
+    req.buf = buf;
+
+    ret = nand_submit_wait(mtd, &req);
+    *retlen = req.retlen;
+
+    return ret;
+}
+
+/********************************************************************************
+* 函数: static int32_t nand_write(__in struct mtd_info *mtd, __in loff_t to,
+                                 __in size_t len, __out size_t *retlen,
+                                 __in const uint8_t *buf)
+* 描述: 写入nandflash数据，提交异步写请求并等待完成
+* 输入: mtd: nandflash设备父类
+       to: 写入的起始地址
+       len: 需要写入的长度
+       buf: 需要写入的数据，不包含oob区
+* 输出: retlen: 成功写入的长度
+* 返回: 0: 写入成功
+       -EINVAL: 输入参数无效
+       -EIO: 写入失败
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_write(__in struct mtd_info *mtd, __in loff_t to, __in size_t len,
+                            __out size_t *retlen, __in const uint8_t *buf)
+{
+    struct mtd_request req;
+    int32_t ret;
+
+    memset(&req, 0, sizeof(req));
+    req.type = MTD_REQ_WRITE;
+    req.addr = to;
+    req.len = len;
+    req.buf = (uint8_t *)buf;
+
+    ret = nand_submit_wait(mtd, &req);
+    *retlen = req.retlen;
+
+    return ret;
+}
+
+/********************************************************************************
+* 函数: static int32_t nand_read_oob(__in struct mtd_info *mtd,
+                                    __in loff_t from,
+                                    __inout struct mtd_oob_ops *ops)
+* 描述: 根据ops选项读取oob或者oob+data在一起的数据，提交异步请求并等待完成
+* 输入: mtd: nandflash设备父类
+       from: 数据起始地址
+       ops: 数据读取参数
+* 输出: ops: 读取完毕的数据和参数
+* 返回: 0: 成功且数据没有错误产生
+       -EINVAL: 输入参数无效
+       -EBADMSG: 出现坏块
+       -EUCLEAN: 数据读取成功，错误位被纠正
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_read_oob(__in struct mtd_info *mtd, __in loff_t from,
+                               __inout struct mtd_oob_ops *ops)
+{
+    struct mtd_request req;
+
+    memset(&req, 0, sizeof(req));
+    req.type = MTD_REQ_READ_OOB;
+    req.addr = from;
+    req.ops = ops;
+
+    return nand_submit_wait(mtd, &req);
+}
+
+/********************************************************************************
+* 函数: static int32_t nand_req_finish_chain(__in struct mtd_info *mtd,
+                                            __in int32_t wait)
+* 描述: 收集队首读请求正在执行的dma链，出错时记录在req_error中
 * 输入: mtd: nandflash设备父类
+       wait: 0: dma链还在执行时立即返回 1: 等待dma链执行完毕
 * 输出: none
-* 返回: none
+* 返回: 0: 成功
+       -EBUSY: dma链还在执行
+       <0: 读取失败
 * 作者:
 * 版本: v1.0
 **********************************************************************************/
-static void nand_sync(__in struct mtd_info *mtd)
+static int32_t nand_req_finish_chain(__in struct mtd_info *mtd, __in int32_t wait)
 {
-    nand_get_device(mtd, FL_SYNCING);
+    struct nand_chip *this = mtd->priv;
+    int32_t ret;
+
+    ret = this->ecc_ctrl.read_multi_finish(mtd, wait);
+    if(ret == -EBUSY)
+        return ret;
 
+    if((ret < 0) && (ret != -EBADMSG))
+        this->req_error = ret;
+    else
+        this->req_head->retlen += this->req_chain << this->page_shift;
+
+    this->req_chain = 0;
     nand_release_device(mtd);
+
+    return ret;
 }
 
+/********************************************************************************
+* 函数: static int32_t nand_req_finish_prog(__in struct mtd_info *mtd,
+                                           __in int32_t wait)
+* 描述: 收集队首写请求正在编程的页，出错时记录在req_error中
+* 输入: mtd: nandflash设备父类
+       wait: 0: 传输或者编程还在进行时立即返回 1: 等待完成
+* 输出: none
+* 返回: 0: 成功
+       -EBUSY: 传输或者编程还在进行
+       <0: 写入失败
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_req_finish_prog(__in struct mtd_info *mtd, __in int32_t wait)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t ret;
 
-/*-------------------------------------------------------------------------------------------
------------------------------------------坏块判断处理------------------------------------------
---------------------------------------------------------------------------------------------*/
+    ret = this->ecc_ctrl.write_page_finish(mtd, wait);
+    if(ret == -EBUSY)
+        return ret;
+
+    if(ret < 0)
+        this->req_error = ret;
+    else
+        this->req_head->retlen += this->req_prog << this->page_shift;
+
+    this->req_prog = 0;
+    nand_release_device(mtd);
+
+    return ret;
+}
 
 /********************************************************************************
-* 函数: static int32_t nand_block_bad(__in struct mtd_info *mtd,
-                                     __in loff_t ofs,
-                                     __in int32_t getchip)
-* 描述: 检测块是否是坏块
+* 函数: static void nand_req_quiesce(__in struct mtd_info *mtd)
+* 描述: 等待异步请求在硬件上进行的dma链、页编程或者擦除完成，同步操作使用芯片之前
+       调用. 擦除只等待每个芯片上已经开始的一块，不开始新的擦除. 结果和请求剩下的
+       部分留给nand_poll处理
 * 输入: mtd: nandflash设备父类
-       ofs: 块地址
-       getchip: 0: 芯片已经被选中
-                1: 需要选取芯片
 * 输出: none
-* 返回: 0: 块正常
-       1: 块是坏块
+* 返回: none
 * 作者:
 * 版本: v1.0
 **********************************************************************************/
-static int32_t nand_block_bad(__in struct mtd_info *mtd, __in loff_t ofs,
-                                __in int32_t getchip)
+static void nand_req_quiesce(__in struct mtd_info *mtd)
+{
+    struct nand_chip *this = mtd->priv;
+
+    if(this->req_chain)
+        nand_req_finish_chain(mtd, 1);
+
+    if(this->req_prog)
+        nand_req_finish_prog(mtd, 1);
+
+    if(this->req_erase.active)
+        while(this->req_erase.busy)
+            nand_erase_step(mtd, &this->req_erase, 0);
+}
+
+/********************************************************************************
+* 函数: static int32_t nand_req_read(__in struct mtd_info *mtd,
+                                    __inout struct mtd_request *req)
+* 描述: 推进读请求. 页对齐的整页交给dma链在硬件上读取，dma链执行期间立即返回，
+       下一次轮询收集结果并开始下一条链. 不对齐的页首和不能直接dma的部分同步读取
+* 输入: mtd: nandflash设备父类
+       req: 队首的读请求
+* 输出: req: 完成的长度
+* 返回: -EINPROGRESS: 还没有完成
+       其他: 同nand_read
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_req_read(__in struct mtd_info *mtd, __inout struct mtd_request *req)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t blkmask = (1 << (this->phys_erase_shift - this->page_shift)) - 1;
+    int32_t realpage, page, count, ret;
+    size_t size, done = 0;
+    loff_t from;
+
+    if(this->req_chain && (nand_req_finish_chain(mtd, 0) == -EBUSY))
+        return -EINPROGRESS;
+
+    if(this->req_error)
+        return this->req_error;
+
+    if(req->retlen < req->len)
+    {
+        from = req->addr + req->retlen;
+        size = req->len - req->retlen;
+
+        /* 不使用条带时一条dma链读取一块内连续的整页 */
+        if(this->ecc_ctrl.read_multi_start && (this->stripe_chips <= 1) &&
+           !(from & (mtd->writesize - 1)) && (size >= mtd->writesize))
+        {
+            realpage = nand_phys_page(this, from);
+            page = realpage & this->page_mask;
+            count = min_t(int32_t, size >> this->page_shift, (blkmask + 1) - (page & blkmask));
+
+            nand_get_device(mtd, FL_READING);
+            this->select_chip(mtd, realpage >> (this->chip_shift - this->page_shift));
+
+            ret = this->ecc_ctrl.read_multi_start(mtd, page, count, req->buf + req->retlen);
+            if(ret > 0)
+            {
+                this->req_chain = ret;
+                return -EINPROGRESS;
+            }
+
+            nand_release_device(mtd);
+            if(ret < 0)
+                return ret;
+        }
+
+        /* 不对齐的页首只读到页边界，之后的整页再交给dma链 */
+        if(from & (mtd->writesize - 1))
+            size = min_t(size_t, size, mtd->writesize - (from & (mtd->writesize - 1)));
+
+        ret = nand_do_read(mtd, from, size, &done, req->buf + req->retlen);
+        req->retlen += done;
+        if((ret < 0) && (ret != -EUCLEAN) && (ret != -EBADMSG))
+            return ret;
+
+        if(req->retlen < req->len)
+            return -EINPROGRESS;
+    }
+
+    /* 按整个请求期间的ecc统计计算返回值 */
+    if(mtd->ecc_stats.failed - this->req_stats.failed)
+        return -EBADMSG;
+    else if(mtd->ecc_stats.corrected - this->req_stats.corrected)
+        return -EUCLEAN;
+
+    return 0;
+}
+
+/********************************************************************************
+* 函数: static int32_t nand_req_write(__in struct mtd_info *mtd,
+                                     __inout struct mtd_request *req)
+* 描述: 推进写请求. 整页交给write_page_start在硬件上传输和编程，编程期间立即
+       返回，下一次轮询收集结果并开始下一页. 两个plane上的一对块使用多plane编程
+       同步写入，不对齐的部分和驱动不能异步编程时同步写到下一个两块边界
+* 输入: mtd: nandflash设备父类
+       req: 队首的写请求
+* 输出: req: 完成的长度
+* 返回: -EINPROGRESS: 还没有完成
+       其他: 同nand_write
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_req_write(__in struct mtd_info *mtd, __inout struct mtd_request *req)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t blkmask = (1 << (this->phys_erase_shift - this->page_shift)) - 1;
+    loff_t span = (loff_t)2 << this->phys_erase_shift;
+    loff_t to;
+    size_t size, done = 0;
+    int32_t realpage, ret;
+
+    if(this->req_prog && (nand_req_finish_prog(mtd, 0) == -EBUSY))
+        return -EINPROGRESS;
+
+    if(this->req_error)
+        return this->req_error;
+
+    to = req->addr + req->retlen;
+    size = req->len - req->retlen;
+    if(!size)
+        return 0;
+
+    /* 页对齐的整页，不是多plane块对的起始时异步编程 */
+    if(this->ecc_ctrl.write_page_start && !(to & (mtd->writesize - 1)) &&
+       (size >= mtd->writesize))
+    {
+        realpage = nand_phys_page(this, to);
+
+        if((realpage & blkmask) || (size < span) || !nand_plane_pair(this, to))
+        {
+            nand_get_device(mtd, FL_WRITING);
+            this->select_chip(mtd, realpage >> (this->chip_shift - this->page_shift));
+
+            memset(this->oob_poi, 0xff, mtd->oobsize);
+            nand_cache_invalidate(this, realpage, 1);
+
+            if(this->ecc_ctrl.write_page_start(mtd, realpage & this->page_mask,
+                                               req->buf + req->retlen, MTD_OOB_RAW))
+            {
+                this->req_prog = 1;
+                return -EINPROGRESS;
+            }
+
+            nand_release_device(mtd);
+        }
+    }
+
+    size = min_t(uint64_t, size, span - (to & (span - 1)));
+
+    ret = nand_do_write(mtd, to, size, &done, req->buf + req->retlen);
+    req->retlen += done;
+    if(ret)
+        return ret;
+
+    return (req->retlen < req->len) ? -EINPROGRESS : 0;
+}
+
+/********************************************************************************
+* 函数: static int32_t nand_req_erase(__in struct mtd_info *mtd,
+                                     __inout struct mtd_request *req)
+* 描述: 推进擦除请求. 第一次开始擦除，之后每次轮询收集完成的芯片并开始下一块，
+       不等待芯片擦除完成
+* 输入: mtd: nandflash设备父类
+       req: 队首的擦除请求
+* 输出: none
+* 返回: -EINPROGRESS: 还没有完成
+       其他: 同nand_erase
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_req_erase(__in struct mtd_info *mtd, __inout struct mtd_request *req)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t ret;
+
+    if(!this->req_erase.active)
+    {
+        ret = nand_erase_begin(mtd, req->instr, 0, &this->req_erase);
+        return ret ? ret : -EINPROGRESS;
+    }
+
+    if(!nand_erase_step(mtd, &this->req_erase, 1))
+        return -EINPROGRESS;
+
+    return nand_erase_end(mtd, &this->req_erase);
+}
+
+/********************************************************************************
+* 函数: static int32_t nand_req_exec(__in struct mtd_info *mtd,
+                                    __inout struct mtd_request *req)
+* 描述: 同步执行请求，用于处理队首请求期间驱动内部的同步调用(例如更新bbt)
+* 输入: mtd: nandflash设备父类
+       req: 请求
+* 输出: req: 完成的长度
+* 返回: 同步接口的返回值
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_req_exec(__in struct mtd_info *mtd, __inout struct mtd_request *req)
+{
+    int32_t ret;
+
+    switch(req->type)
+    {
+    case MTD_REQ_READ:
+        return nand_do_read(mtd, req->addr, req->len, &req->retlen, req->buf);
+
+    case MTD_REQ_WRITE:
+        return nand_do_write(mtd, req->addr, req->len, &req->retlen, req->buf);
+
+    case MTD_REQ_READ_OOB:
+        ret = nand_do_read_oob(mtd, req->addr, req->ops);
+        req->retlen = req->ops->retlen;
+        return ret;
+
+    default:
+        return nand_erase_nand(mtd, req->instr, 0);
+    }
+}
+
+/********************************************************************************
+* 函数: static int32_t nand_req_step(__in struct mtd_info *mtd,
+                                    __inout struct mtd_request *req)
+* 描述: 推进队首请求一步，硬件操作进行中时立即返回. 多plane块对、不完整的页和
+       READ_OOB请求没有异步的硬件路径，每次同步执行一段，READ_OOB一次执行完
+* 输入: mtd: nandflash设备父类
+       req: 队首请求
+* 输出: req: 完成的长度
+* 返回: -EINPROGRESS: 还没有完成
+       其他: 请求的结果
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_req_step(__in struct mtd_info *mtd, __inout struct mtd_request *req)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t ret;
+
+    this->req_running = 1;
+
+    switch(req->type)
+    {
+    case MTD_REQ_READ:
+        ret = nand_req_read(mtd, req);
+        break;
+
+    case MTD_REQ_WRITE:
+        ret = nand_req_write(mtd, req);
+        break;
+
+    case MTD_REQ_READ_OOB:
+        ret = nand_do_read_oob(mtd, req->addr, req->ops);
+        req->retlen = req->ops->retlen;
+        break;
+
+    default:
+        ret = nand_req_erase(mtd, req);
+        break;
+    }
+
+    this->req_running = 0;
+
+    return ret;
+}
+
+/********************************************************************************
+* 函数: static int32_t nand_poll(__in struct mtd_info *mtd)
+* 描述: 推进请求队列，不等待硬件. 队首请求完成之后出队并调用完成回调，然后继续
+       处理下一个请求，直到有硬件操作在进行或者执行了一段同步操作
+* 输入: mtd: nandflash设备父类
+* 输出: none
+* 返回: 还没有完成的请求数
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_poll(__in struct mtd_info *mtd)
+{
+    struct nand_chip *this = mtd->priv;
+    struct mtd_request *req;
+    int32_t ret, count = 0;
+
+    while((req = this->req_head) != NULL)
+    {
+        if(!this->req_active)
+        {
+            this->req_active = 1;
+            this->req_error = 0;
+            this->req_stats = mtd->ecc_stats;
+        }
+
+        ret = nand_req_step(mtd, req);
+        if(ret == -EINPROGRESS)
+            break;
+
+        /* 先出队再完成，完成回调中可以提交新的请求 */
+        this->req_head = req->next;
+        if(!this->req_head)
+            this->req_tail = NULL;
+        this->req_active = 0;
+
+        mtd_request_done(req, ret);
+    }
+
+    for(req = this->req_head; req; req = req->next)
+        count++;
+
+    return count;
+}
+
+/********************************************************************************
+* 函数: static int32_t nand_submit(__in struct mtd_info *mtd,
+                                  __inout struct mtd_request *req)
+* 描述: 提交异步请求. 请求按提交顺序处理，队列原来为空时立即开始处理，dma链和
+       擦除在返回之后继续在硬件上执行
+* 输入: mtd: nandflash设备父类
+       req: 请求
+* 输出: none
+* 返回: 0: 请求已经接受
+       -EINVAL: 参数无效
+       -EBUSY: 在处理队首请求的过程中(驱动内部)提交
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_submit(__in struct mtd_info *mtd, __inout struct mtd_request *req)
+{
+    struct nand_chip *this = mtd->priv;
+
+    switch(req->type)
+    {
+    case MTD_REQ_READ:
+    case MTD_REQ_WRITE:
+        if((req->addr + req->len) > mtd->size)
+            return -EINVAL;
+        break;
+
+    case MTD_REQ_READ_OOB:
+        if(!req->ops)
+            return -EINVAL;
+        break;
+
+    case MTD_REQ_ERASE:
+        if(!req->instr)
+            return -EINVAL;
+        break;
+
+    default:
+        return -EINVAL;
+    }
+
+    /* 处理队首请求期间不能提交，驱动内部的同步调用由nand_submit_wait直接执行 */
+    if(this->req_running)
+        return -EBUSY;
+
+    req->next = NULL;
+    if(this->req_tail)
+        this->req_tail->next = req;
+    else
+        this->req_head = req;
+    this->req_tail = req;
+
+    if(this->req_head == req)
+        nand_poll(mtd);
+
+    return 0;
+}
+
+
+/********************************************************************************
+* 函数: static int32_t nand_submit_wait(__in struct mtd_info *mtd,
+                                       __inout struct mtd_request *req)
+* 描述: 同步接口使用的提交并等待. 处理队首请求期间驱动内部的同步调用(例如擦除
+       失败时更新bbt)不经过队列，直接同步执行
+* 输入: mtd: nandflash设备父类
+       req: 请求
+* 输出: req: 完成的长度
+* 返回: 请求的结果
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_submit_wait(__in struct mtd_info *mtd, __inout struct mtd_request *req)
+{
+    struct nand_chip *this = mtd->priv;
+
+    if(this->req_running)
+        return nand_req_exec(mtd, req);
+
+    return mtd_submit_wait(mtd, req);
+}
+
+
+/********************************************************************************
+* 函数: static void nand_sync(__in struct mtd_info *mtd)
+* 描述: 同步nandflash设备
+* 输入: mtd: nandflash设备父类
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void nand_sync(__in struct mtd_info *mtd)
+{
+    nand_get_device(mtd, FL_SYNCING);
+
+    nand_release_device(mtd);
+}
+
+
+/*-------------------------------------------------------------------------------------------
+-----------------------------------------坏块判断处理------------------------------------------
+--------------------------------------------------------------------------------------------*/
+
+/********************************************************************************
+* 函数: static int32_t nand_block_bad(__in struct mtd_info *mtd,
+                                     __in loff_t ofs,
+                                     __in int32_t getchip)
+* 描述: 检测块是否是坏块
+* 输入: mtd: nandflash设备父类
+       ofs: 块地址
+       getchip: 0: 芯片已经被选中
+                1: 需要选取芯片
+* 输出: none
+* 返回: 0: 块正常
+       1: 块是坏块
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_block_bad(__in struct mtd_info *mtd, __in loff_t ofs,
+                                __in int32_t getchip)
 {
     int32_t page = 0, chipnr = 0, res = 0;
     uint16_t bad = 0;
     struct nand_chip *this = mtd->priv;
 
-    page = (int32_t)(ofs >> this->page_shift) & (this->page_mask);
+    page = nand_phys_page(this, ofs);
+    chipnr = page >> (this->chip_shift - this->page_shift);
+    page &= this->page_mask;
+
+    /* 选取nand设备 */
+    if(getchip)
+    {
+        /* 需要选取芯片 */
+        /* 设置芯片状态 */
+        nand_get_device(mtd, FL_READING);
+
+        /* 选择芯片 */
+        this->select_chip(mtd, chipnr);
+    }
+
+    if(this->options & NAND_BUSWIDTH_16)
+    {
+        /* 坏块标记2字节对齐 */
+        this->cmdfunc(mtd, NAND_CMD_READOOB, this->badblockpos & 0xfe, page);
+        bad = cpu_to_le16(this->read_word(mtd));
+
+        /* 不对齐处理 */
+        if(this->badblockpos & 0x01)
+            bad >>= 8;
+
+        /* 出现坏块 */
+        if((bad & 0xff) != 0xff)
+            res = 1;
+    }
+    else
+    {
+        this->cmdfunc(mtd, NAND_CMD_READOOB, this->badblockpos, page);
+        if(this->read_byte(mtd) != 0xff)
+            res = 1;
+    }
+
+    /* 释放nand设备 */
+    if(getchip)
+        nand_release_device(mtd);
+
+
+    return res;
+
+}
+
+/********************************************************************************
+* 函数: static int32_t nand_read_bbm_std(__in struct mtd_info *mtd,
+                                        __in const int32_t *pages,
+                                        __in int32_t count,
+                                        __in int32_t column,
+                                        __in int32_t len,
+                                        __out uint8_t *buf)
+* 描述: 默认的批量读取坏块标记，每页只读取oob区中标记所在的字节
+* 输入: mtd: nandflash设备父类
+       pages: 每页的芯片内页号，芯片已经选中
+       count: 页数
+       column: 标记在oob区中的偏移
+       len: 标记长度
+* 输出: buf: 标记输出缓冲区，每页len字节
+* 返回: 0: 成功
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_read_bbm_std(__in struct mtd_info *mtd, __in const int32_t *pages,
+                                   __in int32_t count, __in int32_t column,
+                                   __in int32_t len, __out uint8_t *buf)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t i;
+
+    for(i = 0; i < count; i++)
+    {
+        if(this->options & NAND_BUSWIDTH_16)
+        {
+            /* 16位总线列地址需要对齐，读取整个oob区 */
+            this->ecc_ctrl.read_oob(mtd, pages[i], 1);
+            memcpy(buf, this->oob_poi + column, len);
+        }
+        else
+        {
+            this->cmdfunc(mtd, NAND_CMD_READOOB, column, pages[i]);
+            this->read_buf(mtd, buf, len);
+        }
+
+        buf += len;
+    }
+
+    return 0;
+}
+
+/********************************************************************************
+* 函数: int32_t nand_read_bbm(__in struct mtd_info *mtd, __in loff_t from,
+                             __in int32_t numblocks, __in int32_t numpages,
+                             __in int32_t column, __in int32_t len,
+                             __out uint8_t *buf)
+* 描述: 批量读取连续多块前numpages页oob区中的坏块标记，用于建立bbt. 每批最多
+       NAND_BBM_BATCH块，按芯片分组后交给read_bbm一次读取，驱动可以把一组页
+       放到一条dma链中执行
+* 输入: mtd: nandflash设备父类
+       from: 起始块地址
+       numblocks: 块数
+       numpages: 每块读取的页数，1或2
+       column: 标记在oob区中的偏移
+       len: 标记长度，不超过NAND_BBM_MAX_LEN
+* 输出: buf: 标记输出缓冲区，按块和页顺序排列，每页len字节
+* 返回: 0: 成功
+       -EINVAL: 参数无效
+       <0: 驱动读取失败
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+int32_t nand_read_bbm(__in struct mtd_info *mtd, __in loff_t from, __in int32_t numblocks,
+                      __in int32_t numpages, __in int32_t column, __in int32_t len,
+                      __out uint8_t *buf)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t pages[NAND_BBM_BATCH * 2];
+    int32_t idx[NAND_BBM_BATCH * 2];
+    uint8_t tmp[NAND_BBM_BATCH * 2 * NAND_BBM_MAX_LEN];
+    int32_t realpage, chipnr, num, count, i, j;
+    int32_t ret = 0;
+
+    if((numpages < 1) || (numpages > 2) || (len < 1) || (len > NAND_BBM_MAX_LEN) ||
+       ((column + len) > mtd->oobsize) ||
+       ((from + ((loff_t)numblocks << this->phys_erase_shift)) > mtd->size))
+        return -EINVAL;
 
-    /* 选取nand设备 */
-    if(getchip)
-    {
-        /* 需要选取芯片 */
-        chipnr = (int32_t)(ofs >> this->chip_shift);
+    nand_get_device(mtd, FL_READING);
 
-        /* 设置芯片状态 */
-        nand_get_device(mtd, FL_READING);
+    while(numblocks > 0)
+    {
+        num = min_t(int32_t, numblocks, NAND_BBM_BATCH);
 
-        /* 选择芯片 */
-        this->select_chip(mtd, chipnr);
-    }
+        /* 使用条带时同一批的块分布在多个芯片上，每个芯片读取一次 */
+        for(chipnr = 0; chipnr < this->numchips; chipnr++)
+        {
+            count = 0;
+            for(i = 0; i < num; i++)
+            {
+                realpage = nand_phys_page(this, from + ((loff_t)i << this->phys_erase_shift));
+                if((realpage >> (this->chip_shift - this->page_shift)) != chipnr)
+                    continue;
 
-    if(this->options & NAND_BUSWIDTH_16)
-    {
-        /* 坏块标记2字节对齐 */
-        this->cmdfunc(mtd, NAND_CMD_READOOB, this->badblockpos & 0xfe, page);
-        bad = cpu_to_le16(this->read_word(mtd));
+                for(j = 0; j < numpages; j++)
+                {
+                    pages[count] = (realpage & this->page_mask) + j;
+                    idx[count] = i * numpages + j;
+                    count++;
+                }
+            }
 
-        /* 不对齐处理 */
-        if(this->badblockpos & 0x01)
-            bad >>= 8;
+            if(!count)
+                continue;
 
-        /* 出现坏块 */
-        if((bad & 0xff) != 0xff)
-            res = 1;
-    }
-    else
-    {
-        this->cmdfunc(mtd, NAND_CMD_READOOB, this->badblockpos, page);
-        if(this->read_byte(mtd) != 0xff)
-            res = 1;
-    }
+            this->select_chip(mtd, chipnr);
+            ret = this->read_bbm(mtd, pages, count, column, len, tmp);
+            this->select_chip(mtd, -1);
+            if(ret)
+                goto out;
 
-    /* 释放nand设备 */
-    if(getchip)
-        nand_release_device(mtd);
+            for(i = 0; i < count; i++)
+                memcpy(buf + idx[i] * len, tmp + i * len, len);
+        }
 
+        buf += num * numpages * len;
+        from += (loff_t)num << this->phys_erase_shift;
+        numblocks -= num;
+    }
 
-    return res;
+out:
+    nand_release_device(mtd);
 
+    return ret;
 }
 
 
@@ -2256,7 +4085,10 @@ static int32_t nand_default_block_markbad(__in struct mtd_info *mtd, __in loff_t
     //标记坏块
     block = (int32_t)(ofs >> this->bbt_erase_shift);
     if(this->bbt)
+    {
         this->bbt[block >> 2] |= 1 << ((block & 0x03) << 1);
+        this->bbt_index_valid = 0;
+    }
 
     if(this->options & NAND_USE_FLASH_BBT)
         ret = nand_update_bbt(mtd, ofs);
@@ -2331,6 +4163,117 @@ static int32_t nand_block_markbad(__in struct mtd_info *mtd, __in loff_t offs)
 
     return this->block_markbad(mtd, offs);
 }
+
+/********************************************************************************
+* 函数: static int32_t nand_block_nextgood(__in struct mtd_info *mtd,
+                                          __in loff_t offs,
+                                          __out loff_t *good)
+* 描述: 查找offs所在块或者之后的第一个好块，有bbt时按字扫描bbt
+* 输入: mtd: nandflash设备父类
+       offs: 起始地址
+* 输出: good: 好块起始地址
+* 返回: 0: 找到好块
+       -EINVAL: 参数无效
+       -ENOSPC: 之后没有好块
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_block_nextgood(__in struct mtd_info *mtd, __in loff_t offs,
+                                     __out loff_t *good)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t ret;
+
+    if((offs < 0) || (offs >= mtd->size))
+        return -EINVAL;
+
+    offs &= ~((loff_t)mtd->erasesize - 1);
+
+    /* 第一次检查时建立bbt */
+    ret = nand_block_checkbad(mtd, offs, 1, 0);
+    if(ret < 0)
+        return ret;
+
+    if(!ret)
+    {
+        *good = offs;
+        return 0;
+    }
+
+    if(this->bbt)
+    {
+        if(offs + mtd->erasesize >= mtd->size)
+            return -ENOSPC;
+
+        return nand_bbt_next_good(mtd, offs + mtd->erasesize, good);
+    }
+
+    /* 没有bbt，逐块检查 */
+    for(offs += mtd->erasesize; offs < mtd->size; offs += mtd->erasesize)
+    {
+        if(!this->block_bad(mtd, offs, 1))
+        {
+            *good = offs;
+            return 0;
+        }
+    }
+
+    return -ENOSPC;
+}
+
+/********************************************************************************
+* 函数: static int32_t nand_block_skipbad(__in struct mtd_info *mtd,
+                                         __in loff_t from, __in loff_t offs,
+                                         __out loff_t *phys)
+* 描述: 从from所在块开始跳过坏块，计算逻辑偏移offs对应的物理地址
+* 输入: mtd: nandflash设备父类
+       from: 起始地址
+       offs: 跳过坏块后的逻辑偏移
+* 输出: phys: 物理地址
+* 返回: 0: 成功
+       -EINVAL: 参数无效
+       -ENOSPC: 好块不够
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_block_skipbad(__in struct mtd_info *mtd, __in loff_t from,
+                                    __in loff_t offs, __out loff_t *phys)
+{
+    struct nand_chip *this = mtd->priv;
+    loff_t skip;
+    int32_t ret;
+
+    if((from < 0) || (from >= mtd->size) || (offs < 0))
+        return -EINVAL;
+
+    from &= ~((loff_t)mtd->erasesize - 1);
+
+    /* 第一次检查时建立bbt */
+    ret = nand_block_checkbad(mtd, from, 1, 0);
+    if(ret < 0)
+        return ret;
+
+    if(this->bbt)
+        return nand_bbt_skip_bad(mtd, from, offs, phys);
+
+    /* 没有bbt，逐块跳过 */
+    skip = offs & ~((loff_t)mtd->erasesize - 1);
+    for(; from < mtd->size; from += mtd->erasesize)
+    {
+        if(this->block_bad(mtd, from, 1))
+            continue;
+
+        if(!skip)
+        {
+            *phys = from + (offs & (mtd->erasesize - 1));
+            return 0;
+        }
+
+        skip -= mtd->erasesize;
+    }
+
+    return -ENOSPC;
+}
 /*-------------------------------------------------------------------------------------------
 --------------------------------------坏块判断处理(end)----------------------------------------
 --------------------------------------------------------------------------------------------*/
@@ -2404,6 +4347,8 @@ static void nand_set_defaults(__in struct nand_chip *this, __in int32_t busw)
 		this->block_bad = nand_block_bad;
 	if(!this->block_markbad)
 		this->block_markbad = nand_default_block_markbad;
+	if(!this->read_bbm)
+		this->read_bbm = nand_read_bbm_std;
 	if(!this->write_buf)
 		this->write_buf = busw ? nand_write_buf16 : nand_write_buf;
 	if(!this->read_buf)
@@ -2414,6 +4359,285 @@ static void nand_set_defaults(__in struct nand_chip *this, __in int32_t busw)
 		this->scan_bbt = nand_default_bbt;
 }
 
+/* 参数页中的16/32位小端数据 */
+#define PARAM_GET_LE16(p, ofs)       ((uint32_t)(p)[ofs] | ((uint32_t)(p)[(ofs) + 1] << 8))
+#define PARAM_GET_LE32(p, ofs)       (PARAM_GET_LE16(p, ofs) | (PARAM_GET_LE16(p, (ofs) + 2) << 16))
+
+/* ONFI和JEDEC参数页前面部分的公共布局 */
+#define PARAM_REVISION               4
+#define PARAM_FEATURES               6
+#define PARAM_OPT_CMD                8
+#define PARAM_MODEL                  44
+#define PARAM_MODEL_LEN              20
+#define PARAM_BYTE_PER_PAGE          80
+#define PARAM_SPARE_PER_PAGE         84
+#define PARAM_PAGES_PER_BLOCK        92
+#define PARAM_BLOCKS_PER_LUN         96
+#define PARAM_LUN_COUNT              100
+#define PARAM_BITS_PER_CELL          102
+
+/* features域 */
+#define PARAM_FEATURE_16_BIT_BUS     (1 << 0)
+#define PARAM_FEATURE_MULTI_PLANE    (1 << 3)
+
+/* opt_cmd域 */
+#define PARAM_OPT_CMD_CACHE_PROG     (1 << 0)
+#define PARAM_OPT_CMD_CACHE_READ     (1 << 1)
+#define PARAM_OPT_CMD_FEATURES       (1 << 2)
+/* 增强的列地址切换(06h-地址-e0h)，ONFI和JEDEC都是bit6 */
+#define PARAM_OPT_CMD_RNDOUT_PLANE   (1 << 6)
+
+/* 参数页至少有3份冗余拷贝 */
+#define PARAM_COPIES                 3
+
+/* crc16初始值 */
+#define PARAM_CRC_BASE               0x4f4e
+
+/* 参数页的差异部分 */
+struct nand_param_layout
+{
+    const int8_t *name;
+    int32_t id_addr; /* READID的地址 */
+    const int8_t *id_sig; /* READID返回的签名 */
+    uint32_t id_sig_len;
+    int32_t param_addr; /* PARAM指令的地址 */
+    const int8_t *sig; /* 参数页签名，4字节 */
+    uint32_t size; /* 参数页大小，最后2字节为crc */
+    uint32_t plane_ofs; /* plane地址位数所在偏移 */
+    uint32_t timing_ofs; /* 支持的异步时序模式位图所在偏移 */
+};
+
+static const struct nand_param_layout nand_param_layouts[] =
+{
+    {"ONFI", 0x20, "ONFI", 4, 0x00, "ONFI", 256, 113, 129},
+    {"JEDEC", 0x40, "JEDEC", 5, 0x40, "JESD", 512, 104, 144},
+};
+
+/*
+   ONFI异步时序模式0~5，JEDEC的异步SDR速度等级与之相同
+   data_setup取tRP/tWP，data_hold取tREH/tWH并保证setup+hold不小于tRC/tWC，
+   address_setup取tALS/tCLS
+*/
+static const struct nand_timing nand_onfi_timings[] =
+{
+    {50, 50, 50, 6, 40, 0, 0},
+    {25, 25, 25, 6, 30, 0, 15},
+    {17, 18, 15, 6, 25, 0, 15},
+    {15, 15, 10, 6, 20, 0, 15},
+    {12, 13, 10, 6, 20, 5, 15},
+    {10, 10, 10, 6, 16, 5, 15},
+};
+
+/* 通过参数页识别出的芯片信息 */
+static struct nand_device_info nand_param_info;
+static int8_t nand_param_model[PARAM_MODEL_LEN + 1];
+
+/********************************************************************************
+* 函数: static uint32_t nand_param_crc16(__in uint32_t crc, __in const uint8_t *p,
+                                         __in uint32_t len)
+* 描述: 计算参数页的crc16，多项式0x8005，高位在前
+* 输入: crc: 初始值
+       p: 数据
+       len: 数据长度
+* 输出: none
+* 返回: crc16
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static uint32_t nand_param_crc16(__in uint32_t crc, __in const uint8_t *p, __in uint32_t len)
+{
+    int32_t i;
+
+    while(len--)
+    {
+        crc ^= *p++ << 8;
+        for(i = 0; i < 8; i++)
+            crc = ((crc << 1) ^ ((crc & 0x8000) ? 0x8005 : 0)) & 0xffff;
+    }
+
+    return crc;
+}
+
+/********************************************************************************
+* 函数: static struct nand_device_info *nand_detect_param_page(
+                                     __in struct mtd_info *mtd, __in const uint8_t *id,
+                                     __in const struct nand_param_layout *layout)
+* 描述: 读取ONFI或JEDEC参数页，校验crc之后生成芯片信息，包括布局，最快的异步
+       时序模式，缓存读/编程和多plane支持
+* 输入: mtd: nandflash设备父类
+       id: 芯片ID
+       layout: 参数页布局
+* 输出: none
+* 返回: 成功: nandflash芯片参数结构体
+       失败: NULL，芯片不支持该参数页或者参数页无效
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static struct nand_device_info *nand_detect_param_page(__in struct mtd_info *mtd,
+                               __in const uint8_t *id, __in const struct nand_param_layout *layout)
+{
+    struct nand_chip *this = mtd->priv;
+    struct nand_device_info *info = &nand_param_info;
+    uint8_t *p = this->page_databuf;
+    uint8_t sig[8];
+    uint32_t copy, features, opt_cmd, modes;
+    uint32_t page, spare, ppb, bpl, luns;
+    int32_t mode, i;
+
+    /* 检查READID返回的签名 */
+    this->cmdfunc(mtd, NAND_CMD_READID, layout->id_addr, -1);
+    this->read_buf(mtd, sig, layout->id_sig_len);
+    if(memcmp(sig, layout->id_sig, layout->id_sig_len))
+        return NULL;
+
+    /* 参数页有多份拷贝连续输出，使用第一份crc正确的 */
+    this->cmdfunc(mtd, NAND_CMD_PARAM, layout->param_addr, -1);
+    for(copy = 0; copy < PARAM_COPIES; copy++)
+    {
+        this->read_buf(mtd, p, layout->size);
+        if(!memcmp(p, layout->sig, 4) &&
+           (nand_param_crc16(PARAM_CRC_BASE, p, layout->size - 2) ==
+            PARAM_GET_LE16(p, layout->size - 2)))
+            break;
+    }
+
+    if(copy >= PARAM_COPIES)
+    {
+        printl(LOG_LEVEL_ERR, "[NAND:ERR] %s parameter page crc error\n", layout->name);
+        return NULL;
+    }
+
+    if(!PARAM_GET_LE16(p, PARAM_REVISION))
+    {
+        printl(LOG_LEVEL_ERR, "[NAND:ERR] unsupported %s version\n", layout->name);
+        return NULL;
+    }
+
+    /* 芯片布局 */
+    page = PARAM_GET_LE32(p, PARAM_BYTE_PER_PAGE);
+    spare = PARAM_GET_LE16(p, PARAM_SPARE_PER_PAGE);
+    ppb = PARAM_GET_LE32(p, PARAM_PAGES_PER_BLOCK);
+    bpl = PARAM_GET_LE32(p, PARAM_BLOCKS_PER_LUN);
+    luns = p[PARAM_LUN_COUNT];
+
+    if(!page || (page & (page - 1)) || (page > NAND_MAX_PAGESIZE) ||
+       (spare > NAND_MAX_OOBSIZE) || !ppb || (ppb & (ppb - 1)) || !bpl || !luns)
+    {
+        printl(LOG_LEVEL_ERR, "[NAND:ERR] invalid %s geometry %u+%u, %u pages per block\n",
+               layout->name, page, spare, ppb);
+        return NULL;
+    }
+
+    /* 总线宽度必须和板级设置一致 */
+    features = PARAM_GET_LE16(p, PARAM_FEATURES);
+    if(!(features & PARAM_FEATURE_16_BIT_BUS) != !(this->options & NAND_BUSWIDTH_16))
+    {
+        printl(LOG_LEVEL_ERR, "[NAND:ERR] %s bus width mismatch, chip is %d bit\n",
+               layout->name, (features & PARAM_FEATURE_16_BIT_BUS) ? 16 : 8);
+        return NULL;
+    }
+
+    memset(info, 0, sizeof(struct nand_device_info));
+    info->end_of_table = false;
+    info->manufacturer_code = id[0];
+    info->device_code = id[1];
+    info->cell_technology = (p[PARAM_BITS_PER_CELL] > 1) ?
+                            NAND_DEVICE_CELL_TECH_MLC : NAND_DEVICE_CELL_TECH_SLC;
+    info->page_data_size_in_bytes = page;
+    info->page_oob_size_in_bytes = spare;
+    info->block_size_in_bytes = page * ppb;
+    info->chip_size_in_bytes = (uint64_t)info->block_size_in_bytes * bpl * luns;
+
+    /* 使用支持的最快异步时序模式 */
+    modes = PARAM_GET_LE16(p, layout->timing_ofs) &
+            ((1 << (sizeof(nand_onfi_timings) / sizeof(nand_onfi_timings[0]))) - 1);
+    mode = modes ? (generic_fls(modes) - 1) : 0;
+    info->timing = nand_onfi_timings[mode];
+
+    /* 支持SET FEATURES时需要把芯片切换到该模式，否则芯片直接工作在该模式 */
+    opt_cmd = PARAM_GET_LE16(p, PARAM_OPT_CMD);
+    info->timing_mode = (opt_cmd & PARAM_OPT_CMD_FEATURES) ? mode : 0;
+
+    info->options = NAND_NO_PADDING | NAND_NO_READRDY | NAND_NO_AUTOINCR;
+    if(opt_cmd & PARAM_OPT_CMD_CACHE_PROG)
+        info->options |= NAND_CACHEPRG;
+    if(opt_cmd & PARAM_OPT_CMD_CACHE_READ)
+        info->options |= NAND_CACHEREAD;
+
+    /* 多plane操作 */
+    if(features & PARAM_FEATURE_MULTI_PLANE)
+        info->planes = 1 << (p[layout->plane_ofs] & 0x0f);
+    else
+        info->planes = 1;
+
+    if(info->planes > 1)
+    {
+        info->options |= NAND_MULTI_PLANE;
+        /* 多plane读需要06h-e0h选择输出的plane，参数页声明支持时才使用 */
+        if(opt_cmd & PARAM_OPT_CMD_RNDOUT_PLANE)
+            info->options |= NAND_MULTI_PLANE_READ;
+    }
+
+    /* 型号，去掉末尾的空格 */
+    memcpy(nand_param_model, p + PARAM_MODEL, PARAM_MODEL_LEN);
+    nand_param_model[PARAM_MODEL_LEN] = 0;
+    for(i = PARAM_MODEL_LEN - 1; (i >= 0) && (nand_param_model[i] == ' '); i--)
+        nand_param_model[i] = 0;
+    info->description = nand_param_model;
+
+    printl(LOG_LEVEL_INFO, "[NAND:INFO] %s parameter page found, timing mode %d\n",
+           layout->name, mode);
+
+    return info;
+}
+
+/********************************************************************************
+* 函数: static int32_t nand_set_timing_mode(__in struct mtd_info *mtd,
+                                           __in int32_t chipnr, __in int32_t mode)
+* 描述: 通过SET FEATURES把芯片切换到指定的异步时序模式，并读回确认
+* 输入: mtd: nandflash设备父类
+       chipnr: 芯片号
+       mode: 时序模式
+* 输出: none
+* 返回: 0: 成功
+       -EIO: 芯片没有切换到该模式
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_set_timing_mode(__in struct mtd_info *mtd, __in int32_t chipnr,
+                                    __in int32_t mode)
+{
+    struct nand_chip *this = mtd->priv;
+    uint8_t feature[4] = {0};
+
+    this->select_chip(mtd, chipnr);
+
+    feature[0] = mode;
+    this->cmdfunc(mtd, NAND_CMD_SET_FEATURES, ONFI_FEATURE_ADDR_TIMING_MODE, -1);
+    this->write_buf(mtd, feature, 4);
+
+    /* 等待tFEAT */
+    ndelay(100);
+    if(this->dev_ready)
+        nand_wait_ready(mtd);
+    else
+        udelay(this->chip_delay);
+
+    /* 读回确认 */
+    memset(feature, 0, 4);
+    this->cmdfunc(mtd, NAND_CMD_GET_FEATURES, ONFI_FEATURE_ADDR_TIMING_MODE, -1);
+    this->read_buf(mtd, feature, 4);
+
+    if((feature[0] & 0x0f) != mode)
+    {
+        printl(LOG_LEVEL_ERR, "[NAND:ERR] chip %d failed to enter timing mode %d\n",
+               chipnr, mode);
+        return -EIO;
+    }
+
+    return 0;
+}
+
 /********************************************************************************
 * 函数: static struct nand_device_info *nand_get_flash_type(__in struct
                                                            mtd_info *mtd)
@@ -2429,8 +4653,10 @@ static struct nand_device_info *nand_get_flash_type(__in struct mtd_info *mtd)
 {
     struct nand_chip *this = mtd->priv;
 	struct nand_device_info *type = NULL;
+	struct nand_device_info *param = NULL;
 	uint8_t id_bytes[2];
 	uint8_t tmp_id_bytes[2];
+	uint32_t i;
 
 	/* 选中设备 */
 	this->select_chip(mtd, 0);
@@ -2461,6 +4687,18 @@ static struct nand_device_info *nand_get_flash_type(__in struct mtd_info *mtd)
 	/* 从内建的表中找到设备的具体信息 */
 	type = nand_device_get_info(id_bytes);
 
+	/* 读取ONFI/JEDEC参数页，表中没有的芯片完全使用参数页的信息 */
+	for(i = 0; !param && (i < sizeof(nand_param_layouts) / sizeof(nand_param_layouts[0])); i++)
+	    param = nand_detect_param_page(mtd, id_bytes, &nand_param_layouts[i]);
+
+	/* 表中的芯片使用表中的布局和时序，布局一致时缓存读和多plane能力取自参数页 */
+	if(type && param && ((type->page_data_size_in_bytes != param->page_data_size_in_bytes) ||
+	                     (type->block_size_in_bytes != param->block_size_in_bytes)))
+	    param = NULL;
+
+	if(!type)
+	    type = param;
+
 	if(!type)
 	{
 	    printl(LOG_LEVEL_ERR, "[NAND:ERR] unkonwn nandflash device %d(%d)\n",
@@ -2475,6 +4713,7 @@ static struct nand_device_info *nand_get_flash_type(__in struct mtd_info *mtd)
     mtd->writesize = type->page_data_size_in_bytes;
     mtd->oobsize = type->page_oob_size_in_bytes;
 
+    this->planes = type->planes ? type->planes : 1;
 
 	/* 计算page_shift */
 	this->page_shift = ffs(mtd->writesize) - 1;
@@ -2495,6 +4734,12 @@ static struct nand_device_info *nand_get_flash_type(__in struct mtd_info *mtd)
 	/* 芯片选项 */
 	this->options &= ~NAND_CHIPOPTIONS_MSK;
 	this->options |= type->options & NAND_CHIPOPTIONS_MSK;
+	if(param && (param != type))
+	{
+	    this->options |= param->options & (NAND_CACHEREAD | NAND_MULTI_PLANE | NAND_MULTI_PLANE_READ);
+	    if(param->planes > this->planes)
+	        this->planes = param->planes;
+	}
 
 	/* 默认不支持NAND_NO_AUTOINCR，板级可以修改 */
 	this->options |= NAND_NO_AUTOINCR;
@@ -2525,7 +4770,7 @@ static struct nand_device_info *nand_get_flash_type(__in struct mtd_info *mtd)
 **********************************************************************************/
 int32_t nand_scan_ident(__in struct mtd_info *mtd, __in int32_t maxchips)
 {
-	int32_t i, busw;
+	int32_t i, j, busw;
 	struct nand_chip *this = mtd->priv;
     struct nand_device_info *type = NULL;
 
@@ -2562,6 +4807,21 @@ int32_t nand_scan_ident(__in struct mtd_info *mtd, __in int32_t maxchips)
 	if(i > 1)
 		printl(LOG_LEVEL_INFO, "[NAND:INFO] %d NAND chips detected\n", i);
 
+	/* 复位之后芯片处于时序模式0，逐个切换到参数页中最快的模式，失败时退回模式0 */
+	if(type->timing_mode > 0)
+	{
+		for(j = 0; j < i; j++)
+		{
+			if(nand_set_timing_mode(mtd, j, type->timing_mode))
+			{
+				type->timing = nand_onfi_timings[0];
+				type->timing_mode = 0;
+				break;
+			}
+		}
+		this->select_chip(mtd, -1);
+	}
+
 
 	/* 校准芯片和mtd大小 */
 	this->numchips = i;
@@ -2570,6 +4830,102 @@ int32_t nand_scan_ident(__in struct mtd_info *mtd, __in int32_t maxchips)
 	return 0;
 }
 
+#ifdef CONFIG_NAND_ECC_BCH
+/********************************************************************************
+* 函数: static int32_t nand_bch_init(__in struct mtd_info *mtd)
+* 描述: 初始化软件bch，根据每块数据大小和纠错位数选择最小的GF(2^m)，
+        没有指定ecc布局时把ecc放在oob区末尾
+* 输入: mtd: nandflash设备父类
+* 输出: none
+* 返回: 0: 成功
+       -EINVAL: 参数无效
+       -ENOMEM: 内存不足
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_bch_init(__in struct mtd_info *mtd)
+{
+    struct nand_chip *this = mtd->priv;
+    struct nand_ecclayout *layout = this->ecc_ctrl.layout;
+    uint32_t m, i, size, steps, eccbytes;
+    struct bch_control *bch;
+    uint8_t *erased;
+
+    if(!this->ecc_ctrl.data_size_per_step)
+        this->ecc_ctrl.data_size_per_step = 512;
+    if(!this->ecc_ctrl.ecc_strength)
+        this->ecc_ctrl.ecc_strength = 4;
+
+    size = this->ecc_ctrl.data_size_per_step;
+    steps = mtd->writesize / size;
+
+    /* 码长必须能容纳数据和ecc */
+    for(m = BCH_MIN_M; m <= BCH_MAX_M; m++)
+    {
+        if(((1 << m) - 1) >= (size * 8 + m * this->ecc_ctrl.ecc_strength))
+            break;
+    }
+
+    bch = bch_init(m, this->ecc_ctrl.ecc_strength);
+    if(!bch)
+    {
+        printl(LOG_LEVEL_ERR, "[NAND:ERR] bch init failed, size %d, strength %d\n",
+               size, this->ecc_ctrl.ecc_strength);
+        return -EINVAL;
+    }
+
+    eccbytes = steps * bch->ecc_bytes;
+    if(!layout)
+    {
+        if((eccbytes > sizeof(layout->eccpos) / sizeof(layout->eccpos[0])) ||
+           (eccbytes + 2 > mtd->oobsize))
+        {
+            printl(LOG_LEVEL_ERR, "[NAND:ERR] no room for %d bch ecc bytes in "
+                   "oob %d\n", eccbytes, mtd->oobsize);
+            bch_free(bch);
+            return -EINVAL;
+        }
+
+        layout = &nand_bch_oob;
+        layout->eccbytes = eccbytes;
+        for(i = 0; i < eccbytes; i++)
+            layout->eccpos[i] = mtd->oobsize - eccbytes + i;
+        layout->oobfree[0].offset = 2;
+        layout->oobfree[0].length = mtd->oobsize - eccbytes - 2;
+        this->ecc_ctrl.layout = layout;
+    }
+    else if(layout->eccbytes != eccbytes)
+    {
+        printl(LOG_LEVEL_ERR, "[NAND:ERR] invalid bch ecc layout, need %d ecc bytes\n",
+               eccbytes);
+        bch_free(bch);
+        return -EINVAL;
+    }
+
+    /* 擦除页掩码: 全0xff数据的ecc取反 */
+    this->ecc_ctrl.bch_eccmask = dlmalloc(bch->ecc_bytes);
+    erased = dlmalloc(size);
+    if(!this->ecc_ctrl.bch_eccmask || !erased)
+    {
+        dlfree((int8_t *)this->ecc_ctrl.bch_eccmask);
+        dlfree((int8_t *)erased);
+        this->ecc_ctrl.bch_eccmask = NULL;
+        bch_free(bch);
+        return -ENOMEM;
+    }
+    memset(erased, 0xff, size);
+    bch_encode(bch, erased, size, this->ecc_ctrl.bch_eccmask);
+    for(i = 0; i < bch->ecc_bytes; i++)
+        this->ecc_ctrl.bch_eccmask[i] ^= 0xff;
+    dlfree((int8_t *)erased);
+
+    this->ecc_ctrl.bch = bch;
+    this->ecc_ctrl.ecc_bytes_per_step = bch->ecc_bytes;
+
+    return 0;
+}
+#endif
+
 /********************************************************************************
 * 函数: int32_t nand_scan_tail(__in struct mtd_info *mtd)
 * 描述: 扫描具体芯片，初始化默认函数
@@ -2588,8 +4944,8 @@ int32_t nand_scan_tail(__in struct mtd_info *mtd)
 	/* 设置oob缓冲区位置 */
 	this->oob_poi = this->page_databuf + mtd->writesize;
 
-	/* 设置ecc布局 */
-	if(!this->ecc_ctrl.layout)
+	/* 设置ecc布局，软件bch的布局由nand_bch_init生成 */
+	if(!this->ecc_ctrl.layout && (this->ecc_ctrl.mode != NAND_ECC_SOFT_BCH))
 	{
 		switch(mtd->oobsize)
 		{
@@ -2612,6 +4968,18 @@ int32_t nand_scan_tail(__in struct mtd_info *mtd)
 		}
 	}
 
+	/* 条带芯片数必须能整除芯片数量 */
+	if(this->stripe_chips > 1)
+	{
+		if((this->stripe_chips > CONFIG_SYS_NAND_MAX_CHIPS) ||
+		   (this->numchips % this->stripe_chips))
+		{
+			printl(LOG_LEVEL_WARN, "[NAND:WARN] invalid stripe chips %d for %d chips, "
+			       "striping disabled\n", this->stripe_chips, this->numchips);
+			this->stripe_chips = 1;
+		}
+	}
+
 	/* 设置ecc参数 */
 	if(!this->ecc_ctrl.read_page_raw)
 		this->ecc_ctrl.read_page_raw = nand_read_page_raw;
@@ -2630,6 +4998,7 @@ int32_t nand_scan_tail(__in struct mtd_info *mtd)
 			this->ecc_ctrl.read_oob = nand_read_oob_std;
 		if(!this->ecc_ctrl.write_oob)
 			this->ecc_ctrl.write_oob = nand_write_oob_std;
+		break;
 
 	case NAND_ECC_SOFT:
 		this->ecc_ctrl.calculate = ecc_calculate;
@@ -2643,6 +5012,20 @@ int32_t nand_scan_tail(__in struct mtd_info *mtd)
 		this->ecc_ctrl.ecc_bytes_per_step = 3;
 		break;
 
+#ifdef CONFIG_NAND_ECC_BCH
+	case NAND_ECC_SOFT_BCH:
+		if(nand_bch_init(mtd))
+			BUG();
+		this->ecc_ctrl.calculate = NULL;
+		this->ecc_ctrl.correct = NULL;
+		this->ecc_ctrl.read_page = nand_read_page_swbch;
+		this->ecc_ctrl.read_subpage = NULL;
+		this->ecc_ctrl.write_page = nand_write_page_swbch;
+		this->ecc_ctrl.read_oob = nand_read_oob_std;
+		this->ecc_ctrl.write_oob = nand_write_oob_std;
+		break;
+#endif
+
 	case NAND_ECC_NONE:
 		printl(LOG_LEVEL_WARN, "[NAND:WARN] NAND_ECC_NONE selected by board driver. "
 		       "This is not recommended !!!\n");
@@ -2695,11 +5078,24 @@ int32_t nand_scan_tail(__in struct mtd_info *mtd)
 	/* 初始化芯片状态 */
 	this->state = FL_READY;
 
+	/* 异步请求队列为空 */
+	this->req_head = NULL;
+	this->req_tail = NULL;
+	this->req_active = 0;
+	this->req_running = 0;
+	this->req_chain = 0;
+	this->req_prog = 0;
+	this->req_erase.active = 0;
+
 	/* 不选中任何芯片 */
 	this->select_chip(mtd, -1);
 
-	/* 失效数据缓冲区*/
-	this->pagebuf = -1;
+	/* 失效页缓存 */
+	for(i = 0; i < CONFIG_SYS_NAND_PAGE_CACHE; i++)
+		this->page_cache[i].page = -1;
+	this->cache_clock = 0;
+	this->cache_last = -1;
+	memset(&this->cache_stats, 0, sizeof(this->cache_stats));
 
 	/* 初始化mtd默认函数 */
 	mtd->type = MTD_NANDFLASH;
@@ -2711,6 +5107,8 @@ int32_t nand_scan_tail(__in struct mtd_info *mtd)
 	mtd->write = nand_write;
 	mtd->read_oob = nand_read_oob;
 	mtd->write_oob = nand_write_oob;
+	mtd->submit = nand_submit;
+	mtd->poll = nand_poll;
 	mtd->sync = nand_sync;
 	mtd->lock = NULL;
 	mtd->unlock = NULL;
@@ -2718,6 +5116,8 @@ int32_t nand_scan_tail(__in struct mtd_info *mtd)
 	mtd->resume = nand_resume;
 	mtd->block_isbad = nand_block_isbad;
 	mtd->block_markbad = nand_block_markbad;
+	mtd->block_nextgood = nand_block_nextgood;
+	mtd->block_skipbad = nand_block_skipbad;
 
 	/* 初始化mtd ecc布局 */
 	mtd->ecclayout = this->ecc_ctrl.layout;
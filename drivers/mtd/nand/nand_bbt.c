@@ -15,6 +15,9 @@
 #include "string.h"
 #include "malloc.h"
 #include "log.h"
+#include "math.h"
+#include "bitops.h"
+#include "cpu_endian.h"
 #include "errno.h"
 #include "mtd/bbm.h"
 #include "mtd/nand/nand.h"
@@ -165,7 +168,7 @@ static int32_t read_bbt(__in struct mtd_info *mtd, __out uint8_t *buf, __in int3
         /* 分析读到的数据 */
         for(i = 0; i < len; i++)
         {
-            for(j = 0; j < 8; j += bits)
+            for(j = 0; j < 8; j += bits, act += 2)
             {
                 blkflag = ((buf[i] >> j) & mask);
 
@@ -195,8 +198,6 @@ static int32_t read_bbt(__in struct mtd_info *mtd, __out uint8_t *buf, __in int3
                     /* 使用过程中出现的坏块 */
                     this->bbt[offs + (act >> 3)] |= (0x01 <<  (act & 0x06));
 
-                act += 2;
-
                 mtd->ecc_stats.badblocks ++;
             }
         }
@@ -283,7 +284,8 @@ static int32_t read_abs_bbts(__in struct mtd_info *mtd, __out uint8_t *buf,
     struct mtd_oob_ops ops;
     int32_t res;
 
-    ops.mode = MTD_OOB_RAW;
+    /* 标记和版本号通过ecc读取，控制器把oob放在ecc保护的metadata中时也能读到 */
+    ops.mode = MTD_OOB_PLACE;
     ops.ooboffs = 0;
     ops.ooblen = mtd->oobsize;
     ops.oobbuf = buf + mtd->writesize;
@@ -294,7 +296,7 @@ static int32_t read_abs_bbts(__in struct mtd_info *mtd, __out uint8_t *buf,
     {
         res = mtd->read_oob(mtd, (loff_t)(td->pages[0] << this->page_shift), &ops);
 
-        if(res)
+        if(res && (res != -EUCLEAN))
         {
             printl(LOG_LEVEL_MSG, "[NANDBBT:MSG] bad block table at page %d, version 0x%02x\n",
                                td->pages[0], td->version[0]);
@@ -310,12 +312,12 @@ static int32_t read_abs_bbts(__in struct mtd_info *mtd, __out uint8_t *buf,
 
     if(md && (md->options & NAND_BBT_VERSION))
     {
-         res = mtd->read_oob(mtd, (loff_t)(md->pages[0] << this->page_shift), &ops);
+        res = mtd->read_oob(mtd, (loff_t)(md->pages[0] << this->page_shift), &ops);
 
-        if(res)
+        if(res && (res != -EUCLEAN))
         {
-            printl(LOG_LEVEL_MSG, "[NANDBBT:MSG] bad block table at page %d, version 0x%02x\n",
-                               td->pages[0], td->version[0]);
+            printl(LOG_LEVEL_MSG, "[NANDBBT:MSG] mirror bad block table at page %d, version 0x%02x\n",
+                               md->pages[0], md->version[0]);
             return res;
         }
 
@@ -330,27 +332,80 @@ static int32_t read_abs_bbts(__in struct mtd_info *mtd, __out uint8_t *buf,
 }
 
 /********************************************************************************
-* 函数: static int32_t scan_block_fast(__in struct mtd_info *mtd,
-                                      __in nand_bbt_desc *bd,
-                                      __in loff_t offs,
-                                      __out uint8_t *buf, __in int32_t numpages)
-* 描述: 快速扫描好/坏块标记
+* 函数: static int32_t scan_blocks_fast(__in struct mtd_info *mtd,
+                                       __in nand_bbt_desc *bd,
+                                       __in loff_t offs,
+                                       __out uint8_t *buf,
+                                       __in int32_t numblocks,
+                                       __in int32_t numpages)
+* 描述: 快速扫描连续多块的好/坏块标记，一次读取所有块前numpages页的标记
 * 输入: mtd: nandflash设备父类
        bd: bbt区域描述符
        offs: 扫描的起始地址
-       numpages: 扫描的页的个数
-* 输出: buf: oob原始数据输出缓冲区
-* 返回: 0: 是好块
-       1: 是坏块
-       <0: 出现坏块
+       numblocks: 扫描的块数，不超过NAND_BBM_BATCH
+       numpages: 每块扫描的页的个数
+* 输出: buf: 每块一个字节，0: 是好块 1: 是坏块
+* 返回: 0: 扫描成功
+       <0: 读取标记失败
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t scan_blocks_fast(__in struct mtd_info *mtd, __in struct nand_bbt_desc *bd,
+                                  __in loff_t offs, __out uint8_t *buf,
+                                  __in int32_t numblocks, __in int32_t numpages)
+{
+    int32_t i, j, ret;
+    const uint8_t *p = buf;
+
+    ret = nand_read_bbm(mtd, offs, numblocks, numpages, bd->offs, bd->len, buf);
+    if(ret)
+        return ret;
+
+    /* 检测好/坏块标记，结果按块压缩到缓冲区开头 */
+    for(i = 0; i < numblocks; i++)
+    {
+        uint8_t bad = 0;
+
+        for(j = 0; j < numpages; j++, p += bd->len)
+        {
+            if(memcmp(p, bd->pattern, bd->len))
+                bad = 1;
+        }
+
+        buf[i] = bad;
+    }
+
+    return 0;
+}
+
+
+
+#ifdef CONFIG_SYS_NAND_BENCH
+/********************************************************************************
+* 函数: static void scan_bench_per_page(__in struct mtd_info *mtd,
+                                       __in struct nand_bbt_desc *bd,
+                                       __in loff_t offs, __in int32_t numblocks,
+                                       __in int32_t numpages, __out uint8_t *buf)
+* 描述: 用逐页read_oob的方式(批量扫描之前的做法)再扫描一遍同样的块，给出用时，
+       和批量扫描比较. 只计时，不修改bbt
+* 输入: mtd: nandflash设备父类
+       bd: bbt区域描述符
+       offs: 扫描的起始地址
+       numblocks: 扫描的块数
+       numpages: 每块扫描的页的个数
+* 输出: buf: oob临时缓冲区
+* 返回: none
 * 作者:
 * 版本: v1.0
 **********************************************************************************/
-static int32_t scan_block_fast(__in struct mtd_info *mtd, __in struct nand_bbt_desc *bd,
-                                 __in loff_t offs, __out uint8_t *buf, __in int32_t numpages)
+static void scan_bench_per_page(__in struct mtd_info *mtd, __in struct nand_bbt_desc *bd,
+                                 __in loff_t offs, __in int32_t numblocks,
+                                 __in int32_t numpages, __out uint8_t *buf)
 {
+    struct nand_chip *this = mtd->priv;
     struct mtd_oob_ops ops;
-    int32_t i, ret;
+    uint32_t start;
+    int32_t i, j, bad = 0;
 
     ops.mode = MTD_OOB_PLACE;
     ops.ooblen = mtd->oobsize;
@@ -358,23 +413,26 @@ static int32_t scan_block_fast(__in struct mtd_info *mtd, __in struct nand_bbt_d
     ops.ooboffs = 0;
     ops.databuf = NULL;
 
-    for(i = 0; i < numpages; i++)
+    start = get_timer_us(0);
+    for(i = 0; i < numblocks; i++, offs += (1 << this->bbt_erase_shift))
     {
-        ret = mtd->read_oob(mtd, offs, &ops);
-        if(ret)
-            return ret;
-
-        /* 检测好/坏块标记 */
-        if(check_short_pattern(buf, bd))
-            return 1; /* 是坏块 */
+        for(j = 0; j < numpages; j++)
+        {
+            if(mtd->read_oob(mtd, offs + j * mtd->writesize, &ops))
+                return;
 
-        offs += mtd->writesize;
+            if(check_short_pattern(buf, bd))
+            {
+                bad++;
+                break;
+            }
+        }
     }
 
-    return 0;
+    printl(LOG_LEVEL_INFO, "[NANDBBT:INFO] per-page scan of %d blocks: %u us, %d bad\n",
+                           numblocks, get_timer_us(start), bad);
 }
-
-
+#endif
 
 /********************************************************************************
 * 函数: static int32_t create_bbt(__in struct mtd_info *mtd, __out uint8_t *buf,
@@ -394,6 +452,7 @@ static int32_t create_bbt(__in struct mtd_info *mtd, __in uint8_t *buf,
 {
     struct nand_chip *this = mtd->priv;
     int32_t len, numblocks, startblock, i;
+    uint32_t start;
 
     loff_t from;
 
@@ -430,31 +489,46 @@ static int32_t create_bbt(__in struct mtd_info *mtd, __in uint8_t *buf,
         from = (loff_t)(startblock << (this->bbt_erase_shift - 1));
     }
 
-    for(i = startblock; i < numblocks; i++)
+    start = get_timer_us(0);
+
+    for(i = startblock; i < numblocks;)
     {
-        int32_t ret;
+        int32_t ret, num, j;
 
-        ret = scan_block_fast(mtd, bd, from, buf, len);
+        /* 每次批量扫描NAND_BBM_BATCH块 */
+        num = min_t(int32_t, (numblocks - i) >> 1, NAND_BBM_BATCH);
+        ret = scan_blocks_fast(mtd, bd, from, buf, num, len);
 
         /* 读取好/坏块标记错误，一般一块的第1/2页都保证是好页，可以存放此块的好/坏标志 */
         if(ret < 0)
             return ret;
 
-        if(ret)
+        for(j = 0; j < num; j++)
         {
-            /* 出现坏块，标记坏块 */
-            this->bbt[i >> 3] |= 0x03 << (i & 0x06);
+            if(buf[j])
+            {
+                /* 出现坏块，标记坏块 */
+                this->bbt[i >> 3] |= 0x03 << (i & 0x06);
 
-            printl(LOG_LEVEL_INFO, "[NANDBBT:INFO] bad eraseblock %d at 0x%012llx\n",
-                                   i >> 1, (uint64_t)from);
+                printl(LOG_LEVEL_INFO, "[NANDBBT:INFO] bad eraseblock %d at 0x%012llx\n",
+                                       i >> 1, (uint64_t)from);
 
-            mtd->ecc_stats.badblocks++;
-        }
+                mtd->ecc_stats.badblocks++;
+            }
 
-        i += 2;
-        from += (1 << this->bbt_erase_shift);
+            i += 2;
+            from += (1 << this->bbt_erase_shift);
+        }
     }
 
+    printl(LOG_LEVEL_MSG, "[NANDBBT:MSG] scanned %d blocks in %u us\n",
+                          (numblocks - startblock) >> 1, get_timer_us(start));
+
+#ifdef CONFIG_SYS_NAND_BENCH
+    scan_bench_per_page(mtd, bd, (loff_t)startblock << (this->bbt_erase_shift - 1),
+                        (numblocks - startblock) >> 1, len, buf);
+#endif
+
     return 0;
 }
 
@@ -475,14 +549,16 @@ static int32_t search_bbt(__in struct mtd_info *mtd, __out uint8_t *buf,
     struct nand_chip *this = mtd->priv;
     int32_t startblock, dir, block;
     int32_t blocktopage = this->bbt_erase_shift - this->page_shift;
-    int32_t i, numchips;
+    int32_t i, numchips, res;
     struct mtd_oob_ops ops;
 
-    ops.mode = MTD_OOB_RAW;
+    /* 标记和版本号通过ecc读取，控制器把oob放在ecc保护的metadata中时也能读到 */
+    ops.mode = MTD_OOB_PLACE;
     ops.ooblen = mtd->oobsize;
-    ops.oobbuf = buf;
+    ops.oobbuf = buf + mtd->writesize;
     ops.ooboffs = 0;
-    ops.databuf = NULL;
+    ops.databuf = buf;
+    ops.len = mtd->writesize;
 
 
     /* bbt存放位置 */
@@ -504,6 +580,8 @@ static int32_t search_bbt(__in struct mtd_info *mtd, __out uint8_t *buf,
     if(td->options & NAND_BBT_PERCHIP)
     {
         numchips = this->numchips;
+        /* 从第一个芯片内的块开始 */
+        startblock &= (this->chipsize >> this->bbt_erase_shift) - 1;
     }
     else
     {
@@ -514,7 +592,7 @@ static int32_t search_bbt(__in struct mtd_info *mtd, __out uint8_t *buf,
     for(i = 0; i < numchips; i++)
     {
         td->version[i] = 0;
-        td->pages[i] = 0;
+        td->pages[i] = -1;
 
         for(block = 0; block < td->maxblocks; block++)
         {
@@ -522,13 +600,16 @@ static int32_t search_bbt(__in struct mtd_info *mtd, __out uint8_t *buf,
 			loff_t offs = (loff_t)curblock << this->bbt_erase_shift;
 
             /* 读取block的第一页，bbt都存放在block的第一页 */
-            mtd->read_oob(mtd, offs, &ops);
-            if(!check_short_pattern(buf, td))
+            res = mtd->read_oob(mtd, offs, &ops);
+            if(res && (res != -EUCLEAN))
+                continue;
+
+            if(!check_short_pattern(ops.oobbuf, td))
             {
                 /* 找到bbt */
 				td->pages[i] = curblock << blocktopage;
 				if(td->options & NAND_BBT_VERSION)
-                    td->version[i] = buf[td->veroffs];
+                    td->version[i] = ops.oobbuf[td->veroffs];
 
 				break;
             }
@@ -815,9 +896,6 @@ write:
 		einfo.len = 1 << this->bbt_erase_shift;
 		res = nand_erase_nand(mtd, &einfo, 1);
 		if (res < 0)
-		{
-		    printl(LOG_LEVEL_ERR, "[NANDBBT:ERR] Error while writing bad block table %d\n", res);
-		}
 			goto outerr;
 
         /* 写入bbt数据 */
@@ -1087,6 +1165,7 @@ int32_t nand_scan_bbt(__in struct mtd_info *mtd, __in struct nand_bbt_desc *bd)
 		printl(LOG_LEVEL_ERR, "[NANDBBT:ERR] Out of memory\n");
 		return -ENOMEM;
 	}
+	memset(this->bbt, 0, len);
 
 	/* 分配可以保存一块数据大小的临时空间 */
 	len = (1 << this->bbt_erase_shift);
@@ -1100,6 +1179,22 @@ int32_t nand_scan_bbt(__in struct mtd_info *mtd, __in struct nand_bbt_desc *bd)
 		return -ENOMEM;
 	}
 
+	/* 基于内存的bbt，扫描整个设备 */
+	if(!td)
+	{
+		res = create_bbt(mtd, buf, bd, -1);
+		this->bbt_index_valid = 0;
+		if(res)
+		{
+			printl(LOG_LEVEL_ERR, "[NANDBBT:ERR] Can't scan flash and build the RAM-based BBT\n");
+			dlfree((int8_t *)(this->bbt));
+			this->bbt = NULL;
+		}
+
+		dlfree((int8_t *)buf);
+		return res;
+	}
+
 	/* bbt存放在指定位置? */
 	if (td->options & NAND_BBT_ABSPAGE)
 	{
@@ -1120,6 +1215,8 @@ int32_t nand_scan_bbt(__in struct mtd_info *mtd, __in struct nand_bbt_desc *bd)
 	if(md)
 		mark_bbt_region(mtd, md);
 
+	this->bbt_index_valid = 0;
+
 	dlfree((int8_t *)buf);
 	return res;
 }
@@ -1127,9 +1224,10 @@ int32_t nand_scan_bbt(__in struct mtd_info *mtd, __in struct nand_bbt_desc *bd)
 
 /********************************************************************************
 * 函数: int32_t nand_update_bbt(__in struct mtd_info *mtd, __in loff_t offs)
-* 描述: 更新bbt,此时内存中已经建立好bbt表
+* 描述: 更新bbt,此时内存中已经建立好bbt表. NAND_BBT_PERCHIP时只增加offs所在芯片
+       的版本号并重写这个芯片的原始和镜像bbt，其他芯片的bbt不变
 * 输入: mtd: nandflash设备父类
-       offs: bbt数据存储在nandflash中的起始地址, 在存在NAND_BBT_PERCHIP时有效
+       offs: 状态发生变化的块地址, 在存在NAND_BBT_PERCHIP时用来确定芯片
 * 输出: none
 * 返回: 0: 成功
        !0: 失败
@@ -1242,9 +1340,243 @@ int32_t nand_default_bbt(__in struct mtd_info *mtd)
 }
 
 
+/* bbt一个32位字保存16块的状态 */
+#define BBT_WORD_BLOCKS    16
+
+/********************************************************************************
+* 函数: static uint32_t bbt_good_word(__in struct nand_chip *this, __in int32_t w,
+                                     __in int32_t len)
+* 描述: 取bbt的第w个32位字，转换成好块掩码，块状态为0时对应的偶数位置1
+* 输入: this: nandflash设备自身指针
+       w: 字序号
+       len: bbt字节数，超出部分按坏块处理
+* 输出: none
+* 返回: 好块掩码，第i块好时第2i位为1
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static uint32_t bbt_good_word(__in struct nand_chip *this, __in int32_t w, __in int32_t len)
+{
+    uint32_t val;
+    int32_t i;
+
+    if((w << 2) + 4 <= len)
+        val = le32_to_cpu(*(const uint32_t *)(this->bbt + (w << 2)));
+    else
+    {
+        /* 最后不足一个字 */
+        val = 0xffffffff;
+        for(i = 0; (w << 2) + i < len; i++)
+        {
+            val &= ~((uint32_t)0xff << (i << 3));
+            val |= (uint32_t)this->bbt[(w << 2) + i] << (i << 3);
+        }
+    }
+
+    return ~(val | (val >> 1)) & 0x55555555;
+}
+
+/********************************************************************************
+* 函数: static int32_t nand_bbt_build_index(__in struct mtd_info *mtd)
+* 描述: 按字扫描bbt，建立好块前缀计数和好块索引，之后逻辑块和物理块之间的
+       转换不需要再扫描bbt
+* 输入: mtd: nandflash设备父类
+* 输出: none
+* 返回: 0: 成功
+       -ENOMEM: 内存不足
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t nand_bbt_build_index(__in struct mtd_info *mtd)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t numblocks = (int32_t)(mtd->size >> this->phys_erase_shift);
+    int32_t len = numblocks >> 2;
+    int32_t words = (numblocks + BBT_WORD_BLOCKS - 1) / BBT_WORD_BLOCKS;
+    uint32_t count = 0;
+    uint32_t mask;
+    int32_t w;
+
+    if(!this->bbt_rank)
+    {
+        this->bbt_rank = dlmalloc((words + 1) * sizeof(uint32_t));
+        this->bbt_good = dlmalloc(numblocks * sizeof(uint32_t));
+        if(!this->bbt_rank || !this->bbt_good)
+        {
+            printl(LOG_LEVEL_ERR, "[NANDBBT:ERR] Out of memory\n");
+            if(this->bbt_rank)
+                dlfree((int8_t *)this->bbt_rank);
+            if(this->bbt_good)
+                dlfree((int8_t *)this->bbt_good);
+            this->bbt_rank = NULL;
+            this->bbt_good = NULL;
+            return -ENOMEM;
+        }
+    }
+
+    for(w = 0; w < words; w++)
+    {
+        this->bbt_rank[w] = count;
+
+        mask = bbt_good_word(this, w, len);
+        while(mask)
+        {
+            this->bbt_good[count++] = w * BBT_WORD_BLOCKS + ((ffs(mask) - 1) >> 1);
+            mask &= mask - 1;
+        }
+    }
+
+    this->bbt_rank[words] = count;
+    this->bbt_index_valid = 1;
+
+    return 0;
+}
+
+/********************************************************************************
+* 函数: int32_t nand_bbt_next_good(__in struct mtd_info *mtd, __in loff_t offs,
+                                  __out loff_t *good)
+* 描述: 按字扫描bbt，查找offs所在块或者之后的第一个好块，保留块也按坏块处理
+* 输入: mtd: nandflash设备父类
+       offs: 起始地址
+* 输出: good: 好块起始地址
+* 返回: 0: 找到好块
+       -EINVAL: 参数无效
+       -ENOSPC: 之后没有好块
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+int32_t nand_bbt_next_good(__in struct mtd_info *mtd, __in loff_t offs, __out loff_t *good)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t numblocks = (int32_t)(mtd->size >> this->phys_erase_shift);
+    int32_t block, w;
+    uint32_t mask;
+
+    if(!this->bbt || (offs < 0) || (offs >= mtd->size))
+        return -EINVAL;
+
+    block = (int32_t)(offs >> this->phys_erase_shift);
+    w = block / BBT_WORD_BLOCKS;
 
+    /* 去掉起始块之前的块 */
+    mask = bbt_good_word(this, w, numblocks >> 2) &
+           (0xffffffff << ((block % BBT_WORD_BLOCKS) << 1));
+
+    while(!mask)
+    {
+        if(++w * BBT_WORD_BLOCKS >= numblocks)
+            return -ENOSPC;
 
+        mask = bbt_good_word(this, w, numblocks >> 2);
+    }
 
+    block = w * BBT_WORD_BLOCKS + ((ffs(mask) - 1) >> 1);
+    if(block >= numblocks)
+        return -ENOSPC;
 
+    *good = (loff_t)block << this->phys_erase_shift;
 
+    return 0;
+}
 
+/********************************************************************************
+* 函数: int32_t nand_bbt_first_bad(__in struct mtd_info *mtd, __in loff_t offs,
+                                  __in uint64_t len, __out loff_t *bad)
+* 描述: 按字扫描bbt，一次检查一个区域内是否有坏块，保留块也按坏块处理
+* 输入: mtd: nandflash设备父类
+       offs: 起始地址，按块对齐
+       len: 长度，按块对齐
+* 输出: bad: 第一个坏块的地址
+* 返回: 0: 区域内全是好块
+       1: 区域内有坏块
+       -EINVAL: 参数无效
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+int32_t nand_bbt_first_bad(__in struct mtd_info *mtd, __in loff_t offs, __in uint64_t len,
+                           __out loff_t *bad)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t numblocks = (int32_t)(mtd->size >> this->phys_erase_shift);
+    int32_t block, end, w;
+    uint32_t mask;
+
+    if(!this->bbt || (offs < 0) || ((offs + len) > mtd->size))
+        return -EINVAL;
+
+    block = (int32_t)(offs >> this->phys_erase_shift);
+    end = (int32_t)((offs + len) >> this->phys_erase_shift);
+
+    while(block < end)
+    {
+        w = block / BBT_WORD_BLOCKS;
+
+        /* 起始块之前的块不检查 */
+        mask = ~bbt_good_word(this, w, numblocks >> 2) & 0x55555555 &
+               (0xffffffff << ((block % BBT_WORD_BLOCKS) << 1));
+        if(mask)
+        {
+            block = w * BBT_WORD_BLOCKS + ((ffs(mask) - 1) >> 1);
+            if(block >= end)
+                return 0;
+
+            *bad = (loff_t)block << this->phys_erase_shift;
+            return 1;
+        }
+
+        block = (w + 1) * BBT_WORD_BLOCKS;
+    }
+
+    return 0;
+}
+
+/********************************************************************************
+* 函数: int32_t nand_bbt_skip_bad(__in struct mtd_info *mtd, __in loff_t from,
+                                 __in loff_t offs, __out loff_t *phys)
+* 描述: 从from所在块开始跳过坏块，计算逻辑偏移offs对应的物理地址. 使用好块
+       前缀计数和好块索引，转换时间和坏块数量无关
+* 输入: mtd: nandflash设备父类
+       from: 起始地址，按块对齐
+       offs: 跳过坏块后的逻辑偏移
+* 输出: phys: 物理地址
+* 返回: 0: 成功
+       -EINVAL: 参数无效
+       -ENOMEM: 内存不足
+       -ENOSPC: 好块不够
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+int32_t nand_bbt_skip_bad(__in struct mtd_info *mtd, __in loff_t from, __in loff_t offs,
+                          __out loff_t *phys)
+{
+    struct nand_chip *this = mtd->priv;
+    int32_t numblocks = (int32_t)(mtd->size >> this->phys_erase_shift);
+    int32_t block, ret;
+    uint32_t rank;
+
+    if(!this->bbt || (from < 0) || (offs < 0) || (from >= mtd->size))
+        return -EINVAL;
+
+    if(!this->bbt_index_valid)
+    {
+        ret = nand_bbt_build_index(mtd);
+        if(ret)
+            return ret;
+    }
+
+    /* from之前的好块数 */
+    block = (int32_t)(from >> this->phys_erase_shift);
+    rank = this->bbt_rank[block / BBT_WORD_BLOCKS] +
+           generic_hweight32(bbt_good_word(this, block / BBT_WORD_BLOCKS, numblocks >> 2) &
+                             ~(0xffffffff << ((block % BBT_WORD_BLOCKS) << 1)));
+
+    /* 第rank + offs / erasesize个好块 */
+    rank += (uint32_t)(offs >> this->phys_erase_shift);
+    if(rank >= this->bbt_rank[(numblocks + BBT_WORD_BLOCKS - 1) / BBT_WORD_BLOCKS])
+        return -ENOSPC;
+
+    *phys = ((loff_t)this->bbt_good[rank] << this->phys_erase_shift) +
+            (offs & ((1 << this->phys_erase_shift) - 1));
+
+    return 0;
+}
@@ -43,15 +43,17 @@ static struct nand_device_info nand_device_info_table[] =
         .page_oob_size_in_bytes   = 64,
 
         {
-            .data_setup_in_ns         = 35,
-            .data_hold_in_ns          = 25,
+            .data_setup_in_ns         = 15,
+            .data_hold_in_ns          = 10,
             .address_setup_in_ns      = 0,
             .gpmi_sample_delay_in_ns  = 6,
-            .tREA_in_ns               = -1,
-            .tRLOH_in_ns              = -1,
-            .tRHOH_in_ns              = -1,
+            .tREA_in_ns               = 20,
+            .tRLOH_in_ns              = 5,
+            .tRHOH_in_ns              = 15,
         },
 
+        /* K9F1G08没有缓存读(0x31/0x3f)，支持缓存读的型号在这里加上NAND_CACHEREAD，
+           ONFI芯片由参数页设置 */
         .options = NAND_NO_PADDING | NAND_CACHEPRG | NAND_NO_READRDY | NAND_NO_AUTOINCR,
         "K9F1F08",
     },
@@ -251,6 +253,11 @@ void nand_device_print_info(__in struct nand_device_info *info)
     else
         printl(LOG_LEVEL_INFO, "tRHOH             : Unknown\n");
 
+    printl(LOG_LEVEL_INFO, "Planes            : %u\n", info->planes ? info->planes : 1);
+
+    if(info->timing_mode > 0)
+        printl(LOG_LEVEL_INFO, "Timing Mode       : %d\n", info->timing_mode);
+
     if(info->description)
         printl(LOG_LEVEL_INFO, "Description       : %s\n", info->description);
     else
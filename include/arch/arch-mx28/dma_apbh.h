@@ -71,6 +71,15 @@ struct dma_cmd
 
 
 #define DMA_ALIGNMENT	8  //描述符结构体8字节对齐
+
+/* 描述器池大小，所有通道共用 */
+#ifndef CONFIG_DMA_DESC_POOL_SIZE
+  #define DMA_DESC_POOL_SIZE   64
+#else
+  #define DMA_DESC_POOL_SIZE   CONFIG_DMA_DESC_POOL_SIZE
+#endif
+
+#define DMA_DESC_POOL_ALIGN  32  //描述器池按cache行对齐
 /* DMA指令描述 */
 
 /* flag位 */
@@ -96,6 +105,9 @@ struct dma_info
 {
 	uint32_t status;   //错误信息
     uint32_t buf_addr;  //buffer字段的地址
+    uint32_t pool_total;  //描述器池大小
+    uint32_t pool_used;  //当前已分配的描述器个数
+    uint32_t pool_peak;  //已分配描述器个数的最大值
 };
 
 
@@ -113,6 +125,7 @@ struct dma_chan
 	uint32_t pending_num;  //active链表尾部等待执行的命令个数
 	struct list_head active;  //正在执行的指令的链表
 	struct list_head done;  //已经完成指令的链表或调用dma_disable()忽略的指令
+	volatile uint32_t irq_status;  //中断服务程序记录的状态，bit0: 完成，bit1: 错误
 };
 
 
@@ -170,6 +183,10 @@ int32_t dma_desc_add_list(__in uint32_t channel, __in struct list_head *head);
 int32_t dma_get_cooked(__in int32_t channel, __out struct list_head *head);
 int32_t dma_init(__in enum dma_channel channel);
 int32_t dma_wait_complete(__in uint32_t uSecTimeout, __in uint32_t chan);
+void dma_start(__in int32_t chan);
+int32_t dma_is_finished(__in int32_t chan);
+int32_t dma_finish(__in int32_t chan, __in uint32_t timeout);
+int32_t dma_go_timeout(__in int32_t chan, __in uint32_t timeout);
 int32_t dma_go(__in int32_t chan);
 
 
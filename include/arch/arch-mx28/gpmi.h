@@ -102,6 +102,74 @@ struct gpmi_info
 
 	/* 块好/坏状态偏移地址 */
 	uint32_t aux_status_ofs;
+
+	/* 直接dma到调用者缓冲区的页读次数 */
+	uint32_t direct_read_cnt;
+
+	/* 经过data_buf中转的页读次数 */
+	uint32_t bounce_read_cnt;
+
+	/* 多页读dma链命令缓冲区 */
+	uint8_t  *chain_cmd_buf;
+
+	/* 多页读每页auxiliary区缓冲区 */
+	uint8_t  *chain_aux_buf;
+
+	/* 通过多页dma链读取的页数 */
+	uint32_t chain_read_cnt;
+
+	/* 通过多芯片交错读取的页数 */
+	uint32_t interleave_read_cnt;
+
+	/* 通过缓存读取的页数 */
+	uint32_t cache_read_cnt;
+
+	/* 多页写交替使用的两组编程缓冲区，第一组就是data_buf/oob_buf */
+	uint8_t  *prog_data_buf[2];
+	uint8_t  *prog_oob_buf[2];
+
+	/* 通过缓存编程写入的页数 */
+	uint32_t cache_prog_cnt;
+
+	/* 只解码部分ecc块的读取次数 */
+	uint32_t subpage_read_cnt;
+
+	/* 整页擦除，跳过拷贝直接填充0xff的页读次数 */
+	uint32_t erased_read_cnt;
+
+	/* BCH报告无法纠正，但0位个数在ecc强度以内(且不为0)按擦除处理的ecc块数 */
+	uint32_t erased_bitflip_cnt;
+
+	/* 通过dma链批量读取坏块标记的页数 */
+	uint32_t bbm_read_cnt;
+
+	/* 通过多plane编程写入的页数 */
+	uint32_t multi_plane_prog_cnt;
+
+	/* 正在执行的异步多页读dma链: 芯片、起始页、页数(0表示没有)、数据缓冲区和开始时间 */
+	uint32_t async_chip;
+	int32_t async_page;
+	int32_t async_count;
+	uint8_t *async_buf;
+	uint32_t async_start;
+
+	/* 通过异步dma链读取的页数 */
+	uint32_t async_read_cnt;
+
+	/* 正在执行的异步页编程: 状态(0没有，1数据传输中，2芯片编程中)、芯片、页、
+	   是否原始写入和开始时间 */
+	int32_t prog_async;
+	uint32_t prog_async_chip;
+	int32_t prog_async_page;
+	int32_t prog_async_raw;
+	uint32_t prog_async_start;
+
+	/* 通过异步编程写入的页数 */
+	uint32_t async_prog_cnt;
+
+	/* 当前使用的时序，以及计算该时序时的gpmi时钟频率 */
+	struct nand_timing *timing;
+	uint32_t timing_clk_rate;
 };
 
 
@@ -0,0 +1,40 @@
+#ifndef _ICOLL_H_
+  #define _ICOLL_H_
+
+#include "types.h"
+
+
+/* 中断控制器支持的中断源数量 */
+#define ICOLL_IRQ_CNT                 (128)
+
+/* 使用到的中断源编号 */
+#define IRQ_BCH                       (41)
+#define IRQ_SSP0_DMA                  (82)
+#define IRQ_SSP1_DMA                  (83)
+#define IRQ_SSP2_DMA                  (84)
+#define IRQ_SSP3_DMA                  (85)
+#define IRQ_LCDIF_DMA                 (86)
+#define IRQ_HSADC_DMA                 (87)
+#define IRQ_GPMI_DMA                  (88)
+
+/* 中断处理函数 */
+typedef void (*irq_handler_t)(void *data);
+
+
+/*******************************************************************************/
+/************************************ 外部接口 ***********************************/
+/*******************************************************************************/
+int32_t icoll_init(void);
+int32_t irq_install_handler(__in uint32_t irq, __in irq_handler_t handler, __in void *data);
+void irq_free_handler(__in uint32_t irq);
+void irq_enable(__in uint32_t irq);
+void irq_disable(__in uint32_t irq);
+int32_t interrupt_init(void);
+void enable_interrupts(void);
+int32_t disable_interrupts(void);
+void do_irq(__in void *regs);
+void do_fiq(__in void *regs);
+
+
+
+#endif /* _ICOLL_H_ */
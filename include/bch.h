@@ -0,0 +1,48 @@
+#ifndef _BCH_H_
+  #define _BCH_H_
+
+#include "stddef.h"
+
+
+/* 支持的GF(2^m)范围 */
+#define BCH_MIN_M    5
+#define BCH_MAX_M    15
+
+/* 支持的最大纠错位数 */
+#define BCH_MAX_T    32
+
+/* 二进制BCH编解码控制结构体 */
+struct bch_control
+{
+    uint32_t m; /* GF(2^m) */
+    uint32_t n; /* 码长2^m-1 */
+    uint32_t t; /* 最多可纠正的位数 */
+    uint32_t ecc_bits; /* ecc位数，生成多项式的阶 */
+    uint32_t ecc_bytes; /* ecc字节数 */
+    uint32_t ecc_words; /* ecc占用的32位字数 */
+    uint16_t *a_pow_tab; /* 指数表: a_pow_tab[i] = α^i */
+    uint16_t *a_log_tab; /* 对数表: a_log_tab[α^i] = i */
+    uint32_t *mod8_tab; /* 按字节编码的余数表，每项ecc_words个字 */
+    uint32_t *ecc_buf; /* 编码余数 */
+    uint32_t *ecc_buf2; /* 解码时计算出的余数 */
+    uint32_t *syn; /* 2t个伴随式 */
+    uint32_t *elp; /* 错误位置多项式 */
+    uint32_t *elp_prev; /* berlekamp-massey中的辅助多项式 */
+    uint32_t *elp_tmp;
+    uint32_t *chien; /* chien搜索中各项当前的对数值 */
+    uint32_t *errloc; /* 错误位置(码字中的位序号) */
+};
+
+
+extern struct bch_control *bch_init(__in uint32_t m, __in uint32_t t);
+extern void bch_free(__in struct bch_control *bch);
+extern void bch_encode(__in struct bch_control *bch, __in const uint8_t *data,
+                       __in uint32_t len, __out uint8_t *ecc);
+extern int32_t bch_decode(__in struct bch_control *bch, __inout uint8_t *data,
+                          __in uint32_t len, __in const uint8_t *recv_ecc,
+                          __in const uint8_t *calc_ecc);
+
+
+
+#endif
+
@@ -28,6 +28,7 @@ extern int32_t ctrlc(void);
 *********************************************************/
 void reset_timer(void);
 uint32_t get_timer(__in uint32_t base);
+uint32_t get_timer_us(__in uint32_t base);
 void set_timer(__in uint32_t t);
 extern void udelay(__in uint32_t usec);
 extern void mdelay(__in uint32_t msec);
@@ -22,6 +22,32 @@
 
 #define CONFIG_SYS_HZ		          1000
 
+/*
+* TEXT_BASE下方的内存布局，从高到低: malloc区、全局数据(gd_t和bd_t)、IRQ/FIQ栈、
+* abort栈和svc栈. 数值需要是arm指令的立即数
+*/
+#define CONFIG_SYS_MALLOC_LEN         (1024 * 1024)
+#define CONFIG_SYS_GBL_DATA_SIZE      128
+#define CONFIG_STACKSIZE              (128 * 1024)
+
+/*
+* 中断，dma和bch完成事件通过中断通知
+*/
+#define CONFIG_USE_IRQ                1
+#define CONFIG_STACKSIZE_IRQ          (4 * 1024)
+#define CONFIG_STACKSIZE_FIQ          (4 * 1024)
+
+/*
+* dma描述器池大小: gpmi单页操作8个 + 多页读链41个，其余留给其他通道
+*/
+#define CONFIG_DMA_DESC_POOL_SIZE     64
+
+/*
+* 使用arch/arm/lib中ldm/stm实现的memcpy/memset
+*/
+#define CONFIG_USE_ARCH_MEMCPY
+#define CONFIG_USE_ARCH_MEMSET
+
 #define CONFIG_NR_DRAM_BANKS          1
 
 
@@ -35,6 +61,33 @@
 #define NAND_MAX_CHIPS		8
 #define CONFIG_SYS_NAND_BASE		0x40000000
 #define CONFIG_SYS_MAX_NAND_DEVICE	  1
+#define CONFIG_SYS_NAND_PAGE_CACHE	  4
+#define CONFIG_SYS_NAND_READAHEAD	  2
+
+/*
+* 编译软件bch纠错，芯片的ecc模式为NAND_ECC_SOFT_BCH时使用，gpmi仍然使用
+* 硬件bch，打开后nand_base和lib/bch.c一起编译
+*/
+#define CONFIG_NAND_ECC_BCH
+
+/*
+* 多片nand按擦除块条带，连续的逻辑块轮流分布到各个芯片上，同时需要把
+* CONFIG_SYS_NAND_MAX_CHIPS设置为芯片数量. 本板只有一片nand，没有打开
+*/
+/* #define CONFIG_SYS_NAND_MAX_CHIPS     2 */
+/* #define CONFIG_SYS_NAND_STRIPE_CHIPS  2 */
+
+/*
+* 启动时测试nand顺序读取速度，值为读取的字节数. 打开条带时分别给出不使用
+* 条带和使用条带的速度，gpmi分别给出安全时序和芯片时序下的速度
+*/
+/* #define CONFIG_SYS_NAND_BENCH         (4 << 20) */
+
+/*
+* 启动时比较两个nand设备首尾相接和按擦除块条带的mtd设备链的读取速度，
+* 值为读取的字节数，需要CONFIG_SYS_MAX_NAND_DEVICE不小于2
+*/
+/* #define CONFIG_SYS_MTD_CONCAT_BENCH   (4 << 20) */
 
 #endif
 
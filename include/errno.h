@@ -39,6 +39,7 @@
 #define	ECONNRESET		33	/* Connection reset by peer */
 #define	ETIMEDOUT		34	/* Connection timed out */
 #define	EUCLEAN			35	/* Structure needs cleaning */
+#define	EINPROGRESS		36	/* 操作正在进行 */
 
 
 /* 返回指针情况此下错误代码识别和处理 */
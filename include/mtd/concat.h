@@ -0,0 +1,29 @@
+#ifndef _CONCAT_H_
+  #define _CONCAT_H_
+
+
+#include "types.h"
+
+
+struct mtd_info;
+
+/* 把多个mtd设备首尾相接成一个设备 */
+struct mtd_info *mtd_concat_create(struct mtd_info *subdev[], int32_t num_devs, const int8_t *name);
+
+/* 按stripe大小把地址轮流分布到多个mtd设备上(RAID-0) */
+struct mtd_info *mtd_concat_create_striped(struct mtd_info *subdev[], int32_t num_devs,
+                                           uint32_t stripe, const int8_t *name);
+
+#ifdef CONFIG_SYS_MTD_CONCAT_BENCH
+/* 比较首尾相接和条带的顺序读取速度 */
+void mtd_concat_bench(struct mtd_info *subdev[], int32_t num_devs, size_t len);
+#endif
+
+
+
+
+
+
+
+
+#endif
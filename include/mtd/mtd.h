@@ -95,6 +95,33 @@ struct mtd_oob_ops
 	uint8_t *oobbuf;  /* oob数据缓冲区，为null时只会读写data数据 */
 };
 
+/* 异步请求类型 */
+#define MTD_REQ_READ             0
+#define MTD_REQ_WRITE            1
+#define MTD_REQ_READ_OOB         2
+#define MTD_REQ_ERASE            3
+
+/* 异步请求. 提交之后status为-EINPROGRESS，完成时status为同步接口的返回值，
+   然后调用complete，complete返回之后请求可以释放或者重新提交 */
+struct mtd_request
+{
+	uint8_t type;  /* 请求类型 */
+	loff_t addr;  /* 读写地址，MTD_REQ_ERASE使用instr中的地址 */
+	size_t len;  /* 读写长度 */
+	size_t retlen;  /* 已经完成的长度 */
+	uint8_t *buf;  /* 数据缓冲区，写请求不会修改缓冲区 */
+	struct mtd_oob_ops *ops;  /* MTD_REQ_READ_OOB的操作参数 */
+	struct erase_info *instr;  /* MTD_REQ_ERASE的擦除信息 */
+	int32_t status;  /* 请求状态，-EINPROGRESS表示还没有完成 */
+	void (*complete)(struct mtd_request *req);  /* 完成回调，可以为NULL，回调中可以提交新的请求 */
+	void *priv;  /* 调用者私有数据 */
+
+	/* 以下供驱动内部使用 */
+	struct mtd_info *mtd;  /* 提交到的设备 */
+	loff_t bias;  /* 分区等直通层累加到地址上的偏移，完成时恢复 */
+	struct mtd_request *next;  /* 设备请求队列 */
+};
+
 
 /* mtd信息结构体 */
 struct mtd_info
@@ -121,7 +148,8 @@ struct mtd_info
 	int32_t numeraseregions;
 	struct mtd_erase_region_info *eraseregions;
 
-	/* 擦除是异步操作。当擦除完成时设备驱动会调用instr->callback()函数。 */
+	/* 擦除是异步操作。当擦除完成时设备驱动会调用instr->callback()函数，成功和失败都调用一次，
+	   state为MTD_ERASE_DONE或者MTD_ERASE_FAILED。参数无效等没有开始擦除的错误不调用 */
 	int32_t (*erase)(struct mtd_info *mtd, struct erase_info *instr);
 
 	/* 片上执行 */
@@ -147,6 +175,13 @@ struct mtd_info
 	int32_t (*read_oob) (struct mtd_info *mtd, loff_t from, struct mtd_oob_ops *ops);
 	int32_t (*write_oob) (struct mtd_info *mtd, loff_t to, struct mtd_oob_ops *ops);
 
+	/* 异步请求，submit把请求加入设备队列后立即返回，poll推进队列中的请求但不等待硬件，
+	   返回还没有完成的请求数. 驱动没有异步硬件路径的操作在poll中同步执行一段(nand:
+	   多plane块对、不完整的页和READ_OOB)，驱动处理请求的过程中submit返回-EBUSY.
+	   不支持时mtd_submit同步执行请求，可选 */
+	int32_t (*submit) (struct mtd_info *mtd, struct mtd_request *req);
+	int32_t (*poll) (struct mtd_info *mtd);
+
 	/*
 	 * Methods to access the protection register area, present in some
 	 * flash devices. The user data is one time programmable but the
@@ -182,6 +217,8 @@ struct mtd_info
 	/* Bad block management functions */
 	int32_t (*block_isbad) (struct mtd_info *mtd, loff_t ofs);
 	int32_t (*block_markbad) (struct mtd_info *mtd, loff_t ofs);
+	int32_t (*block_nextgood) (struct mtd_info *mtd, loff_t ofs, loff_t *good); /* ofs所在块或之后的第一个好块，可选 */
+	int32_t (*block_skipbad) (struct mtd_info *mtd, loff_t from, loff_t ofs, loff_t *phys); /* 从from开始跳过坏块后逻辑偏移ofs的物理地址，可选 */
 
 
 	/* ECC status information */
@@ -222,6 +259,17 @@ extern struct mtd_info *get_mtd_device_nm(const char *name);
 
 extern void put_mtd_device(struct mtd_info *mtd);
 
+extern int32_t mtd_read_skip_bad(struct mtd_info *mtd, loff_t from, size_t len, size_t *retlen,
+                                 loff_t *span, uint8_t *buf);
+extern int32_t mtd_write_skip_bad(struct mtd_info *mtd, loff_t to, size_t len, size_t *retlen,
+                                  loff_t *span, const uint8_t *buf);
+
+extern int32_t mtd_submit(struct mtd_info *mtd, struct mtd_request *req);
+extern int32_t mtd_poll(struct mtd_info *mtd);
+extern int32_t mtd_wait(struct mtd_info *mtd, struct mtd_request *req);
+extern int32_t mtd_submit_wait(struct mtd_info *mtd, struct mtd_request *req);
+extern void mtd_request_done(struct mtd_request *req, int32_t status);
+
 
 
 #ifdef CONFIG_MTD_PARTITIONS
@@ -136,12 +136,19 @@ struct nand_ecclayout {
  * @failed:	number of uncorrectable errors
  * @badblocks:	number of bad blocks in this partition
  * @bbtblocks:	number of blocks reserved for bad block tables
+ * @max_bitflips:	largest number of bitflips seen in a single ecc chunk
+ * @bitflip_hist:	number of ecc chunks read, indexed by bitflips in the
+ *		chunk; the last bucket counts everything above it
  */
+#define MTD_ECC_HIST_SIZE	17
+
 struct mtd_ecc_stats {
 	uint32_t corrected;
 	uint32_t failed;
 	uint32_t badblocks;
 	uint32_t bbtblocks;
+	uint32_t max_bitflips;
+	uint32_t bitflip_hist[MTD_ECC_HIST_SIZE];
 };
 
 /*
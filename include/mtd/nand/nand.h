@@ -22,6 +22,15 @@ extern int32_t nand_scan_bbt(__in struct mtd_info *mtd, __in struct nand_bbt_des
 extern int32_t nand_update_bbt(__in struct mtd_info *mtd, __in loff_t offs);
 extern int32_t nand_default_bbt(__in struct mtd_info *mtd);
 extern int32_t nand_isbad_bbt(__in struct mtd_info *mtd, __in loff_t offs, __in int32_t allowbbt);
+extern int32_t nand_bbt_next_good(__in struct mtd_info *mtd, __in loff_t offs, __out loff_t *good);
+extern int32_t nand_bbt_first_bad(__in struct mtd_info *mtd, __in loff_t offs, __in uint64_t len,
+                                  __out loff_t *bad);
+extern int32_t nand_bbt_skip_bad(__in struct mtd_info *mtd, __in loff_t from, __in loff_t offs,
+                                 __out loff_t *phys);
+extern int32_t nand_read_bbm(__in struct mtd_info *mtd, __in loff_t from, __in int32_t numblocks,
+                             __in int32_t numpages, __in int32_t column, __in int32_t len,
+                             __out uint8_t *buf);
+extern int32_t nand_plane_status(__in struct mtd_info *mtd);
 extern int32_t board_nand_init(__in struct nand_chip *chip);
 
 
@@ -29,6 +38,25 @@ extern int32_t board_nand_init(__in struct nand_chip *chip);
 #define NAND_MAX_OOBSIZE	(218 * CONFIG_SYS_NAND_MAX_CHIPS)
 #define NAND_MAX_PAGESIZE	(4096 * CONFIG_SYS_NAND_MAX_CHIPS)
 
+/* 页缓存路数，至少1路 */
+#ifndef CONFIG_SYS_NAND_PAGE_CACHE
+#define CONFIG_SYS_NAND_PAGE_CACHE	1
+#endif
+
+/* 顺序读时预读的页数，0表示不预读 */
+#ifndef CONFIG_SYS_NAND_READAHEAD
+#define CONFIG_SYS_NAND_READAHEAD	0
+#endif
+
+/* 按擦除块条带的芯片数，1表示不使用条带 */
+#ifndef CONFIG_SYS_NAND_STRIPE_CHIPS
+#define CONFIG_SYS_NAND_STRIPE_CHIPS	1
+#endif
+
+/* 批量扫描坏块标记时每批的块数和标记的最大长度 */
+#define NAND_BBM_BATCH		32
+#define NAND_BBM_MAX_LEN	8
+
 /*
 * 出场坏块标记位置
 */
@@ -56,18 +84,24 @@ extern int32_t board_nand_init(__in struct nand_chip *chip);
 #define NAND_CMD_READ1		         0x01
 #define NAND_CMD_READOOB	         0x50
 #define NAND_CMD_READSTART	         0x30
+#define NAND_CMD_MULTI_READSTART     0x32
 #define NAND_CMD_CACHEREADSTART      0x31
+#define NAND_CMD_CACHEREADEND        0x3f
 
 #define NAND_CMD_RNDIN		         0x85
 #define NAND_CMD_RNDOUT		         0x05
 #define NAND_CMD_RNDOUTSTART	     0xe0
+/* 多plane读之后选择输出数据的plane和列地址(06h-地址-e0h) */
+#define NAND_CMD_RNDOUT_PLANE        0x06
 
 #define NAND_CMD_SEQIN		         0x80
 #define NAND_CMD_PAGEPROG	         0x10
 #define NAND_CMD_CACHEDPROG          0x15
+#define NAND_CMD_MULTI_PROG          0x11
 
 #define NAND_CMD_ERASE1		         0x60
 #define NAND_CMD_ERASE2		         0xd0
+#define NAND_CMD_MULTI_ERASE2        0xd1
 
 #define NAND_CMD_STATUS		         0x70
 #define NAND_CMD_STATUS_MULTI	     0x71
@@ -76,6 +110,20 @@ extern int32_t board_nand_init(__in struct nand_chip *chip);
 
 #define NAND_CMD_RESET		         0xff
 
+/* ONFI/JEDEC扩展指令 */
+#define NAND_CMD_PARAM		         0xec
+#define NAND_CMD_GET_FEATURES	     0xee
+#define NAND_CMD_SET_FEATURES	     0xef
+
+/* 这些指令只有一个字节的地址，并且16位总线时地址不需要移位 */
+#define NAND_CMD_8BIT_ADDR(cmd)      (((cmd) == NAND_CMD_READID) || \
+                                      ((cmd) == NAND_CMD_PARAM) || \
+                                      ((cmd) == NAND_CMD_GET_FEATURES) || \
+                                      ((cmd) == NAND_CMD_SET_FEATURES))
+
+/* ONFI特性地址: 时序模式 */
+#define ONFI_FEATURE_ADDR_TIMING_MODE 0x01
+
 /* 空指令 */
 #define NAND_CMD_NONE		         -1
 
@@ -86,6 +134,10 @@ extern int32_t board_nand_init(__in struct nand_chip *chip);
 #define NAND_STATUS_READY	         0x40
 #define NAND_STATUS_WP		         0x80
 
+/* 多plane状态(0x71)，bit0是两个plane的合并结果 */
+#define NAND_STATUS_FAIL_PLANE0      0x02
+#define NAND_STATUS_FAIL_PLANE1      0x04
+
 
 
 /*
@@ -115,6 +167,12 @@ extern int32_t board_nand_init(__in struct nand_chip *chip);
 #define NAND_CACHEPRG		0x00000008
 /* Chip has copy back function */
 #define NAND_COPYBACK		0x00000010
+/* 芯片支持缓存读(0x31/0x3f)，读出当前页的同时装载下一页 */
+#define NAND_CACHEREAD		0x00000020
+/* 芯片支持两个plane同时读取、编程和擦除(0x32/0x11/0xd1)，plane地址是块号的最低位 */
+#define NAND_MULTI_PLANE	0x00000040
+/* 芯片支持两个plane同时读取之后用06h-e0h选择输出的plane，来自参数页 */
+#define NAND_MULTI_PLANE_READ	0x00000080
 /* Chip does not require ready check on read. True
  * for all large page devices, as they do not support
  * autoincrement.*/
@@ -128,6 +186,9 @@ extern int32_t board_nand_init(__in struct nand_chip *chip);
 #define NAND_MUST_PAD(chip) (!(chip->options & NAND_NO_PADDING))
 #define NAND_HAS_CACHEPROG(chip) ((chip->options & NAND_CACHEPRG))
 #define NAND_HAS_COPYBACK(chip) ((chip->options & NAND_COPYBACK))
+#define NAND_HAS_CACHEREAD(chip) ((chip->options & NAND_CACHEREAD))
+#define NAND_HAS_MULTIPLANE(chip) ((chip->options & NAND_MULTI_PLANE) && (chip->planes > 1))
+#define NAND_HAS_MULTIPLANE_READ(chip) (NAND_HAS_MULTIPLANE(chip) && (chip->options & NAND_MULTI_PLANE_READ))
 /* Large page NAND with SOFT_ECC should support subpage reads */
 #define NAND_SUBPAGE_READ(chip) ((chip->ecc.mode == NAND_ECC_SOFT) \
 					&& (chip->page_shift > 9))
@@ -182,8 +243,11 @@ typedef enum
 	NAND_ECC_SOFT,
 	NAND_ECC_HW,
 	NAND_ECC_HW_SYNDROME,
+	NAND_ECC_SOFT_BCH,
 } nand_ecc_modes_t;
 
+struct bch_control;
+
 
 
 /* ecc控制 */
@@ -194,6 +258,9 @@ struct nand_ecc_ctrl
 	int32_t data_size_per_step; /* 每块ecc管理多少字节数据 */
 	int32_t ecc_bytes_per_step; /* 每块ecc字节数 */
 	int32_t ecc_total_bytes_per_page; /* 一页ecc总字节数 */
+	int32_t ecc_strength; /* 每块ecc最多可纠正的位数，软件bch使用，0使用默认值 */
+	struct bch_control *bch; /* 软件bch编解码器 */
+	uint8_t *bch_eccmask; /* 擦除页的ecc掩码，保证全0xff的页ecc也是全0xff */
 	uint8_t ecc_calcbuf[NAND_MAX_OOBSIZE]; /* 计算出的ecc数据保存缓冲区 */
 	uint8_t ecc_codebuf[NAND_MAX_OOBSIZE]; /* 从nandflash读出的ecc数据保存缓冲区*/
 	struct nand_ecclayout *layout; /* ecc布局 */
@@ -202,13 +269,63 @@ struct nand_ecc_ctrl
 	int32_t (*correct)(uint8_t *data, uint8_t *read_ecc, uint8_t *calc_ecc);
 	int32_t (*read_page_raw)(struct mtd_info *mtd, uint8_t *buf);
 	int32_t (*write_page_raw)(struct mtd_info *mtd, const uint8_t *buf);
-	int32_t (*read_page)(struct mtd_info *mtd, uint8_t *buf);
+	int32_t (*read_page)(struct mtd_info *mtd, uint8_t *buf); /* 返回单个ecc块最多的翻转位数，无法纠正时可以返回-EBADMSG(已计入ecc_stats) */
 	int32_t (*read_subpage)(struct mtd_info *mtd, uint32_t offs, uint32_t len, uint8_t *buf);
+	int32_t (*read_multi_page)(struct mtd_info *mtd, int32_t page, int32_t count, uint8_t *buf); /* 连续读取一块内的多页，芯片支持缓存读时需要使用缓存读，可选 */
+	int32_t (*read_interleave)(struct mtd_info *mtd, int32_t count, const int32_t *chips, const int32_t *pages, uint8_t **bufs); /* 从count个不同芯片各读一页，可选 */
+	int32_t (*read_multi_start)(struct mtd_info *mtd, int32_t page, int32_t count, uint8_t *buf); /* 开始读取一块内的多页，不等待完成，返回开始的页数，0表示只能同步读取，可选 */
+	int32_t (*read_multi_finish)(struct mtd_info *mtd, int32_t wait); /* 收集read_multi_start的结果，没有完成且wait为0时返回-EBUSY */
 	int32_t (*write_page)(struct mtd_info *mtd, const uint8_t *buf);
+	int32_t (*write_multi_page)(struct mtd_info *mtd, int32_t page, int32_t count, const uint8_t *buf, int32_t raw); /* 连续写入一块内的多页，芯片支持缓存编程时需要使用缓存编程，可选 */
+	int32_t (*write_multi_plane)(struct mtd_info *mtd, int32_t page, int32_t count, const uint8_t *buf0, const uint8_t *buf1, int32_t raw); /* 两个plane上成对的块从page开始各写count页，page在plane0上，可选 */
+	int32_t (*write_page_start)(struct mtd_info *mtd, int32_t page, const uint8_t *buf, int32_t raw); /* 开始编程一页，不等待传输和编程完成，返回1表示已经开始，0表示只能同步写入，可选 */
+	int32_t (*write_page_finish)(struct mtd_info *mtd, int32_t wait); /* 收集write_page_start的结果，没有完成且wait为0时返回-EBUSY */
 	int32_t (*read_oob)(struct mtd_info *mtd, int32_t page, int32_t sndcmd);
 	int32_t (*write_oob)(struct mtd_info *mtd, int32_t page);
 };
 
+/* 页缓存中的一页，只保存经过ecc校验的data区 */
+struct nand_page_cache
+{
+	int32_t page; /* 缓存的物理页，-1表示无效 */
+	uint32_t stamp; /* 最近一次命中的时间戳，最小的最先被替换 */
+	uint8_t data[NAND_MAX_PAGESIZE];
+};
+
+/* 页缓存统计 */
+struct nand_cache_stats
+{
+	uint32_t hits; /* 命中的页数 */
+	uint32_t misses; /* 没有命中，从芯片读取的页数 */
+	uint32_t readahead; /* 预读的页数 */
+	uint32_t readahead_corrected; /* 预读页中纠正的位数，不计入ecc_stats */
+	uint32_t evictions; /* 被替换出去的有效页数 */
+};
+
+/* 流水线擦除时每个芯片上正在进行的擦除 */
+struct nand_erase_slot
+{
+    loff_t ofs; /* 正在擦除的逻辑地址，-1表示空闲 */
+    loff_t next; /* 该芯片上下一个要擦除的逻辑地址 */
+    int32_t pair; /* 是否两个plane一起擦除 */
+};
+
+/* 一次擦除的进度，同步擦除和异步擦除请求共用 */
+struct nand_erase_ctx
+{
+    struct erase_info *instr; /* 擦除信息 */
+    struct nand_erase_slot slots[CONFIG_SYS_NAND_MAX_CHIPS]; /* 当前芯片分组中每个芯片的擦除状态 */
+    loff_t end; /* 擦除区域的结束地址 */
+    int32_t base; /* 当前芯片分组的第一个芯片 */
+    int32_t busy; /* 当前分组中正在擦除的芯片数 */
+    int32_t failed; /* 失败的擦除次数 */
+    int32_t bad; /* 跳过的坏块数 */
+    int32_t check_bad; /* 区域中可能有坏块，开始擦除之前逐块检查 */
+    int32_t allowbbt; /* 是否允许擦除bbt区域 */
+    int32_t active; /* 擦除已经开始还没有结束 */
+    uint32_t start; /* 最近一次有芯片完成的时间，微秒 */
+};
+
 /* nanflash芯片控制结构体 */
 struct nand_chip
 {
@@ -236,6 +353,7 @@ struct nand_chip
 	void (*select_chip)(__in struct mtd_info *mtd, __in int32_t chipnr);
 	int (*block_bad)(__in struct mtd_info *mtd, __in loff_t ofs, __in  int32_t getchip);
 	int (*block_markbad)(struct mtd_info *mtd, loff_t ofs);
+	int32_t (*read_bbm)(__in struct mtd_info *mtd, __in const int32_t *pages, __in int32_t count, __in int32_t column, __in int32_t len, __out uint8_t *buf); /* 批量读取已选中芯片上多页的坏块标记，每页len字节 */
 
 	void (*cmdfunc)(__in struct mtd_info *mtd, __in uint32_t command, __in int32_t column, __in int32_t page_addr);
 	int (*waitfunc)(struct mtd_info *mtd);
@@ -254,9 +372,14 @@ struct nand_chip
 	int32_t chip_shift; /* 一片nandflash组的大小, 以移位表示(目前仅支持单片(一个CE#选择)大小4G以下的flash) */
 
 	int32_t numchips; /* nandflash物理芯片的数量, 按CE#脚数量计算 */
+	int32_t stripe_chips; /* 条带芯片数，大于1时连续的逻辑块轮流分布到stripe_chips个芯片上，板级初始化时设置 */
+	int32_t planes; /* 每个芯片可以同时操作的plane数，不支持多plane操作时为1 */
 	uint64_t chipsize; /* 一片物理nandflash的总大小, 内部可能包含多个plane, 所以大小可能超过4g */
 
-	int32_t pagebuf; /* 当前缓冲区中保存的数据属于的页数 */
+	struct nand_page_cache page_cache[CONFIG_SYS_NAND_PAGE_CACHE]; /* 页缓存，LRU替换 */
+	uint32_t cache_clock; /* 页缓存时间戳 */
+	int32_t cache_last; /* 上一次从芯片读取的物理页，用于检测顺序读 */
+	struct nand_cache_stats cache_stats; /* 页缓存统计 */
 	uint8_t cellinfo;
 
 	int32_t badblockpos; /* 坏块标记位置 */
@@ -270,11 +393,24 @@ struct nand_chip
 	uint8_t *bbt; /* bbt数据缓冲区 */
 	struct nand_bbt_desc *bbt_td; /* 原始bbt描述符,必须存在 */
 	struct nand_bbt_desc *bbt_md; /* 镜像bbt描述符,可以不存在 */
+	uint32_t *bbt_rank; /* bbt中每个32位字(16块)之前的好块数，最后一项为好块总数 */
+	uint32_t *bbt_good; /* 好块索引，第n个好块的块号 */
+	int32_t bbt_index_valid; /* bbt_rank和bbt_good是否和bbt一致，bbt改变后清0 */
 
 	struct nand_bbt_desc *badblock_pattern;
 
 	struct nand_timing *timing; /* 物理芯片的时序 */
 
+	struct mtd_request *req_head; /* 异步请求队列，队首的请求正在处理 */
+	struct mtd_request *req_tail;
+	int32_t req_active; /* 队首请求已经开始 */
+	int32_t req_running; /* 正在执行队首请求的一步，期间驱动内部的同步调用不经过队列直接执行 */
+	int32_t req_chain; /* 队首读请求正在执行的dma链页数，0表示没有 */
+	int32_t req_prog; /* 队首写请求正在编程的页数，0表示没有 */
+	int32_t req_error; /* 队首请求在dma链或者编程中出现的错误 */
+	struct mtd_ecc_stats req_stats; /* 队首请求开始时的ecc统计 */
+	struct nand_erase_ctx req_erase; /* 队首擦除请求的进度 */
+
     /*--------------------------可选支持------------------------*/
 	void *priv;
 	int (*errstat)(__in struct mtd_info *mtd, __in int32_t state, __in int32_t status, __in int32_t page);
@@ -56,6 +56,12 @@ struct nand_device_info
 
 	/* nandflash描述 */
 	const int8_t  *description;
+
+	/* 每个芯片可以同时操作的plane数，0和1都表示不支持多plane操作 */
+	uint32_t planes;
+
+	/* 需要通过SET FEATURES设置的ONFI时序模式，0为上电默认模式，不需要设置 */
+	int32_t timing_mode;
 };
 
 
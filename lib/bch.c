@@ -0,0 +1,588 @@
+#include "bch.h"
+#include "errno.h"
+#include "malloc.h"
+#include "string.h"
+#include "bitops.h"
+
+
+/*
+* 二进制BCH编解码，按位顺序把数据看成GF(2)上的多项式:
+* 第0个字节的最高位是最高次项，ecc紧跟在数据后面，ecc最后一位是x^0项
+* 编码: 按字节查表求data(x)*x^ecc_bits除以生成多项式的余数
+* 解码: 余数差值求伴随式 -> berlekamp-massey求错误位置多项式 -> chien搜索求根
+*/
+
+/* GF(2^m)本原多项式，下标为m-BCH_MIN_M */
+static const uint32_t bch_prim_poly[] =
+{
+    0x25, 0x43, 0x83, 0x11d, 0x211, 0x409, 0x805, 0x1053, 0x201b, 0x402b, 0x8003
+};
+
+
+
+/********************************************************************************
+* 函数: static inline uint32_t gf_mod_n(__in struct bch_control *bch,
+                                       __in uint32_t v)
+* 描述: 对数值对n取模
+* 输入: bch: bch控制结构体
+       v: 需要取模的对数值，小于2n
+* 输出: none
+* 返回: 取模后的值
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static inline uint32_t gf_mod_n(__in struct bch_control *bch, __in uint32_t v)
+{
+    while(v >= bch->n)
+        v -= bch->n;
+
+    return v;
+}
+
+/********************************************************************************
+* 函数: static inline uint32_t gf_mul(__in struct bch_control *bch,
+                                     __in uint32_t a, __in uint32_t b)
+* 描述: GF(2^m)乘法
+* 输入: bch: bch控制结构体
+       a: 乘数
+       b: 乘数
+* 输出: none
+* 返回: a*b
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static inline uint32_t gf_mul(__in struct bch_control *bch, __in uint32_t a,
+                              __in uint32_t b)
+{
+    if(!a || !b)
+        return 0;
+
+    return bch->a_pow_tab[gf_mod_n(bch, bch->a_log_tab[a] + bch->a_log_tab[b])];
+}
+
+/********************************************************************************
+* 函数: static inline uint32_t gf_div(__in struct bch_control *bch,
+                                     __in uint32_t a, __in uint32_t b)
+* 描述: GF(2^m)除法
+* 输入: bch: bch控制结构体
+       a: 被除数
+       b: 除数，不能为0
+* 输出: none
+* 返回: a/b
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static inline uint32_t gf_div(__in struct bch_control *bch, __in uint32_t a,
+                              __in uint32_t b)
+{
+    if(!a)
+        return 0;
+
+    return bch->a_pow_tab[gf_mod_n(bch, bch->a_log_tab[a] + bch->n -
+                                   bch->a_log_tab[b])];
+}
+
+/********************************************************************************
+* 函数: static void bch_shift_left(__inout uint32_t *r, __in uint32_t words,
+                                  __in uint32_t bits)
+* 描述: 左对齐的多字余数整体左移
+* 输入: r: 余数
+       words: 余数字数
+       bits: 移动位数，1~31
+* 输出: r: 移位后的余数
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void bch_shift_left(__inout uint32_t *r, __in uint32_t words, __in uint32_t bits)
+{
+    uint32_t i;
+
+    for(i = 0; i < words - 1; i++)
+        r[i] = (r[i] << bits) | (r[i + 1] >> (32 - bits));
+    r[i] <<= bits;
+}
+
+/********************************************************************************
+* 函数: static void bch_encode_raw(__in struct bch_control *bch,
+                                  __in const uint8_t *data, __in uint32_t len,
+                                  __out uint32_t *r)
+* 描述: 按字节查表计算data(x)*x^ecc_bits除以生成多项式的余数
+* 输入: bch: bch控制结构体
+       data: 数据
+       len: 数据长度
+* 输出: r: 左对齐的余数，ecc_words个字
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void bch_encode_raw(__in struct bch_control *bch, __in const uint8_t *data,
+                           __in uint32_t len, __out uint32_t *r)
+{
+    const uint32_t *tab;
+    uint32_t i, last = bch->ecc_words - 1;
+
+    memset(r, 0, bch->ecc_words * sizeof(uint32_t));
+
+    while(len--)
+    {
+        tab = bch->mod8_tab + ((r[0] >> 24) ^ *data++) * bch->ecc_words;
+        for(i = 0; i < last; i++)
+            r[i] = ((r[i] << 8) | (r[i + 1] >> 24)) ^ tab[i];
+        r[last] = (r[last] << 8) ^ tab[last];
+    }
+}
+
+/********************************************************************************
+* 函数: static int32_t bch_build_tables(__in struct bch_control *bch)
+* 描述: 生成GF(2^m)的指数/对数表，求生成多项式，并生成按字节编码的余数表
+        生成多项式为α^1, α^3 ... α^(2t-1)所在分圆陪集全部根的乘积
+* 输入: bch: bch控制结构体，m/n/t已经设置
+* 输出: none
+* 返回: 0: 成功
+       -EINVAL: 参数不能构造有效的码
+       -ENOMEM: 内存不足
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t bch_build_tables(__in struct bch_control *bch)
+{
+    uint32_t i, j, x, r, deg, fb, v;
+    uint32_t poly = bch_prim_poly[bch->m - BCH_MIN_M];
+    uint32_t *genpoly, *gbits, *tab;
+    uint8_t *roots;
+
+    /* 指数/对数表 */
+    x = 1;
+    for(i = 0; i < bch->n; i++)
+    {
+        bch->a_pow_tab[i] = x;
+        bch->a_log_tab[x] = i;
+        x <<= 1;
+        if(x & (1 << bch->m))
+            x ^= poly;
+    }
+    bch->a_pow_tab[bch->n] = 1;
+    bch->a_log_tab[0] = 0;
+
+    /* 标记所有根 */
+    roots = dlmalloc(bch->n + 1);
+    genpoly = dlmalloc((bch->m * bch->t + 1) * sizeof(uint32_t));
+    if(!roots || !genpoly)
+    {
+        dlfree((int8_t *)roots);
+        dlfree((int8_t *)genpoly);
+        return -ENOMEM;
+    }
+    memset(roots, 0, bch->n + 1);
+    for(i = 0; i < bch->t; i++)
+    {
+        r = 2 * i + 1;
+        do
+        {
+            roots[r] = 1;
+            r = gf_mod_n(bch, 2 * r);
+        }while(r != 2 * i + 1);
+    }
+
+    /* g(x) = ∏(x + α^r) */
+    genpoly[0] = 1;
+    deg = 0;
+    for(r = 0; r < bch->n; r++)
+    {
+        if(!roots[r])
+            continue;
+
+        x = bch->a_pow_tab[r];
+        genpoly[deg + 1] = 1;
+        for(j = deg; j > 0; j--)
+            genpoly[j] = genpoly[j - 1] ^ gf_mul(bch, genpoly[j], x);
+        genpoly[0] = gf_mul(bch, genpoly[0], x);
+        deg++;
+    }
+    dlfree((int8_t *)roots);
+
+    if((deg < 8) || (deg > bch->m * bch->t))
+    {
+        dlfree((int8_t *)genpoly);
+        return -EINVAL;
+    }
+
+    bch->ecc_bits = deg;
+    bch->ecc_bytes = (deg + 7) / 8;
+    bch->ecc_words = (deg + 31) / 32;
+
+    bch->mod8_tab = dlmalloc(256 * bch->ecc_words * sizeof(uint32_t));
+    gbits = dlmalloc(bch->ecc_words * sizeof(uint32_t));
+    if(!bch->mod8_tab || !gbits)
+    {
+        dlfree((int8_t *)gbits);
+        dlfree((int8_t *)genpoly);
+        return -ENOMEM;
+    }
+
+    /* 去掉最高次项后左对齐的生成多项式 */
+    memset(gbits, 0, bch->ecc_words * sizeof(uint32_t));
+    for(i = 0; i < deg; i++)
+    {
+        if(genpoly[deg - 1 - i])
+            gbits[i / 32] |= 0x80000000 >> (i % 32);
+    }
+    dlfree((int8_t *)genpoly);
+
+    /* mod8_tab[v] = v(x)*x^ecc_bits mod g(x) */
+    for(v = 0; v < 256; v++)
+    {
+        tab = bch->mod8_tab + v * bch->ecc_words;
+        memset(tab, 0, bch->ecc_words * sizeof(uint32_t));
+        for(i = 8; i > 0; i--)
+        {
+            fb = (tab[0] >> 31) ^ ((v >> (i - 1)) & 0x01);
+            bch_shift_left(tab, bch->ecc_words, 1);
+            if(fb)
+            {
+                for(j = 0; j < bch->ecc_words; j++)
+                    tab[j] ^= gbits[j];
+            }
+        }
+    }
+    dlfree((int8_t *)gbits);
+
+    return 0;
+}
+
+/********************************************************************************
+* 函数: struct bch_control *bch_init(__in uint32_t m, __in uint32_t t)
+* 描述: 初始化bch编解码器
+* 输入: m: GF(2^m)，码长为2^m-1，数据位数+ecc位数不能超过码长
+       t: 最多可纠正的位数
+* 输出: none
+* 返回: bch控制结构体，失败返回NULL
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+struct bch_control *bch_init(__in uint32_t m, __in uint32_t t)
+{
+    struct bch_control *bch;
+
+    if((m < BCH_MIN_M) || (m > BCH_MAX_M) || !t || (t > BCH_MAX_T) ||
+       (m * t >= (1 << m) - 1))
+        return NULL;
+
+    bch = dlmalloc(sizeof(struct bch_control));
+    if(!bch)
+        return NULL;
+
+    memset(bch, 0, sizeof(struct bch_control));
+    bch->m = m;
+    bch->n = (1 << m) - 1;
+    bch->t = t;
+
+    bch->a_pow_tab = dlmalloc((bch->n + 1) * sizeof(uint16_t));
+    bch->a_log_tab = dlmalloc((bch->n + 1) * sizeof(uint16_t));
+    bch->syn = dlmalloc(2 * t * sizeof(uint32_t));
+    bch->elp = dlmalloc((2 * t + 1) * sizeof(uint32_t));
+    bch->elp_prev = dlmalloc((2 * t + 1) * sizeof(uint32_t));
+    bch->elp_tmp = dlmalloc((2 * t + 1) * sizeof(uint32_t));
+    bch->chien = dlmalloc((t + 1) * sizeof(uint32_t));
+    bch->errloc = dlmalloc(t * sizeof(uint32_t));
+    if(!bch->a_pow_tab || !bch->a_log_tab || !bch->syn || !bch->elp ||
+       !bch->elp_prev || !bch->elp_tmp || !bch->chien || !bch->errloc)
+        goto fail;
+
+    if(bch_build_tables(bch))
+        goto fail;
+
+    bch->ecc_buf = dlmalloc(bch->ecc_words * sizeof(uint32_t));
+    bch->ecc_buf2 = dlmalloc(bch->ecc_words * sizeof(uint32_t));
+    if(!bch->ecc_buf || !bch->ecc_buf2)
+        goto fail;
+
+    return bch;
+
+fail:
+    bch_free(bch);
+    return NULL;
+}
+
+/********************************************************************************
+* 函数: void bch_free(__in struct bch_control *bch)
+* 描述: 释放bch编解码器
+* 输入: bch: bch控制结构体
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+void bch_free(__in struct bch_control *bch)
+{
+    if(!bch)
+        return ;
+
+    dlfree((int8_t *)bch->a_pow_tab);
+    dlfree((int8_t *)bch->a_log_tab);
+    dlfree((int8_t *)bch->mod8_tab);
+    dlfree((int8_t *)bch->ecc_buf);
+    dlfree((int8_t *)bch->ecc_buf2);
+    dlfree((int8_t *)bch->syn);
+    dlfree((int8_t *)bch->elp);
+    dlfree((int8_t *)bch->elp_prev);
+    dlfree((int8_t *)bch->elp_tmp);
+    dlfree((int8_t *)bch->chien);
+    dlfree((int8_t *)bch->errloc);
+    dlfree((int8_t *)bch);
+}
+
+/********************************************************************************
+* 函数: void bch_encode(__in struct bch_control *bch, __in const uint8_t *data,
+                       __in uint32_t len, __out uint8_t *ecc)
+* 描述: 计算数据的bch ecc
+* 输入: bch: bch控制结构体
+       data: 数据
+       len: 数据长度
+* 输出: ecc: ecc数据，ecc_bytes个字节，最后一个字节多余的低位为0
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+void bch_encode(__in struct bch_control *bch, __in const uint8_t *data,
+                __in uint32_t len, __out uint8_t *ecc)
+{
+    uint32_t i;
+
+    bch_encode_raw(bch, data, len, bch->ecc_buf);
+
+    for(i = 0; i < bch->ecc_bytes; i++)
+        ecc[i] = (bch->ecc_buf[i / 4] >> (24 - 8 * (i % 4))) & 0xff;
+}
+
+/********************************************************************************
+* 函数: static void bch_syndromes(__in struct bch_control *bch,
+                                 __in const uint32_t *r)
+* 描述: 由余数计算2t个伴随式，S(j) = r(α^j)，偶数项S(2j) = S(j)^2
+* 输入: bch: bch控制结构体
+       r: 左对齐的余数
+* 输出: none
+* 返回: none
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static void bch_syndromes(__in struct bch_control *bch, __in const uint32_t *r)
+{
+    uint32_t i, j, d, pos, step, w;
+    uint32_t *syn = bch->syn;
+
+    memset(syn, 0, 2 * bch->t * sizeof(uint32_t));
+
+    for(i = 0; i < bch->ecc_words; i++)
+    {
+        w = r[i];
+        while(w)
+        {
+            /* 从最高位开始取出为1的位 */
+            j = fls(w) - 1;
+            w &= ~(1u << j);
+            d = bch->ecc_bits - 1 - (i * 32 + 31 - j);
+
+            pos = d;
+            step = gf_mod_n(bch, 2 * d);
+            for(j = 0; j < 2 * bch->t; j += 2)
+            {
+                syn[j] ^= bch->a_pow_tab[pos];
+                pos = gf_mod_n(bch, pos + step);
+            }
+        }
+    }
+
+    for(j = 1; j <= bch->t; j++)
+        syn[2 * j - 1] = gf_mul(bch, syn[j - 1], syn[j - 1]);
+}
+
+/********************************************************************************
+* 函数: static int32_t bch_compute_elp(__in struct bch_control *bch)
+* 描述: berlekamp-massey算法计算错误位置多项式
+* 输入: bch: bch控制结构体，伴随式已经计算好
+* 输出: none
+* 返回: 错误位置多项式的阶
+       -EBADMSG: 错误位数超过纠错能力
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t bch_compute_elp(__in struct bch_control *bch)
+{
+    uint32_t *c = bch->elp, *b = bch->elp_prev, *tmp = bch->elp_tmp;
+    uint32_t *syn = bch->syn;
+    uint32_t i, r, d, coef, bd = 1, k = 1, l = 0;
+    uint32_t size = (2 * bch->t + 1) * sizeof(uint32_t);
+
+    memset(c, 0, size);
+    memset(b, 0, size);
+    c[0] = 1;
+    b[0] = 1;
+
+    for(r = 0; r < 2 * bch->t; r++)
+    {
+        /* 偏差 */
+        d = syn[r];
+        for(i = 1; i <= l; i++)
+            d ^= gf_mul(bch, c[i], syn[r - i]);
+
+        if(!d)
+        {
+            k++;
+            continue;
+        }
+
+        coef = gf_div(bch, d, bd);
+        if(2 * l <= r)
+        {
+            memcpy(tmp, c, size);
+            for(i = 0; i + k <= 2 * bch->t; i++)
+                c[i + k] ^= gf_mul(bch, coef, b[i]);
+            l = r + 1 - l;
+            memcpy(b, tmp, size);
+            bd = d;
+            k = 1;
+        }
+        else
+        {
+            for(i = 0; i + k <= 2 * bch->t; i++)
+                c[i + k] ^= gf_mul(bch, coef, b[i]);
+            k++;
+        }
+    }
+
+    if((l > bch->t) || !c[l])
+        return -EBADMSG;
+
+    return l;
+}
+
+/********************************************************************************
+* 函数: static int32_t bch_chien_search(__in struct bch_control *bch,
+                                       __in uint32_t deg, __in uint32_t nbits)
+* 描述: 求错误位置多项式的根，码字是缩短码，只搜索实际存在的nbits个位置;
+        一阶多项式直接求根，找齐deg个根后提前结束
+* 输入: bch: bch控制结构体
+       deg: 错误位置多项式的阶
+       nbits: 码字实际位数(数据+ecc)
+* 输出: none
+* 返回: 找到的根的个数
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+static int32_t bch_chien_search(__in struct bch_control *bch, __in uint32_t deg,
+                                __in uint32_t nbits)
+{
+    uint32_t *elp = bch->elp, *logs = bch->chien, *terms = bch->elp_tmp;
+    uint32_t i, p, sum, cnt = 0, found = 0;
+
+    if(deg == 1)
+    {
+        /* elp(x) = 1 + X*x，X = α^p */
+        p = bch->a_log_tab[elp[1]];
+        if(p >= nbits)
+            return 0;
+
+        bch->errloc[0] = p;
+        return 1;
+    }
+
+    /* 只保留非0项 */
+    for(i = 1; i <= deg; i++)
+    {
+        if(elp[i])
+        {
+            terms[cnt] = i;
+            logs[cnt] = bch->a_log_tab[elp[i]];
+            cnt++;
+        }
+    }
+
+    /* elp(α^-p) = 1 + ∑elp[i]*α^(-p*i) */
+    for(p = 0; p < nbits; p++)
+    {
+        sum = 1;
+        for(i = 0; i < cnt; i++)
+        {
+            sum ^= bch->a_pow_tab[logs[i]];
+            logs[i] = gf_mod_n(bch, logs[i] + bch->n - terms[i]);
+        }
+
+        if(!sum)
+        {
+            bch->errloc[found++] = p;
+            if(found == deg)
+                break;
+        }
+    }
+
+    return found;
+}
+
+/********************************************************************************
+* 函数: int32_t bch_decode(__in struct bch_control *bch, __inout uint8_t *data,
+                          __in uint32_t len, __in const uint8_t *recv_ecc,
+                          __in const uint8_t *calc_ecc)
+* 描述: 检查并纠正数据中的位错误
+* 输入: bch: bch控制结构体
+       data: 读取到的数据
+       len: 数据长度
+       recv_ecc: 读取到的ecc
+       calc_ecc: 根据读取到的数据计算出的ecc
+* 输出: data: 纠正后的数据
+* 返回: >=0: 纠正的位数(包括ecc中的错误位)
+       -EINVAL: 数据太长
+       -EBADMSG: 错误位数超过纠错能力
+* 作者:
+* 版本: v1.0
+**********************************************************************************/
+int32_t bch_decode(__in struct bch_control *bch, __inout uint8_t *data,
+                   __in uint32_t len, __in const uint8_t *recv_ecc,
+                   __in const uint8_t *calc_ecc)
+{
+    uint32_t *r = bch->ecc_buf2;
+    uint32_t i, nbits, diff = 0, q;
+    int32_t deg, cnt;
+
+    nbits = len * 8 + bch->ecc_bits;
+    if(nbits > bch->n)
+        return -EINVAL;
+
+    /* 余数之差 */
+    memset(r, 0, bch->ecc_words * sizeof(uint32_t));
+    for(i = 0; i < bch->ecc_bytes; i++)
+    {
+        r[i / 4] |= (uint32_t)(recv_ecc[i] ^ calc_ecc[i]) << (24 - 8 * (i % 4));
+        diff |= recv_ecc[i] ^ calc_ecc[i];
+    }
+    if(!diff)
+        return 0;
+
+    /* 去掉最后一个字节中多余的位 */
+    if(bch->ecc_bits % 32)
+        r[bch->ecc_words - 1] &= ~(0xffffffff >> (bch->ecc_bits % 32));
+
+    bch_syndromes(bch, r);
+
+    deg = bch_compute_elp(bch);
+    if(deg <= 0)
+        return (deg == 0) ? 0 : deg;
+
+    cnt = bch_chien_search(bch, deg, nbits);
+    if(cnt != deg)
+        return -EBADMSG;
+
+    /* 纠正数据区的错误，ecc区的错误不需要处理 */
+    for(i = 0; i < cnt; i++)
+    {
+        if(bch->errloc[i] < bch->ecc_bits)
+            continue;
+
+        q = bch->errloc[i] - bch->ecc_bits;
+        data[len - 1 - (q >> 3)] ^= (1 << (q & 0x07));
+    }
+
+    return cnt;
+}
+
@@ -1,5 +1,7 @@
 #include "ecc.h"
 #include "errno.h"
+#include "config.h"
+#include "cpu_endian.h"
 
 /* ECC预处理表 */
 static const uint8_t ecc_precalc_table[] =
@@ -42,37 +44,21 @@ static inline int32_t countbits(__in uint32_t byte)
 }
 
 /********************************************************************************
-* 函数: int32_t calculate_ecc(__in const uint8_t *data,
-                                  __out uint8_t *ecc_code)
-* 描述: 计算ecc
-* 输入: data: 需要计算的数据
+* 函数: static void ecc_make_code(__in uint32_t reg1, __in uint32_t reg2,
+                                  __in uint32_t reg3, __out uint8_t *ecc_code)
+* 描述: 根据列极性和行极性生成3字节ecc
+* 输入: reg1: 列极性
+       reg2: 行极性(字节序号对应位为1的行)
+       reg3: 行极性(字节序号对应位为0的行)
 * 输出: ecc_code: 计算出来的ecc数据
-* 返回: 0: 正常
-       -1: 失败
+* 返回: none
 * 作者:
 * 版本: V1.0
 **********************************************************************************/
-int32_t ecc_calculate(__in const uint8_t *data, __out uint8_t *ecc_code)
+static void ecc_make_code(__in uint32_t reg1, __in uint32_t reg2,
+                          __in uint32_t reg3, __out uint8_t *ecc_code)
 {
-    int32_t idx = 0, reg1 = 0, reg2 = 0, reg3 = 0;
-    int32_t tmp1 = 0, tmp2 = 0;
-    int32_t i = 0;
-
-    if(!data || !ecc_code)
-        return -1;
-
-    for(i = 0; i < 256; i++)
-    {
-        idx = ecc_precalc_table[*data++];
-        reg1 ^= (idx & 0x3f);
-
-        //行极性为1
-        if(idx & 0x40)
-        {
-            reg2 ^= (uint8_t)i;
-            reg3 ^= ~((uint8_t)i);
-        }
-    }
+    uint32_t tmp1, tmp2;
 
     tmp1  = (reg3 & 0x80) >> 0;
 	tmp1 |= (reg2 & 0x80) >> 1;
@@ -95,9 +81,139 @@ int32_t ecc_calculate(__in const uint8_t *data, __out uint8_t *ecc_code)
 	ecc_code[0] = ~tmp1;
 	ecc_code[1] = ~tmp2;
 	ecc_code[2] = ((~reg1 << 2)) | 0x03;
+}
 
-	return 0;
+/********************************************************************************
+* 函数: static void ecc_calculate_bytes(__in const uint8_t *data,
+                                        __out uint8_t *ecc_code)
+* 描述: 按字节查表计算ecc，用于数据地址不是字对齐的情况
+* 输入: data: 需要计算的数据
+* 输出: ecc_code: 计算出来的ecc数据
+* 返回: none
+* 作者:
+* 版本: V1.0
+**********************************************************************************/
+static void ecc_calculate_bytes(__in const uint8_t *data, __out uint8_t *ecc_code)
+{
+    uint32_t idx = 0, reg1 = 0, reg2 = 0, reg3 = 0;
+    uint32_t i = 0;
+
+    for(i = 0; i < 256; i++)
+    {
+        idx = ecc_precalc_table[*data++];
+        reg1 ^= (idx & 0x3f);
+
+        //行极性为1
+        if(idx & 0x40)
+        {
+            reg2 ^= (uint8_t)i;
+            reg3 ^= ~((uint8_t)i);
+        }
+    }
+
+    ecc_make_code(reg1, reg2, reg3, ecc_code);
+}
+
+/********************************************************************************
+* 函数: static inline uint32_t parity32(__in uint32_t val)
+* 描述: 计算32位数据的奇偶校验
+* 输入: val: 需要计算的数据
+* 输出: none
+* 返回: 1: 奇数个1
+       0: 偶数个1
+* 作者:
+* 版本: V1.0
+**********************************************************************************/
+static inline uint32_t parity32(__in uint32_t val)
+{
+    val ^= (val >> 16);
+    val ^= (val >> 8);
+    return (ecc_precalc_table[val & 0xff] >> 6) & 0x01;
+}
 
+/********************************************************************************
+* 函数: int32_t calculate_ecc(__in const uint8_t *data,
+                                  __out uint8_t *ecc_code)
+* 描述: 计算256字节数据的ecc，每次处理4个字(16字节)
+        所有字异或得到par，par折叠成一个字节查表得到列极性；
+        字节序号的bit2~bit7对应字序号的bit0~bit5，把序号对应位为1的字分别
+        异或到rp2~rp7，其奇偶即为对应的行极性；bit0/bit1在字内，直接由par
+        中相应字节的奇偶得到. 结果与逐字节查表完全一致
+* 输入: data: 需要计算的数据
+* 输出: ecc_code: 计算出来的ecc数据
+* 返回: 0: 正常
+       -1: 失败
+* 作者:
+* 版本: V1.0
+**********************************************************************************/
+int32_t ecc_calculate(__in const uint8_t *data, __out uint8_t *ecc_code)
+{
+    const uint32_t *bp;
+    uint32_t w0, w1, w2, w3, tmp;
+    uint32_t par = 0, rp2 = 0, rp3 = 0, rp4 = 0, rp5 = 0, rp6 = 0, rp7 = 0;
+    uint32_t reg1, reg2, reg3;
+    int32_t i = 0;
+
+    if(!data || !ecc_code)
+        return -1;
+
+    if((uint32_t)data & 0x03)
+    {
+        ecc_calculate_bytes(data, ecc_code);
+        return 0;
+    }
+
+    bp = (const uint32_t *)data;
+    for(i = 0; i < 16; i++)
+    {
+        w0 = le32_to_cpu(bp[0]);
+        w1 = le32_to_cpu(bp[1]);
+        w2 = le32_to_cpu(bp[2]);
+        w3 = le32_to_cpu(bp[3]);
+        bp += 4;
+
+        rp2 ^= (w1 ^ w3);
+        rp3 ^= (w2 ^ w3);
+        tmp = w0 ^ w1 ^ w2 ^ w3;
+        par ^= tmp;
+
+        if(i & 0x01)
+            rp4 ^= tmp;
+        if(i & 0x02)
+            rp5 ^= tmp;
+        if(i & 0x04)
+            rp6 ^= tmp;
+        if(i & 0x08)
+            rp7 ^= tmp;
+    }
+
+    /* 列极性 */
+    tmp = par ^ (par >> 16);
+    tmp ^= (tmp >> 8);
+    reg1 = ecc_precalc_table[tmp & 0xff] & 0x3f;
+
+    /* 行极性 */
+    reg2 = parity32(par & 0xff00ff00);
+    reg2 |= parity32(par & 0xffff0000) << 1;
+    reg2 |= parity32(rp2) << 2;
+    reg2 |= parity32(rp3) << 3;
+    reg2 |= parity32(rp4) << 4;
+    reg2 |= parity32(rp5) << 5;
+    reg2 |= parity32(rp6) << 6;
+    reg2 |= parity32(rp7) << 7;
+
+    reg3 = parity32(par & 0x00ff00ff);
+    reg3 |= parity32(par & 0x0000ffff) << 1;
+    reg3 |= parity32(par ^ rp2) << 2;
+    reg3 |= parity32(par ^ rp3) << 3;
+    reg3 |= parity32(par ^ rp4) << 4;
+    reg3 |= parity32(par ^ rp5) << 5;
+    reg3 |= parity32(par ^ rp6) << 6;
+    reg3 |= parity32(par ^ rp7) << 7;
+
+    ecc_make_code(reg1, reg2, reg3, ecc_code);
+
+	return 0;
 }
 
 
@@ -128,20 +244,24 @@ int32_t ecc_correct_data(__in uint8_t *data, __in uint8_t *read_ecc,
     if((s0 | s1 | s2) == 0)
         return 0;
 
-    if(((s0 ^ (s0 >> 1)) == 0x55) &&
-       ((s1 ^ (s1 >> 1)) == 0x55) &&
-       ((s2 ^ (s2 >> 1)) == 0x54))
+    /*
+    * 单个数据位出错时，s0/s1中每对(reg3, reg2)的两位以及s2中每对列极性的两位
+    * 恰好有一位为1. s0是字节序号的bit7~bit4，s1是bit3~bit0，取每对中的低位
+    */
+    if((((s0 ^ (s0 >> 1)) & 0x55) == 0x55) &&
+       (((s1 ^ (s1 >> 1)) & 0x55) == 0x55) &&
+       (((s2 ^ (s2 >> 1)) & 0x54) == 0x54))
     {
         uint32_t byteoffs, bitnum;
 
-        byteoffs = (s1 << 0) & 0x80;
-        byteoffs |= (s1 << 1) & 0x40;
-        byteoffs |= (s1 << 2) & 0x20;
-        byteoffs |= (s1 << 3) & 0x10;
-        byteoffs |= (s0 >> 4) & 0x08;
-        byteoffs |= (s0 >> 3) & 0x04;
-        byteoffs |= (s0 >> 2) & 0x02;
-        byteoffs |= (s0 >> 1) & 0x01;
+        byteoffs = (s0 << 1) & 0x80;
+        byteoffs |= (s0 << 2) & 0x40;
+        byteoffs |= (s0 << 3) & 0x20;
+        byteoffs |= (s0 << 4) & 0x10;
+        byteoffs |= (s1 >> 3) & 0x08;
+        byteoffs |= (s1 >> 2) & 0x04;
+        byteoffs |= (s1 >> 1) & 0x02;
+        byteoffs |= (s1 >> 0) & 0x01;
 
         bitnum = (s2 >> 5) & 0x04;
         bitnum |= (s2 >> 4) & 0x02;
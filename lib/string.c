@@ -1,6 +1,10 @@
 #include "stddef.h"
 #include "string.h"
 #include "malloc.h"
+#include "config.h"
+
+/* 地址是否字对齐 */
+#define WORD_ALIGNED(addr)    (!((uint32_t)(addr) & 0x03))
 
 /********************************************************************************
 * 函数: size_t strspn(__in const int8_t *s, __in const int8_t *accept)
@@ -364,9 +368,11 @@ int8_t *strdup(__in const int8_t *src)
 
 
 
+#ifndef CONFIG_USE_ARCH_MEMSET
 /********************************************************************************
 * 函数: void *memset(__in void *src, __in int32_t ch, __in size_t size)
-* 描述: 将src中前size字节用ch替换并返回s
+* 描述: 将src中前size字节用ch替换并返回s. 先按字节写到字对齐，之后每次写8个字，
+       最后剩下不足一个字的按字节写
 * 输入: src: 需要替换的字符串
 		ch: 替换的字符
 		size: 替换块的大小
@@ -377,20 +383,58 @@ int8_t *strdup(__in const int8_t *src)
 **********************************************************************************/
 void *memset(__in void *src, __in int32_t ch, __in size_t size)
 {
-    int8_t *psrc = (int8_t *)src;
-	if(psrc)
+	uint8_t *psrc = (uint8_t *)src;
+	uint32_t *pword;
+	uint32_t word;
+
+	if(!psrc)
+		return src;
+
+	while(size && !WORD_ALIGNED(psrc))
+	{
+		*psrc++ = ch;
+		size--;
+	}
+
+	word = (uint8_t)ch;
+	word |= word << 8;
+	word |= word << 16;
+
+	pword = (uint32_t *)psrc;
+	while(size >= 32)
+	{
+		pword[0] = word;
+		pword[1] = word;
+		pword[2] = word;
+		pword[3] = word;
+		pword[4] = word;
+		pword[5] = word;
+		pword[6] = word;
+		pword[7] = word;
+		pword += 8;
+		size -= 32;
+	}
+
+	while(size >= 4)
 	{
-		while(size--)
-			*psrc++ = ch;
+		*pword++ = word;
+		size -= 4;
 	}
 
+	psrc = (uint8_t *)pword;
+	while(size--)
+		*psrc++ = ch;
+
 	return src;
 }
+#endif
 
+#ifndef CONFIG_USE_ARCH_MEMCPY
 /********************************************************************************
 * 函数: void *memcpy(__in void *dest, __in const void *src, __in size_t num)
 * 描述: 从源src所指的内存地址的起始位置开始拷贝num个字节到目标dest所指的内存地址的
-       起始位置中
+       起始位置中. src和dest相对对齐时按字拷贝，每次8个字; 相对不对齐时dest对齐
+       之后读取对齐的src字移位拼接(小端)
 * 输入: src: 源地址
 		num: 拷贝的字节数
 * 输出: dest: 目的地址
@@ -400,18 +444,87 @@ void *memset(__in void *src, __in int32_t ch, __in size_t size)
 **********************************************************************************/
 void *memcpy(__out void *dest, __in const void *src, __in size_t num)
 {
-	int8_t *pdest = dest;
-	const int8_t *psrc = (int8_t *)src;
+	uint8_t *pdest = dest;
+	const uint8_t *psrc = (const uint8_t *)src;
+	uint32_t *pdword;
+	const uint32_t *psword;
+	uint32_t w0, w1;
+	uint32_t shift;
+
+	/* 数据太短不值得对齐 */
+	if(num < 8)
+	{
+		while(num--)
+			*pdest++ = *psrc++;
 
+		return dest;
+	}
+
+	while(!WORD_ALIGNED(pdest))
+	{
+		*pdest++ = *psrc++;
+		num--;
+	}
+
+	pdword = (uint32_t *)pdest;
+
+	if(WORD_ALIGNED(psrc))
+	{
+		psword = (const uint32_t *)psrc;
+
+		while(num >= 32)
+		{
+			pdword[0] = psword[0];
+			pdword[1] = psword[1];
+			pdword[2] = psword[2];
+			pdword[3] = psword[3];
+			pdword[4] = psword[4];
+			pdword[5] = psword[5];
+			pdword[6] = psword[6];
+			pdword[7] = psword[7];
+			pdword += 8;
+			psword += 8;
+			num -= 32;
+		}
+
+		while(num >= 4)
+		{
+			*pdword++ = *psword++;
+			num -= 4;
+		}
+
+		psrc = (const uint8_t *)psword;
+	}
+	else
+	{
+		/* 每个目的字由相邻的两个源字拼接而成 */
+		shift = ((uint32_t)psrc & 0x03) << 3;
+		psword = (const uint32_t *)(psrc - ((uint32_t)psrc & 0x03));
+		w0 = *psword++;
+
+		while(num >= 4)
+		{
+			w1 = *psword++;
+			*pdword++ = (w0 >> shift) | (w1 << (32 - shift));
+			w0 = w1;
+			num -= 4;
+		}
+
+		psrc = (const uint8_t *)(psword - 1) + (shift >> 3);
+	}
+
+	pdest = (uint8_t *)pdword;
 	while(num--)
 		*pdest++ = *psrc++;
 
 	return dest;
 }
+#endif
 
 /********************************************************************************
 * 函数: void *memmove(__in void *dest, __in const void *src, __in size_t count)
-* 描述: 用于从src拷贝count个字符到dest
+* 描述: 用于从src拷贝count个字符到dest，区域可以重叠. dest在src之前或者不重叠时
+       使用memcpy从前往后拷贝，否则从后往前拷贝
 * 输入: src: 源地址
 		count: 拷贝的数量
 * 输出: dest: 目的地地址
@@ -421,22 +534,41 @@ void *memcpy(__out void *dest, __in const void *src, __in size_t num)
 **********************************************************************************/
 void *memmove(__in void *dest, __in const void *src, __in size_t count)
 {
-	int8_t *pdest, *psrc;
-	if(dest <= src)
-	{
-		pdest = (int8_t *)dest;
-		psrc = (int8_t *)src;
-		while(count--)
-			*pdest++ = *psrc++;
-	}
-	else
+	uint8_t *pdest;
+	const uint8_t *psrc;
+	uint32_t *pdword;
+	const uint32_t *psword;
+
+	if((dest <= src) || ((const uint8_t *)src + count <= (uint8_t *)dest))
+		return memcpy(dest, src, count);
+
+	pdest = (uint8_t *)dest + count;
+	psrc = (const uint8_t *)src + count;
+
+	/* 相对对齐时结尾对齐之后按字拷贝 */
+	if(WORD_ALIGNED((uint32_t)pdest ^ (uint32_t)psrc))
 	{
-		pdest = (int8_t *)dest + count;
-		psrc = (int8_t *)src + count;
-		while(count--)
-			*pdest-- = *psrc--;
+		while(count && !WORD_ALIGNED(pdest))
+		{
+			*--pdest = *--psrc;
+			count--;
+		}
+
+		pdword = (uint32_t *)pdest;
+		psword = (const uint32_t *)psrc;
+		while(count >= 4)
+		{
+			*--pdword = *--psword;
+			count -= 4;
+		}
+
+		pdest = (uint8_t *)pdword;
+		psrc = (const uint8_t *)psword;
 	}
 
+	while(count--)
+		*--pdest = *--psrc;
+
 	return dest;
 }
 
@@ -485,9 +617,27 @@ int32_t memcmp(__in const void *buf1, __in const void *buf2, __in size_t count)
 	const uint8_t *pbuf1 = (uint8_t *)buf1, *pbuf2 = (uint8_t *)buf2;
 	int32_t rval = 0;
 
+	/* 相对字对齐时先逐字节比较到字对齐，再按字比较，找到不相等的字之后再按字节比较 */
+	if(WORD_ALIGNED((uint32_t)pbuf1 ^ (uint32_t)pbuf2))
+	{
+		for(; count && !WORD_ALIGNED(pbuf1); count--)
+		{
+			rval = *pbuf1++ - *pbuf2++;
+			if(rval != 0)
+				return rval;
+		}
+
+		while((count >= 4) && (*(const uint32_t *)pbuf1 == *(const uint32_t *)pbuf2))
+		{
+			pbuf1 += 4;
+			pbuf2 += 4;
+			count -= 4;
+		}
+	}
+
 	while(count--)
 	{
-		rval = *pbuf1 - *pbuf2;
+		rval = *pbuf1++ - *pbuf2++;
 		if(rval != 0)
 			break;
 	}
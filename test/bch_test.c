@@ -0,0 +1,375 @@
+/*
+* lib/bch.c软件BCH编解码的主机端正确性测试和速度测试
+*
+* 编译运行(在源码顶层目录):
+*   gcc -O2 -fno-builtin -Wno-pointer-to-int-cast -Iinclude \
+*       test/bch_test.c -o bch_test && ./bch_test
+*
+* 直接包含lib/bch.c，dlmalloc使用测试中的静态内存池. 每512字节数据块
+* 使用GF(2^13)，和nand_bch_init为512字节ecc块选择的m相同. 测试0位、1位到
+* t位错误能够纠正，t+1位错误报告-EBADMSG(或者纠正到另一个合法码字)，速度
+* 测试给出0位、1位和t位错误时每块的解码时钟周期数
+*/
+#include "../lib/bch.c"
+
+
+/* 主机c库函数 */
+extern int printf(const char *fmt, ...);
+extern long clock(void);
+
+#define CLOCKS_PER_SEC    1000000
+
+#define BCH_BLOCK         512
+#define BCH_M             13
+
+#define ARRAY_SIZE(a)     (sizeof(a) / sizeof((a)[0]))
+
+/* bch_init使用的内存，测试中只分配不释放 */
+static uint8_t heap[1 << 20] __attribute__((aligned(8)));
+static uint32_t heap_used;
+
+void *dlmalloc(size_t bytes)
+{
+    void *p;
+
+    bytes = (bytes + 7) & ~7;
+    if(heap_used + bytes > sizeof(heap))
+        return NULL;
+
+    p = heap + heap_used;
+    heap_used += bytes;
+
+    return p;
+}
+
+void dlfree(char *mem)
+{
+}
+
+static uint8_t block[BCH_BLOCK];
+static uint8_t saved[BCH_BLOCK];
+
+static int failures;
+
+/* 伪随机数，保证每次运行结果相同 */
+static uint32_t rand_state = 0x13579bdf;
+
+static uint32_t rand32(void)
+{
+    rand_state = rand_state * 1103515245 + 12345;
+    return rand_state >> 8;
+}
+
+static void copy(uint8_t *dest, const uint8_t *src, int len)
+{
+    while(len--)
+        *dest++ = *src++;
+}
+
+static int same(const uint8_t *a, const uint8_t *b, int len)
+{
+    for(; len; len--)
+    {
+        if(*a++ != *b++)
+            return 0;
+    }
+
+    return 1;
+}
+
+static void check(int cond, const char *name, int arg)
+{
+    if(cond)
+        return;
+
+    failures++;
+    if(failures <= 20)
+        printf("FAIL %s (%d)\n", name, arg);
+}
+
+
+/*
+* 在码字中翻转一位. 码字的位序号和bch_decode的errloc相同: 0~ecc_bits-1在ecc
+* 区，ecc最后一位是0；之后是数据区，数据最后一个字节的最低位是ecc_bits
+*/
+static void flip(struct bch_control *bch, uint8_t *data, uint8_t *ecc, uint32_t pos)
+{
+    uint32_t q;
+
+    if(pos < bch->ecc_bits)
+    {
+        q = bch->ecc_bits - 1 - pos;
+        ecc[q >> 3] ^= 0x80 >> (q & 0x07);
+    }
+    else
+    {
+        q = pos - bch->ecc_bits;
+        data[BCH_BLOCK - 1 - (q >> 3)] ^= 1 << (q & 0x07);
+    }
+}
+
+/* 在码字中选择count个不同的位置 */
+static void pick(struct bch_control *bch, uint32_t *pos, uint32_t count)
+{
+    uint32_t nbits = BCH_BLOCK * 8 + bch->ecc_bits;
+    uint32_t i, j;
+
+    for(i = 0; i < count; i++)
+    {
+        do
+        {
+            pos[i] = rand32() % nbits;
+            for(j = 0; (j < i) && (pos[j] != pos[i]); j++)
+                ;
+        } while(j < i);
+    }
+}
+
+/*
+* 注入count位错误后解码: 数据区的错误体现在重新计算的ecc中，ecc区的错误
+* 体现在读回的ecc中. 返回bch_decode的结果
+*/
+static int32_t inject_decode(struct bch_control *bch, const uint8_t *good, uint32_t count)
+{
+    uint8_t recv[BCH_MAX_T * BCH_MAX_M / 8 + 1], calc[BCH_MAX_T * BCH_MAX_M / 8 + 1];
+    uint32_t pos[BCH_MAX_T + 1];
+    uint32_t i;
+
+    copy(block, saved, BCH_BLOCK);
+    copy(recv, good, bch->ecc_bytes);
+
+    pick(bch, pos, count);
+    for(i = 0; i < count; i++)
+        flip(bch, block, recv, pos[i]);
+
+    bch_encode(bch, block, BCH_BLOCK, calc);
+
+    return bch_decode(bch, block, BCH_BLOCK, recv, calc);
+}
+
+/* 0位、1位和2~t位错误都能纠正，返回值是错误位数 */
+static void test_correct(struct bch_control *bch)
+{
+    uint8_t good[BCH_MAX_T * BCH_MAX_M / 8 + 1];
+    uint32_t n, count;
+    int32_t ret;
+
+    for(n = 0; n < BCH_BLOCK; n++)
+        saved[n] = (uint8_t)rand32();
+    bch_encode(bch, saved, BCH_BLOCK, good);
+
+    ret = inject_decode(bch, good, 0);
+    check(ret == 0, "no error", bch->t);
+    check(same(block, saved, BCH_BLOCK), "no error data untouched", bch->t);
+
+    for(count = 1; count <= bch->t; count++)
+    {
+        for(n = 0; n < 500; n++)
+        {
+            ret = inject_decode(bch, good, count);
+            check(ret == (int32_t)count, "errors corrected", count);
+            check(same(block, saved, BCH_BLOCK), "errors restored", count);
+        }
+    }
+}
+
+/* 数据区每一位单独翻转都能纠正 */
+static void test_every_bit(struct bch_control *bch)
+{
+    uint8_t good[BCH_MAX_T * BCH_MAX_M / 8 + 1], calc[BCH_MAX_T * BCH_MAX_M / 8 + 1];
+    uint32_t bit;
+    int32_t ret;
+
+    for(bit = 0; bit < BCH_BLOCK; bit++)
+        saved[bit] = (uint8_t)rand32();
+    bch_encode(bch, saved, BCH_BLOCK, good);
+
+    for(bit = 0; bit < BCH_BLOCK * 8; bit++)
+    {
+        copy(block, saved, BCH_BLOCK);
+        block[bit >> 3] ^= 0x80 >> (bit & 0x07);
+        bch_encode(bch, block, BCH_BLOCK, calc);
+
+        ret = bch_decode(bch, block, BCH_BLOCK, good, calc);
+        check(ret == 1, "single bit corrected", bit);
+        check(same(block, saved, BCH_BLOCK), "single bit restored", bit);
+    }
+}
+
+/*
+* t+1位错误超出纠错能力，应该报告-EBADMSG. 错误图样离另一个码字不超过t位时
+* 解码器会纠正到那个码字(BCH码固有的误纠正，概率随t增大迅速下降)，这时
+* 纠正结果必须是合法码字并且不是原来的数据. t>=4时误纠正不超过1%
+*/
+static void test_uncorrectable(struct bch_control *bch)
+{
+    const uint32_t loops = 2000;
+    uint8_t good[BCH_MAX_T * BCH_MAX_M / 8 + 1], calc[BCH_MAX_T * BCH_MAX_M / 8 + 1];
+    uint8_t recv[BCH_MAX_T * BCH_MAX_M / 8 + 1];
+    uint32_t pos[BCH_MAX_T + 1];
+    uint32_t n, i, miscorrected = 0;
+    int32_t ret;
+
+    for(n = 0; n < BCH_BLOCK; n++)
+        saved[n] = (uint8_t)rand32();
+    bch_encode(bch, saved, BCH_BLOCK, good);
+
+    for(n = 0; n < loops; n++)
+    {
+        copy(block, saved, BCH_BLOCK);
+        copy(recv, good, bch->ecc_bytes);
+
+        pick(bch, pos, bch->t + 1);
+        for(i = 0; i <= bch->t; i++)
+            flip(bch, block, recv, pos[i]);
+
+        bch_encode(bch, block, BCH_BLOCK, calc);
+        ret = bch_decode(bch, block, BCH_BLOCK, recv, calc);
+        if(ret == -EBADMSG)
+            continue;
+
+        /* 误纠正: 把ecc区的纠正也加上之后必须是合法码字 */
+        miscorrected++;
+        check((ret > 0) && (ret <= (int32_t)bch->t), "t+1 errors miscorrected count", n);
+        for(i = 0; (ret > 0) && (i < (uint32_t)ret); i++)
+        {
+            if(bch->errloc[i] < bch->ecc_bits)
+                flip(bch, block, recv, bch->errloc[i]);
+        }
+
+        bch_encode(bch, block, BCH_BLOCK, calc);
+        check(same(calc, recv, bch->ecc_bytes), "t+1 errors miscorrected to codeword", n);
+        check(!same(block, saved, BCH_BLOCK), "t+1 errors miscorrected data", n);
+    }
+
+    if(bch->t >= 4)
+        check(miscorrected * 100 <= loops, "t+1 errors rejected", miscorrected);
+
+    printf("t=%u: %u of %u t+1 bit error patterns rejected\n",
+           bch->t, loops - miscorrected, loops);
+}
+
+/* 擦除页: 数据和ecc全部为0xff时编码结果不是0xff，由nand层单独处理，这里只
+   检查全0数据的ecc为0，解码不报告错误 */
+static void test_zero(struct bch_control *bch)
+{
+    uint8_t ecc[BCH_MAX_T * BCH_MAX_M / 8 + 1];
+    uint32_t i, zero = 1;
+
+    for(i = 0; i < BCH_BLOCK; i++)
+        block[i] = 0;
+
+    bch_encode(bch, block, BCH_BLOCK, ecc);
+    for(i = 0; i < bch->ecc_bytes; i++)
+        zero &= !ecc[i];
+
+    check(zero, "zero data zero ecc", bch->t);
+    check(bch_decode(bch, block, BCH_BLOCK, ecc, ecc) == 0, "zero data decode", bch->t);
+}
+
+
+/* 速度测试，x86上使用时间戳计数器统计时钟周期 */
+static uint64_t now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return (uint64_t)clock();
+#endif
+}
+
+static void bench(struct bch_control *bch)
+{
+    const uint32_t loops = 2000;
+    uint8_t good[BCH_MAX_T * BCH_MAX_M / 8 + 1];
+    uint8_t recv[BCH_MAX_T][BCH_MAX_T * BCH_MAX_M / 8 + 1];
+    uint8_t calc[BCH_MAX_T][BCH_MAX_T * BCH_MAX_M / 8 + 1];
+    static uint8_t bad[BCH_MAX_T][BCH_BLOCK];
+    uint32_t counts[3] = {0, 1, bch->t};
+    uint32_t pos[BCH_MAX_T + 1];
+    uint64_t start, t_enc, t_dec;
+    uint32_t n, c, k, i;
+
+    for(n = 0; n < BCH_BLOCK; n++)
+        saved[n] = (uint8_t)rand32();
+
+    start = now();
+    for(n = 0; n < loops; n++)
+        bch_encode(bch, saved, BCH_BLOCK, good);
+    t_enc = now() - start;
+
+    printf("t=%u, %u ecc bytes: encode %u",
+           bch->t, bch->ecc_bytes, (unsigned)(t_enc / loops));
+
+    for(c = 0; c < ARRAY_SIZE(counts); c++)
+    {
+        /* 预先准备几组错误，计时只包括解码，每次解码前恢复出错的数据 */
+        for(k = 0; k < BCH_MAX_T; k++)
+        {
+            copy(bad[k], saved, BCH_BLOCK);
+            copy(recv[k], good, bch->ecc_bytes);
+
+            pick(bch, pos, counts[c]);
+            for(i = 0; i < counts[c]; i++)
+                flip(bch, bad[k], recv[k], pos[i]);
+
+            bch_encode(bch, bad[k], BCH_BLOCK, calc[k]);
+        }
+
+        t_dec = 0;
+        for(n = 0; n < loops; n++)
+        {
+            k = n % BCH_MAX_T;
+            copy(block, bad[k], BCH_BLOCK);
+
+            start = now();
+            bch_decode(bch, block, BCH_BLOCK, recv[k], calc[k]);
+            t_dec += now() - start;
+        }
+
+        printf(", decode %u errors %u", counts[c], (unsigned)(t_dec / loops));
+    }
+
+    printf(" %s per %u byte block\n",
+#if defined(__x86_64__) || defined(__i386__)
+           "cycles",
+#else
+           "clock ticks x 1000",
+#endif
+           BCH_BLOCK);
+}
+
+
+int main(int argc, char **argv)
+{
+    static const uint32_t strengths[] = {2, 4, 8};
+    struct bch_control *bch[ARRAY_SIZE(strengths)];
+    uint32_t i;
+
+    for(i = 0; i < ARRAY_SIZE(strengths); i++)
+    {
+        bch[i] = bch_init(BCH_M, strengths[i]);
+        check(bch[i] != NULL, "bch_init", strengths[i]);
+        if(!bch[i])
+            continue;
+
+        test_correct(bch[i]);
+        test_every_bit(bch[i]);
+        test_uncorrectable(bch[i]);
+        test_zero(bch[i]);
+    }
+
+    printf("bch vectors: %s (%d failures)\n", failures ? "FAIL" : "PASS", failures);
+    if(failures)
+        return 1;
+
+    /* 带任意参数时只做正确性测试 */
+    if(argc < 2)
+    {
+        printf("\n");
+        for(i = 0; i < ARRAY_SIZE(strengths); i++)
+            bench(bch[i]);
+    }
+
+    return 0;
+}
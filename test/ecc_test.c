@@ -0,0 +1,355 @@
+/*
+* lib/ecc.c软件Hamming ecc的主机端测试向量和速度测试
+*
+* 编译运行(在源码顶层目录):
+*   gcc -O2 -fno-builtin -Wno-pointer-to-int-cast -Iinclude \
+*       test/ecc_test.c -o ecc_test && ./ecc_test
+*
+* 直接包含lib/ecc.c，按字计算的ecc_calculate和原来逐字节查表的
+* ecc_calculate_bytes都可以访问. 参考实现按Hamming码的定义逐位计算行列极性，
+* 不使用ecc_precalc_table
+*/
+#include "../lib/ecc.c"
+
+
+/* 主机c库函数 */
+extern int printf(const char *fmt, ...);
+extern long clock(void);
+
+#define CLOCKS_PER_SEC    1000000
+
+#define ECC_BLOCK         256
+
+#define ARRAY_SIZE(a)     (sizeof(a) / sizeof((a)[0]))
+
+static uint8_t block[ECC_BLOCK + 4] __attribute__((aligned(8)));
+static uint8_t saved[ECC_BLOCK];
+
+static int failures;
+
+
+/* 伪随机数，保证每次运行结果相同 */
+static uint32_t rand_state = 0x2468ace1;
+
+static uint32_t rand32(void)
+{
+    rand_state = rand_state * 1103515245 + 12345;
+    return rand_state >> 8;
+}
+
+static void copy(uint8_t *dest, const uint8_t *src, int len)
+{
+    while(len--)
+        *dest++ = *src++;
+}
+
+static int same(const uint8_t *a, const uint8_t *b, int len)
+{
+    for(; len; len--)
+    {
+        if(*a++ != *b++)
+            return 0;
+    }
+
+    return 1;
+}
+
+static void check(int cond, const char *name, int arg)
+{
+    if(cond)
+        return;
+
+    failures++;
+    if(failures <= 20)
+        printf("FAIL %s (%d)\n", name, arg);
+}
+
+
+/*
+* 按定义计算ecc: 列极性CP0~CP5是所有字节指定位的奇偶，行极性是字节序号
+* 第k位为1(reg2)和为0(reg3)的所有字节的奇偶. 字节排列和ecc_make_code相同
+*/
+static void ref_ecc(const uint8_t *data, uint8_t *ecc)
+{
+    static const uint8_t cp_mask[6] = {0x55, 0xaa, 0x33, 0xcc, 0x0f, 0xf0};
+    uint32_t reg1 = 0, reg2 = 0, reg3 = 0;
+    uint32_t i, k, p, bit;
+
+    for(k = 0; k < 6; k++)
+    {
+        p = 0;
+        for(i = 0; i < ECC_BLOCK; i++)
+        {
+            for(bit = 0; bit < 8; bit++)
+            {
+                if(cp_mask[k] & (1 << bit))
+                    p ^= (data[i] >> bit) & 0x01;
+            }
+        }
+        reg1 |= p << k;
+    }
+
+    for(i = 0; i < ECC_BLOCK; i++)
+    {
+        p = 0;
+        for(bit = 0; bit < 8; bit++)
+            p ^= (data[i] >> bit) & 0x01;
+
+        for(k = 0; k < 8; k++)
+        {
+            if(i & (1 << k))
+                reg2 ^= p << k;
+            else
+                reg3 ^= p << k;
+        }
+    }
+
+    ecc_make_code(reg1, reg2, reg3, ecc);
+}
+
+
+/* 固定测试向量，结果由按定义计算的参考实现得到 */
+struct ecc_vector
+{
+    const char *name;
+    uint8_t ecc[3];
+};
+
+static void fill_vector(int n, uint8_t *data)
+{
+    int i;
+
+    for(i = 0; i < ECC_BLOCK; i++)
+    {
+        switch(n)
+        {
+        case 0: data[i] = 0xff; break;                  /* 擦除页 */
+        case 1: data[i] = 0x00; break;
+        case 2: data[i] = (uint8_t)i; break;
+        case 3: data[i] = (i == 0) ? 0x01 : 0x00; break;
+        case 4: data[i] = (i == 255) ? 0x80 : 0x00; break;
+        case 5: data[i] = (uint8_t)(i * 37 + 11); break;
+        case 6: data[i] = 0x55; break;
+        default: data[i] = (i == 100) ? 0xfb : 0xff; break;
+        }
+    }
+}
+
+static const struct ecc_vector vectors[] =
+{
+    {"all 0xff",          {0xff, 0xff, 0xff}},
+    {"all 0x00",          {0xff, 0xff, 0xff}},
+    {"ramp",              {0xff, 0xff, 0xff}},
+    {"byte 0 bit 0",      {0x55, 0x55, 0xab}},
+    {"byte 255 bit 7",    {0xaa, 0xaa, 0x57}},
+    {"i * 37 + 11",       {0x3f, 0xff, 0xff}},
+    {"all 0x55",          {0xff, 0xff, 0xff}},
+    {"0xff, byte 100 bit 2 clear", {0x69, 0x65, 0x9b}},
+};
+
+static void test_vectors(void)
+{
+    uint8_t ecc[3], ref[3], old[3];
+    uint32_t n, ofs;
+
+    for(n = 0; n < ARRAY_SIZE(vectors); n++)
+    {
+        /* 对齐和不对齐地址都要得到相同结果 */
+        for(ofs = 0; ofs < 4; ofs++)
+        {
+            fill_vector(n, block + ofs);
+            ecc_calculate(block + ofs, ecc);
+            check(same(ecc, vectors[n].ecc, 3), vectors[n].name, ofs);
+        }
+
+        fill_vector(n, block);
+        ref_ecc(block, ref);
+        ecc_calculate_bytes(block, old);
+        check(same(ref, vectors[n].ecc, 3), "reference", n);
+        check(same(old, vectors[n].ecc, 3), "byte table", n);
+    }
+}
+
+/* 随机数据: 按字计算、逐字节查表和参考实现完全一致 */
+static void test_random(void)
+{
+    uint8_t ecc[3], ref[3], old[3];
+    uint32_t n, i, ofs;
+
+    for(n = 0; n < 2000; n++)
+    {
+        ofs = n & 0x03;
+        for(i = 0; i < ECC_BLOCK; i++)
+            block[ofs + i] = (uint8_t)rand32();
+
+        ecc_calculate(block + ofs, ecc);
+        ecc_calculate_bytes(block + ofs, old);
+        ref_ecc(block + ofs, ref);
+
+        check(same(ecc, ref, 3), "random vs reference", n);
+        check(same(old, ref, 3), "random byte table vs reference", n);
+    }
+}
+
+/* 数据区每一位单独翻转都能纠正 */
+static void test_single_bit(void)
+{
+    uint8_t good[3], calc[3];
+    uint32_t i, byte, bit;
+    int32_t ret;
+
+    for(i = 0; i < ECC_BLOCK; i++)
+        block[i] = (uint8_t)rand32();
+    copy(saved, block, ECC_BLOCK);
+    ecc_calculate(block, good);
+
+    for(byte = 0; byte < ECC_BLOCK; byte++)
+    {
+        for(bit = 0; bit < 8; bit++)
+        {
+            block[byte] ^= 1 << bit;
+            ecc_calculate(block, calc);
+            ret = ecc_correct_data(block, good, calc);
+
+            check(ret == 1, "single bit corrected", byte * 8 + bit);
+            check(same(block, saved, ECC_BLOCK), "single bit restored", byte * 8 + bit);
+            copy(block, saved, ECC_BLOCK);
+        }
+    }
+}
+
+/* ecc本身一位出错，数据不变 */
+static void test_ecc_bit(void)
+{
+    uint8_t good[3], read[3];
+    uint32_t bit;
+    int32_t ret;
+
+    ecc_calculate(saved, good);
+    copy(block, saved, ECC_BLOCK);
+
+    /* ecc[2]的低两位固定为1，不参与校验 */
+    for(bit = 2; bit < 24; bit++)
+    {
+        copy(read, good, 3);
+        read[bit >> 3] ^= 1 << (bit & 0x07);
+
+        ret = ecc_correct_data(block, read, good);
+        check(ret == 2, "ecc bit error detected", bit);
+        check(same(block, saved, ECC_BLOCK), "ecc bit error data untouched", bit);
+    }
+}
+
+/* 数据区两位出错不能纠正，数据不被修改 */
+static void test_uncorrectable(void)
+{
+    uint8_t good[3], calc[3];
+    uint32_t n, b1, b2;
+    int32_t ret;
+
+    ecc_calculate(saved, good);
+
+    for(n = 0; n < 5000; n++)
+    {
+        b1 = rand32() % (ECC_BLOCK * 8);
+        do
+        {
+            b2 = rand32() % (ECC_BLOCK * 8);
+        } while(b2 == b1);
+
+        copy(block, saved, ECC_BLOCK);
+        block[b1 >> 3] ^= 1 << (b1 & 0x07);
+        block[b2 >> 3] ^= 1 << (b2 & 0x07);
+
+        ecc_calculate(block, calc);
+        ret = ecc_correct_data(block, good, calc);
+        check(ret == -EBADMSG, "double bit rejected", n);
+
+        block[b1 >> 3] ^= 1 << (b1 & 0x07);
+        block[b2 >> 3] ^= 1 << (b2 & 0x07);
+        check(same(block, saved, ECC_BLOCK), "double bit data untouched", n);
+    }
+}
+
+/* 擦除页的ecc全部为0xff，读回时不报告错误 */
+static void test_erased(void)
+{
+    uint8_t erased_ecc[3] = {0xff, 0xff, 0xff};
+    uint8_t calc[3];
+    uint32_t i;
+
+    for(i = 0; i < ECC_BLOCK; i++)
+        block[i] = 0xff;
+
+    ecc_calculate(block, calc);
+    check(ecc_correct_data(block, erased_ecc, calc) == 0, "erased page", 0);
+}
+
+
+/* 速度测试，x86上使用时间戳计数器统计时钟周期 */
+static uint64_t now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return (uint64_t)clock();
+#endif
+}
+
+static void bench(void)
+{
+    const uint32_t loops = 200000;
+    uint8_t ecc[3] = {0};
+    uint64_t start, t_new, t_old;
+    uint32_t n;
+
+    for(n = 0; n < ECC_BLOCK; n++)
+        block[n] = (uint8_t)rand32();
+
+    start = now();
+    for(n = 0; n < loops; n++)
+    {
+        block[n & 0xff] ^= ecc[0];
+        ecc_calculate(block, ecc);
+    }
+    t_new = now() - start;
+
+    start = now();
+    for(n = 0; n < loops; n++)
+    {
+        block[n & 0xff] ^= ecc[0];
+        ecc_calculate_bytes(block, ecc);
+    }
+    t_old = now() - start;
+
+    /* 每KiB是4个256字节块 */
+    printf("\n%s/KiB: ecc_calculate %u, byte table %u (%u.%02ux)\n",
+#if defined(__x86_64__) || defined(__i386__)
+           "cycles",
+#else
+           "clock ticks x 1000",
+#endif
+           (unsigned)(t_new * 4 / loops), (unsigned)(t_old * 4 / loops),
+           (unsigned)(t_old / t_new), (unsigned)((t_old * 100 / t_new) % 100));
+}
+
+
+int main(int argc, char **argv)
+{
+    test_vectors();
+    test_random();
+    test_single_bit();
+    test_ecc_bit();
+    test_uncorrectable();
+    test_erased();
+
+    printf("ecc vectors: %s (%d failures)\n", failures ? "FAIL" : "PASS", failures);
+    if(failures)
+        return 1;
+
+    /* 带任意参数时只做正确性测试 */
+    if(argc < 2)
+        bench();
+
+    return 0;
+}
@@ -0,0 +1,363 @@
+/*
+* lib/string.c中memcpy/memset/memmove/memcmp的主机端正确性测试和速度测试
+*
+* 编译运行(在源码顶层目录):
+*   gcc -O2 -fno-builtin -fno-tree-loop-distribute-patterns -Wno-pointer-to-int-cast \
+*       -D_CONFIG_H_ -Iinclude \
+*       test/string_test.c lib/string.c -o string_test && ./string_test
+*
+* -D_CONFIG_H_跳过板级配置，测试的是lib/string.c中的C实现，而不是
+* CONFIG_USE_ARCH_MEMCPY/MEMSET选择的arch/arm/lib汇编版本. 可执行文件中的
+* mem*函数就是被测试的实现，参考实现使用逐字节循环
+*/
+#include "string.h"
+
+
+/* 主机c库函数 */
+extern int printf(const char *fmt, ...);
+extern long clock(void);
+
+#define CLOCKS_PER_SEC    1000000
+
+/* lib/string.c中strdup使用，测试不涉及 */
+void *dlmalloc(size_t bytes)
+{
+    return NULL;
+}
+
+/* 测试缓冲区大小，保证最大长度加上对齐偏移和两侧保护区不越界 */
+#define GUARD             16
+#define MAX_ALIGN         8
+#define MAX_LEN           300
+#define BUF_SIZE          (GUARD + MAX_ALIGN + MAX_LEN + GUARD)
+
+/* 速度测试缓冲区 */
+#define BENCH_SIZE        (64 * 1024)
+
+static uint8_t buf_a[BUF_SIZE] __attribute__((aligned(8)));
+static uint8_t buf_b[BUF_SIZE] __attribute__((aligned(8)));
+static uint8_t buf_ref[BUF_SIZE] __attribute__((aligned(8)));
+
+static uint8_t bench_src[BENCH_SIZE + MAX_ALIGN] __attribute__((aligned(8)));
+static uint8_t bench_dst[BENCH_SIZE + MAX_ALIGN] __attribute__((aligned(8)));
+
+static int failures;
+
+/* 长度表: 0~MAX_LEN全部覆盖太慢，取边界附近的长度 */
+static const size_t lengths[] =
+{
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 11, 12, 15, 16, 17, 23, 31, 32, 33,
+    35, 36, 47, 63, 64, 65, 95, 127, 128, 129, 255, 256, 257, 300
+};
+
+#define ARRAY_SIZE(a)    (sizeof(a) / sizeof((a)[0]))
+
+
+/* 伪随机数，保证每次运行结果相同 */
+static uint32_t rand_state = 0x12345678;
+
+static uint8_t rand8(void)
+{
+    rand_state = rand_state * 1103515245 + 12345;
+    return (uint8_t)(rand_state >> 16);
+}
+
+static void fill_rand(uint8_t *buf, size_t len)
+{
+    while(len--)
+        *buf++ = rand8();
+}
+
+/* 逐字节参考实现 */
+static void ref_memcpy(uint8_t *dest, const uint8_t *src, size_t len)
+{
+    while(len--)
+        *dest++ = *src++;
+}
+
+static void ref_memmove(uint8_t *dest, const uint8_t *src, size_t len)
+{
+    if(dest <= src)
+    {
+        while(len--)
+            *dest++ = *src++;
+    }
+    else
+    {
+        while(len--)
+            dest[len] = src[len];
+    }
+}
+
+static void ref_memset(uint8_t *dest, uint8_t ch, size_t len)
+{
+    while(len--)
+        *dest++ = ch;
+}
+
+static int ref_memcmp(const uint8_t *a, const uint8_t *b, size_t len)
+{
+    for(; len; len--, a++, b++)
+    {
+        if(*a != *b)
+            return *a - *b;
+    }
+
+    return 0;
+}
+
+static int sign(int val)
+{
+    return (val > 0) - (val < 0);
+}
+
+static void check(int cond, const char *name, int a1, int a2, size_t len, int pos)
+{
+    if(cond)
+        return;
+
+    failures++;
+    if(failures <= 20)
+        printf("FAIL %s: align %d/%d len %u pos %d\n", name, a1, a2, (unsigned)len, pos);
+}
+
+
+/* memcpy: 所有源/目的对齐组合和长度，检查数据和两侧保护区 */
+static void test_memcpy(void)
+{
+    int a1, a2;
+    size_t i, len;
+    void *ret;
+
+    for(a1 = 0; a1 < MAX_ALIGN; a1++)
+    {
+        for(a2 = 0; a2 < MAX_ALIGN; a2++)
+        {
+            for(i = 0; i < ARRAY_SIZE(lengths); i++)
+            {
+                len = lengths[i];
+                fill_rand(buf_a, BUF_SIZE);
+                fill_rand(buf_b, BUF_SIZE);
+                ref_memcpy(buf_ref, buf_b, BUF_SIZE);
+                ref_memcpy(buf_ref + GUARD + a2, buf_a + GUARD + a1, len);
+
+                ret = memcpy(buf_b + GUARD + a2, buf_a + GUARD + a1, len);
+                check(ret == buf_b + GUARD + a2, "memcpy ret", a1, a2, len, -1);
+                check(!ref_memcmp(buf_b, buf_ref, BUF_SIZE), "memcpy", a1, a2, len, -1);
+            }
+        }
+    }
+}
+
+/* memmove: 同一缓冲区内向前和向后重叠，以及不重叠 */
+static void test_memmove(void)
+{
+    int a1, a2, dist;
+    size_t i, len;
+    uint8_t *src, *dest;
+
+    for(a1 = 0; a1 < MAX_ALIGN; a1++)
+    {
+        for(a2 = 0; a2 < MAX_ALIGN; a2++)
+        {
+            for(i = 0; i < ARRAY_SIZE(lengths); i++)
+            {
+                len = lengths[i];
+                if(len > MAX_LEN - 2 * GUARD)
+                    continue;
+
+                for(dist = -2 * GUARD; dist <= 2 * GUARD; dist += GUARD)
+                {
+                    src = buf_b + 2 * GUARD + a1;
+                    dest = buf_b + 2 * GUARD + a2 + dist;
+
+                    fill_rand(buf_b, BUF_SIZE);
+                    ref_memcpy(buf_ref, buf_b, BUF_SIZE);
+                    ref_memmove(buf_ref + (dest - buf_b), buf_ref + (src - buf_b), len);
+
+                    memmove(dest, src, len);
+                    check(!ref_memcmp(buf_b, buf_ref, BUF_SIZE), "memmove", a1, a2, len, dist);
+                }
+            }
+        }
+    }
+}
+
+/* memset: 所有对齐和长度，包括0x00/0xff和最高位为1的字节 */
+static void test_memset(void)
+{
+    static const uint8_t values[] = {0x00, 0xff, 0x5a, 0x80};
+    int a1, v;
+    size_t i, len;
+    void *ret;
+
+    for(a1 = 0; a1 < MAX_ALIGN; a1++)
+    {
+        for(i = 0; i < ARRAY_SIZE(lengths); i++)
+        {
+            len = lengths[i];
+            for(v = 0; v < (int)ARRAY_SIZE(values); v++)
+            {
+                fill_rand(buf_b, BUF_SIZE);
+                ref_memcpy(buf_ref, buf_b, BUF_SIZE);
+                ref_memset(buf_ref + GUARD + a1, values[v], len);
+
+                ret = memset(buf_b + GUARD + a1, values[v], len);
+                check(ret == buf_b + GUARD + a1, "memset ret", a1, 0, len, -1);
+                check(!ref_memcmp(buf_b, buf_ref, BUF_SIZE), "memset", a1, 0, len, v);
+            }
+        }
+    }
+}
+
+/*
+* memcmp: 所有对齐组合和长度，相等以及在每个位置出现第一个不同字节，不同字节
+* 分别取大于和小于，并覆盖最高位为1的字节(按无符号比较)和不同字节之后还有
+* 反向差异的情况
+*/
+static void test_memcmp(void)
+{
+    static const uint8_t pairs[][2] =
+    {
+        {0x01, 0x02}, {0x02, 0x01}, {0x7f, 0x80}, {0x80, 0x7f}, {0x00, 0xff}, {0xff, 0x00}
+    };
+    uint8_t *p1, *p2;
+    int a1, a2, k, pos;
+    size_t i, len;
+
+    for(a1 = 0; a1 < MAX_ALIGN; a1++)
+    {
+        for(a2 = 0; a2 < MAX_ALIGN; a2++)
+        {
+            for(i = 0; i < ARRAY_SIZE(lengths); i++)
+            {
+                len = lengths[i];
+                p1 = buf_a + GUARD + a1;
+                p2 = buf_b + GUARD + a2;
+
+                /* 相等，比较范围之外的字节不同 */
+                fill_rand(buf_a, BUF_SIZE);
+                fill_rand(buf_b, BUF_SIZE);
+                ref_memcpy(p2, p1, len);
+                check(memcmp(p1, p2, len) == 0, "memcmp equal", a1, a2, len, -1);
+
+                for(pos = 0; pos < (int)len; pos++)
+                {
+                    for(k = 0; k < (int)ARRAY_SIZE(pairs); k++)
+                    {
+                        p1[pos] = pairs[k][0];
+                        p2[pos] = pairs[k][1];
+
+                        /* 后面的字节反向不同，结果只能由第一个不同字节决定 */
+                        if(pos + 1 < (int)len)
+                        {
+                            p1[pos + 1] = pairs[k][1];
+                            p2[pos + 1] = pairs[k][0];
+                        }
+
+                        check(sign(memcmp(p1, p2, len)) == sign(ref_memcmp(p1, p2, len)),
+                              "memcmp", a1, a2, len, pos);
+
+                        if(pos + 1 < (int)len)
+                            p2[pos + 1] = p1[pos + 1];
+                        p2[pos] = p1[pos];
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+/* 速度测试，返回MB/s */
+static unsigned bench_rate(long ticks, size_t bytes)
+{
+    if(ticks <= 0)
+        ticks = 1;
+
+    return (unsigned)((double)bytes * CLOCKS_PER_SEC / ticks / (1024 * 1024));
+}
+
+static void bench(void)
+{
+    static const size_t sizes[] = {64, 512, 2048, 4096, BENCH_SIZE};
+    static const int aligns[][2] = {{0, 0}, {1, 1}, {0, 1}, {0, 3}};
+    size_t i, loops, n, total;
+    int a;
+    long start, t_new, t_ref;
+
+    printf("\n%8s %6s %10s %10s %10s %10s %10s %10s\n", "size", "align",
+           "memcpy", "byte", "memset", "byte", "memcmp", "byte");
+
+    for(i = 0; i < ARRAY_SIZE(sizes); i++)
+    {
+        /* 每种大小处理大约64MiB */
+        loops = (64 * 1024 * 1024) / sizes[i];
+        total = loops * sizes[i];
+
+        for(a = 0; a < (int)ARRAY_SIZE(aligns); a++)
+        {
+            uint8_t *src = bench_src + aligns[a][0];
+            uint8_t *dst = bench_dst + aligns[a][1];
+            unsigned r[6];
+
+            start = clock();
+            for(n = 0; n < loops; n++)
+                memcpy(dst, src, sizes[i]);
+            t_new = clock() - start;
+            start = clock();
+            for(n = 0; n < loops; n++)
+                ref_memcpy(dst, src, sizes[i]);
+            t_ref = clock() - start;
+            r[0] = bench_rate(t_new, total);
+            r[1] = bench_rate(t_ref, total);
+
+            start = clock();
+            for(n = 0; n < loops; n++)
+                memset(dst, (int)n, sizes[i]);
+            t_new = clock() - start;
+            start = clock();
+            for(n = 0; n < loops; n++)
+                ref_memset(dst, (uint8_t)n, sizes[i]);
+            t_ref = clock() - start;
+            r[2] = bench_rate(t_new, total);
+            r[3] = bench_rate(t_ref, total);
+
+            ref_memcpy(dst, src, sizes[i]);
+            start = clock();
+            for(n = 0; n < loops; n++)
+                failures += (memcmp(dst, src, sizes[i]) != 0);
+            t_new = clock() - start;
+            start = clock();
+            for(n = 0; n < loops; n++)
+                failures += (ref_memcmp(dst, src, sizes[i]) != 0);
+            t_ref = clock() - start;
+            r[4] = bench_rate(t_new, total);
+            r[5] = bench_rate(t_ref, total);
+
+            printf("%8u %3d/%-2d %10u %10u %10u %10u %10u %10u\n", (unsigned)sizes[i],
+                   aligns[a][0], aligns[a][1], r[0], r[1], r[2], r[3], r[4], r[5]);
+        }
+    }
+
+    printf("(MB/s, \"byte\" is the byte-at-a-time reference loop)\n");
+}
+
+
+int main(int argc, char **argv)
+{
+    test_memcpy();
+    test_memmove();
+    test_memset();
+    test_memcmp();
+
+    printf("correctness: %s (%d failures)\n", failures ? "FAIL" : "PASS", failures);
+    if(failures)
+        return 1;
+
+    /* 带任意参数时只做正确性测试 */
+    if(argc < 2)
+        bench();
+
+    return failures ? 1 : 0;
+}